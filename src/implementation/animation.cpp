@@ -145,10 +145,10 @@ void resource::Animation::ReadSegment(int64_t frame, IKeyValueCollection &segmen
 	auto channelAttribute = dataChannel->FindValue<std::string>("m_szVariableName", "");
 
 	// Read container
-	auto *container = segment.FindBinaryBlob("m_container");
-	if(container == nullptr)
+	auto container = segment.FindBinaryBlobView("m_container");
+	if(container.has_value() == false)
 		return;
-	pragma::util::DataStream ds {container->data(), static_cast<uint32_t>(container->size())};
+	pragma::util::DataStream ds {const_cast<uint8_t *>(container->data()), static_cast<uint32_t>(container->size())};
 	ds->SetOffset(0);
 	auto elementIndexArray = dataChannel->FindArrayValues<int32_t>("m_nElementIndexArray");
 	auto numChannelElements = decodeKey.FindValue<int32_t>("m_nChannelElements", 0);
@@ -248,9 +248,15 @@ void resource::Animation::ConstructFromDesc(IKeyValueCollection &animDesc, IKeyV
 
 			// Only consider blocks that actual contain info for this frame
 			if(frameIndex >= startFrame && frameIndex <= endFrame) {
-				auto segmentIndexArray = frameBlock->FindArrayValues<int32_t>("m_segmentIndexArray");
+				// Avoid copying the indices for every frame if they're stored contiguously
+				std::vector<int32_t> segmentIndexArray {};
+				auto segmentIndices = frameBlock->FindArrayView<int32_t>("m_segmentIndexArray");
+				if(segmentIndices.has_value() == false) {
+					segmentIndexArray = frameBlock->FindArrayValues<int32_t>("m_segmentIndexArray");
+					segmentIndices = segmentIndexArray;
+				}
 
-				for(auto segmentIndex : segmentIndexArray) {
+				for(auto segmentIndex : *segmentIndices) {
 					auto segment = segmentArray.at(segmentIndex);
 					ReadSegment(frameIndex - startFrame, *segment, decodeKey, decoderArray, *frame, numFrames);
 				}
@@ -12,3 +12,28 @@ uint32_t resource::Block::GetOffset() const { return m_offset; }
 uint32_t resource::Block::GetSize() const { return m_size; }
 void resource::Block::SetOffset(uint32_t offset) { m_offset = offset; }
 void resource::Block::SetSize(uint32_t size) { m_size = size; }
+std::span<const uint8_t> resource::Block::ReadData(const Resource &resource, ufile::IFile &f, size_t size, std::vector<uint8_t> &buffer) const
+{
+	auto &mappedFile = resource.GetMappedFile();
+	if(mappedFile) {
+		auto data = mappedFile->GetData();
+		auto offset = f.Tell();
+		if(offset > data.size() || size > data.size() - offset)
+			throw std::runtime_error {"Block data exceeds file bounds"};
+		f.Seek(offset + size);
+		return data.subspan(offset, size);
+	}
+	buffer.resize(size);
+	f.Read(buffer.data(), size);
+	return buffer;
+}
+void resource::Block::ReadData(const Resource &resource, ufile::IFile &f, std::span<uint8_t> output) const
+{
+	if(resource.GetMappedFile()) {
+		std::vector<uint8_t> unused {};
+		auto data = ReadData(resource, f, output.size(), unused);
+		memcpy(output.data(), data.data(), data.size());
+		return;
+	}
+	f.Read(output.data(), output.size());
+}
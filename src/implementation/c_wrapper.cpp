@@ -14,6 +14,24 @@ struct ResourceWrapper {
 };
 static std::unique_ptr<ResourceWrapper> load_resource(const std::string &fileName, const std::optional<std::string> &path)
 {
+	auto assetLoader = [](const std::string &path) -> std::unique_ptr<ufile::IFile> {
+		auto fp = pragma::fs::open_system_file(path, pragma::fs::FileMode::Read | pragma::fs::FileMode::Binary);
+		if(!fp)
+			return nullptr;
+		return std::make_unique<pragma::fs::File>(fp);
+	};
+	source2::resource::ResourceLoadOptions loadOptions {};
+	loadOptions.memoryMap = true;
+	// Only opens system files, which doesn't depend on any shared state
+	loadOptions.threadSafeAssetLoader = true;
+	auto mappedFile = source2::resource::MappedFile::Open(fileName);
+	if(mappedFile) {
+		auto wrapper = std::make_unique<ResourceWrapper>();
+		wrapper->basePath = ufile::get_path_from_filename(fileName);
+		wrapper->resource = source2::load_resource(mappedFile, loadOptions, assetLoader);
+		return wrapper->resource ? std::move(wrapper) : nullptr;
+	}
+
 	auto fp = pragma::fs::open_system_file(fileName, pragma::fs::FileMode::Read | pragma::fs::FileMode::Binary);
 	if(fp == nullptr) {
 		if(path.has_value()) {
@@ -26,12 +44,7 @@ static std::unique_ptr<ResourceWrapper> load_resource(const std::string &fileNam
 	auto wrapper = std::make_unique<ResourceWrapper>();
 	wrapper->file = std::make_unique<pragma::fs::File>(fp);
 	wrapper->basePath = ufile::get_path_from_filename(fileName);
-	wrapper->resource = source2::load_resource(*wrapper->file, [](const std::string &path) -> std::unique_ptr<ufile::IFile> {
-		auto fp = pragma::fs::open_system_file(path, pragma::fs::FileMode::Read | pragma::fs::FileMode::Binary);
-		if(!fp)
-			return nullptr;
-		return std::make_unique<pragma::fs::File>(fp);
-	});
+	wrapper->resource = source2::load_resource(*wrapper->file, loadOptions, assetLoader);
 	return wrapper->resource ? std::move(wrapper) : nullptr;
 }
 
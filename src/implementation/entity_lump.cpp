@@ -83,7 +83,9 @@ std::vector<std::shared_ptr<resource::Entity>> resource::EntityLump::GetEntities
 	auto entityKeyValues = data->FindArrayValues<IKeyValueCollection *>("m_entityKeyValues");
 	ents.reserve(entityKeyValues.size());
 	for(auto &kv : entityKeyValues) {
-		auto *kvData = kv->FindBinaryBlob("m_keyValuesData");
+		auto kvData = kv->FindBinaryBlobView("m_keyValuesData");
+		if(kvData.has_value() == false)
+			continue;
 		auto ent = ParseEntityProperties(*kvData);
 		// TODO: m_connections
 		if(ent == nullptr)
@@ -92,7 +94,7 @@ std::vector<std::shared_ptr<resource::Entity>> resource::EntityLump::GetEntities
 	}
 	return ents;
 }
-std::shared_ptr<resource::Entity> resource::EntityLump::ParseEntityProperties(const std::vector<uint8_t> &bytes) const
+std::shared_ptr<resource::Entity> resource::EntityLump::ParseEntityProperties(std::span<const uint8_t> bytes) const
 {
 	pragma::util::DataStream ds {const_cast<uint8_t *>(bytes.data()), static_cast<uint32_t>(bytes.size())};
 	ds->SetOffset(0);
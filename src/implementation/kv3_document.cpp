@@ -0,0 +1,162 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+module source2;
+
+using namespace source2;
+
+resource::KV3Collection::KV3Collection(const KV3Document &document, uint32_t node) : m_document {&document}, m_node {node} {}
+const resource::KV3Document &resource::KV3Collection::GetDocument() const { return *m_document; }
+const resource::KV3Node &resource::KV3Collection::GetNode() const { return m_document->GetNode(m_node); }
+bool resource::KV3Collection::IsArray() const { return GetNode().type == KVType::ARRAY; }
+uint32_t resource::KV3Collection::GetCount() const { return GetNode().count; }
+const resource::KV3Node *resource::KV3Collection::FindNode(KVKey key) const { return m_document->FindMember(GetNode(), key); }
+const resource::KV3Node *resource::KV3Collection::GetArrayNode(uint32_t idx) const { return m_document->GetArrayElement(GetNode(), idx); }
+resource::BinaryBlob *resource::KV3Collection::FindBinaryBlob(KVKey key) const
+{
+	auto *node = FindNode(key);
+	if(node == nullptr || node->type != KVType::BINARY_BLOB)
+		return nullptr;
+	return m_document->GetBinaryBlob(*node);
+}
+std::optional<std::span<const uint8_t>> resource::KV3Collection::FindBinaryBlobView(KVKey key) const
+{
+	auto *node = FindNode(key);
+	if(node == nullptr || node->type != KVType::BINARY_BLOB)
+		return {};
+	return m_document->GetBinaryBlobView(*node);
+}
+void resource::KV3Collection::DebugPrint(std::stringstream &ss, const std::string &t) const { m_document->DebugPrint(ss, GetNode(), t); }
+
+////////////////
+
+resource::KV3Document::KV3Document(std::vector<std::string> &&strings) : m_strings {std::move(strings)}
+{
+	m_stringHashes.reserve(m_strings.size());
+	for(auto &str : m_strings)
+		m_stringHashes.push_back(KVKey::Hash(str));
+}
+const std::vector<std::string> &resource::KV3Document::GetStrings() const { return m_strings; }
+const std::string &resource::KV3Document::GetString(int32_t id) const
+{
+	static const std::string empty {};
+	return (id >= 0 && static_cast<size_t>(id) < m_strings.size()) ? m_strings[id] : empty;
+}
+const std::vector<resource::KV3Node> &resource::KV3Document::GetNodes() const { return m_nodes; }
+const resource::KV3Node &resource::KV3Document::GetNode(uint32_t idx) const { return m_nodes[idx]; }
+std::span<const resource::KV3Member> resource::KV3Document::GetMembers(const KV3Node &node) const
+{
+	if(node.type != KVType::OBJECT && node.type != KVType::ARRAY)
+		return {};
+	return std::span<const KV3Member> {m_members.data() + node.container.firstMember, node.count};
+}
+const resource::KV3Node *resource::KV3Document::FindMember(const KV3Node &node, KVKey key) const
+{
+	if(node.type == KVType::ARRAY) {
+		// Arrays can still be addressed by their stringified index
+		uint32_t idx;
+		auto *end = key.name.data() + key.name.size();
+		auto res = std::from_chars(key.name.data(), end, idx);
+		if(res.ec != std::errc {} || res.ptr != end)
+			return nullptr;
+		return GetArrayElement(node, idx);
+	}
+	for(auto &member : GetMembers(node)) {
+		if(member.keyId >= 0 && m_stringHashes[member.keyId] == key.hash && m_strings[member.keyId] == key.name)
+			return &m_nodes[member.node];
+	}
+	return nullptr;
+}
+const resource::KV3Node *resource::KV3Document::GetArrayElement(const KV3Node &node, uint32_t idx) const
+{
+	if(node.type != KVType::ARRAY || idx >= node.count)
+		return nullptr;
+	return &m_nodes[m_members[node.container.firstMember + idx].node];
+}
+resource::KV3Collection *resource::KV3Document::GetCollection(const KV3Node &node) const
+{
+	if(node.type != KVType::OBJECT && node.type != KVType::ARRAY)
+		return nullptr;
+	// Collections are lightweight views into the document, handing out mutable pointers does not allow modifying the document itself
+	return const_cast<KV3Collection *>(&m_collections[node.container.collection]);
+}
+resource::BinaryBlob *resource::KV3Document::GetBinaryBlob(const KV3Node &node) const
+{
+	if(node.type != KVType::BINARY_BLOB || node.blobIndex >= m_blobs.size())
+		return nullptr;
+	return const_cast<BinaryBlob *>(&m_blobs[node.blobIndex]);
+}
+std::span<const uint8_t> resource::KV3Document::GetBinaryBlobView(const KV3Node &node) const
+{
+	if(node.type != KVType::BINARY_BLOB || node.blobIndex >= m_blobViews.size())
+		return {};
+	return m_blobViews[node.blobIndex];
+}
+resource::KV3Collection &resource::KV3Document::GetRoot() { return m_collections.front(); }
+const resource::KV3Collection &resource::KV3Document::GetRoot() const { return m_collections.front(); }
+void resource::KV3Document::DebugPrint(std::stringstream &ss, const std::string &t) const
+{
+	ss << t << "KV3Document:\n";
+	ss << t << "\tNodes: " << m_nodes.size() << "\n";
+	ss << t << "\tStrings: " << m_strings.size() << "\n";
+	ss << t << "\tBinary blobs: " << m_blobs.size() << "\n";
+	if(m_nodes.empty() == false)
+		DebugPrint(ss, m_nodes.front(), t + "\t");
+}
+void resource::KV3Document::DebugPrint(std::stringstream &ss, const KV3Node &node, const std::string &t) const
+{
+	ss << t << "KV3Node = {\n";
+	ss << t << "\tType = " << to_string(node.type) << "\n";
+	switch(node.type) {
+	case KVType::Null:
+		ss << t << "\tValue = null\n";
+		break;
+	case KVType::BOOLEAN:
+		ss << t << "\tValue = " << node.boolean << "\n";
+		break;
+	case KVType::INT64:
+		ss << t << "\tValue = " << node.int64 << "\n";
+		break;
+	case KVType::UINT64:
+		ss << t << "\tValue = " << node.uint64 << "\n";
+		break;
+	case KVType::DOUBLE:
+		ss << t << "\tValue = " << node.float64 << "\n";
+		break;
+	case KVType::STRING:
+		ss << t << "\tValue = " << GetString(node.stringId) << "\n";
+		break;
+	case KVType::INT32:
+		ss << t << "\tValue = " << node.int32 << "\n";
+		break;
+	case KVType::UINT32:
+		ss << t << "\tValue = " << node.uint32 << "\n";
+		break;
+	case KVType::BINARY_BLOB:
+		ss << t << "\tValue = [BINARY_BLOB] (" << node.count << " bytes)\n";
+		break;
+	case KVType::OBJECT:
+	case KVType::ARRAY:
+		{
+			ss << t << "\tValues:\n";
+			auto members = GetMembers(node);
+			for(auto i = decltype(members.size()) {0u}; i < members.size(); ++i) {
+				auto &member = members[i];
+				ss << t << "\t\t[";
+				if(member.keyId >= 0)
+					ss << GetString(member.keyId);
+				else
+					ss << i;
+				ss << "] = {\n";
+				DebugPrint(ss, m_nodes[member.node], t + "\t\t\t");
+				ss << t << "\t\t}\n";
+			}
+			break;
+		}
+	default:
+		break;
+	}
+	ss << t << "}\n";
+}
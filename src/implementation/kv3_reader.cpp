@@ -0,0 +1,342 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+module source2;
+
+using namespace source2;
+
+struct resource::KV3Reader::Cursor {
+	template<typename T>
+	T Read(size_t &pos) const
+	{
+		if(pos + sizeof(T) > data.size())
+			throw std::runtime_error {"Unexpected end of KV3 data on byte " + std::to_string(pos)};
+		T value;
+		memcpy(&value, data.data() + pos, sizeof(T));
+		pos += sizeof(T);
+		return value;
+	}
+	template<typename T>
+	T Read()
+	{
+		return Read<T>(offset);
+	}
+	template<typename T>
+	T ReadEightBytes()
+	{
+		return Read<T>(hasEightByteSection ? eightBytesOffset : offset);
+	}
+	// 16-bit integers only exist in KV3\x04, which always has a two-byte section if they're used
+	template<typename T>
+	T ReadTwoBytes()
+	{
+		if(!hasTwoByteSection)
+			throw std::runtime_error {"KV3 data contains two-byte values, but has no two-byte section"};
+		return Read<T>(twoBytesOffset);
+	}
+	uint8_t ReadTypeByte()
+	{
+		if(types.empty())
+			return Read<uint8_t>();
+		if(typeIndex >= types.size())
+			throw std::runtime_error {"Unexpected end of KV3 types array"};
+		return types[typeIndex++];
+	}
+	std::pair<KVType, KVFlag> ReadType()
+	{
+		auto databyte = ReadTypeByte();
+		auto flagInfo = KVFlag::None;
+		if((databyte & 0x80) > 0) {
+			databyte &= 0x7F; // Remove the flag bit
+			flagInfo = static_cast<KVFlag>(ReadTypeByte());
+		}
+		return {static_cast<KVType>(databyte), flagInfo};
+	}
+	// Booleans and blobs of KV3 version 2 are stored in the binary section
+	size_t &GetBinaryOffset() { return hasBinarySection ? binaryBytesOffset : offset; }
+	void Advance(size_t &pos, uint64_t size) const
+	{
+		if(pos + size > data.size())
+			throw std::runtime_error {"Unexpected end of KV3 data on byte " + std::to_string(pos)};
+		pos += size;
+	}
+	// Blobs are stored in the binary section, unless they are stored in separate blocks (KV3\x02 and newer)
+	std::span<const uint8_t> ReadBlob()
+	{
+		size_t length;
+		size_t *pos;
+		if(blobSizes.empty()) {
+			auto size = Read<int32_t>();
+			if(size < 0)
+				throw std::runtime_error {"Invalid KV3 binary blob size " + std::to_string(size)};
+			length = size;
+			pos = &GetBinaryOffset();
+		}
+		else {
+			if(blobIndex >= blobSizes.size())
+				throw std::runtime_error {"Unexpected end of KV3 binary blobs"};
+			length = blobSizes[blobIndex++];
+			pos = &blobsOffset;
+		}
+		auto start = *pos;
+		Advance(*pos, length);
+		return data.subspan(start, length);
+	}
+	// Skips 'count' values of a fixed-size type without reading them, returns false if the type has no fixed size
+	bool Skip(KVType type, uint32_t count)
+	{
+		switch(type) {
+		case KVType::Null:
+		case KVType::BOOLEAN_TRUE:
+		case KVType::BOOLEAN_FALSE:
+		case KVType::INT64_ZERO:
+		case KVType::INT64_ONE:
+		case KVType::DOUBLE_ZERO:
+		case KVType::DOUBLE_ONE:
+			return true;
+		case KVType::BOOLEAN:
+			Advance(GetBinaryOffset(), count);
+			return true;
+		case KVType::INT32:
+		case KVType::UINT32:
+		case KVType::FLOAT:
+		case KVType::STRING:
+			Advance(offset, count * uint64_t {4});
+			return true;
+		case KVType::INT16:
+		case KVType::UINT16:
+			if(!hasTwoByteSection)
+				throw std::runtime_error {"KV3 data contains two-byte values, but has no two-byte section"};
+			Advance(twoBytesOffset, count * uint64_t {2});
+			return true;
+		case KVType::INT64:
+		case KVType::UINT64:
+		case KVType::DOUBLE:
+			Advance(hasEightByteSection ? eightBytesOffset : offset, count * uint64_t {8});
+			return true;
+		default:
+			return false;
+		}
+	}
+	// Returns the values of a typed array of integers, doubles, booleans or string ids without advancing the cursor
+	std::optional<std::span<const uint8_t>> GetElements(KVType type, uint32_t count) const
+	{
+		size_t pos;
+		uint64_t size;
+		switch(type) {
+		case KVType::BOOLEAN:
+			pos = hasBinarySection ? binaryBytesOffset : offset;
+			size = count;
+			break;
+		case KVType::INT32:
+		case KVType::UINT32:
+		case KVType::STRING:
+			pos = offset;
+			size = count * uint64_t {4};
+			break;
+		case KVType::INT64:
+		case KVType::UINT64:
+		case KVType::DOUBLE:
+			pos = hasEightByteSection ? eightBytesOffset : offset;
+			size = count * uint64_t {8};
+			break;
+		default:
+			return {};
+		}
+		if(pos + size > data.size())
+			throw std::runtime_error {"Unexpected end of KV3 data on byte " + std::to_string(pos)};
+		return data.subspan(pos, size);
+	}
+	std::span<const uint8_t> data;
+	size_t offset = 0;
+	std::span<const uint8_t> types;
+	size_t typeIndex = 0;
+	bool hasBinarySection = false;
+	size_t binaryBytesOffset = 0;
+	bool hasEightByteSection = false;
+	size_t eightBytesOffset = 0;
+	std::span<const uint32_t> blobSizes;
+	size_t blobIndex = 0;
+	size_t blobsOffset = 0;
+	bool hasTwoByteSection = false;
+	size_t twoBytesOffset = 0;
+};
+
+resource::KV3Reader::KV3Reader(std::span<const uint8_t> data, size_t offset, std::span<const std::string> strings, std::span<const uint8_t> types, int64_t binaryBytesOffset, int64_t eightBytesOffset, std::span<const uint32_t> blobSizes,
+  size_t blobsOffset, int64_t twoBytesOffset)
+    : m_data {data}, m_offset {offset}, m_strings {strings}, m_types {types}, m_binaryBytesOffset {binaryBytesOffset}, m_eightBytesOffset {eightBytesOffset}, m_blobSizes {blobSizes}, m_blobsOffset {blobsOffset}, m_twoBytesOffset {twoBytesOffset}
+{
+}
+
+void resource::KV3Reader::Read(KV3Visitor &visitor) const
+{
+	struct Container {
+		uint32_t remaining;
+		bool isObject;
+		bool isTyped;
+		std::pair<KVType, KVFlag> elementType;
+		// Skipped containers are still read to advance the cursor, but nothing is reported to the visitor
+		bool skip;
+	};
+	Cursor cursor {m_data, m_offset, m_types};
+	if(m_binaryBytesOffset > -1) {
+		cursor.hasBinarySection = true;
+		cursor.binaryBytesOffset = m_binaryBytesOffset;
+	}
+	if(m_eightBytesOffset > 0) {
+		cursor.hasEightByteSection = true;
+		cursor.eightBytesOffset = m_eightBytesOffset;
+	}
+	cursor.blobSizes = m_blobSizes;
+	cursor.blobsOffset = m_blobsOffset;
+	if(m_twoBytesOffset > -1) {
+		cursor.hasTwoByteSection = true;
+		cursor.twoBytesOffset = m_twoBytesOffset;
+	}
+	std::vector<Container> stack;
+	stack.reserve(16);
+	auto getString = [this](int32_t id) -> std::string_view {
+		if(id == -1)
+			return {};
+		if(id < 0 || static_cast<size_t>(id) >= m_strings.size())
+			throw std::runtime_error {"Invalid KV3 string index " + std::to_string(id)};
+		return m_strings[id];
+	};
+	// Reports scalar values directly, containers are pushed onto the stack and their elements are read by the loop below
+	auto readValue = [&cursor, &stack, &visitor, &getString](KVType datatype, KVFlag flagInfo, bool skip) {
+		KV3Node node {};
+		node.flags = flagInfo;
+		switch(datatype) {
+		case KVType::Null:
+			node.type = KVType::Null;
+			break;
+		case KVType::BOOLEAN:
+			node.type = KVType::BOOLEAN;
+			node.boolean = cursor.Read<bool>(cursor.GetBinaryOffset());
+			break;
+		case KVType::BOOLEAN_TRUE:
+		case KVType::BOOLEAN_FALSE:
+			node.type = KVType::BOOLEAN;
+			node.boolean = (datatype == KVType::BOOLEAN_TRUE);
+			break;
+		case KVType::INT64:
+			node.type = KVType::INT64;
+			node.int64 = cursor.ReadEightBytes<int64_t>();
+			break;
+		case KVType::INT64_ZERO:
+		case KVType::INT64_ONE:
+			node.type = KVType::INT64;
+			node.int64 = (datatype == KVType::INT64_ONE) ? 1 : 0;
+			break;
+		case KVType::UINT64:
+			node.type = KVType::UINT64;
+			node.uint64 = cursor.ReadEightBytes<uint64_t>();
+			break;
+		case KVType::DOUBLE:
+			node.type = KVType::DOUBLE;
+			node.float64 = cursor.ReadEightBytes<double>();
+			break;
+		case KVType::DOUBLE_ZERO:
+		case KVType::DOUBLE_ONE:
+			node.type = KVType::DOUBLE;
+			node.float64 = (datatype == KVType::DOUBLE_ONE) ? 1.0 : 0.0;
+			break;
+		case KVType::INT32:
+			node.type = KVType::INT32;
+			node.int32 = cursor.Read<int32_t>();
+			break;
+		case KVType::UINT32:
+			node.type = KVType::UINT32;
+			node.uint32 = cursor.Read<uint32_t>();
+			break;
+		// The narrower types of KV3\x04 are widened, so consumers only have to handle the older value types
+		case KVType::FLOAT:
+			node.type = KVType::DOUBLE;
+			node.float64 = cursor.Read<float>();
+			break;
+		case KVType::INT16:
+			node.type = KVType::INT32;
+			node.int32 = cursor.ReadTwoBytes<int16_t>();
+			break;
+		case KVType::UINT16:
+			node.type = KVType::UINT32;
+			node.uint32 = cursor.ReadTwoBytes<uint16_t>();
+			break;
+		case KVType::STRING:
+			{
+				node.type = KVType::STRING;
+				node.stringId = cursor.Read<int32_t>();
+				if(!skip)
+					visitor.Scalar(node, getString(node.stringId));
+				return;
+			}
+		case KVType::BINARY_BLOB:
+			{
+				auto data = cursor.ReadBlob();
+				if(!skip)
+					visitor.Blob(data, flagInfo);
+				return;
+			}
+		case KVType::ARRAY:
+		case KVType::ARRAY_TYPED:
+		case KVType::OBJECT:
+			{
+				auto length = cursor.Read<int32_t>();
+				if(length < 0)
+					throw std::runtime_error {"Invalid KV3 container size " + std::to_string(length)};
+				Container container {static_cast<uint32_t>(length), datatype == KVType::OBJECT, datatype == KVType::ARRAY_TYPED};
+				if(container.isTyped) {
+					container.elementType = cursor.ReadType();
+					// Numeric elements can be consumed as a single block
+					auto elements = skip ? std::optional<std::span<const uint8_t>> {} : cursor.GetElements(container.elementType.first, container.remaining);
+					if(elements && visitor.TypedArray(container.elementType.first, *elements, container.remaining, flagInfo)) {
+						cursor.Skip(container.elementType.first, container.remaining);
+						return;
+					}
+				}
+				if(!skip)
+					skip = container.isObject ? !visitor.BeginObject(container.remaining, flagInfo) : !visitor.BeginArray(container.remaining, flagInfo);
+				container.skip = skip;
+				// The elements of skipped typed arrays don't have to be read if they have a fixed size
+				if(skip && container.isTyped && cursor.Skip(container.elementType.first, container.remaining))
+					return;
+				stack.push_back(container);
+				return;
+			}
+		default:
+			throw std::runtime_error {"Unknown KVType " + std::to_string(pragma::math::to_integral(datatype)) + " on byte " + std::to_string(cursor.offset - 1)};
+		}
+		if(!skip)
+			visitor.Scalar(node, {});
+	};
+
+	auto rootType = cursor.ReadType();
+	readValue(rootType.first, rootType.second, false);
+	while(!stack.empty()) {
+		auto &container = stack.back();
+		if(container.remaining == 0) {
+			auto isObject = container.isObject;
+			auto skip = container.skip;
+			stack.pop_back();
+			if(skip)
+				continue;
+			if(isObject)
+				visitor.EndObject();
+			else
+				visitor.EndArray();
+			continue;
+		}
+		--container.remaining;
+		auto skip = container.skip;
+		if(container.isObject) {
+			auto keyId = cursor.Read<int32_t>();
+			if(!skip)
+				visitor.Key(getString(keyId), keyId);
+		}
+		// Note: 'container' may be invalidated by readValue
+		auto type = container.isTyped ? container.elementType : cursor.ReadType();
+		readValue(type.first, type.second, skip);
+	}
+}
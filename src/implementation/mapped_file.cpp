@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "definitions.hpp"
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+module source2;
+
+using namespace source2;
+
+std::shared_ptr<resource::MappedFile> resource::MappedFile::Open(const std::string &systemPath)
+{
+	std::shared_ptr<MappedFile> mappedFile {new MappedFile {}};
+#ifdef _WIN32
+	auto hFile = CreateFileA(systemPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(hFile == INVALID_HANDLE_VALUE)
+		return nullptr;
+	mappedFile->m_fileHandle = hFile;
+	LARGE_INTEGER size;
+	if(GetFileSizeEx(hFile, &size) == FALSE || size.QuadPart <= 0)
+		return nullptr;
+	auto hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(hMapping == nullptr)
+		return nullptr;
+	mappedFile->m_mappingHandle = hMapping;
+	auto *data = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if(data == nullptr)
+		return nullptr;
+	mappedFile->m_data = static_cast<const uint8_t *>(data);
+	mappedFile->m_size = static_cast<size_t>(size.QuadPart);
+#else
+	auto fd = open(systemPath.c_str(), O_RDONLY);
+	if(fd == -1)
+		return nullptr;
+	struct stat st {};
+	if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return nullptr;
+	}
+	auto *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping stays valid after the descriptor has been closed
+	close(fd);
+	if(data == MAP_FAILED)
+		return nullptr;
+	mappedFile->m_data = static_cast<const uint8_t *>(data);
+	mappedFile->m_size = static_cast<size_t>(st.st_size);
+#endif
+	mappedFile->m_isMemoryMapped = true;
+	return mappedFile;
+}
+std::shared_ptr<resource::MappedFile> resource::MappedFile::Create(ufile::IFile &f)
+{
+	std::shared_ptr<MappedFile> mappedFile {new MappedFile {}};
+	f.Seek(0);
+	auto &buffer = mappedFile->m_buffer;
+	buffer.resize(f.GetSize());
+	f.Read(buffer.data(), buffer.size() * sizeof(buffer.front()));
+	mappedFile->m_data = buffer.data();
+	mappedFile->m_size = buffer.size();
+	return mappedFile;
+}
+resource::MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if(m_isMemoryMapped)
+		UnmapViewOfFile(m_data);
+	if(m_mappingHandle)
+		CloseHandle(m_mappingHandle);
+	if(m_fileHandle)
+		CloseHandle(m_fileHandle);
+#else
+	if(m_isMemoryMapped)
+		munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+}
+std::span<const uint8_t> resource::MappedFile::GetData() const { return {m_data, m_size}; }
+bool resource::MappedFile::IsMemoryMapped() const { return m_isMemoryMapped; }
@@ -24,7 +24,9 @@ std::string resource::Model::GetName() const
 }
 std::vector<resource::Skin> resource::Model::GetSkins()
 {
-	auto *data = GetData().get();
+	constexpr std::array<std::string_view, 2> paths {"m_materialGroups[*].m_name", "m_materialGroups[*].m_materials"};
+	auto dataPtr = GetData(paths);
+	auto *data = dataPtr.get();
 
 #if 0
 	{
@@ -61,9 +63,10 @@ std::vector<std::shared_ptr<resource::Mesh>> resource::Model::GetEmbeddedMeshes(
 {
 	std::vector<std::shared_ptr<Mesh>> meshes {};
 	auto *blockCtrl = dynamic_cast<BinaryKV3 *>(m_resource.FindBlock(BlockType::CTRL));
-	if(blockCtrl == nullptr)
+	auto ctrlData = blockCtrl ? blockCtrl->GetCollection() : nullptr;
+	if(ctrlData == nullptr)
 		return meshes;
-	auto embeddedMeshes = blockCtrl->GetData()->FindArrayValues<IKeyValueCollection *>("embedded_meshes");
+	auto embeddedMeshes = ctrlData->FindArrayValues<IKeyValueCollection *>("embedded_meshes");
 	for(auto *embeddedMesh : embeddedMeshes) {
 		auto dataBlockIndex = IKeyValueCollection::FindValue<int32_t>(*embeddedMesh, "data_block");
 		auto vbibBlockIndex = IKeyValueCollection::FindValue<int32_t>(*embeddedMesh, "vbib_block");
@@ -87,9 +90,10 @@ std::vector<std::shared_ptr<resource::Animation>> resource::Model::GetEmbeddedAn
 {
 	std::vector<std::shared_ptr<Animation>> animations {};
 	auto *blockCtrl = dynamic_cast<BinaryKV3 *>(resource.FindBlock(BlockType::CTRL));
-	if(blockCtrl == nullptr)
+	auto ctrlData = blockCtrl ? blockCtrl->GetCollection() : nullptr;
+	if(ctrlData == nullptr)
 		return {};
-	auto *embeddedAnimations = blockCtrl->GetData()->FindSubCollection("embedded_animation");
+	auto *embeddedAnimations = ctrlData->FindSubCollection("embedded_animation");
 	if(embeddedAnimations == nullptr)
 		return {};
 	auto groupDataBlockIndex = embeddedAnimations->FindValue<int32_t>("group_data_block");
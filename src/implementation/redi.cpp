@@ -82,10 +82,11 @@ void resource::ArgumentDependencies::DebugPrint(std::stringstream &ss, const std
 	ss << t << "}\n";
 }
 
-ResourceType resource::SpecialDependencies::DetermineResourceTypeByCompilerIdentifier(const SpecialDependency &input)
+ResourceType resource::SpecialDependencies::DetermineResourceTypeByCompilerIdentifier(const SpecialDependency &input) { return DetermineResourceTypeByCompilerIdentifier(input.compilerIdentifier, input.string); }
+ResourceType resource::SpecialDependencies::DetermineResourceTypeByCompilerIdentifier(std::string_view compilerIdentifier, std::string_view string)
 {
-	auto identifier = input.compilerIdentifier;
-	if(pragma::string::compare(identifier.c_str(), "Compile", true, 7))
+	auto identifier = compilerIdentifier;
+	if(identifier.size() >= 7 && pragma::string::compare(identifier.data(), "Compile", true, 7))
 		identifier = identifier.substr(7);
 
 	// Special mappings and otherwise different identifiers
@@ -100,13 +101,13 @@ ResourceType resource::SpecialDependencies::DetermineResourceTypeByCompilerIdent
 	if(identifier == "RenderMesh")
 		return ResourceType::Mesh;
 	if(identifier == "Panorama") {
-		if(input.string == "Panorama Style Compiler Version")
+		if(string == "Panorama Style Compiler Version")
 			return ResourceType::PanoramaStyle;
-		if(input.string == "Panorama Script Compiler Version")
+		if(string == "Panorama Script Compiler Version")
 			return ResourceType::PanoramaScript;
-		if(input.string == "Panorama Layout Compiler Version")
+		if(string == "Panorama Layout Compiler Version")
 			return ResourceType::PanoramaLayout;
-		if(input.string == "Panorama Dynamic Images Compiler Version")
+		if(string == "Panorama Dynamic Images Compiler Version")
 			return ResourceType::PanoramaDynamicImages;
 		return ResourceType::Panorama;
 	}
@@ -8,7 +8,9 @@ module source2;
 
 using namespace source2;
 
-resource::Resource::Resource(const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &assetFileLoader) : m_assetFileLoader {assetFileLoader}
+static std::atomic<uint64_t> g_nextAssetLoaderId = 0;
+
+resource::Resource::Resource(const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &assetFileLoader, const ResourceLoadOptions &loadOptions) : m_assetFileLoader {assetFileLoader}, m_loadOptions {loadOptions}
 {
 	if(m_assetFileLoader == nullptr) {
 		m_assetFileLoader = [](const std::string &path) -> std::unique_ptr<ufile::IFile> {
@@ -17,24 +19,90 @@ resource::Resource::Resource(const std::function<std::unique_ptr<ufile::IFile>(c
 				return nullptr;
 			return std::make_unique<pragma::fs::File>(f);
 		};
+		if(m_loadOptions.assetLoaderKey.empty())
+			m_loadOptions.assetLoaderKey = "#fs";
+	}
+	else if(m_loadOptions.assetLoaderKey.empty()) {
+		// Loaders can't be compared, so every custom loader without a key is assumed to be different. Child resources inherit the key.
+		m_loadOptions.assetLoaderKey = "#" + std::to_string(++g_nextAssetLoaderId);
+	}
+	if(!m_loadOptions.threadSafeAssetLoader) {
+		// Child resources inherit the wrapped loader and its mutex, so they're marked as thread-safe
+		m_assetFileLoader = [loader = std::move(m_assetFileLoader), mutex = std::make_shared<std::mutex>()](const std::string &path) -> std::unique_ptr<ufile::IFile> {
+			std::scoped_lock lock {*mutex};
+			return loader(path);
+		};
+		m_loadOptions.threadSafeAssetLoader = true;
 	}
 }
 std::unique_ptr<ufile::IFile> resource::Resource::OpenAssetFile(const std::string &path) const { return m_assetFileLoader(path); }
 std::shared_ptr<resource::Resource> resource::Resource::LoadResource(const std::string &path) const
 {
-	auto f = OpenAssetFile(path);
-	if(f == nullptr)
-		return nullptr;
-	return load_resource(*f, m_assetFileLoader);
+	auto load = [this, &path]() -> std::shared_ptr<Resource> {
+		auto f = OpenAssetFile(path);
+		if(f == nullptr)
+			return nullptr;
+		return load_resource(*f, m_loadOptions, m_assetFileLoader);
+	};
+	if(m_loadOptions.cache)
+		return m_loadOptions.cache->Load(path, m_loadOptions, load);
+	return load();
 }
 resource::Block *resource::Resource::FindBlock(BlockType type)
 {
 	auto it = std::find_if(m_blocks.begin(), m_blocks.end(), [type](const std::shared_ptr<Block> &block) { return block->GetType() == type; });
-	return (it != m_blocks.end()) ? it->get() : nullptr;
+	if(it == m_blocks.end())
+		return nullptr;
+	LoadBlock(**it);
+	return it->get();
 }
 const resource::Block *resource::Resource::FindBlock(BlockType type) const { return const_cast<Resource *>(this)->FindBlock(type); }
-const std::vector<std::shared_ptr<resource::Block>> &resource::Resource::GetBlocks() const { return m_blocks; }
-std::shared_ptr<resource::Block> resource::Resource::GetBlock(uint32_t idx) const { return (idx < m_blocks.size()) ? m_blocks.at(idx) : nullptr; }
+const std::vector<std::shared_ptr<resource::Block>> &resource::Resource::GetBlocks() const
+{
+	for(auto &block : m_blocks)
+		LoadBlock(*block);
+	return m_blocks;
+}
+std::shared_ptr<resource::Block> resource::Resource::GetBlock(uint32_t idx) const
+{
+	if(idx >= m_blocks.size())
+		return nullptr;
+	auto &block = m_blocks.at(idx);
+	LoadBlock(*block);
+	return block;
+}
+void resource::Resource::ReadBlock(Block &block, ufile::IFile &f) const
+{
+	std::call_once(block.m_readOnce, [this, &block, &f]() {
+		try {
+			block.Read(*this, f);
+		}
+		catch(...) {
+			block.m_readException = std::current_exception();
+		}
+	});
+	if(block.m_readException)
+		std::rethrow_exception(block.m_readException);
+}
+void resource::Resource::LoadBlock(Block &block) const
+{
+	if(!m_lazyBlocks)
+		return;
+	std::call_once(block.m_readOnce, [this, &block]() {
+		// Every block gets its own cursor, so multiple blocks can be parsed concurrently
+		auto data = m_mappedFile->GetData();
+		ufile::MemoryFile f {const_cast<uint8_t *>(data.data()), data.size()};
+		try {
+			block.Read(*this, f);
+		}
+		catch(...) {
+			// The block may have been partially filled, so it must not be read again
+			block.m_readException = std::current_exception();
+		}
+	});
+	if(block.m_readException)
+		std::rethrow_exception(block.m_readException);
+}
 bool resource::Resource::IsHandledResourceType(ResourceType type)
 {
 	switch(type) {
@@ -55,6 +123,7 @@ bool resource::Resource::Read(ufile::IFile &f)
 		throw std::runtime_error {"Use ValvePak library to parse VPK files."};
 	if(fileSize == 0x32736376) // "vcs2"
 		throw std::runtime_error {"Use CompiledShader() class to parse compiled shader files."};
+	m_fileSize = fileSize;
 
 	auto headerVersion = f.Read<uint16_t>();
 	constexpr uint32_t knownHeaderVersion = 12u;
@@ -62,6 +131,7 @@ bool resource::Resource::Read(ufile::IFile &f)
 		throw std::runtime_error {"Bad header version. (" + std::to_string(headerVersion) + " != expected " + std::to_string(knownHeaderVersion) + ")"};
 
 	m_version = f.Read<uint16_t>();
+	m_lazyBlocks = m_loadOptions.lazyBlocks && m_mappedFile != nullptr;
 	auto startOffset = f.Tell();
 	auto blockOffset = f.Read<uint32_t>();
 	auto blockCount = f.Read<uint32_t>();
@@ -75,7 +145,7 @@ bool resource::Resource::Read(ufile::IFile &f)
 		if(size >= 4 && pragma::string::compare(blockType.data(), "DATA", true, blockType.size()) && !IsHandledResourceType(m_resourceType)) {
 			f.Seek(offset);
 			auto magic = f.Read<uint32_t>();
-			if(magic == BinaryKV3::MAGIC || magic == BinaryKV3::MAGIC2)
+			if(BinaryKV3::IsMagic(magic))
 				block = std::make_shared<BinaryKV3>();
 			f.Seek(position);
 		}
@@ -88,7 +158,7 @@ bool resource::Resource::Read(ufile::IFile &f)
 			block->SetSize(size);
 
 			if(strBlockType == "REDI" || strBlockType == "NTRO")
-				block->Read(*this, f);
+				ReadBlock(*block, f);
 
 			m_blocks.push_back(block);
 
@@ -105,26 +175,33 @@ bool resource::Resource::Read(ufile::IFile &f)
 			case BlockType::NTRO:
 				if(m_resourceType == ResourceType::Unknown) {
 					auto *manifest = GetIntrospectionManifest();
-					if(manifest && manifest->GetReferencedStructs().size() > 0) {
-						auto &strct = manifest->GetReferencedStructs().front();
-						if(strct.name == "VSoundEventScript_t")
-							m_resourceType = ResourceType::SoundEventScript;
-						else if(strct.name == "CWorldVisibility")
-							m_resourceType = ResourceType::WorldVisibility;
-					}
+					if(manifest && manifest->GetReferencedStructs().size() > 0)
+						m_resourceType = ResourceIntrospectionManifest::DetermineResourceTypeByStructName(manifest->GetReferencedStructs().front()->name);
 				}
 				break;
 			}
 		}
 		f.Seek(position + sizeof(uint32_t) * 2);
 	}
+	if(m_lazyBlocks)
+		return true;
 	for(auto &block : m_blocks) {
 		auto type = block->GetType();
 		if(type != BlockType::REDI && type != BlockType::NTRO)
-			block->Read(*this, f);
+			ReadBlock(*block, f);
 	}
 	return true;
 }
+bool resource::Resource::Read(const std::shared_ptr<const MappedFile> &mappedFile)
+{
+	if(mappedFile == nullptr)
+		return false;
+	m_mappedFile = mappedFile;
+	auto data = mappedFile->GetData();
+	// The data is never written to, MemoryFile just doesn't accept a const pointer
+	ufile::MemoryFile f {const_cast<uint8_t *>(data.data()), data.size()};
+	return Read(f);
+}
 std::shared_ptr<resource::Block> resource::Resource::ConstructFromType(std::string input)
 {
 	if(input == "DATA")
@@ -161,6 +238,9 @@ std::shared_ptr<resource::Block> resource::Resource::ConstructFromType(std::stri
 	return nullptr;
 }
 uint32_t resource::Resource::GetVersion() const { return m_version; }
+uint32_t resource::Resource::GetFileSize() const { return m_fileSize; }
+const resource::ResourceLoadOptions &resource::Resource::GetLoadOptions() const { return m_loadOptions; }
+const std::shared_ptr<const resource::MappedFile> &resource::Resource::GetMappedFile() const { return m_mappedFile; }
 std::shared_ptr<resource::ResourceData> resource::Resource::ConstructResourceType()
 {
 	switch(m_resourceType) {
@@ -0,0 +1,199 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+module source2;
+
+import :thread_pool;
+
+using namespace source2;
+
+// Keys of the resources which are currently being loaded by the calling thread
+static thread_local std::vector<std::pair<const resource::ResourceCache *, std::string>> g_loadingKeys;
+
+resource::ResourceCache::ResourceCache(size_t fileSizeBudget) : m_fileSizeBudget {fileSizeBudget} {}
+std::shared_ptr<resource::Resource> resource::ResourceCache::WaitForResource(const std::shared_future<std::shared_ptr<Resource>> &resource)
+{
+	// Waiting threads that are part of a pool help with its tasks, otherwise the pool could run out of workers
+	// if they're all waiting on resources which are loaded by pending tasks
+	auto *pool = impl::ThreadPool::GetCurrent();
+	if(!pool)
+		return resource.get();
+	{
+		std::scoped_lock lock {m_mutex};
+		m_waitingPools.push_back(pool);
+	}
+	auto removeWaitingPool = [this, pool]() {
+		std::scoped_lock lock {m_mutex};
+		m_waitingPools.erase(std::ranges::find(m_waitingPools, pool));
+	};
+	auto isReady = [&resource]() { return resource.wait_for(std::chrono::seconds {0}) == std::future_status::ready; };
+	try {
+		while(!isReady()) {
+			if(!pool->RunPendingTask())
+				pool->WaitForTask(isReady);
+		}
+	}
+	catch(...) {
+		removeWaitingPool();
+		throw;
+	}
+	removeWaitingPool();
+	return resource.get();
+}
+void resource::ResourceCache::NotifyWaitingPools()
+{
+	std::scoped_lock lock {m_mutex};
+	for(auto *pool : m_waitingPools)
+		pool->NotifyWaiters();
+}
+std::string resource::ResourceCache::NormalizePath(const std::string &path)
+{
+	// Asset paths are case-insensitive
+	auto normalizedPath = path;
+	for(auto &c : normalizedPath) {
+		if(c == '\\')
+			c = '/';
+		else
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	return normalizedPath;
+}
+std::string resource::ResourceCache::GetKey(const std::string &path, const ResourceLoadOptions &loadOptions)
+{
+	// Resources parsed with different options or loaded through different asset loaders are never shared.
+	// Paths can't contain null characters, so they separate the path from the options.
+	auto key = NormalizePath(path);
+	key += '\0';
+	key += std::to_string(pragma::math::to_integral(loadOptions.kv3Representation));
+	key += loadOptions.aliasBinaryBlobs ? '1' : '0';
+	key += loadOptions.memoryMap ? '1' : '0';
+	key += loadOptions.lazyBlocks ? '1' : '0';
+	key += '\0';
+	key += loadOptions.assetLoaderKey;
+	return key;
+}
+std::shared_ptr<resource::Resource> resource::ResourceCache::Load(const std::string &path, const ResourceLoadOptions &loadOptions, const std::function<std::shared_ptr<Resource>()> &loader)
+{
+	auto key = GetKey(path, loadOptions);
+	std::promise<std::shared_ptr<Resource>> promise {};
+	uint64_t id;
+	{
+		std::unique_lock lock {m_mutex};
+		auto it = m_entries.find(key);
+		if(it != m_entries.end()) {
+			++m_hits;
+			auto &entry = it->second;
+			m_lru.splice(m_lru.begin(), m_lru, entry.lruIt);
+			if(!entry.loaded && std::ranges::find(g_loadingKeys, std::pair<const ResourceCache *, std::string> {this, key}) != g_loadingKeys.end())
+				return nullptr; // Waiting for the resource would deadlock, since it can only complete once this call has returned
+			auto resource = entry.resource;
+			lock.unlock();
+			return WaitForResource(resource);
+		}
+		++m_misses;
+		id = ++m_nextId;
+		m_lru.push_front(key);
+		auto &entry = m_entries[key];
+		entry.resource = promise.get_future().share();
+		entry.lruIt = m_lru.begin();
+		entry.id = id;
+	}
+
+	std::shared_ptr<Resource> resource = nullptr;
+	g_loadingKeys.push_back({this, key});
+	try {
+		resource = loader();
+		g_loadingKeys.pop_back();
+	}
+	catch(...) {
+		g_loadingKeys.pop_back();
+		promise.set_exception(std::current_exception());
+		NotifyWaitingPools();
+		Remove(key, id);
+		throw;
+	}
+	promise.set_value(resource);
+	NotifyWaitingPools();
+	if(resource == nullptr) {
+		// Failed loads are not cached, so the resource can be loaded once it becomes available
+		Remove(key, id);
+		return nullptr;
+	}
+
+	std::scoped_lock lock {m_mutex};
+	auto it = m_entries.find(key);
+	if(it == m_entries.end() || it->second.id != id)
+		return resource; // The cache has been cleared in the meantime
+	auto &entry = it->second;
+	entry.size = resource->GetFileSize();
+	entry.loaded = true;
+	m_fileSize += entry.size;
+	EvictEntries();
+	return resource;
+}
+void resource::ResourceCache::Remove(const std::string &key, uint64_t id)
+{
+	std::scoped_lock lock {m_mutex};
+	auto it = m_entries.find(key);
+	if(it == m_entries.end() || it->second.id != id)
+		return;
+	m_fileSize -= it->second.size;
+	m_lru.erase(it->second.lruIt);
+	m_entries.erase(it);
+}
+void resource::ResourceCache::EvictEntries()
+{
+	if(m_fileSizeBudget == 0)
+		return;
+	auto it = m_lru.end();
+	while(m_fileSize > m_fileSizeBudget && it != m_lru.begin()) {
+		--it;
+		auto itEntry = m_entries.find(*it);
+		// Resources which are still being loaded can't be evicted yet
+		if(itEntry->second.loaded == false)
+			continue;
+		// Only the cache's reference is released, the resource stays alive for as long as it's still in use
+		m_fileSize -= itEntry->second.size;
+		++m_evictions;
+		m_entries.erase(itEntry);
+		it = m_lru.erase(it);
+	}
+}
+void resource::ResourceCache::SetFileSizeBudget(size_t fileSizeBudget)
+{
+	std::scoped_lock lock {m_mutex};
+	m_fileSizeBudget = fileSizeBudget;
+	EvictEntries();
+}
+size_t resource::ResourceCache::GetFileSizeBudget() const
+{
+	std::scoped_lock lock {m_mutex};
+	return m_fileSizeBudget;
+}
+resource::ResourceCache::Statistics resource::ResourceCache::GetStatistics() const
+{
+	std::scoped_lock lock {m_mutex};
+	Statistics stats {};
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.evictions = m_evictions;
+	stats.fileSize = m_fileSize;
+	stats.entryCount = m_entries.size();
+	return stats;
+}
+void resource::ResourceCache::ResetStatistics()
+{
+	std::scoped_lock lock {m_mutex};
+	m_hits = 0;
+	m_misses = 0;
+	m_evictions = 0;
+}
+void resource::ResourceCache::Clear()
+{
+	std::scoped_lock lock {m_mutex};
+	m_entries.clear();
+	m_lru.clear();
+	m_fileSize = 0;
+}
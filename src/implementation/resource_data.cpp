@@ -12,13 +12,11 @@ module;
 module source2;
 
 import :impl;
+import :texture_decoder;
+import :thread_pool;
 
 using namespace source2;
 
-#ifdef __linux__
-using byte = uint8_t;
-#endif
-
 #undef GetObject
 #undef max
 
@@ -65,23 +63,41 @@ std::string resource::to_string(KVType type)
 		return "DOUBLE_ZERO";
 	case KVType::DOUBLE_ONE:
 		return "DOUBLE_ONE";
+	case KVType::FLOAT:
+		return "FLOAT";
+	case KVType::INT16:
+		return "INT16";
+	case KVType::UINT16:
+		return "UINT16";
 	}
 	return "Unknown";
 }
 
 ///////////////
 
-resource::IKeyValueCollection *resource::IKeyValueCollection::FindSubCollection(const std::string &key)
+resource::IKeyValueCollection *resource::IKeyValueCollection::FindSubCollection(KVKey key)
 {
 	auto oCollection = IKeyValueCollection::FindValue<IKeyValueCollection *>(*this, key);
 	return oCollection.has_value() ? *oCollection : nullptr;
 }
-resource::BinaryBlob *resource::IKeyValueCollection::FindBinaryBlob(const std::string &key)
+resource::BinaryBlob *resource::IKeyValueCollection::FindBinaryBlob(KVKey key)
 {
 	if(typeid(*this) == typeid(NTROStruct))
 		return static_cast<NTROStruct &>(*this).FindBinaryBlob(key);
 	else if(typeid(*this) == typeid(KVObject))
 		return static_cast<KVObject &>(*this).FindBinaryBlob(key);
+	else if(typeid(*this) == typeid(KV3Collection))
+		return static_cast<KV3Collection &>(*this).FindBinaryBlob(key);
+	return {};
+}
+std::optional<std::span<const uint8_t>> resource::IKeyValueCollection::FindBinaryBlobView(KVKey key)
+{
+	if(typeid(*this) == typeid(NTROStruct))
+		return static_cast<NTROStruct &>(*this).FindBinaryBlobView(key);
+	else if(typeid(*this) == typeid(KVObject))
+		return static_cast<KVObject &>(*this).FindBinaryBlobView(key);
+	else if(typeid(*this) == typeid(KV3Collection))
+		return static_cast<KV3Collection &>(*this).FindBinaryBlobView(key);
 	return {};
 }
 
@@ -95,7 +111,7 @@ resource::IKeyValueCollection *resource::ResourceData::GetData()
 		return ntro->GetOutput().get();
 	auto *binaryKv3 = dynamic_cast<BinaryKV3 *>(this);
 	if(binaryKv3)
-		return binaryKv3->GetData().get();
+		return binaryKv3->GetCollection().get();
 	auto *keyValuesOrNTRO = dynamic_cast<KeyValuesOrNTRO *>(this);
 	return keyValuesOrNTRO ? keyValuesOrNTRO->GetData().get() : nullptr;
 }
@@ -155,26 +171,33 @@ resource::NTROStruct::NTROStruct(const std::vector<std::shared_ptr<NTROValue>> &
 		Add(std::to_string(i), *v);
 	}
 }
-const std::unordered_map<std::string, std::shared_ptr<resource::NTROValue>> &resource::NTROStruct::GetContents() const { return m_contents; }
-resource::BinaryBlob *resource::NTROStruct::FindBinaryBlob(const std::string &key)
+const resource::KVKeyMap<std::shared_ptr<resource::NTROValue>> &resource::NTROStruct::GetContents() const { return m_contents; }
+resource::BinaryBlob *resource::NTROStruct::FindBinaryBlob(KVKey key)
 {
 	auto *val = dynamic_cast<NTROArray *>(FindValue(key));
 	if(val == nullptr || val->type != DataType::Byte)
 		return nullptr;
 	return &val->InitBinaryBlob();
 }
-resource::NTROValue *resource::NTROStruct::FindValue(const std::string &key)
+std::optional<std::span<const uint8_t>> resource::NTROStruct::FindBinaryBlobView(KVKey key)
+{
+	auto *blob = FindBinaryBlob(key);
+	if(blob == nullptr)
+		return {};
+	return std::span<const uint8_t> {*blob};
+}
+resource::NTROValue *resource::NTROStruct::FindValue(KVKey key)
 {
 	auto it = m_contents.find(key);
 	return (it != m_contents.end()) ? it->second.get() : nullptr;
 }
-const resource::NTROValue *resource::NTROStruct::FindValue(const std::string &key) const { return const_cast<NTROStruct *>(this)->FindValue(key); }
-resource::NTROArray *resource::NTROStruct::FindArray(const std::string &key)
+const resource::NTROValue *resource::NTROStruct::FindValue(KVKey key) const { return const_cast<NTROStruct *>(this)->FindValue(key); }
+resource::NTROArray *resource::NTROStruct::FindArray(KVKey key)
 {
 	auto o = FindValue<std::shared_ptr<NTROArray>>(key);
 	return o.has_value() ? o->get() : nullptr;
 }
-const resource::NTROArray *resource::NTROStruct::FindArray(const std::string &key) const { return const_cast<NTROStruct *>(this)->FindArray(key); }
+const resource::NTROArray *resource::NTROStruct::FindArray(KVKey key) const { return const_cast<NTROStruct *>(this)->FindArray(key); }
 void resource::NTROStruct::Add(const std::string &id, NTROValue &val) { m_contents.insert(std::make_pair(id, val.shared_from_this())); }
 void resource::NTROStruct::DebugPrint(std::stringstream &ss, const std::string &t) const
 {
@@ -192,200 +215,222 @@ void resource::NTROStruct::DebugPrint(std::stringstream &ss, const std::string &
 
 ///////////////
 
+struct resource::NTRO::DataSource {
+	template<typename T>
+	T Read(size_t offset) const
+	{
+		if(offset < base || offset - base + sizeof(T) > data.size())
+			throw std::runtime_error {"NTRO data exceeds block bounds on byte " + std::to_string(offset)};
+		T value;
+		memcpy(&value, data.data() + (offset - base), sizeof(T));
+		return value;
+	}
+	template<typename T>
+	T ReadNext(size_t &offset) const
+	{
+		auto value = Read<T>(offset);
+		offset += sizeof(T);
+		return value;
+	}
+	// Equivalent of read_offset_string
+	std::string ReadOffsetString(size_t offset) const
+	{
+		auto strOffset = Read<uint32_t>(offset);
+		if(strOffset == 0)
+			return {};
+		offset += strOffset;
+		if(offset < base || offset - base >= data.size())
+			throw std::runtime_error {"NTRO string exceeds block bounds on byte " + std::to_string(offset)};
+		auto *begin = reinterpret_cast<const char *>(data.data() + (offset - base));
+		auto *end = reinterpret_cast<const char *>(data.data() + data.size());
+		return std::string {begin, std::find(begin, end, '\0')}; // TODO: Encoding
+	}
+	std::span<const uint8_t> data;
+	size_t base = 0; // File offset of data[0]
+	const Resource &resource;
+	const ResourceIntrospectionManifest &manifest;
+};
+
 void resource::NTRO::Read(const Resource &resource, ufile::IFile &f)
 {
 	auto *block = static_cast<const ResourceIntrospectionManifest *>(resource.FindBlock(BlockType::NTRO));
 	if(block == nullptr)
 		return;
 	auto &structs = block->GetReferencedStructs();
+	if(structs.empty())
+		return;
+	size_t structIdx = 0;
 	if(m_structName.empty() == false) {
-		auto it = std::find_if(structs.begin(), structs.end(), [this](const ResourceIntrospectionManifest::ResourceDiskStruct &strct) { return strct.name == m_structName; });
+		auto it = std::find_if(structs.begin(), structs.end(), [this](const std::shared_ptr<const ResourceIntrospectionManifest::ResourceDiskStruct> &strct) { return strct->name == m_structName; });
 		if(it == structs.end())
 			return;
-		m_output = ReadStructure(resource, *it, GetOffset(), f);
-		return;
+		structIdx = it - structs.begin();
 	}
-	for(auto &refStruct : structs) {
-		m_output = ReadStructure(resource, refStruct, GetOffset(), f);
-		break;
+
+	// Pointers and strings may point anywhere in the file if it's available in memory, otherwise only the block is read
+	std::vector<uint8_t> buffer {};
+	DataSource source {{}, 0, resource, *block};
+	auto &mappedFile = resource.GetMappedFile();
+	if(mappedFile)
+		source.data = mappedFile->GetData();
+	else {
+		f.Seek(GetOffset());
+		source.data = ReadData(resource, f, GetSize(), buffer);
+		source.base = GetOffset();
 	}
+	m_output = ReadStructure(source, block->GetDecodePlan(structIdx), GetOffset());
 }
-void resource::NTRO::ReadFieldIntrospection(const Resource &resource, const ResourceIntrospectionManifest::ResourceDiskStruct::Field &field, NTROStruct &structEntry, ufile::IFile &f)
+void resource::NTRO::ReadFieldIntrospection(const DataSource &source, const ResourceIntrospectionManifest::DecodePlan::Field &field, size_t offset, NTROStruct &structEntry)
 {
-	auto count = std::max<uint16_t>(field.count, static_cast<uint16_t>(1));
+	uint32_t count = field.count;
 	auto pointer = false;
-	uint64_t prevOffset = 0;
-	if(field.indirections.empty() == false) {
-		if(field.indirections.size() > 1)
-			throw std::runtime_error {"More than one indirection, not yet handled."};
-		if(field.count > 0)
-			throw std::runtime_error {"Indirection.Count > 0 && field.Count > 0"};
-		auto indirection = field.indirections.at(0); // TODO: depth needs fixing?
-		auto offset = f.Read<uint32_t>();
-		if(indirection == 0x03) {
+	switch(field.indirection) {
+	case ResourceIntrospectionManifest::DecodePlan::Indirection::None:
+		break;
+	case ResourceIntrospectionManifest::DecodePlan::Indirection::Pointer:
+		{
+			auto indirectionOffset = source.Read<uint32_t>(offset);
 			pointer = true;
-			if(offset == 0) {
+			if(indirectionOffset == 0) {
 				auto value = std::make_shared<TNTROValue<uint8_t>>(field.type, 0u, true);
-				structEntry.Add(field.fieldName, *value); //being byte shouldn't matter
+				structEntry.Add(field.field->fieldName, *value); //being byte shouldn't matter
 				return;
 			}
-			prevOffset = f.Tell();
-			f.Seek(f.Tell() + offset - sizeof(uint32_t));
+			offset += indirectionOffset;
+			break;
 		}
-		else if(indirection == 0x04) {
-			count = f.Read<uint32_t>();
-
-			prevOffset = f.Tell();
-
-			if(count > 0)
-				f.Seek(f.Tell() + offset - sizeof(uint32_t) * 2);
+	case ResourceIntrospectionManifest::DecodePlan::Indirection::Array:
+		{
+			auto indirectionOffset = source.Read<uint32_t>(offset);
+			count = source.Read<uint32_t>(offset + sizeof(uint32_t));
+			offset += indirectionOffset;
+			break;
 		}
-		else
-			throw std::runtime_error {"Unknown indirection. (" + std::to_string(indirection) + ")"};
+	default:
+		throw std::runtime_error {field.error};
 	}
 
 	//if (pointer)
 	//{
 	//    Writer.Write("{0} {1}* = (ptr) ->", ValveDataType(field.Type), field.FieldName);
 	//}
-	if(field.count > 0 || field.indirections.size() > 0) {
-		auto ntroValues = std::make_shared<NTROArray>(field.type, (int)count, pointer, field.indirections.empty() == false);
+	if(field.isArray) {
+		auto ntroValues = std::make_shared<NTROArray>(field.type, (int)count, pointer, field.indirection != ResourceIntrospectionManifest::DecodePlan::Indirection::None);
 
 		for(auto i = decltype(count) {0u}; i < count; ++i)
-			ntroValues->GetContents().at(i) = ReadField(resource, field, pointer, f);
+			ntroValues->GetContents().at(i) = ReadField(source, field, pointer, offset);
 
-		structEntry.Add(field.fieldName, *ntroValues);
+		structEntry.Add(field.field->fieldName, *ntroValues);
 	}
 	else {
 		for(auto i = decltype(count) {0u}; i < count; ++i) {
-			auto pfield = ReadField(resource, field, pointer, f);
-			structEntry.Add(field.fieldName, *pfield);
+			auto pfield = ReadField(source, field, pointer, offset);
+			structEntry.Add(field.field->fieldName, *pfield);
 		}
 	}
-	if(prevOffset > 0)
-		f.Seek(prevOffset);
 }
 
-static std::shared_ptr<resource::NTROValue> get_float_array_ntro_value(uint32_t numValues, resource::DataType type, bool pointer, ufile::IFile &f)
-{
-	std::vector<std::shared_ptr<resource::NTROValue>> values {};
-	values.reserve(numValues);
-	for(auto i = decltype(numValues) {0u}; i < numValues; ++i) {
-		auto val = f.Read<float>();
-		values.push_back(std::static_pointer_cast<resource::NTROValue>(std::make_shared<resource::TNTROValue<float>>(resource::DataType::Float, val, pointer)));
-	}
-	return std::static_pointer_cast<resource::NTROValue>(std::make_shared<resource::TNTROValue<resource::NTROStruct>>(type, resource::NTROStruct {values}, pointer));
-}
-std::shared_ptr<resource::NTROValue> resource::NTRO::ReadField(const Resource &resource, const ResourceIntrospectionManifest::ResourceDiskStruct::Field &field, bool pointer, ufile::IFile &f)
+std::shared_ptr<resource::NTROValue> resource::NTRO::ReadField(const DataSource &source, const ResourceIntrospectionManifest::DecodePlan::Field &field, bool pointer, size_t &offset)
 {
+	// Vectors, quaternions, colors and matrices are stored inline instead of as a struct with one value per component
+	auto readPacked = [&source, &field, pointer, &offset]<typename T>() {
+		auto components = source.ReadNext<NTROFloats<sizeof(T) / sizeof(float)>>(offset);
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<T>>(field.type, *cast_components_to_type<T>(components), pointer));
+	};
 	switch(field.type) {
 	case DataType::Struct:
 		{
-			auto *introspectionManifest = resource.GetIntrospectionManifest();
-			auto &refStructs = introspectionManifest->GetReferencedStructs();
-			auto it = std::find_if(refStructs.begin(), refStructs.end(), [&field](const ResourceIntrospectionManifest::ResourceDiskStruct &diskStruct) { return diskStruct.id == field.typeData; });
-			auto &newStruct = *it;
-			return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<std::shared_ptr<NTROStruct>>>(field.type, ReadStructure(resource, newStruct, f.Tell(), f), pointer));
+			if(field.structPlan == nullptr)
+				throw std::runtime_error {"Unknown struct id " + std::to_string(field.field->typeData) + " (name: " + field.field->fieldName + ")"};
+			auto value = ReadStructure(source, *field.structPlan, offset);
+			// Some structs are padded, so all the field sizes do not add up to the size on disk
+			offset += field.structPlan->diskStruct->diskSize;
+			return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<std::shared_ptr<NTROStruct>>>(field.type, value, pointer));
 		}
 	case DataType::Enum:
 		// TODO: Lookup in ReferencedEnums
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<uint32_t>>(field.type, f.Read<uint32_t>(), pointer));
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<uint32_t>>(field.type, source.ReadNext<uint32_t>(offset), pointer));
 
 	case DataType::SByte:
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<int8_t>>(field.type, f.Read<int8_t>(), pointer));
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<int8_t>>(field.type, source.ReadNext<int8_t>(offset), pointer));
 
 	case DataType::Byte:
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<uint8_t>>(field.type, f.Read<uint8_t>(), pointer));
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<uint8_t>>(field.type, source.ReadNext<uint8_t>(offset), pointer));
 
 	case DataType::Boolean:
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<bool>>(field.type, f.Read<uint8_t>() == 1 ? true : false, pointer));
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<bool>>(field.type, source.ReadNext<uint8_t>(offset) == 1 ? true : false, pointer));
 
 	case DataType::Int16:
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<int16_t>>(field.type, f.Read<int16_t>(), pointer));
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<int16_t>>(field.type, source.ReadNext<int16_t>(offset), pointer));
 
 	case DataType::UInt16:
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<uint16_t>>(field.type, f.Read<uint16_t>(), pointer));
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<uint16_t>>(field.type, source.ReadNext<uint16_t>(offset), pointer));
 
 	case DataType::Int32:
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<int32_t>>(field.type, f.Read<int32_t>(), pointer));
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<int32_t>>(field.type, source.ReadNext<int32_t>(offset), pointer));
 
 	case DataType::UInt32:
 		// This causes a compiler error under clang-22
-		// return std::static_pointer_cast<resource::NTROValue>(std::make_shared<TNTROValue<uint32_t>>(field.type, f.Read<uint32_t>(), pointer));
-		return std::static_pointer_cast<NTROValue>(std::shared_ptr<TNTROValue<uint32_t>> {new TNTROValue<uint32_t> {field.type, f.Read<uint32_t>(), pointer}});
+		// return std::static_pointer_cast<resource::NTROValue>(std::make_shared<TNTROValue<uint32_t>>(field.type, source.ReadNext<uint32_t>(offset), pointer));
+		return std::static_pointer_cast<NTROValue>(std::shared_ptr<TNTROValue<uint32_t>> {new TNTROValue<uint32_t> {field.type, source.ReadNext<uint32_t>(offset), pointer}});
 	case DataType::Float:
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<float>>(field.type, f.Read<float>(), pointer));
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<float>>(field.type, source.ReadNext<float>(offset), pointer));
 
 	case DataType::Int64:
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<int64_t>>(field.type, f.Read<int64_t>(), pointer));
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<int64_t>>(field.type, source.ReadNext<int64_t>(offset), pointer));
 
 	case DataType::ExternalReference:
 		{
-			auto id = f.Read<uint64_t>();
-			auto *externalReferences = resource.GetExternalReferences();
-			std::string value {};
+			auto id = source.ReadNext<uint64_t>(offset);
+			auto *externalReferences = source.resource.GetExternalReferences();
+			// The name is shared with the reference list instead of being copied for every field
+			std::shared_ptr<const std::string> value {};
 			if(externalReferences) {
-				auto &refInfos = externalReferences->GetResourceReferenceInfos();
-				auto it = std::find_if(refInfos.begin(), refInfos.end(), [id](const ResourceExtRefList::ResourceReferenceInfo &refInfo) { return refInfo.id == id; });
-				if(it != refInfos.end())
-					value = it->name;
+				auto *refInfo = externalReferences->FindResourceReferenceInfo(id);
+				if(refInfo)
+					value = refInfo->name;
 			}
-			return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<std::string>>(field.type, value, pointer));
+			return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<std::shared_ptr<const std::string>>>(field.type, value, pointer));
 		}
 	case DataType::UInt64:
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<uint64_t>>(field.type, f.Read<uint64_t>(), pointer));
+		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<uint64_t>>(field.type, source.ReadNext<uint64_t>(offset), pointer));
 
 	case DataType::Vector:
-		return get_float_array_ntro_value(3, field.type, pointer, f);
+		return readPacked.template operator()<Vector3>();
 	case DataType::Quaternion:
-		return get_float_array_ntro_value(4, field.type, pointer, f);
+		return readPacked.template operator()<Quat>();
 	case DataType::Color:
 	case DataType::Fltx4:
 	case DataType::Vector4D:
 	case DataType::Vector4D_44:
-		return get_float_array_ntro_value(4, field.type, pointer, f);
+		return readPacked.template operator()<Vector4>();
 	case DataType::String4:
 	case DataType::String:
-		return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<std::string>>(field.type, read_offset_string(f), pointer));
+		{
+			auto value = source.ReadOffsetString(offset);
+			offset += sizeof(uint32_t);
+			return std::static_pointer_cast<NTROValue>(std::make_shared<TNTROValue<std::string>>(field.type, value, pointer));
+		}
 
 	case DataType::Matrix2x4:
-		return get_float_array_ntro_value(8, field.type, pointer, f);
+		return readPacked.template operator()<NTROFloats<8>>();
 	case DataType::Matrix3x4:
 	case DataType::Matrix3x4a:
-		return get_float_array_ntro_value(12, field.type, pointer, f);
+		return readPacked.template operator()<NTROFloats<12>>();
 	case DataType::CTransform:
-		return get_float_array_ntro_value(8, field.type, pointer, f);
+		return readPacked.template operator()<NTROFloats<8>>();
 	default:
-		throw std::runtime_error {"Unknown data type: " + to_string(field.type) + " (name: " + field.fieldName + ")"};
+		throw std::runtime_error {"Unknown data type: " + to_string(field.type) + " (name: " + field.field->fieldName + ")"};
 	}
 	return nullptr;
 }
 
-std::shared_ptr<resource::NTROStruct> resource::NTRO::ReadStructure(const Resource &resource, const ResourceIntrospectionManifest::ResourceDiskStruct &refStruct, int64_t startingOffset, ufile::IFile &f)
+std::shared_ptr<resource::NTROStruct> resource::NTRO::ReadStructure(const DataSource &source, const ResourceIntrospectionManifest::DecodePlan &plan, size_t startingOffset)
 {
-	auto structEntry = std::make_shared<NTROStruct>(refStruct.name);
-	for(auto &field : refStruct.fieldIntrospection) {
-		f.Seek(startingOffset + field.diskOffset);
-		ReadFieldIntrospection(resource, field, *structEntry, f);
-	}
-
-	// Some structs are padded, so all the field sizes do not add up to the size on disk
-	f.Seek(startingOffset + refStruct.diskSize);
-
-	if(refStruct.baseStructId != 0) {
-		auto previousOffset = f.Tell();
-		auto *introspectionManifest = resource.GetIntrospectionManifest();
-		auto &refStructs = introspectionManifest->GetReferencedStructs();
-		auto it = std::find_if(refStructs.begin(), refStructs.end(), [&refStruct](const ResourceIntrospectionManifest::ResourceDiskStruct &diskStruct) { return diskStruct.id == refStruct.baseStructId; });
-
-		auto &newStruct = *it;
-		// Valve doesn't print this struct's type, so we can't just call ReadStructure *sigh*
-		for(auto &field : newStruct.fieldIntrospection) {
-			f.Seek(startingOffset + field.diskOffset);
-			ReadFieldIntrospection(resource, field, *structEntry, f);
-		}
-		f.Seek(previousOffset);
-	}
+	// The plan already contains the fields of the base struct
+	auto structEntry = std::make_shared<NTROStruct>(plan.diskStruct->name);
+	for(auto &field : plan.fields)
+		ReadFieldIntrospection(source, field, startingOffset + field.diskOffset, *structEntry);
 	return structEntry;
 }
 void resource::NTRO::DebugPrint(std::stringstream &ss, const std::string &t) const
@@ -559,7 +604,7 @@ void resource::KeyValuesOrNTRO::Read(const Resource &resource, ufile::IFile &f)
 		kv3->SetSize(GetSize());
 		kv3->Read(resource, f);
 
-		m_data = std::static_pointer_cast<IKeyValueCollection>(kv3->GetData());
+		m_data = kv3->GetCollection();
 		m_bakingData = std::static_pointer_cast<ResourceData>(kv3);
 	}
 	else {
@@ -576,6 +621,13 @@ void resource::KeyValuesOrNTRO::Read(const Resource &resource, ufile::IFile &f)
 void resource::KeyValuesOrNTRO::DebugPrint(std::stringstream &ss, const std::string &t) const {}
 BlockType resource::KeyValuesOrNTRO::GetType() const { return m_type; }
 const std::shared_ptr<resource::IKeyValueCollection> &resource::KeyValuesOrNTRO::GetData() const { return m_data; }
+std::shared_ptr<resource::IKeyValueCollection> resource::KeyValuesOrNTRO::GetData(std::span<const std::string_view> paths) const
+{
+	if(m_data)
+		return m_data;
+	auto *kv3 = dynamic_cast<BinaryKV3 *>(m_bakingData.get());
+	return kv3 ? kv3->Project(paths) : nullptr;
+}
 const std::shared_ptr<resource::ResourceData> &resource::KeyValuesOrNTRO::GetBakingData() const { return m_bakingData; }
 
 ///////////////
@@ -714,371 +766,41 @@ uint8_t resource::Texture::GetMipMapCount() const { return m_mipMapCount; }
 uint32_t resource::Texture::GetPicmip0Res() const { return m_picmip0Res; }
 const std::unordered_map<VTexExtraData, std::vector<uint8_t>> &resource::Texture::GetExtraData() const { return m_extraData; }
 
-static std::array<std::array<uint8_t, 16>, 64> BC7PartitionTable3 {
-  //Partition table for 3-subset BPTC, with the 4×4 block of values for each partition number
-  std::array<uint8_t, 16> {0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2},
-  {0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1},
-  {0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1},
-  {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1},
-  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2},
-  {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2},
-  {0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1},
-  {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1},
-  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2},
-  {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2},
-  {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2},
-  {0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2},
-  {0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2},
-  {0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2},
-  {0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2},
-  {0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0},
-  {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2},
-  {0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0},
-  {0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2},
-  {0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1},
-  {0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2},
-  {0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1},
-  {0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2},
-  {0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0},
-  {0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0},
-  {0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2},
-  {0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0},
-  {0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1},
-  {0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2},
-  {0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2},
-  {0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1},
-  {0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1},
-  {0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2},
-  {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1},
-  {0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2},
-  {0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0},
-  {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0},
-  {0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0},
-  {0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0},
-  {0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1},
-  {0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1},
-  {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2},
-  {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1},
-  {0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2},
-  {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1},
-  {0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1},
-  {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1},
-  {0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1},
-  {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2},
-  {0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1},
-  {0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2},
-  {0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2},
-  {0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2},
-  {0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2},
-  {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2},
-  {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2},
-  {0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2},
-  {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2},
-  {0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2},
-  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2},
-  {0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1},
-  {0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2},
-  {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2},
-  {0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0},
-};
-
-static std::array<uint8_t, 64> BC7AnchorIndices32 {//BPTC anchor index values for the second subset of three-subset partitioning, by partition number
-  3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3, 3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15, 8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15, 3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3};
-static std::array<uint8_t, 64> BC7AnchorIndices33 {//BPTC anchor index values for the third subset of three-subset partitioning, by partition number
-  15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8, 15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8, 15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8, 15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8};
-static std::array<uint8_t, 8> BC7IndLength = {3, 3, 2, 2, 2, 2, 4, 2};
-
-static std::array<std::array<uint8_t, 16>, 64> BPTCPartitionTable2 {
-  //Partition table for 2-subset BPTC, with the 4×4 block of values for each partition number
-  std::array<uint8_t, 16> {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
-  {0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1},
-  {0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1},
-  {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1},
-  {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1},
-  {0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1},
-  {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1},
-  {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1},
-  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1},
-  {0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-  {0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1},
-  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1},
-  {0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1},
-  {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
-  {0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1},
-  {0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
-  {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0},
-  {0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0},
-  {0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
-  {0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0},
-  {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0},
-  {0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1},
-  {0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0},
-  {0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0},
-  {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0},
-  {0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0},
-  {0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0},
-  {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0},
-  {0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0},
-  {0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0},
-  {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1},
-  {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1},
-  {0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0},
-  {0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0},
-  {0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0},
-  {0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0},
-  {0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1},
-  {0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1},
-  {0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0},
-  {0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0},
-  {0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0},
-  {0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0},
-  {0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0},
-  {0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1},
-  {0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1},
-  {0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0},
-  {0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0},
-  {0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0},
-  {0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0},
-  {0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0},
-  {0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1},
-  {0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1},
-  {0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0},
-  {0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0},
-  {0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1},
-  {0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1},
-  {0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1},
-  {0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1},
-  {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
-  {0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0},
-  {0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0},
-  {0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1},
-};
-static std::array<uint8_t, 64> BPTCAnchorIndices2 {// BPTC anchor index values for the second subset of two-subset partitioning, by partition number
-  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2, 15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6, 6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15};
-static std::array<uint8_t, 4> BPTCWeights2 = {0, 21, 43, 64};
-static std::array<uint8_t, 8> BPTCWeights3 = {0, 9, 19, 27, 47, 46, 55, 64};
-static std::array<uint8_t, 16> BPTCWeights4 = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
-
-static uint16_t BPTCInterpolateFactor(int weight, int e0, int e1) { return (uint16_t)((((64 - weight) * e0) + (weight * e1) + 32) >> 6); }
-
 void resource::Texture::UncompressBC7(uint32_t RowBytes, pragma::util::DataStream &ds, std::vector<uint8_t> &data, int w, int h, bool hemiOctRB, bool invert)
 {
-	auto blockCountX = (w + 3) / 4;
-	auto blockCountY = (h + 3) / 4;
-
-	for(auto j = decltype(blockCountY) {0u}; j < blockCountY; ++j) {
-		for(auto i = decltype(blockCountX) {0u}; i < blockCountX; ++i) {
-			auto block0 = ds->Read<uint64_t>();
-			auto block64 = ds->Read<uint64_t>();
-			int m = 0;
-			for(; m < 8; m++) {
-				if((block0 >> m & 1) == 1) {
-					break;
-				}
-			}
-
-			byte pb = 0;
-			byte rb = 0;
-			byte isb = 0;
-			std::array<std::array<uint8_t, 4>, 6> endpoints {};
-			byte epbits = 0;
-			byte spbits = 0;
-			uint64_t ib = 0;
-			uint64_t ib2 = 0;
-
-			if(m == 0) {
-				pb = (byte)(block0 >> 1 & 0xF); //4bit
-			}
-			else if(m == 1 || m == 2 || m == 3 || m == 7) {
-				pb = (byte)((block0 >> (m + 1)) & 0x3F); //6bit
-			}
-
-			auto ReadEndpoints = [&](int start, int ns2, int cb, int astart, int ab) {
-				auto GetVal = [&](int p, byte vm) -> uint8_t {
-					byte res = 0;
-					if(p < 64) {
-						res = (byte)(block0 >> p & vm);
-						if(p + cb > 64) {
-							res |= (byte)(block64 << (64 - p) & vm);
-						}
-					}
-					else {
-						res = (byte)(block64 >> (p - 64) & vm);
-					}
-
-					return res;
-				};
-
-				auto mask = (byte)((0x1 << cb) - 1);
-				for(int c = 0; c < 3; c++) {
-					for(int s = 0; s < ns2; s++) {
-						int ofs = start + (cb * ((c * ns2) + s));
-						endpoints[s][c] = GetVal(ofs, mask);
-						if(m == 1) {
-							endpoints[s][c] = (byte)(endpoints[s][c] << 2 | ((spbits >> (s >> 1) & 1) << 1) | (endpoints[s][c] >> 5));
-						}
-						else if(m == 0 || m == 3 || m == 6 || m == 7) {
-							endpoints[s][c] = (byte)(endpoints[s][c] << (8 - cb) | ((epbits >> s & 1) << (7 - cb)) | (endpoints[s][c] >> ((cb * 2) - 7)));
-						}
-						else {
-							endpoints[s][c] = (byte)(endpoints[s][c] << (8 - cb) | (endpoints[s][c] >> ((cb * 2) - 8)));
-						}
-					}
-				}
-
-				if(ab != 0) {
-					mask = (byte)((0x1 << ab) - 1);
-					for(int s = 0; s < ns2; s++) {
-						int ofs = astart + (ab * s);
-						endpoints[s][3] = GetVal(ofs, mask);
-						if(m == 6 || m == 7) {
-							endpoints[s][3] = (byte)((endpoints[s][3] << (8 - ab)) | ((epbits >> s & 1) << (7 - ab)) | (endpoints[s][3] >> ((ab * 2) - 7)));
-						}
-						else {
-							endpoints[s][3] = (byte)((endpoints[s][3] << (8 - ab)) | (endpoints[s][3] >> ((ab * 2) - 8)));
-						}
-					}
-				}
-			};
-
-			if(m == 0) {
-				epbits = (byte)(block64 >> 13 & 0x3F);
-				ReadEndpoints(5, 6, 4, 0, 0);
-				ib = block64 >> 19;
-			}
-			else if(m == 1) {
-				spbits = (byte)((block64 >> 16 & 1) | ((block64 >> 17 & 1) << 1));
-				ReadEndpoints(8, 4, 6, 0, 0);
-				ib = block64 >> 18;
-			}
-			else if(m == 2) {
-				ReadEndpoints(9, 6, 5, 0, 0);
-				ib = block64 >> 35;
-			}
-			else if(m == 3) {
-				epbits = (byte)(block64 >> 30 & 0xF);
-				ReadEndpoints(10, 4, 7, 0, 0);
-				ib = block64 >> 34;
-			}
-			else if(m == 4) {
-				rb = (byte)(block0 >> 5 & 0x3);
-				isb = (byte)(block0 >> 7 & 0x1);
-				ReadEndpoints(8, 2, 5, 38, 6);
-				ib = (block0 >> 50) | (block64 << 14);
-				ib2 = block64 >> 17;
-			}
-			else if(m == 5) {
-				rb = (byte)((block0 >> 6) & 0x3);
-				ReadEndpoints(8, 2, 7, 50, 8);
-				ib = block64 >> 2;
-				ib2 = block64 >> 33;
-			}
-			else if(m == 6) {
-				epbits = (byte)((block0 >> 63) | ((block64 & 1) << 1));
-				ReadEndpoints(7, 2, 7, 49, 7);
-				ib = block64 >> 1;
-			}
-			else if(m == 7) {
-				epbits = (byte)(block64 >> 30 & 0xF);
-				ReadEndpoints(14, 4, 5, 74, 5);
-				ib = block64 >> 34;
-			}
-
-			int ib2l = (m == 4) ? 3 : 2;
-			for(int by = 0; by < 4; by++) {
-				for(int bx = 0; bx < 4; bx++) {
-					int io = (by * 4) + bx;
-					auto pixelIndex = (((j * 4) + by) * RowBytes) + (((i * 4) + bx) * 4);
-
-					byte cweight = 0;
-					byte aweight = 0;
-					byte subset = 0;
-
-					int isAnchor = 0;
-					if(m == 0 || m == 2) { //3 subsets
-						isAnchor = (io == 0 || io == BC7AnchorIndices32[pb] || io == BC7AnchorIndices33[pb]) ? 1 : 0;
-						subset = (byte)(BC7PartitionTable3[pb][io] * 2);
-					}
-					else if(m == 1 || m == 3 || m == 7) { //2 subsets
-						subset = (byte)(BPTCPartitionTable2[pb][io] * 2);
-						isAnchor = (io == 0 || io == BPTCAnchorIndices2[pb]) ? 1 : 0;
-					}
-					else if(m == 4 || m == 5 || m == 6) { //1 subset
-						isAnchor = (io == 0) ? 1 : 0;
-					}
-
-					if(m == 0 || m == 1) { //3 bit
-						cweight = BPTCWeights3[ib & (0x7u >> isAnchor)];
-					}
-					else if(m == 6) { //4 bit
-						cweight = BPTCWeights4[ib & (0xFu >> isAnchor)];
-					}
-					else { //2 bit
-						cweight = BPTCWeights2[ib & (0x3u >> isAnchor)];
-					}
-
-					ib >>= BC7IndLength[m] - isAnchor;
-
-					if(m == 4) {
-						aweight = BPTCWeights3[ib2 & (0x7u >> isAnchor)];
-						ib2 >>= ib2l - isAnchor;
-
-						if(isb == 1) {
-							byte t = cweight;
-							cweight = aweight;
-							aweight = t;
-						}
-					}
-					else if(m == 5) {
-						aweight = BPTCWeights2[ib2 & (0x3u >> isAnchor)];
-						ib2 >>= ib2l - isAnchor;
-					}
-					else if(m > 5) {
-						aweight = cweight;
-					}
-
-					data[pixelIndex] = (byte)BPTCInterpolateFactor(cweight, endpoints[subset][2], endpoints[subset + 1][2]);
-					data[pixelIndex + 1] = (byte)BPTCInterpolateFactor(cweight, endpoints[subset][1], endpoints[subset + 1][1]);
-					data[pixelIndex + 2] = (byte)BPTCInterpolateFactor(cweight, endpoints[subset][0], endpoints[subset + 1][0]);
-
-					if(m < 4) {
-						data[pixelIndex + 3] = std::numeric_limits<uint8_t>::max();
-					}
-					else {
-						data[pixelIndex + 3] = (byte)BPTCInterpolateFactor(aweight, endpoints[subset][3], endpoints[subset + 1][3]);
-
-						if((m == 4 || m == 5) && rb != 0) {
-							byte t = data[pixelIndex + 3];
-							data[pixelIndex + 3] = data[pixelIndex + 3 - rb];
-							data[pixelIndex + 3 - rb] = t;
-						}
-					}
-
-					if(hemiOctRB) {
-						float nx = ((data[pixelIndex + 2] + data[pixelIndex + 1]) / 255.0f) - 1.003922f;
-						float ny = (data[pixelIndex + 2] - data[pixelIndex + 1]) / 255.0f;
-						float nz = 1 - fabsf(nx) - fabsf(ny);
-
-						float l = (float)sqrtf((nx * nx) + (ny * ny) + (nz * nz));
-						data[pixelIndex + 3] = data[pixelIndex + 0]; //b to alpha
-						data[pixelIndex + 2] = (byte)(((nx / l * 0.5f) + 0.5f) * 255);
-						data[pixelIndex + 1] = (byte)(((ny / l * 0.5f) + 0.5f) * 255);
-						data[pixelIndex + 0] = (byte)(((nz / l * 0.5f) + 0.5f) * 255);
-					}
-
-					if(invert) {
-						data[pixelIndex + 1] = (byte)(~data[pixelIndex + 1]); // LegacySource1InvertNormals
-					}
-				}
-			}
-		}
-	}
+	auto blockCountX = static_cast<uint32_t>((w + 3) / 4);
+	auto blockCountY = static_cast<uint32_t>((h + 3) / 4);
+	auto inputSize = static_cast<size_t>(blockCountX) * blockCountY * 16;
+	auto offset = ds->GetOffset();
+	if(offset + inputSize > ds->GetInternalSize())
+		throw std::runtime_error {"BC7 data exceeds stream size"};
+	// Complete blocks are written, including texels beyond w x h
+	std::span<const uint8_t> input {static_cast<const uint8_t *>(ds->GetData()) + offset, inputSize};
+	impl::decode_blocks(impl::BlockFormat::BC7, input, data.data(), RowBytes, blockCountX * 4, blockCountY * 4, {hemiOctRB, invert});
+	ds->SetOffset(offset + inputSize);
+}
+void resource::Texture::UncompressBC7(std::span<const uint8_t> input, std::span<uint8_t> output, uint32_t rowPitch, uint32_t width, uint32_t height, bool hemiOctRB, bool invert, uint32_t numThreads)
+{
+	if(width == 0 || height == 0)
+		return;
+	if(rowPitch < static_cast<size_t>(width) * 4 || output.size() < static_cast<size_t>(rowPitch) * (height - 1) + static_cast<size_t>(width) * 4)
+		throw std::runtime_error {"Output buffer is too small for BC7 decode"};
+	impl::decode_blocks(impl::BlockFormat::BC7, input, output.data(), rowPitch, width, height, {hemiOctRB, invert}, numThreads);
+}
+void resource::Texture::UncompressBC7(std::span<const uint8_t> input, std::span<uint8_t> output, uint32_t rowPitch, uint32_t width, uint32_t height, bool hemiOctRB, bool invert, ThreadPool &threadPool)
+{
+	if(width == 0 || height == 0)
+		return;
+	if(rowPitch < static_cast<size_t>(width) * 4 || output.size() < static_cast<size_t>(rowPitch) * (height - 1) + static_cast<size_t>(width) * 4)
+		throw std::runtime_error {"Output buffer is too small for BC7 decode"};
+	impl::decode_blocks(impl::BlockFormat::BC7, input, output.data(), rowPitch, width, height, {hemiOctRB, invert}, threadPool);
 }
 void resource::Texture::Read(const Resource &resource, ufile::IFile &f)
 {
-	m_file = &f;
+	// The texture keeps its own reference to the file data, so mipmaps can be read by offset after the resource file has been closed
+	m_mappedFile = resource.GetMappedFile();
+	if(!m_mappedFile)
+		m_mappedFile = MappedFile::Create(f);
 	f.Seek(GetOffset());
 	auto version = f.Read<uint16_t>();
 	if(version != 1)
@@ -1142,6 +864,23 @@ void resource::Texture::Read(const Resource &resource, ufile::IFile &f)
 		}
 	}
 	m_dataOffset = GetOffset() + GetSize();
+
+	// Mipmaps are stored from the smallest to the largest one
+	m_mipInfos.resize(m_mipMapCount);
+	auto offset = m_dataOffset;
+	for(auto mip = static_cast<int32_t>(m_mipMapCount) - 1; mip >= 0; --mip) {
+		auto &mipInfo = m_mipInfos[mip];
+		mipInfo.offset = offset;
+		mipInfo.size = CalculateBufferSizeForMipLevel(mip);
+		if(m_isCompressed) {
+			if(static_cast<size_t>(mip) >= m_compressedMips.size())
+				throw std::runtime_error {"Missing compressed size for mipmap " + std::to_string(mip)};
+			mipInfo.storedSize = static_cast<uint32_t>(m_compressedMips[mip]);
+		}
+		else
+			mipInfo.storedSize = mipInfo.size;
+		offset += mipInfo.storedSize;
+	}
 }
 
 void resource::Texture::DebugPrint(std::stringstream &ss, const std::string &t) const
@@ -1163,7 +902,7 @@ void resource::Texture::DebugPrint(std::stringstream &ss, const std::string &t)
 	ss << t << "}\n";
 }
 
-uint32_t resource::Texture::GetBlockSize()
+uint32_t resource::Texture::GetBlockSize() const
 {
 	switch(m_format) {
 	case DXT1:
@@ -1213,53 +952,338 @@ uint32_t resource::Texture::GetBlockSize()
 	return 1;
 }
 
-uint64_t resource::Texture::GetMipmapDataOffset(uint8_t mipmap)
+uint64_t resource::Texture::GetMipmapDataOffset(uint8_t mipmap) const
 {
-	auto offset = m_dataOffset;
+	auto *mipInfo = GetMipInfo(mipmap);
+	return mipInfo ? mipInfo->offset : m_dataOffset;
+}
 
-	auto numMipmLevels = GetMipMapCount();
-	if(numMipmLevels == 1)
-		return offset;
+const resource::Texture::MipInfo *resource::Texture::GetMipInfo(uint8_t mipLevel) const { return (mipLevel < m_mipInfos.size()) ? &m_mipInfos[mipLevel] : nullptr; }
 
-	for(auto j = numMipmLevels - 1; j > mipmap; j--) {
-		if(m_isCompressed) {
-			offset += m_compressedMips[j];
+void resource::Texture::ReadTextureData(uint8_t mipLevel, std::vector<uint8_t> &outData) const
+{
+	auto *mipInfo = GetMipInfo(mipLevel);
+	if(!mipInfo)
+		throw std::runtime_error {"Invalid mip level " + std::to_string(mipLevel)};
+	outData.resize(mipInfo->size);
+	ReadTextureData(mipLevel, std::span<uint8_t> {outData});
+}
+
+void resource::Texture::ReadTextureData(uint8_t mipLevel, std::span<uint8_t> outData) const
+{
+	auto *mipInfo = GetMipInfo(mipLevel);
+	if(!mipInfo)
+		throw std::runtime_error {"Invalid mip level " + std::to_string(mipLevel)};
+	if(outData.size() < mipInfo->size)
+		throw std::runtime_error {"Output buffer is too small for mipmap " + std::to_string(mipLevel)};
+	auto storedSize = std::min(mipInfo->storedSize, mipInfo->size);
+	auto data = m_mappedFile->GetData();
+	if(mipInfo->offset > data.size() || storedSize > data.size() - mipInfo->offset)
+		throw std::runtime_error {"Texture data exceeds file bounds"};
+	auto storedData = data.subspan(mipInfo->offset, storedSize);
+	if(!mipInfo->IsCompressed()) {
+		memcpy(outData.data(), storedData.data(), storedData.size());
+		return;
+	}
+
+	auto result = LZ4_decompress_safe(reinterpret_cast<const char *>(storedData.data()), reinterpret_cast<char *>(outData.data()), storedData.size() * sizeof(storedData.front()), mipInfo->size);
+	if(result < 0)
+		throw std::runtime_error {"Unable to decompress LZ4 data: " + std::to_string(result)};
+}
+
+std::vector<std::vector<uint8_t>> resource::Texture::ReadTextureDataRange(uint8_t firstMipLevel, uint8_t lastMipLevel) const
+{
+	if(firstMipLevel > lastMipLevel)
+		throw std::runtime_error {"Invalid mip level range"};
+	std::vector<std::vector<uint8_t>> data;
+	data.resize(lastMipLevel - firstMipLevel + 1);
+	for(auto i = decltype(data.size()) {0u}; i < data.size(); ++i)
+		ReadTextureData(static_cast<uint8_t>(firstMipLevel + i), data[i]);
+	return data;
+}
+
+std::optional<std::span<const uint8_t>> resource::Texture::GetMappedTextureData(uint8_t mipLevel) const
+{
+	auto *mipInfo = GetMipInfo(mipLevel);
+	if(!mipInfo || mipInfo->IsCompressed())
+		return {};
+	auto data = m_mappedFile->GetData();
+	if(mipInfo->offset > data.size() || mipInfo->size > data.size() - mipInfo->offset)
+		return {};
+	return data.subspan(mipInfo->offset, mipInfo->size);
+}
+
+static std::optional<impl::BlockFormat> get_block_format(VTexFormat format)
+{
+	switch(format) {
+	case DXT1:
+		return impl::BlockFormat::BC1;
+	case DXT5:
+		return impl::BlockFormat::BC3;
+	case ATI1N:
+		return impl::BlockFormat::BC4;
+	case ATI2N:
+		return impl::BlockFormat::BC5;
+	case BC6H:
+		return impl::BlockFormat::BC6H;
+	case BC7:
+		return impl::BlockFormat::BC7;
+	case ETC2:
+		return impl::BlockFormat::ETC2;
+	case ETC2_EAC:
+		return impl::BlockFormat::ETC2_EAC;
+	default:
+		return {};
+	}
+}
+
+// Decodes LZ4-decompressed mipmap data. If a task group is specified, the slices are split into tasks of a few block rows each.
+static impl::TextureDecodeOptions get_decode_options(const resource::Texture::DecodeOptions &options) { return {options.hemiOctRB, options.invert}; }
+
+static void decode_mip(VTexFormat vtexFormat, std::span<const uint8_t> data, std::span<uint8_t> output, uint32_t rowPitch, uint32_t width, uint32_t height, uint32_t numSlices, uint32_t texelSize, const impl::TextureDecodeOptions &options,
+  impl::TaskGroup *taskGroup)
+{
+	auto sliceOutputSize = static_cast<size_t>(rowPitch) * height;
+	auto format = get_block_format(vtexFormat);
+	if(!format) {
+		auto rowSize = static_cast<size_t>(width) * texelSize;
+		if(rowSize * height * numSlices > data.size())
+			throw std::runtime_error {"Insufficient texture data"};
+		auto applyOptions = (options.hemiOctRB || options.invert) && (vtexFormat == VTexFormat::RGBA8888 || vtexFormat == VTexFormat::BGRA8888);
+		for(auto row = decltype(height) {0u}; row < height * numSlices; ++row) {
+			auto *rowOutput = output.data() + static_cast<size_t>(row) * rowPitch;
+			memcpy(rowOutput, data.data() + row * rowSize, rowSize);
+			if(applyOptions)
+				impl::apply_decode_options(rowOutput, width, options, vtexFormat == VTexFormat::RGBA8888);
 		}
-		else {
-			offset += CalculateBufferSizeForMipLevel(j);
+		return;
+	}
+	auto sliceInputSize = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * impl::get_block_size(*format);
+	if(sliceInputSize * numSlices > data.size())
+		throw std::runtime_error {"Insufficient texture data"};
+	auto blockCountY = (height + 3) / 4;
+	constexpr uint32_t blockRowsPerTask = 16;
+	for(auto z = decltype(numSlices) {0u}; z < numSlices; ++z) {
+		auto input = data.subspan(sliceInputSize * z, sliceInputSize);
+		auto *sliceOutput = output.data() + sliceOutputSize * z;
+		if(!taskGroup) {
+			impl::decode_block_rows(*format, input, sliceOutput, rowPitch, width, height, 0, blockCountY, options);
+			continue;
 		}
+		for(auto start = 0u; start < blockCountY; start += blockRowsPerTask)
+			taskGroup->Run([format = *format, input, sliceOutput, rowPitch, width, height, start, options]() { impl::decode_block_rows(format, input, sliceOutput, rowPitch, width, height, start, start + blockRowsPerTask, options); });
 	}
-	return offset;
 }
 
-void resource::Texture::ReadTextureData(uint8_t mipLevel, std::vector<uint8_t> &outData)
+void resource::Texture::GetMipDimensions(uint8_t mipLevel, uint32_t &outWidth, uint32_t &outHeight, uint32_t &outNumSlices) const
 {
-	m_file->Seek(GetMipmapDataOffset(mipLevel));
-	auto uncompressedSize = CalculateBufferSizeForMipLevel(mipLevel);
-	auto compressedSize = m_isCompressed ? m_compressedMips.at(mipLevel) : uncompressedSize;
-	outData.resize(uncompressedSize);
-	if(compressedSize >= uncompressedSize) {
-		m_file->Read(outData.data(), outData.size() * sizeof(outData.front()));
+	outWidth = std::max(m_width >> mipLevel, 1);
+	outHeight = std::max(m_height >> mipLevel, 1);
+	outNumSlices = GetMipDepth(mipLevel) * GetFaceCount();
+}
+
+uint32_t resource::Texture::GetMipDepth(uint8_t mipLevel) const
+{
+	// Only volume textures shrink along the z-axis, for texture arrays the depth is the number of layers
+	auto depth = (pragma::math::to_integral(m_flags) & pragma::math::to_integral(VTexFlags::VOLUME_TEXTURE)) ? (m_depth >> mipLevel) : m_depth;
+	return std::max<uint32_t>(depth, 1);
+}
+
+uint32_t resource::Texture::GetFaceCount() const { return (pragma::math::to_integral(m_flags) & pragma::math::to_integral(VTexFlags::CUBE_TEXTURE)) ? 6 : 1; }
+
+resource::Texture::DecodedFormat resource::Texture::GetDecodedFormat() const
+{
+	switch(m_format) {
+	case BC6H:
+		return DecodedFormat::RGBA16F;
+	case RGBA8888:
+		return DecodedFormat::RGBA8;
+	case BGRA8888:
+		return DecodedFormat::BGRA8;
+	case RGBA16161616F:
+		return DecodedFormat::RGBA16F;
+	case RGBA32323232F:
+		return DecodedFormat::RGBA32F;
+	default:
+		return get_block_format(m_format) ? DecodedFormat::BGRA8 : DecodedFormat::Stored;
+	}
+}
+uint32_t resource::Texture::GetDecodedTexelSize() const
+{
+	auto format = get_block_format(m_format);
+	return format ? impl::get_decoded_texel_size(*format) : GetBlockSize();
+}
+
+resource::Texture::DecodeBufferSizes resource::Texture::GetDecodeBufferSizes(uint8_t mipLevel, uint32_t rowPitch) const
+{
+	auto *mipInfo = GetMipInfo(mipLevel);
+	if(!mipInfo)
+		throw std::runtime_error {"Invalid mip level " + std::to_string(mipLevel)};
+	uint32_t width, height, numSlices;
+	GetMipDimensions(mipLevel, width, height, numSlices);
+	auto tightRowPitch = width * GetDecodedTexelSize();
+	DecodeBufferSizes sizes {};
+	sizes.rowPitch = (rowPitch > 0) ? rowPitch : tightRowPitch;
+	sizes.outputSize = static_cast<size_t>(sizes.rowPitch) * height * numSlices;
+	// LZ4-compressed data needs to be decompressed somewhere first, unless it can be decompressed into the output directly
+	if(mipInfo->IsCompressed() && (get_block_format(m_format).has_value() || sizes.rowPitch != tightRowPitch))
+		sizes.scratchSize = mipInfo->size;
+	return sizes;
+}
+
+void resource::Texture::DecodeTextureData(uint8_t mipLevel, std::span<uint8_t> output, uint32_t rowPitch, std::span<uint8_t> scratch, const DecodeOptions &options) const
+{
+	auto sizes = GetDecodeBufferSizes(mipLevel, rowPitch);
+	uint32_t width, height, numSlices;
+	GetMipDimensions(mipLevel, width, height, numSlices);
+	auto texelSize = GetDecodedTexelSize();
+	if(sizes.rowPitch < width * texelSize || output.size() < sizes.outputSize)
+		throw std::runtime_error {"Output buffer is too small for mipmap " + std::to_string(mipLevel)};
+
+	std::span<const uint8_t> data {};
+	std::vector<uint8_t> buffer {};
+	auto decodeOptions = get_decode_options(options);
+	auto mappedData = GetMappedTextureData(mipLevel);
+	if(mappedData)
+		data = *mappedData;
+	else if(sizes.scratchSize == 0) {
+		// Tightly packed uncompressed format, no decoding required
+		ReadTextureData(mipLevel, output);
+		if(m_format == VTexFormat::RGBA8888 || m_format == VTexFormat::BGRA8888)
+			impl::apply_decode_options(output.data(), sizes.outputSize / texelSize, decodeOptions, m_format == VTexFormat::RGBA8888);
 		return;
 	}
-	std::vector<uint8_t> compressedData {};
-	compressedData.resize(compressedSize);
-	m_file->Read(compressedData.data(), compressedData.size() * sizeof(compressedData.front()));
+	else {
+		if(scratch.size() < sizes.scratchSize) {
+			buffer.resize(sizes.scratchSize);
+			scratch = buffer;
+		}
+		ReadTextureData(mipLevel, scratch);
+		data = scratch.subspan(0, sizes.scratchSize);
+	}
 
-	auto result = LZ4_decompress_safe(reinterpret_cast<char *>(compressedData.data()), reinterpret_cast<char *>(outData.data()), compressedData.size() * sizeof(compressedData.front()), outData.size() * sizeof(outData.front()));
-	if(result < 0)
-		throw std::runtime_error {"Unable to decompress LZ4 data: " + std::to_string(result)};
+	decode_mip(m_format, data, output, sizes.rowPitch, width, height, numSlices, texelSize, decodeOptions, nullptr);
 }
 
-uint32_t resource::Texture::CalculateBufferSizeForMipLevel(uint8_t mipLevel)
+std::vector<uint8_t> resource::Texture::GetDecompressedTextureAtMipLevel(int mipLevel, const DecodeOptions &options) const
 {
-	auto bytesPerPixel = GetBlockSize();
-	auto width = m_width >> mipLevel;
-	auto height = m_height >> mipLevel;
-	auto depth = m_depth >> mipLevel;
+	std::vector<uint8_t> data;
+	if(!get_block_format(m_format) && !options.hemiOctRB && !options.invert) {
+		ReadTextureData(mipLevel, data);
+		return data;
+	}
+	auto sizes = GetDecodeBufferSizes(mipLevel);
+	data.resize(sizes.outputSize);
+	DecodeTextureData(mipLevel, data, sizes.rowPitch, {}, options);
+	return data;
+}
+
+void resource::Texture::ApplyDecodeOptions(std::span<uint8_t> texels, const DecodeOptions &options, bool rgba) { impl::apply_decode_options(texels.data(), texels.size() / 4, get_decode_options(options), rgba); }
+
+static impl::BlockFormat get_block_format(resource::Texture::BlockFormat format)
+{
+	switch(format) {
+	case resource::Texture::BlockFormat::BC1:
+		return impl::BlockFormat::BC1;
+	case resource::Texture::BlockFormat::BC3:
+		return impl::BlockFormat::BC3;
+	case resource::Texture::BlockFormat::BC4:
+		return impl::BlockFormat::BC4;
+	case resource::Texture::BlockFormat::BC5:
+		return impl::BlockFormat::BC5;
+	case resource::Texture::BlockFormat::BC6H:
+		return impl::BlockFormat::BC6H;
+	case resource::Texture::BlockFormat::BC7:
+		return impl::BlockFormat::BC7;
+	case resource::Texture::BlockFormat::ETC2:
+		return impl::BlockFormat::ETC2;
+	case resource::Texture::BlockFormat::ETC2_EAC:
+		return impl::BlockFormat::ETC2_EAC;
+	case resource::Texture::BlockFormat::BC4_SNORM:
+		return impl::BlockFormat::BC4_SNORM;
+	case resource::Texture::BlockFormat::BC5_SNORM:
+		return impl::BlockFormat::BC5_SNORM;
+	case resource::Texture::BlockFormat::BC6H_SF16:
+		return impl::BlockFormat::BC6H_SF16;
+	}
+	throw std::runtime_error {"Invalid block format " + std::to_string(pragma::math::to_integral(format))};
+}
+void resource::Texture::DecodeBlocks(BlockFormat format, std::span<const uint8_t> input, std::span<uint8_t> output, uint32_t rowPitch, uint32_t width, uint32_t height, const DecodeOptions &options, uint32_t numThreads)
+{
+	if(width == 0 || height == 0)
+		return;
+	auto blockFormat = get_block_format(format);
+	auto texelSize = impl::get_decoded_texel_size(blockFormat);
+	if(rowPitch < static_cast<size_t>(width) * texelSize || output.size() < static_cast<size_t>(rowPitch) * (height - 1) + static_cast<size_t>(width) * texelSize)
+		throw std::runtime_error {"Output buffer is too small for block decode"};
+	impl::decode_blocks(blockFormat, input, output.data(), rowPitch, width, height, get_decode_options(options), numThreads);
+}
+
+resource::Texture::DecodedMipChain resource::Texture::DecodeAllMips(uint32_t numThreads, const DecodeOptions &options) const
+{
+	impl::ThreadPool threadPool {std::max(numThreads, 1u) - 1};
+	return DecodeAllMips(threadPool, options);
+}
+resource::Texture::DecodedMipChain resource::Texture::DecodeAllMips(ThreadPool &threadPool, const DecodeOptions &options) const
+{
+	DecodedMipChain mipChain {};
+	auto numMips = static_cast<uint8_t>(m_mipInfos.size());
+	std::vector<DecodeBufferSizes> sizes;
+	std::vector<size_t> scratchOffsets;
+	sizes.reserve(numMips);
+	scratchOffsets.reserve(numMips);
+	mipChain.mipOffsets.reserve(numMips);
+	size_t outputSize = 0;
+	size_t scratchSize = 0;
+	for(auto mip = decltype(numMips) {0u}; mip < numMips; ++mip) {
+		sizes.push_back(GetDecodeBufferSizes(mip));
+		mipChain.mipOffsets.push_back(outputSize);
+		scratchOffsets.push_back(scratchSize);
+		outputSize += sizes.back().outputSize;
+		scratchSize += sizes.back().scratchSize;
+	}
+	mipChain.data.resize(outputSize);
+	std::vector<uint8_t> scratch(scratchSize);
+
+	auto texelSize = GetDecodedTexelSize();
+	auto decodeOptions = get_decode_options(options);
+	impl::TaskGroup taskGroup {threadPool};
+	// Each mipmap is an independent LZ4 stream, once it has been decompressed its slices are decoded in separate tasks.
+	// The largest mipmaps are submitted first.
+	for(auto mip = decltype(numMips) {0u}; mip < numMips; ++mip) {
+		taskGroup.Run([this, mip, texelSize, &decodeOptions, &sizes, &scratchOffsets, &mipChain, &scratch, &taskGroup]() {
+			auto &mipSizes = sizes[mip];
+			std::span<uint8_t> output {mipChain.data.data() + mipChain.mipOffsets[mip], mipSizes.outputSize};
+			std::span<const uint8_t> data {};
+			auto mappedData = GetMappedTextureData(mip);
+			if(mappedData)
+				data = *mappedData;
+			else if(mipSizes.scratchSize == 0) {
+				ReadTextureData(mip, output);
+				if(m_format == VTexFormat::RGBA8888 || m_format == VTexFormat::BGRA8888)
+					impl::apply_decode_options(output.data(), output.size() / texelSize, decodeOptions, m_format == VTexFormat::RGBA8888);
+				return;
+			}
+			else {
+				std::span<uint8_t> mipScratch {scratch.data() + scratchOffsets[mip], mipSizes.scratchSize};
+				ReadTextureData(mip, mipScratch);
+				data = mipScratch;
+			}
+			uint32_t width, height, numSlices;
+			GetMipDimensions(mip, width, height, numSlices);
+			decode_mip(m_format, data, output, mipSizes.rowPitch, width, height, numSlices, texelSize, decodeOptions, &taskGroup);
+		});
+	}
+	taskGroup.Wait();
+	return mipChain;
+}
 
-	if(depth < 1)
-		depth = 1;
+uint32_t resource::Texture::CalculateBufferSizeForMipLevel(uint8_t mipLevel) const
+{
+	auto bytesPerPixel = GetBlockSize();
+	auto width = std::max(m_width >> mipLevel, 1);
+	auto height = std::max(m_height >> mipLevel, 1);
+	auto depth = GetMipDepth(mipLevel);
 
 	if(m_format == DXT1 || m_format == DXT5 || m_format == BC6H || m_format == BC7 || m_format == ETC2 || m_format == ETC2_EAC || m_format == ATI1N || m_format == ATI2N) {
 		auto misalign = width % 4;
@@ -1288,19 +1312,21 @@ uint32_t resource::Texture::CalculateBufferSizeForMipLevel(uint8_t mipLevel)
 
 		auto numBlocks = (width * height) >> 4;
 		numBlocks *= depth;
-		return numBlocks * bytesPerPixel;
+		return numBlocks * bytesPerPixel * GetFaceCount();
 	}
 
-	return width * height * depth * bytesPerPixel;
+	return width * height * depth * bytesPerPixel * GetFaceCount();
 }
 
 ////////////////
 
 resource::KVValue::KVValue(KVType type, std::shared_ptr<void> value, KVFlag flags) : m_object {value}, m_flags {flags}, m_type {type} {}
+resource::KVValue::KVValue(const BinaryBlobView &blobView, KVFlag flags) : m_object {std::make_shared<BinaryBlobView>(blobView)}, m_flags {flags}, m_type {KVType::BINARY_BLOB}, m_isBlobView {true} {}
 void *resource::KVValue::GetObject() { return m_object.get(); }
 const void *resource::KVValue::GetObject() const { return const_cast<KVValue *>(this)->GetObject(); }
 resource::KVFlag resource::KVValue::GetFlags() const { return m_flags; }
 resource::KVType resource::KVValue::GetType() const { return m_type; }
+bool resource::KVValue::IsBinaryBlobView() const { return m_isBlobView; }
 void resource::KVValue::DebugPrint(std::stringstream &ss, const std::string &t) const
 {
 	ss << t << "KVValue = {\n";
@@ -1356,15 +1382,29 @@ void resource::KVValue::DebugPrint(std::stringstream &ss, const std::string &t)
 
 resource::KVObject::KVObject(const std::string &name, bool isArray) : m_key {name}, m_isArray {isArray} {}
 
-const std::unordered_map<std::string, std::shared_ptr<resource::KVValue>> &resource::KVObject::GetValues() const { return m_values; }
+const resource::KVKeyMap<std::shared_ptr<resource::KVValue>> &resource::KVObject::GetValues() const { return m_values; }
 
-resource::KVValue *resource::KVObject::FindValue(const std::string &key)
+std::optional<uint32_t> resource::KVObject::ParseArrayIndex(KVKey key)
+{
+	uint32_t idx;
+	auto *end = key.name.data() + key.name.size();
+	auto res = std::from_chars(key.name.data(), end, idx);
+	if(res.ec != std::errc {} || res.ptr != end)
+		return {};
+	return idx;
+}
+resource::KVValue *resource::KVObject::FindValue(KVKey key)
 {
+	if(m_isArray) {
+		// Arrays can still be addressed by their stringified index
+		auto idx = ParseArrayIndex(key);
+		return idx.has_value() ? GetArrayValue(*idx) : nullptr;
+	}
 	auto it = m_values.find(key);
 	return (it != m_values.end()) ? it->second.get() : nullptr;
 }
-const resource::KVValue *resource::KVObject::FindValue(const std::string &key) const { return const_cast<KVObject *>(this)->FindValue(key); }
-resource::KVObject *resource::KVObject::FindArray(const std::string &key)
+const resource::KVValue *resource::KVObject::FindValue(KVKey key) const { return const_cast<KVObject *>(this)->FindValue(key); }
+resource::KVObject *resource::KVObject::FindArray(KVKey key)
 {
 	auto oval = FindValue<KVObject *>(key, KVType::ARRAY_TYPED);
 	if(oval.has_value() == false)
@@ -1373,8 +1413,8 @@ resource::KVObject *resource::KVObject::FindArray(const std::string &key)
 		return nullptr;
 	return *oval;
 }
-const resource::KVObject *resource::KVObject::FindArray(const std::string &key) const { return const_cast<KVObject *>(this)->FindArray(key); }
-resource::BinaryBlob *resource::KVObject::FindBinaryBlob(const std::string &key)
+const resource::KVObject *resource::KVObject::FindArray(KVKey key) const { return const_cast<KVObject *>(this)->FindArray(key); }
+resource::BinaryBlob *resource::KVObject::FindBinaryBlob(KVKey key)
 {
 	auto *val = FindValue(key);
 	if(val == nullptr || val->GetType() != KVType::BINARY_BLOB)
@@ -1384,25 +1424,87 @@ resource::BinaryBlob *resource::KVObject::FindBinaryBlob(const std::string &key)
 		return {};
 	return *oBlob;
 }
+std::optional<std::span<const uint8_t>> resource::KVObject::FindBinaryBlobView(KVKey key)
+{
+	auto *val = FindValue(key);
+	if(val == nullptr)
+		return {};
+	return val->GetObjectValue<std::span<const uint8_t>>();
+}
 
-void resource::KVObject::AddProperty(const std::string &name, KVValue &value)
+void resource::KVObject::AddProperty(const std::string &name, const KVValue &value)
 {
-	auto pvalue = value.shared_from_this();
-	if(m_isArray)
-		m_values.insert(std::make_pair(std::to_string(m_count), pvalue));
-	else
-		m_values.insert(std::make_pair(name, pvalue));
-	++m_count;
+	if(m_isArray) {
+		m_arrayValues.emplace_back(value);
+		return;
+	}
+	m_values.insert(std::make_pair(name, std::make_shared<KVValue>(value)));
+}
+void resource::KVObject::AddProperty(const std::string &name, const std::shared_ptr<KVValue> &value)
+{
+	if(m_isArray) {
+		m_arrayValues.emplace_back(*value);
+		return;
+	}
+	m_values.insert(std::make_pair(name, value));
 }
 
 bool resource::KVObject::IsArray() const { return m_isArray; }
-uint32_t resource::KVObject::GetArrayCount() const { return m_count; }
+uint32_t resource::KVObject::GetArrayCount() const
+{
+	if(!m_isArray)
+		return m_values.size();
+	return std::visit(
+	  [this](const auto &values) -> uint32_t {
+		  if constexpr(std::is_same_v<std::remove_cvref_t<decltype(values)>, std::monostate>)
+			  return m_arrayValues.size();
+		  else
+			  return values.size();
+	  },
+	  m_typedArray);
+}
+void resource::KVObject::ReserveArray(uint32_t count) { m_arrayValues.reserve(count); }
+void resource::KVObject::SetTypedArray(TypedArray &&values)
+{
+	m_typedArray = std::move(values);
+	m_arrayValues.clear();
+}
+bool resource::KVObject::HasTypedArray() const { return !std::holds_alternative<std::monostate>(m_typedArray); }
+void resource::KVObject::MaterializeTypedArray()
+{
+	if(!HasTypedArray())
+		return;
+	std::call_once(m_materializeOnce.flag, [this]() {
+		if(!m_arrayValues.empty())
+			return;
+		std::visit(
+		  [this](const auto &values) {
+			  using TValues = std::remove_cvref_t<decltype(values)>;
+			  if constexpr(!std::is_same_v<TValues, std::monostate>) {
+				  using TElement = typename TValues::value_type;
+				  m_arrayValues.reserve(values.size());
+				  for(auto &&v : values)
+					  m_arrayValues.emplace_back(GetTypedArrayElementType<TElement>(), std::shared_ptr<TElement> {new TElement {v}});
+			  }
+		  },
+		  m_typedArray);
+	});
+}
+std::span<resource::KVValue> resource::KVObject::GetArrayValues()
+{
+	MaterializeTypedArray();
+	return m_arrayValues;
+}
+std::span<const resource::KVValue> resource::KVObject::GetArrayValues() const { return const_cast<KVObject *>(this)->GetArrayValues(); }
 resource::KVValue *resource::KVObject::GetArrayValue(uint32_t idx, std::optional<KVType> confirmType)
 {
 	if(IsArray() == false)
 		return nullptr;
-	auto *val = FindValue(std::to_string(idx));
-	return (val && (confirmType.has_value() == false || val->GetType() == *confirmType)) ? val : nullptr;
+	MaterializeTypedArray();
+	if(idx >= m_arrayValues.size())
+		return nullptr;
+	auto *val = &m_arrayValues[idx];
+	return (confirmType.has_value() == false || val->GetType() == *confirmType) ? val : nullptr;
 }
 const resource::KVValue *resource::KVObject::GetArrayValue(uint32_t idx, std::optional<KVType> confirmType) const { return const_cast<KVObject *>(this)->GetArrayValue(idx, confirmType); }
 void resource::KVObject::DebugPrint(std::stringstream &ss, const std::string &t) const
@@ -1410,8 +1512,26 @@ void resource::KVObject::DebugPrint(std::stringstream &ss, const std::string &t)
 	ss << t << "KVObject:\n";
 	ss << t << "\tKey: " << m_key << "\n";
 	ss << t << "\tIs array: " << m_isArray << "\n";
-	ss << t << "\tCount: " << m_count << "\n";
+	ss << t << "\tCount: " << GetArrayCount() << "\n";
 	ss << t << "\tValues:\n";
+	std::visit(
+	  [&ss, &t](const auto &values) {
+		  using TValues = std::remove_cvref_t<decltype(values)>;
+		  if constexpr(!std::is_same_v<TValues, std::monostate>) {
+			  for(auto i = decltype(values.size()) {0u}; i < values.size(); ++i) {
+				  const typename TValues::value_type &v = values[i];
+				  ss << t << "\t\t[" << i << "] = " << v << "\n";
+			  }
+		  }
+	  },
+	  m_typedArray);
+	if(!HasTypedArray()) {
+		for(auto i = decltype(m_arrayValues.size()) {0u}; i < m_arrayValues.size(); ++i) {
+			ss << t << "\t\t[" << i << "] = {\n";
+			m_arrayValues[i].DebugPrint(ss, t + "\t\t\t");
+			ss << t << "\t\t}\n";
+		}
+	}
 	for(auto &pair : m_values) {
 		auto &v = pair.second;
 		ss << t << "\t\t[" << pair.first << "] = {\n";
@@ -1429,18 +1549,26 @@ const pragma::util::GUID resource::BinaryKV3::KV3_FORMAT_GENERIC = {0x7C, 0x16,
 const std::array<uint8_t, 16> resource::BinaryKV3::ENCODING = {0x46, 0x1A, 0x79, 0x95, 0xBC, 0x95, 0x6C, 0x4F, 0xA7, 0x0B, 0x05, 0xBC, 0xA1, 0xB7, 0xDF, 0xD2};
 const std::array<uint8_t, 16> resource::BinaryKV3::FORMAT = {0x7C, 0x16, 0x12, 0x74, 0xE9, 0x06, 0x98, 0x46, 0xAF, 0xF2, 0xE6, 0x3E, 0xB5, 0x90, 0x37, 0xE7};
 const std::array<uint8_t, 4> resource::BinaryKV3::SIG = {0x56, 0x4B, 0x56, 0x03}; // VKV3 (3 isn't ascii, its 0x03)
-const std::vector<std::string> &resource::BinaryKV3::GetStringArray() const { return m_stringArray; }
+const std::vector<std::string> &resource::BinaryKV3::GetStringArray() const { return m_document ? m_document->GetStrings() : m_stringArray; }
 const std::shared_ptr<resource::KVObject> &resource::BinaryKV3::GetData() const { return const_cast<BinaryKV3 *>(this)->GetData(); }
 std::shared_ptr<resource::KVObject> &resource::BinaryKV3::GetData() { return m_data; }
+const std::shared_ptr<resource::KV3Document> &resource::BinaryKV3::GetDocument() const { return m_document; }
+std::shared_ptr<resource::IKeyValueCollection> resource::BinaryKV3::GetCollection() const
+{
+	if(m_document)
+		return std::shared_ptr<IKeyValueCollection> {m_document, &m_document->GetRoot()};
+	return m_data;
+}
 resource::BinaryKV3::BinaryKV3(BlockType type) : m_blockType {type} {}
+bool resource::BinaryKV3::IsMagic(uint32_t magic) { return magic == MAGIC || (magic & ~0xFFu) == (MAGIC2 & ~0xFFu); }
 void resource::BinaryKV3::Read(const Resource &resource, ufile::IFile &f)
 {
 	f.Seek(GetOffset());
 
 	pragma::util::DataStream ds {};
 	auto magic = f.Read<uint32_t>();
-	if(magic == MAGIC2) {
-		ReadVersion2(f, ds);
+	if((magic & ~0xFFu) == (MAGIC2 & ~0xFFu)) {
+		ReadVersion2(resource, f, ds, magic & 0xFF);
 		return;
 	}
 
@@ -1455,14 +1583,15 @@ void resource::BinaryKV3::Read(const Resource &resource, ufile::IFile &f)
 	// and then it proceeds to call LoadKV3BinaryUncompressed, which should be the same routine for KV3_ENCODING_BINARY_UNCOMPRESSED
 	// Old binary with debug symbols for ref: https://users.alliedmods.net/~asherkin/public/bins/dota_symbols/bin/osx64/libmeshsystem.dylib
 
+	std::vector<uint8_t> buffer {};
+	auto input = ReadData(resource, f, GetSize() - (f.Tell() - GetOffset()), buffer);
 	if(pragma::util::compare_guid(encoding, KV3_ENCODING_BINARY_BLOCK_COMPRESSED))
-		BlockDecompress(f, ds);
+		BlockDecompress(input, ds);
 	else if(pragma::util::compare_guid(encoding, KV3_ENCODING_BINARY_BLOCK_LZ4))
-		DecompressLZ4(f, ds);
+		DecompressLZ4(input, ds);
 	else if(pragma::util::compare_guid(encoding, KV3_ENCODING_BINARY_UNCOMPRESSED)) {
-		auto szCpy = f.GetSize() - f.Tell();
-		ds->Resize(szCpy);
-		f.Read(ds->GetData(), szCpy);
+		ds->Resize(input.size());
+		memcpy(ds->GetData(), input.data(), input.size());
 		ds->SetOffset(0);
 	}
 	else
@@ -1472,23 +1601,73 @@ void resource::BinaryKV3::Read(const Resource &resource, ufile::IFile &f)
 	m_stringArray.reserve(numStrings);
 	for(auto i = decltype(numStrings) {0u}; i < numStrings; ++i)
 		m_stringArray.push_back(ds->ReadString()); // TODO: UTF8
-	m_data = ParseBinaryKV3(ds, nullptr, true);
+	Parse(resource, ds);
+}
+void resource::BinaryKV3::Parse(const Resource &resource, pragma::util::DataStream &ds)
+{
+	auto &loadOptions = resource.GetLoadOptions();
+	m_aliasBinaryBlobs = loadOptions.aliasBinaryBlobs;
+	m_kvDataOffset = ds->GetOffset();
+	m_bufferRetained = m_aliasBinaryBlobs || loadOptions.kv3Representation == KV3Representation::Raw;
+	if(m_bufferRetained)
+		m_buffer = ds;
+	switch(loadOptions.kv3Representation) {
+	case KV3Representation::Raw:
+		break;
+	case KV3Representation::Document:
+		{
+			m_document = std::make_shared<KV3Document>(std::move(m_stringArray));
+			m_stringArray.clear();
+			auto &doc = *m_document;
+			if(m_aliasBinaryBlobs)
+				doc.m_buffer = ds;
+			DocumentBuilder builder {doc, m_aliasBinaryBlobs};
+			CreateReader(ds).Read(builder);
+			if(doc.m_nodes.empty() || doc.m_nodes.front().type != KVType::OBJECT)
+				throw std::runtime_error {"Unexpected KV3 root type " + to_string(doc.m_nodes.empty() ? KVType::Invalid : doc.m_nodes.front().type)};
+			break;
+		}
+	default:
+		{
+			TreeBuilder builder {ds, m_stringArray, m_aliasBinaryBlobs};
+			CreateReader(ds).Read(builder);
+			m_data = builder.GetRoot();
+			break;
+		}
+	}
+}
+void resource::BinaryKV3::Visit(KV3Visitor &visitor) const
+{
+	if(!m_bufferRetained)
+		throw std::runtime_error {"KV3 data has not been retained"};
+	CreateReader(m_buffer).Read(visitor);
+}
+std::shared_ptr<resource::KVObject> resource::BinaryKV3::Project(std::span<const std::string_view> paths) const
+{
+	TreeBuilder builder {m_buffer, GetStringArray(), m_aliasBinaryBlobs};
+	ProjectionFilter filter {builder, paths};
+	Visit(filter);
+	return builder.GetRoot();
 }
 void resource::BinaryKV3::DebugPrint(std::stringstream &ss, const std::string &t) const
 {
 	ss << t << "Texture = {\n";
-	ss << t << "\tCurrent binary bytes offset: " << m_currentBinaryBytesOffset << "\n";
-	ss << t << "\tCurrent eight bytes offset: " << m_currentEightBytesOffset << "\n";
-	ss << t << "\tCurrent type index: " << m_currentTypeIndex << "\n";
-	ss << t << "\tHas types array: " << m_hasTypesArray << "\n";
+	ss << t << "\tBinary bytes offset: " << m_binaryBytesOffset << "\n";
+	ss << t << "\tEight bytes offset: " << m_eightBytesOffset << "\n";
+	ss << t << "\tTwo bytes offset: " << m_twoBytesOffset << "\n";
+	ss << t << "\tHas types array: " << !m_typesArray.empty() << "\n";
 	ss << t << "\tBlock type: " << to_string(m_blockType) << "\n";
 	ss << t << "\tData:\n";
 	ss << t << "\t{\n";
-	m_data->DebugPrint(ss, t + "\t\t");
+	if(m_document)
+		m_document->DebugPrint(ss, t + "\t\t");
+	else if(m_data)
+		m_data->DebugPrint(ss, t + "\t\t");
 	ss << t << "\t}\n";
 	ss << t << "\tStringArray:\n";
-	for(auto i = decltype(m_stringArray.size()) {0u}; i < m_stringArray.size(); ++i) {
-		auto &str = m_stringArray.at(i);
+	auto &stringArray = GetStringArray();
+	for(auto i = decltype(stringArray.size()) {0u}; i < stringArray.size(); ++i) {
+		auto &str = stringArray.at(i);
 		ss << t << "\t\t[" << i << "] = {\n";
 		ss << t << "\t\t\t" << str << "\n";
 		ss << t << "\t\t}\n";
@@ -1503,29 +1682,114 @@ void resource::BinaryKV3::DebugPrint(std::stringstream &ss, const std::string &t
 	ss << t << "}\n";
 }
 BlockType resource::BinaryKV3::GetType() const { return m_blockType; }
-void resource::BinaryKV3::ReadVersion2(ufile::IFile &f, pragma::util::DataStream &outData)
+// The binary blobs of KV3\x02 and newer are LZ4-compressed as a single stream of frames, which may reference the
+// data decompressed before them. The frames therefore have to be decompressed in order and into contiguous memory.
+static void decompress_lz4_blobs(std::span<const uint8_t> input, pragma::util::DataStream &frameSizes, size_t frameSizesEnd, std::span<const uint32_t> blobSizes, uint32_t frameSize, uint8_t *output)
+{
+	LZ4_streamDecode_t stream;
+	LZ4_setStreamDecode(&stream, nullptr, 0);
+	size_t inPos = 0;
+	for(auto blobSize : blobSizes) {
+		size_t decompressed = 0;
+		while(decompressed < blobSize) {
+			if(frameSizes->GetOffset() + sizeof(uint16_t) > frameSizesEnd)
+				throw std::runtime_error {"Unexpected end of KV3 blob frame sizes"};
+			auto compressedSize = frameSizes->Read<uint16_t>();
+			if(inPos + compressedSize > input.size())
+				throw std::runtime_error {"Unexpected end of LZ4 compressed KV3 blob data"};
+			auto maxSize = blobSize - decompressed;
+			if(frameSize > 0)
+				maxSize = std::min<size_t>(maxSize, frameSize);
+			auto result = LZ4_decompress_safe_continue(&stream, reinterpret_cast<const char *>(input.data() + inPos), reinterpret_cast<char *>(output), compressedSize, maxSize);
+			if(result <= 0)
+				throw std::runtime_error {"Unable to decompress LZ4 data: " + std::to_string(result)};
+			inPos += compressedSize;
+			output += result;
+			decompressed += result;
+		}
+	}
+}
+void resource::BinaryKV3::ReadVersion2(const Resource &resource, ufile::IFile &f, pragma::util::DataStream &outData, uint8_t version)
 {
+	// 'version' is the lowest byte of the magic number. KV3\x05 splits the values across two separately compressed buffers,
+	// which is not supported.
+	if(version < 1 || version > 4)
+		throw std::runtime_error {"Unsupported KV3 version " + std::to_string(version)};
 	auto format = f.Read<pragma::util::GUID>();
 
 	auto compressionMethod = f.Read<int32_t>();
+	uint16_t compressionDictionaryId = 0;
+	uint16_t compressionFrameSize = 0;
+	if(version >= 2) {
+		compressionDictionaryId = f.Read<uint16_t>();
+		compressionFrameSize = f.Read<uint16_t>();
+	}
 	auto countOfBinaryBytes = f.Read<int32_t>();     // how many bytes (binary blobs)
 	auto countOfIntegers = f.Read<int32_t>();        // how many 4 byte values (ints)
 	auto countOfEightByteValues = f.Read<int32_t>(); // how many 8 byte values (doubles)
 
-	if(compressionMethod == 0) {
-		auto length = f.Read<int32_t>();
-
-		outData->Resize(length);
-		f.Read(outData->GetData(), length);
+	uint32_t stringAndTypesBufferSize = 0;
+	uint32_t uncompressedSize = 0;
+	uint32_t compressedSize = 0;
+	uint32_t blockCount = 0;     // Number of binary blobs
+	uint32_t blockTotalSize = 0; // Uncompressed size of all binary blobs
+	uint32_t countOfTwoByteValues = 0;
+	if(version >= 2) {
+		stringAndTypesBufferSize = f.Read<uint32_t>();
+		f.Seek(f.Tell() + 2 * sizeof(uint16_t)); // Unknown
+		uncompressedSize = f.Read<uint32_t>();
+		compressedSize = f.Read<uint32_t>();
+		blockCount = f.Read<uint32_t>();
+		blockTotalSize = f.Read<uint32_t>();
+		if(version >= 4) {
+			countOfTwoByteValues = f.Read<uint32_t>();
+			f.Seek(f.Tell() + sizeof(uint32_t)); // Unknown
+		}
 	}
-	else if(compressionMethod == 1)
-		DecompressLZ4(f, outData);
-	else
+
+	if(compressionMethod == 2)
+		throw std::runtime_error {"ZSTD-compressed KV3 data is not supported"};
+	if(compressionMethod != 0 && compressionMethod != 1)
 		throw std::runtime_error {"Unknown KV3 compression method: " + std::to_string(compressionMethod)};
+	if(compressionDictionaryId != 0)
+		throw std::runtime_error {"Unsupported KV3 compression dictionary " + std::to_string(compressionDictionaryId)};
+
+	std::vector<uint8_t> buffer {};
+	if(version == 1) {
+		if(compressionMethod == 0) {
+			auto length = f.Read<int32_t>();
+			outData->Resize(length);
+			ReadData(resource, f, std::span<uint8_t> {static_cast<uint8_t *>(outData->GetData()), static_cast<size_t>(length)});
+		}
+		else
+			DecompressLZ4(ReadData(resource, f, GetSize() - (f.Tell() - GetOffset()), buffer), outData);
+		uncompressedSize = outData->GetInternalSize();
+	}
+	else {
+		// The binary blobs are decompressed to the end of the same buffer, so blob views can alias it as well
+		outData->Resize(static_cast<size_t>(uncompressedSize) + blockTotalSize);
+		std::span<uint8_t> output {static_cast<uint8_t *>(outData->GetData()), uncompressedSize};
+		if(compressionMethod == 0)
+			ReadData(resource, f, output);
+		else {
+			auto input = ReadData(resource, f, compressedSize, buffer);
+			auto result = LZ4_decompress_safe(reinterpret_cast<const char *>(input.data()), reinterpret_cast<char *>(output.data()), input.size(), output.size());
+			if(result != static_cast<int>(output.size()))
+				throw std::runtime_error {"Unable to decompress LZ4 data: " + std::to_string(result)};
+		}
+	}
 
-	m_currentBinaryBytesOffset = 0;
+	m_binaryBytesOffset = 0;
 	outData->SetOffset(countOfBinaryBytes);
 
+	m_twoBytesOffset = -1;
+	if(countOfTwoByteValues > 0) {
+		// Align to % 2 for the start of the two-byte values (KV3\x04)
+		outData->SetOffset(outData->GetOffset() + (outData->GetOffset() % 2));
+		m_twoBytesOffset = outData->GetOffset();
+		outData->SetOffset(outData->GetOffset() + countOfTwoByteValues * 2);
+	}
+
 	if(outData->GetOffset() % 4 != 0) {
 		// Align to % 4 after binary blobs
 		outData->SetOffset(outData->GetOffset() + 4 - (outData->GetOffset() % 4));
@@ -1542,439 +1806,545 @@ void resource::BinaryKV3::ReadVersion2(ufile::IFile &f, pragma::util::DataStream
 		outData->SetOffset(outData->GetOffset() + 8 - (outData->GetOffset() % 8));
 	}
 
-	m_currentEightBytesOffset = outData->GetOffset();
+	m_eightBytesOffset = outData->GetOffset();
 
 	outData->SetOffset(outData->GetOffset() + countOfEightByteValues * 8);
 
+	auto stringsOffset = outData->GetOffset();
 	m_stringArray.resize(countOfStrings);
 
 	for(auto i = decltype(countOfStrings) {0u}; i < countOfStrings; ++i)
 		m_stringArray.at(i) = outData->ReadString(); // UTF8
 
-	// bytes after the string table is kv types, minus 4 static bytes at the end
-	auto typesLength = outData->GetInternalSize() - 4 - outData->GetOffset();
+	// KV3\x01: bytes after the string table is kv types, minus 4 static bytes at the end
+	// KV3\x02 and newer: the size of the strings and types is known, the types are followed by the blob sizes
+	size_t typesLength;
+	if(version == 1)
+		typesLength = uncompressedSize - 4 - outData->GetOffset();
+	else {
+		if(outData->GetOffset() - stringsOffset > stringAndTypesBufferSize)
+			throw std::runtime_error {"KV3 string table exceeds its buffer"};
+		typesLength = stringAndTypesBufferSize - (outData->GetOffset() - stringsOffset);
+	}
 	m_typesArray.resize(typesLength);
-	m_hasTypesArray = true;
 	outData->Read(m_typesArray.data(), m_typesArray.size());
 
+	if(version >= 2) {
+		if(blockCount > 0) {
+			m_blobSizes.resize(blockCount);
+			outData->Read(m_blobSizes.data(), m_blobSizes.size() * sizeof(m_blobSizes.front()));
+		}
+		constexpr uint32_t TRAILER = 0xFFEEDD00;
+		auto trailer = outData->Read<uint32_t>();
+		if(trailer != TRAILER)
+			throw std::runtime_error {"Invalid KV3 trailer " + std::to_string(trailer)};
+		if(blockCount > 0) {
+			if(std::accumulate(m_blobSizes.begin(), m_blobSizes.end(), uint64_t {0}) != blockTotalSize)
+				throw std::runtime_error {"KV3 blob sizes don't match the total blob size " + std::to_string(blockTotalSize)};
+			m_blobsOffset = uncompressedSize;
+			auto *blobs = static_cast<uint8_t *>(outData->GetData()) + m_blobsOffset;
+			if(compressionMethod == 0)
+				ReadData(resource, f, std::span<uint8_t> {blobs, blockTotalSize});
+			else // The compressed size of every frame follows the trailer
+				decompress_lz4_blobs(ReadData(resource, f, GetSize() - (f.Tell() - GetOffset()), buffer), outData, uncompressedSize, m_blobSizes, compressionFrameSize, blobs);
+		}
+	}
+
 	// Move back to the start of the KV data for reading.
 	outData->SetOffset(kvDataOffset);
 
-	m_data = ParseBinaryKV3(outData, nullptr, true);
+	Parse(resource, outData);
 }
-void resource::BinaryKV3::BlockDecompress(ufile::IFile &f, pragma::util::DataStream &outData)
+void resource::BinaryKV3::BlockDecompress(std::span<const uint8_t> input, pragma::util::DataStream &outData)
 {
 	// It is flags, right?
-	auto flags = f.Read<std::array<uint8_t, 4>>();
+	std::array<uint8_t, 4> flags;
+	if(input.size() < flags.size())
+		throw std::runtime_error {"Unexpected end of compressed KV3 block"};
+	memcpy(flags.data(), input.data(), flags.size());
+	input = input.subspan(flags.size());
 
-	// outWrite.Write(flags);
 	if((flags[3] & 0x80) > 0) {
-		auto size = f.GetSize() - f.Tell();
-		outData->Resize(size);
-		f.Read(outData->GetData(), size);
+		outData->Resize(input.size());
+		memcpy(outData->GetData(), input.data(), input.size());
+		outData->SetOffset(0);
+		return;
 	}
-	else {
-		outData->Reserve(f.GetSize() - f.Tell());
-		std::vector<uint8_t> vOutData {};
-		vOutData.reserve(f.GetSize() - f.Tell());
-		auto running = true;
-		uint64_t dataReadOffset = 0ull;
-		uint64_t dataWriteOffset = 0ull;
-		auto fRead = [&vOutData, &dataReadOffset](void *outData, uint64_t size) {
-			memcpy(outData, vOutData.data() + dataReadOffset, size);
-			dataReadOffset += size;
-		};
-		auto fWrite = [&vOutData, &dataWriteOffset, &dataReadOffset](const void *inData, uint64_t size) {
-			if(dataWriteOffset + size >= vOutData.size())
-				vOutData.resize(dataWriteOffset + size);
-			memcpy(vOutData.data() + dataWriteOffset, inData, size);
-			dataWriteOffset += size;
-			dataReadOffset += size;
-		};
-		auto fWriteFront = [&vOutData, &dataWriteOffset, &dataReadOffset](const void *inData, uint64_t size) {
-			if(dataWriteOffset + size >= vOutData.capacity())
-				vOutData.reserve(dataWriteOffset + size);
-			for(uint8_t i = 0; i < size; ++i)
-				vOutData.insert(vOutData.begin(), 0);
-			memcpy(vOutData.data(), inData, size);
-
-			dataWriteOffset += size;
-			dataReadOffset += size;
-		};
-		while(f.Tell() != f.GetSize() && running) {
-			//try
-			//{
-			auto blockMask = f.Read<uint16_t>();
-			for(auto i = decltype(blockMask) {0u}; i < (sizeof(blockMask) * 8); ++i) {
-				// is the ith bit 1
-				if((blockMask & (1 << i)) > 0) {
-					auto offsetSize = f.Read<uint16_t>();
-					auto offset = ((offsetSize & 0xFFF0) >> 4) + 1;
-					auto size = (offsetSize & 0x000F) + 3;
-
-					auto lookupSize = (offset < size) ? offset : size; // If the offset is larger or equal to the size, use the size instead.
-
-					auto p = dataReadOffset;
-					dataReadOffset = p - offset;
-					std::vector<uint8_t> data {};
-					data.resize(lookupSize);
-					fRead(data.data(), data.size() * sizeof(data.front()));
-					dataWriteOffset = p;
-					dataReadOffset = p;
-
-					while(size > 0) {
-						fWrite(data.data(), (lookupSize < size) ? lookupSize : size);
-						size -= lookupSize;
-					}
-				}
-				else {
-					auto data = f.Read<uint8_t>();
-					fWrite(&data, sizeof(data));
-				}
 
-				//TODO: is there a better way of making an unsigned 12bit number?
-				// TODO
-				if(vOutData.size() == (flags[2] << 16) + (flags[1] << 8) + flags[0]) {
-					running = false;
+	// The lower 24 bits of the flags contain the decompressed size
+	auto outSize = static_cast<size_t>(flags[0]) | (static_cast<size_t>(flags[1]) << 8) | (static_cast<size_t>(flags[2]) << 16);
+
+	// Decompress directly into the output buffer
+	outData->Resize(outSize);
+	auto *out = static_cast<uint8_t *>(outData->GetData());
+	auto *in = input.data();
+	auto inSize = input.size();
+	size_t inPos = 0;
+	size_t outPos = 0;
+	auto truncated = false;
+	while(outPos < outSize && !truncated) {
+		if(inPos + sizeof(uint16_t) > inSize) {
+			truncated = true;
+			break;
+		}
+		uint16_t blockMask;
+		memcpy(&blockMask, in + inPos, sizeof(blockMask));
+		inPos += sizeof(blockMask);
+		for(auto i = decltype(sizeof(blockMask)) {0u}; i < (sizeof(blockMask) * 8) && outPos < outSize; ++i) {
+			// is the ith bit 1
+			if((blockMask & (1 << i)) == 0) {
+				// Literal byte
+				if(inPos >= inSize) {
+					truncated = true;
 					break;
 				}
+				out[outPos++] = in[inPos++];
+				continue;
+			}
+			if(inPos + sizeof(uint16_t) > inSize) {
+				truncated = true;
+				break;
 			}
-			//}
-			//catch (EndOfStreamException)
-			//{
-			//	break;
-			//}
+			uint16_t offsetSize;
+			memcpy(&offsetSize, in + inPos, sizeof(offsetSize));
+			inPos += sizeof(offsetSize);
+			size_t offset = ((offsetSize & 0xFFF0) >> 4) + 1;
+			size_t size = (offsetSize & 0x000F) + 3;
+			if(offset > outPos || outPos + size > outSize)
+				throw std::runtime_error {"Invalid back-reference in compressed KV3 block"};
+
+			auto *src = out + outPos - offset;
+			auto *dst = out + outPos;
+			if(offset >= size)
+				memcpy(dst, src, size);
+			else {
+				// The referenced range overlaps with the bytes being written, which repeats the last 'offset' bytes
+				for(auto j = decltype(size) {0u}; j < size; ++j)
+					dst[j] = src[j];
+			}
+			outPos += size;
 		}
-		outData->Write(vOutData.data(), vOutData.size() * sizeof(vOutData.front()));
 	}
+	// Keep whatever could be decoded if the input ends prematurely
+	if(truncated)
+		outData->Resize(outPos);
 	outData->SetOffset(0);
 }
 
-void resource::BinaryKV3::DecompressLZ4(ufile::IFile &f, pragma::util::DataStream &outData)
+void resource::BinaryKV3::DecompressLZ4(std::span<const uint8_t> input, pragma::util::DataStream &outData)
 {
-	auto uncompressedSize = f.Read<uint32_t>();
-	auto compressedSize = GetSize() - (f.Tell() - GetOffset());
-
-	std::vector<uint8_t> input {};
-	input.resize(compressedSize);
-	f.Read(input.data(), input.size() * sizeof(input.front()));
+	uint32_t uncompressedSize;
+	if(input.size() < sizeof(uncompressedSize))
+		throw std::runtime_error {"Unexpected end of LZ4 compressed KV3 block"};
+	memcpy(&uncompressedSize, input.data(), sizeof(uncompressedSize));
+	input = input.subspan(sizeof(uncompressedSize));
 
 	outData->Resize(uncompressedSize);
-	auto result = LZ4_decompress_safe(reinterpret_cast<char *>(input.data()), reinterpret_cast<char *>(outData->GetData()), input.size(), uncompressedSize);
+	auto result = LZ4_decompress_safe(reinterpret_cast<const char *>(input.data()), reinterpret_cast<char *>(outData->GetData()), input.size(), uncompressedSize);
 	if(result < 0)
 		throw std::runtime_error {"Unable to decompress LZ4 data: " + std::to_string(result)};
 
 	outData->SetOffset(0);
 }
 
-std::pair<resource::KVType, resource::KVFlag> resource::BinaryKV3::ReadType(pragma::util::DataStream &ds)
-{
-	uint8_t databyte;
-	if(m_hasTypesArray)
-		databyte = m_typesArray.at(m_currentTypeIndex++);
-	else
-		databyte = ds->Read<uint8_t>();
-
-	auto flagInfo = KVFlag::None;
-	if((databyte & 0x80) > 0) {
-		databyte &= 0x7F; // Remove the flag bit
-
-		if(m_hasTypesArray)
-			flagInfo = static_cast<KVFlag>(m_typesArray.at(m_currentTypeIndex++));
-		else
-			flagInfo = ds->Read<KVFlag>();
-	}
-	return {static_cast<KVType>(databyte), flagInfo};
-}
-
-std::shared_ptr<resource::KVValue> resource::BinaryKV3::MakeValue(KVType type, std::shared_ptr<void> data, KVFlag flag)
-{
-	auto realType = ConvertBinaryOnlyKVType(type);
-	if(flag != KVFlag::None)
-		return std::make_shared<KVValue>(realType, data, flag);
-
-	return std::make_shared<KVValue>(realType, data);
-}
-
-resource::KVType resource::BinaryKV3::ConvertBinaryOnlyKVType(KVType type)
-{
-	switch(type) {
-	case KVType::BOOLEAN:
-	case KVType::BOOLEAN_TRUE:
-	case KVType::BOOLEAN_FALSE:
-		return KVType::BOOLEAN;
-	case KVType::INT64:
-	case KVType::INT64_ZERO:
-	case KVType::INT64_ONE:
-		return KVType::INT64;
-	case KVType::INT32:
-		return KVType::INT32;
-	case KVType::UINT64:
-		return KVType::UINT64;
-	case KVType::UINT32:
-		return KVType::UINT32;
-	case KVType::DOUBLE:
-	case KVType::DOUBLE_ZERO:
-	case KVType::DOUBLE_ONE:
-		return KVType::DOUBLE;
-	case KVType::ARRAY_TYPED:
-		return KVType::ARRAY;
-	}
-
-	return type;
-}
-
-#if 0
-template<class TKVValue,typename T>
-	std::shared_ptr<resource::KVValue> resource::BinaryKV3::MakeValue(KVType type, T data, KVFlag flag)
-{
-	auto v = std::make_shared<T>(data);
-	return std::static_pointer_cast<resource::KVValue>(MakeValueFromPtr<TKVValue>(type,*v,flag));
-}
-
-template<class TKVValue,typename TPtr>
-	std::shared_ptr<resource::KVValue> resource::BinaryKV3::MakeValueFromPtr(KVType type, TPtr &data, KVFlag flag)
-{
-	auto pdata = data.shared_from_this();
-	auto realType = ConvertBinaryOnlyKVType(type);
-
-	if (flag != KVFlag::None)
+// Builds the reference-counted KVObject tree
+class resource::BinaryKV3::TreeBuilder : public KV3Visitor {
+  public:
+	TreeBuilder(const pragma::util::DataStream &ds, std::span<const std::string> strings, bool aliasBinaryBlobs) : m_ds {ds}, m_strings {strings}, m_aliasBinaryBlobs {aliasBinaryBlobs} {}
+	const std::shared_ptr<KVObject> &GetRoot() const { return m_root; }
+	virtual bool BeginObject(uint32_t memberCount, KVFlag flags) override
 	{
-		auto p = std::make_shared<TKVValue>(realType, pdata, flag);
-		return std::static_pointer_cast<resource::KVValue>(p);
+		BeginContainer(false, memberCount, flags);
+		return true;
 	}
-	auto p = std::make_shared<TKVValue>(realType, pdata);
-	return std::static_pointer_cast<resource::KVValue>(p);
-}
-
-template<class TKVValue>
-	std::shared_ptr<resource::KVValue> resource::BinaryKV3::MakeValueFromPtr(KVType type, nullptr_t nptr, KVFlag flag)
-{
-	auto realType = ConvertBinaryOnlyKVType(type);
-
-	if (flag != KVFlag::None)
+	virtual void EndObject() override { m_stack.pop_back(); }
+	virtual bool BeginArray(uint32_t elementCount, KVFlag flags) override
 	{
-		auto p = std::make_shared<TKVValue>(realType, nptr, flag);
-		return std::static_pointer_cast<resource::KVValue>(p);
+		BeginContainer(true, elementCount, flags);
+		return true;
 	}
-	auto p = std::make_shared<TKVValue>(realType, nptr);
-	return std::static_pointer_cast<resource::KVValue>(p);
-}
-#endif
-std::shared_ptr<resource::KVObject> resource::BinaryKV3::ReadBinaryValue(const std::string &name, KVType datatype, KVFlag flagInfo, pragma::util::DataStream ds, std::shared_ptr<KVObject> parent)
-{
-	auto currentOffset = ds->GetOffset();
-
-	std::shared_ptr<void> value = nullptr; // Only needed so the object doesn't get destroyed in the switch-case scope
-	switch(datatype) {
-	case KVType::Null:
-		{
-			auto v = MakeValue(datatype, nullptr, flagInfo);
-			parent->AddProperty(name, *v);
+	virtual void EndArray() override { m_stack.pop_back(); }
+	virtual void Key(std::string_view key, int32_t stringId) override { m_key = key; }
+	virtual void Scalar(const KV3Node &value, std::string_view str) override
+	{
+		std::shared_ptr<void> data = nullptr;
+		switch(value.type) {
+		case KVType::BOOLEAN:
+			data = std::make_shared<bool>(value.boolean);
 			break;
-		}
-	case KVType::BOOLEAN:
-		{
-			if(m_currentBinaryBytesOffset > -1)
-				ds->SetOffset(m_currentBinaryBytesOffset);
-
-			auto v = MakeValue(datatype, std::make_shared<bool>(ds->Read<bool>()), flagInfo);
-			parent->AddProperty(name, *v);
-
-			if(m_currentBinaryBytesOffset > -1) {
-				m_currentBinaryBytesOffset++;
-				ds->SetOffset(currentOffset);
-			}
-
+		case KVType::INT64:
+			data = std::make_shared<int64_t>(value.int64);
 			break;
-		}
-	case KVType::BOOLEAN_TRUE:
-		{
-			auto v = MakeValue(datatype, std::make_shared<bool>(true), flagInfo);
-			parent->AddProperty(name, *v);
+		case KVType::UINT64:
+			data = std::make_shared<uint64_t>(value.uint64);
 			break;
-		}
-	case KVType::BOOLEAN_FALSE:
-		{
-			auto v = MakeValue(datatype, std::make_shared<bool>(false), flagInfo);
-			parent->AddProperty(name, *v);
+		case KVType::INT32:
+			data = std::make_shared<int32_t>(value.int32);
 			break;
-		}
-	case KVType::INT64_ZERO:
-		{
-			auto v = MakeValue(datatype, std::make_shared<int64_t>(0ll), flagInfo);
-			parent->AddProperty(name, *v);
+		case KVType::UINT32:
+			data = std::make_shared<uint32_t>(value.uint32);
 			break;
-		}
-	case KVType::INT64_ONE:
-		{
-			auto v = MakeValue(datatype, std::make_shared<int64_t>(1ull), flagInfo);
-			parent->AddProperty(name, *v);
+		case KVType::DOUBLE:
+			// std::make_shared<double> causes a compiler error with clang-22 here
+			data = std::shared_ptr<double> {new double {value.float64}};
 			break;
-		}
-	case KVType::INT64:
-		{
-			if(m_currentEightBytesOffset > 0)
-				ds->SetOffset(m_currentEightBytesOffset);
-
-			auto v = MakeValue(datatype, std::make_shared<int64_t>(ds->Read<int64_t>()), flagInfo);
-			parent->AddProperty(name, *v);
-
-			if(m_currentEightBytesOffset > 0) {
-				m_currentEightBytesOffset = ds->GetOffset();
-				ds->SetOffset(currentOffset);
-			}
-
+		case KVType::STRING:
+			data = std::make_shared<std::string>(str);
 			break;
-		}
-	case KVType::UINT64:
-		{
-			if(m_currentEightBytesOffset > 0)
-				ds->SetOffset(m_currentEightBytesOffset);
-
-			auto v = MakeValue(datatype, std::make_shared<uint64_t>(ds->Read<uint64_t>()), flagInfo);
-			parent->AddProperty(name, *v);
-
-			if(m_currentEightBytesOffset > 0) {
-				m_currentEightBytesOffset = ds->GetOffset();
-				ds->SetOffset(currentOffset);
-			}
-
+		default:
 			break;
 		}
-	case KVType::INT32:
-		{
-			auto v = MakeValue(datatype, std::make_shared<int32_t>(ds->Read<int32_t>()), flagInfo);
-			parent->AddProperty(name, *v);
+		AddValue(value.type, std::move(data), value.flags);
+	}
+	virtual void Blob(std::span<const uint8_t> data, KVFlag flags) override
+	{
+		if(m_aliasBinaryBlobs)
+			AddValue(BinaryBlobView {m_ds, data}, flags);
+		else
+			AddValue(KVType::BINARY_BLOB, std::make_shared<BinaryBlob>(data.begin(), data.end()), flags);
+	}
+	virtual bool TypedArray(KVType elementType, std::span<const uint8_t> data, uint32_t count, KVFlag flags) override
+	{
+		KVObject::TypedArray values;
+		switch(elementType) {
+		case KVType::INT32:
+			values = CopyElements<int32_t>(data, count);
 			break;
-		}
-	case KVType::UINT32:
-		{
-			auto v = MakeValue(datatype, std::make_shared<uint32_t>(ds->Read<uint32_t>()), flagInfo);
-			parent->AddProperty(name, *v);
+		case KVType::UINT32:
+			values = CopyElements<uint32_t>(data, count);
 			break;
-		}
-	case KVType::DOUBLE:
-		{
-			if(m_currentEightBytesOffset > 0)
-				ds->SetOffset(m_currentEightBytesOffset);
-
-			auto v = MakeValue(datatype, std::make_shared<double>(ds->Read<double>()), flagInfo);
-			parent->AddProperty(name, *v);
-
-			if(m_currentEightBytesOffset > 0) {
-				m_currentEightBytesOffset = ds->GetOffset();
-				ds->SetOffset(currentOffset);
-			}
-
+		case KVType::INT64:
+			values = CopyElements<int64_t>(data, count);
 			break;
-		}
-	case KVType::DOUBLE_ZERO:
-		{
-			// std::make_shared<double> causes a compiler error with clang-22 here
-			auto v = MakeValue(datatype, std::shared_ptr<double> {new double {0.0}}, flagInfo);
-			parent->AddProperty(name, *v);
+		case KVType::UINT64:
+			values = CopyElements<uint64_t>(data, count);
 			break;
-		}
-	case KVType::DOUBLE_ONE:
-		{
-			// std::make_shared<double> causes a compiler error with clang-22 here
-			auto v = MakeValue(datatype, std::shared_ptr<double> {new double {1.0}}, flagInfo);
-			parent->AddProperty(name, *v);
+		case KVType::DOUBLE:
+			values = CopyElements<double>(data, count);
 			break;
+		case KVType::BOOLEAN:
+			{
+				std::vector<bool> bools(count);
+				for(auto i = decltype(count) {0u}; i < count; ++i)
+					bools[i] = (data[i] != 0);
+				values = std::move(bools);
+				break;
+			}
+		case KVType::STRING:
+			{
+				auto ids = CopyElements<int32_t>(data, count);
+				std::vector<std::string> strings;
+				strings.reserve(count);
+				for(auto id : ids) {
+					if(id == -1) {
+						strings.emplace_back();
+						continue;
+					}
+					if(id < 0 || static_cast<size_t>(id) >= m_strings.size())
+						throw std::runtime_error {"Invalid KV3 string index " + std::to_string(id)};
+					strings.push_back(m_strings[id]);
+				}
+				values = std::move(strings);
+				break;
+			}
+		default:
+			return false;
 		}
-	case KVType::STRING:
-		{
-			auto id = ds->Read<int32_t>();
-			auto v = MakeValue(datatype, std::make_shared<std::string>(id == -1 ? std::string {} : m_stringArray.at(id)), flagInfo);
-			parent->AddProperty(name, *v);
-			break;
+		BeginContainer(true, 0, flags);
+		m_stack.back()->SetTypedArray(std::move(values));
+		m_stack.pop_back();
+		return true;
+	}
+  private:
+	template<typename T>
+	static std::vector<T> CopyElements(std::span<const uint8_t> data, uint32_t count)
+	{
+		std::vector<T> values;
+		values.resize(count);
+		memcpy(values.data(), data.data(), count * sizeof(T));
+		return values;
+	}
+	std::string GetName() const { return (m_stack.empty() || m_stack.back()->IsArray()) ? std::string {} : std::string {m_key}; }
+	template<typename... TArgs>
+	void AddValue(TArgs &&...args)
+	{
+		if(m_stack.empty())
+			throw std::runtime_error {"Unexpected KV3 root type " + to_string(KVValue {std::forward<TArgs>(args)...}.GetType())};
+		// Array elements are constructed in place, only object members need their own allocation
+		m_stack.back()->EmplaceProperty(GetName(), std::forward<TArgs>(args)...);
+	}
+	void BeginContainer(bool isArray, uint32_t count, KVFlag flags)
+	{
+		auto object = std::make_shared<KVObject>(GetName(), isArray);
+		if(isArray)
+			object->ReserveArray(count);
+		if(m_stack.empty()) {
+			if(isArray)
+				throw std::runtime_error {"Unexpected KV3 root type " + to_string(KVType::ARRAY)};
+			m_root = object;
 		}
-	case KVType::BINARY_BLOB:
-		{
-			auto length = ds->Read<int32_t>();
-
-			if(m_currentBinaryBytesOffset > -1)
-				ds->SetOffset(m_currentBinaryBytesOffset);
-
-			auto data = std::make_shared<BinaryBlob>();
-			data->resize(length);
-			ds->Read(data->data(), length);
-			value = data;
-			auto v = MakeValue(datatype, data, flagInfo);
-			parent->AddProperty(name, *v);
+		else
+			AddValue(isArray ? KVType::ARRAY : KVType::OBJECT, object, flags);
+		m_stack.push_back(object);
+	}
+	pragma::util::DataStream m_ds;
+	std::span<const std::string> m_strings;
+	bool m_aliasBinaryBlobs = false;
+	std::shared_ptr<KVObject> m_root = nullptr;
+	std::vector<std::shared_ptr<KVObject>> m_stack;
+	std::string_view m_key;
+};
 
-			if(m_currentBinaryBytesOffset > -1) {
-				m_currentBinaryBytesOffset = ds->GetOffset();
-				ds->SetOffset(currentOffset + 4);
-			}
+// Stores the values inline in the document's node array
+class resource::BinaryKV3::DocumentBuilder : public KV3Visitor {
+  public:
+	DocumentBuilder(KV3Document &doc, bool aliasBinaryBlobs) : m_doc {doc}, m_aliasBinaryBlobs {aliasBinaryBlobs} {}
+	virtual bool BeginObject(uint32_t memberCount, KVFlag flags) override
+	{
+		BeginContainer(KVType::OBJECT, memberCount, flags);
+		return true;
+	}
+	virtual void EndObject() override { m_nextMember.pop_back(); }
+	virtual bool BeginArray(uint32_t elementCount, KVFlag flags) override
+	{
+		BeginContainer(KVType::ARRAY, elementCount, flags);
+		return true;
+	}
+	virtual void EndArray() override { m_nextMember.pop_back(); }
+	virtual void Key(std::string_view key, int32_t stringId) override { m_keyId = stringId; }
+	virtual void Scalar(const KV3Node &value, std::string_view str) override { AddNode(value); }
+	virtual void Blob(std::span<const uint8_t> data, KVFlag flags) override
+	{
+		KV3Node node {};
+		node.type = KVType::BINARY_BLOB;
+		node.flags = flags;
+		node.count = data.size();
+		node.blobIndex = m_doc.m_blobViews.size();
+		if(m_aliasBinaryBlobs)
+			m_doc.m_blobViews.push_back(data);
+		else {
+			auto &blob = m_doc.m_blobs.emplace_back(data.begin(), data.end());
+			m_doc.m_blobViews.push_back(blob);
+		}
+		AddNode(node);
+	}
+  private:
+	uint32_t AddNode(const KV3Node &node)
+	{
+		auto nodeIdx = static_cast<uint32_t>(m_doc.m_nodes.size());
+		m_doc.m_nodes.push_back(node);
+		if(!m_nextMember.empty())
+			m_doc.m_members[m_nextMember.back()++] = {m_keyId, nodeIdx};
+		m_keyId = -1;
+		return nodeIdx;
+	}
+	void BeginContainer(KVType type, uint32_t count, KVFlag flags)
+	{
+		KV3Node node {};
+		node.type = type;
+		node.flags = flags;
+		node.count = count;
+		node.container.firstMember = m_doc.m_members.size();
+		node.container.collection = m_doc.m_collections.size();
+		auto nodeIdx = AddNode(node);
+		m_doc.m_collections.push_back(KV3Collection {m_doc, nodeIdx});
+		// Reserve the member range up front, nested containers append their own ranges after it
+		m_doc.m_members.resize(m_doc.m_members.size() + count);
+		m_nextMember.push_back(node.container.firstMember);
+	}
+	KV3Document &m_doc;
+	bool m_aliasBinaryBlobs = false;
+	std::vector<uint32_t> m_nextMember;
+	int32_t m_keyId = -1;
+};
 
-			break;
+// Forwards the values at the projected key paths and the containers leading to them, all other containers are skipped
+class resource::BinaryKV3::ProjectionFilter : public KV3Visitor {
+  public:
+	ProjectionFilter(KV3Visitor &target, std::span<const std::string_view> paths) : m_target {target}
+	{
+		m_paths.reserve(paths.size());
+		for(auto path : paths)
+			m_paths.push_back(ParsePath(path));
+	}
+	virtual bool BeginObject(uint32_t memberCount, KVFlag flags) override { return BeginContainer(false, memberCount, flags); }
+	virtual void EndObject() override { EndContainer(false); }
+	virtual bool BeginArray(uint32_t elementCount, KVFlag flags) override { return BeginContainer(true, elementCount, flags); }
+	virtual void EndArray() override { EndContainer(true); }
+	virtual void Key(std::string_view key, int32_t stringId) override
+	{
+		if(m_forwardDepth > 0) {
+			m_target.Key(key, stringId);
+			return;
 		}
-	case KVType::ARRAY:
-		{
-			auto arrayLength = ds->Read<int32_t>();
-			auto array = std::make_shared<KVObject>(name, true);
-			for(auto i = decltype(arrayLength) {0u}; i < arrayLength; ++i)
-				ParseBinaryKV3(ds, array, true);
-
-			value = array;
-			auto v = MakeValue(datatype, array, flagInfo);
-			parent->AddProperty(name, *v);
-			break;
+		m_key = key;
+		m_keyId = stringId;
+	}
+	virtual void Scalar(const KV3Node &value, std::string_view str) override
+	{
+		if(MatchValue(false) == Match::Full)
+			m_target.Scalar(value, str);
+	}
+	virtual void Blob(std::span<const uint8_t> data, KVFlag flags) override
+	{
+		if(MatchValue(false) == Match::Full)
+			m_target.Blob(data, flags);
+	}
+	virtual bool TypedArray(KVType elementType, std::span<const uint8_t> data, uint32_t count, KVFlag flags) override
+	{
+		if(m_forwardDepth > 0)
+			return m_target.TypedArray(elementType, data, count, flags);
+		auto firstMatch = m_matches.size();
+		auto match = MatchValue(true);
+		if(match == Match::None)
+			return true; // Skipped
+		if(match == Match::Full && m_target.TypedArray(elementType, data, count, flags))
+			return true;
+		// The array has already been matched, the following BeginArray must not match it again
+		m_pendingMatch = {match, firstMatch};
+		return false;
+	}
+  private:
+	struct Segment {
+		std::string_view key;
+		bool isIndex = false;
+		std::optional<uint32_t> index {}; // Any index if not set
+	};
+	struct PathMatch {
+		uint32_t path;
+		uint32_t segment; // Next segment to match
+	};
+	struct Frame {
+		bool isArray;
+		uint32_t nextIndex;
+		size_t firstMatch; // The matches of a container are stored in m_matches from this index to the end
+	};
+	enum class Match : uint8_t { None, Partial, Full };
+	static std::vector<Segment> ParsePath(std::string_view path)
+	{
+		std::vector<Segment> segments;
+		while(!path.empty()) {
+			auto end = path.find_first_of(".[");
+			if(end != 0)
+				segments.push_back({path.substr(0, end)});
+			if(end == std::string_view::npos)
+				break;
+			if(path[end] == '.') {
+				path.remove_prefix(end + 1);
+				continue;
+			}
+			auto close = path.find(']', end);
+			if(close == std::string_view::npos)
+				throw std::runtime_error {"Invalid KV3 key path '" + std::string {path} + "'"};
+			auto selector = path.substr(end + 1, close - end - 1);
+			Segment segment {{}, true};
+			if(selector != "*") {
+				uint32_t index;
+				auto result = std::from_chars(selector.data(), selector.data() + selector.size(), index);
+				if(result.ec != std::errc {} || result.ptr != selector.data() + selector.size())
+					throw std::runtime_error {"Invalid KV3 array index '" + std::string {selector} + "'"};
+				segment.index = index;
+			}
+			segments.push_back(segment);
+			path.remove_prefix(close + 1);
 		}
-	case KVType::ARRAY_TYPED:
-		{
-			auto typeArrayLength = ds->Read<int32_t>();
-			auto type = ReadType(ds);
-			auto typedArray = std::make_shared<KVObject>(name, true);
-
-			for(auto i = decltype(typeArrayLength) {0u}; i < typeArrayLength; ++i)
-				ReadBinaryValue(name, type.first, type.second, ds, typedArray);
-
-			value = typedArray;
-			auto v = MakeValue(datatype, typedArray, flagInfo);
-			parent->AddProperty(name, *v);
-			break;
+		return segments;
+	}
+	// Matches the value which is about to be reported against the key paths. Partial matches of containers are appended to m_matches.
+	Match MatchValue(bool isContainer)
+	{
+		if(m_forwardDepth > 0)
+			return Match::Full;
+		auto firstMatch = m_matches.size();
+		if(m_frames.empty()) {
+			for(auto i = decltype(m_paths.size()) {0u}; i < m_paths.size(); ++i) {
+				if(m_paths[i].empty())
+					return Match::Full;
+				m_matches.push_back({static_cast<uint32_t>(i), 0});
+			}
+			return Match::Partial;
 		}
-	case KVType::OBJECT:
-		{
-			auto objectLength = ds->Read<int32_t>();
-			auto newObject = std::make_shared<KVObject>(name, false);
-			for(auto i = decltype(objectLength) {0u}; i < objectLength; ++i)
-				ParseBinaryKV3(ds, newObject, false);
-
-			value = newObject;
-			if(parent == nullptr)
-				parent = newObject;
-			else {
-				auto v = MakeValue(datatype, newObject, flagInfo);
-				parent->AddProperty(name, *v);
+		auto &frame = m_frames.back();
+		auto index = frame.nextIndex++;
+		auto match = Match::None;
+		for(auto i = frame.firstMatch; i < firstMatch; ++i) {
+			auto pathMatch = m_matches[i];
+			auto &path = m_paths[pathMatch.path];
+			auto &segment = path[pathMatch.segment];
+			auto isMatch = frame.isArray ? (segment.isIndex && (!segment.index || *segment.index == index)) : (!segment.isIndex && segment.key == m_key);
+			if(!isMatch)
+				continue;
+			if(pathMatch.segment + 1 == path.size()) {
+				match = Match::Full;
+				break;
 			}
-
-			break;
+			m_matches.push_back({pathMatch.path, pathMatch.segment + 1});
+			match = Match::Partial;
 		}
-	default:
-		throw new std::runtime_error {"Unknown KVType " + std::to_string(pragma::math::to_integral(datatype)) + " for field '" + name + "' on byte " + std::to_string(ds->GetOffset() - 1)};
+		if(match != Match::Partial || !isContainer)
+			m_matches.resize(firstMatch);
+		if(match == Match::Partial && !isContainer)
+			return Match::None;
+		if(match != Match::None && !frame.isArray)
+			m_target.Key(m_key, m_keyId);
+		return match;
 	}
-
-	return parent ? parent : nullptr;
-}
-
-std::shared_ptr<resource::KVObject> resource::BinaryKV3::ParseBinaryKV3(pragma::util::DataStream &ds, std::shared_ptr<KVObject> parent, bool inArray)
-{
-	std::string name {};
-	if(!inArray) {
-		auto stringID = ds->Read<int32_t>();
-		name = (stringID == -1) ? "" : m_stringArray.at(stringID);
+	bool BeginContainer(bool isArray, uint32_t count, KVFlag flags)
+	{
+		auto firstMatch = m_matches.size();
+		auto match = Match::None;
+		if(m_pendingMatch) {
+			std::tie(match, firstMatch) = *m_pendingMatch;
+			m_pendingMatch = {};
+		}
+		else
+			match = MatchValue(true);
+		if(match == Match::None)
+			return false;
+		if(!(isArray ? m_target.BeginArray(count, flags) : m_target.BeginObject(count, flags))) {
+			m_matches.resize(firstMatch);
+			return false;
+		}
+		if(match == Match::Full)
+			++m_forwardDepth;
+		else
+			m_frames.push_back({isArray, 0, firstMatch});
+		return true;
 	}
+	void EndContainer(bool isArray)
+	{
+		if(m_forwardDepth > 0)
+			--m_forwardDepth;
+		else {
+			m_matches.resize(m_frames.back().firstMatch);
+			m_frames.pop_back();
+		}
+		if(isArray)
+			m_target.EndArray();
+		else
+			m_target.EndObject();
+	}
+	KV3Visitor &m_target;
+	std::vector<std::vector<Segment>> m_paths;
+	std::vector<PathMatch> m_matches;
+	std::vector<Frame> m_frames;
+	// Number of open containers within a fully matched subtree
+	uint32_t m_forwardDepth = 0;
+	std::optional<std::pair<Match, size_t>> m_pendingMatch {};
+	std::string_view m_key;
+	int32_t m_keyId = -1;
+};
 
-	auto type = ReadType(ds);
-	return ReadBinaryValue(name, type.first, type.second, ds, parent);
+resource::KV3Reader resource::BinaryKV3::CreateReader(const pragma::util::DataStream &ds) const
+{
+	std::span<const uint8_t> data {static_cast<const uint8_t *>(ds->GetData()), ds->GetInternalSize()};
+	return KV3Reader {data, m_kvDataOffset, GetStringArray(), m_typesArray, m_binaryBytesOffset, m_eightBytesOffset, m_blobSizes, m_blobsOffset, m_twoBytesOffset};
 }
 
 std::optional<Mat4> resource::cast_to_mat4(NTROValue &v0)
 {
+	if(v0.type == DataType::Matrix3x4 || v0.type == DataType::Matrix3x4a)
+		return cast_components_to_type<Mat4>(static_cast<TNTROValue<NTROFloats<12>> &>(v0).value);
 	auto *vAr = dynamic_cast<NTROArray *>(&v0);
 	if(vAr == nullptr)
 		return {};
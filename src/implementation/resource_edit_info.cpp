@@ -375,6 +375,11 @@ void resource::ResourceEditInfo::DebugPrint(std::stringstream &ss, const std::st
 
 BlockType resource::ResourceExtRefList::GetType() const { return BlockType::RERL; }
 const std::vector<resource::ResourceExtRefList::ResourceReferenceInfo> &resource::ResourceExtRefList::GetResourceReferenceInfos() const { return m_resourceReferenceInfos; }
+const resource::ResourceExtRefList::ResourceReferenceInfo *resource::ResourceExtRefList::FindResourceReferenceInfo(uint64_t id) const
+{
+	auto it = m_referenceIndices.find(id);
+	return (it != m_referenceIndices.end()) ? &m_resourceReferenceInfos[it->second] : nullptr;
+}
 void resource::ResourceExtRefList::Read(const Resource &resource, ufile::IFile &f)
 {
 	f.Seek(GetOffset());
@@ -387,6 +392,7 @@ void resource::ResourceExtRefList::Read(const Resource &resource, ufile::IFile &
 
 	f.Seek(f.Tell() + offset - sizeof(uint32_t) * 2);
 	m_resourceReferenceInfos.resize(size);
+	m_referenceIndices.reserve(size);
 	for(auto i = decltype(size) {0u}; i < size; ++i) {
 		auto &resInfo = m_resourceReferenceInfos.at(i);
 		resInfo.id = f.Read<uint64_t>();
@@ -398,9 +404,12 @@ void resource::ResourceExtRefList::Read(const Resource &resource, ufile::IFile &
 		// so we will need to add 8 to position later
 		f.Seek(previousPosition + f.Read<int64_t>());
 
-		resInfo.name = f.ReadString(); // TODO: UTF8
+		resInfo.name = std::make_shared<const std::string>(f.ReadString()); // TODO: UTF8
 
 		f.Seek(previousPosition + sizeof(int64_t)); // 8 is to account for string offset
+
+		// If an id occurs more than once, the first reference is used
+		m_referenceIndices.insert(std::make_pair(resInfo.id, i));
 	}
 }
 void resource::ResourceExtRefList::DebugPrint(std::stringstream &ss, const std::string &t) const
@@ -410,7 +419,7 @@ void resource::ResourceExtRefList::DebugPrint(std::stringstream &ss, const std::
 		auto &refInfo = m_resourceReferenceInfos.at(i);
 		ss << t << "\t[" << i << "] = {\n";
 		ss << t << "\t\tId = " << refInfo.id << "\n";
-		ss << t << "\t\tName = " << refInfo.name << "\n";
+		ss << t << "\t\tName = " << *refInfo.name << "\n";
 		ss << t << "\t}\n";
 	}
 	ss << t << "}\n";
@@ -421,6 +430,7 @@ void resource::ResourceExtRefList::DebugPrint(std::stringstream &ss, const std::
 BlockType resource::VBIB::GetType() const { return BlockType::VBIB; }
 void resource::VBIB::Read(const Resource &resource, ufile::IFile &f)
 {
+	m_mappedFile = resource.GetMappedFile();
 	f.Seek(GetOffset());
 
 	auto vertexBufferOffset = f.Read<uint32_t>();
@@ -470,8 +480,9 @@ void resource::VBIB::Read(const Resource &resource, ufile::IFile &f)
 		f.Seek(refB + dataOffset);
 
 		if(totalSize == decompressedSize) {
-			vertexBuffer.buffer.resize(totalSize);
-			f.Read(vertexBuffer.buffer.data(), vertexBuffer.buffer.size() * sizeof(vertexBuffer.buffer.front()));
+			auto data = ReadData(resource, f, totalSize, vertexBuffer.buffer);
+			if(m_mappedFile)
+				vertexBuffer.mappedBuffer = data;
 		}
 		else {
 			std::vector<uint8_t> vertexBufferBytes {};
@@ -502,8 +513,9 @@ void resource::VBIB::Read(const Resource &resource, ufile::IFile &f)
 		f.Seek(refC + dataOffset);
 
 		if(dataSize == decompressedSize) {
-			indexBuffer.buffer.resize(dataSize);
-			f.Read(indexBuffer.buffer.data(), indexBuffer.buffer.size() * sizeof(indexBuffer.buffer.front()));
+			auto data = ReadData(resource, f, dataSize, indexBuffer.buffer);
+			if(m_mappedFile)
+				indexBuffer.mappedBuffer = data;
 		}
 		else {
 			std::vector<uint8_t> indexBufferBytes {};
@@ -549,9 +561,12 @@ void resource::VBIB::DebugPrint(std::stringstream &ss, const std::string &t) con
 const std::vector<resource::VBIB::VertexBuffer> &resource::VBIB::GetVertexBuffers() const { return m_vertexBuffers; }
 const std::vector<resource::VBIB::IndexBuffer> &resource::VBIB::GetIndexBuffers() const { return m_indexBuffers; }
 
+std::span<const uint8_t> resource::VBIB::VertexBuffer::GetBuffer() const { return mappedBuffer.empty() ? std::span<const uint8_t> {buffer} : mappedBuffer; }
+std::span<const uint8_t> resource::VBIB::IndexBuffer::GetBuffer() const { return mappedBuffer.empty() ? std::span<const uint8_t> {buffer} : mappedBuffer; }
 void resource::VBIB::VertexBuffer::ReadVertexAttribute(uint32_t offset, const VertexAttribute &attribute, std::vector<float> &outData) const
 {
 	offset = offset * size + attribute.offset;
+	auto buffer = GetBuffer();
 
 	switch(attribute.type) {
 	case DXGI_FORMAT::R32G32B32_FLOAT:
@@ -626,6 +641,45 @@ void resource::SNAP::DebugPrint(std::stringstream &ss, const std::string &t) con
 
 ///////////
 
+// Struct and enum definitions only change if the game's code changes, so the same definitions occur in all resources of a game.
+// They are shared process-wide along with the decode plans compiled from them.
+struct IntrospectionCache {
+	std::mutex mutex;
+	size_t limit = 4'096;
+	std::unordered_map<uint64_t, std::shared_ptr<const resource::ResourceIntrospectionManifest::ResourceDiskStruct>> structs;
+	std::unordered_map<uint64_t, std::shared_ptr<const resource::ResourceIntrospectionManifest::ResourceDiskEnum>> enums;
+	// Keyed by the keys of all structs of a manifest, since the plans resolve references between them
+	std::map<std::vector<uint64_t>, std::shared_ptr<const resource::ResourceIntrospectionManifest::Schema>> schemas;
+};
+static IntrospectionCache &get_introspection_cache()
+{
+	static IntrospectionCache cache {};
+	return cache;
+}
+static uint64_t get_introspection_key(uint32_t id, uint32_t crc) { return (static_cast<uint64_t>(id) << 32) | crc; }
+// The cache mutex must be locked. Keeps the existing entry if another thread has inserted the same key in the meantime.
+template<typename TMap>
+static typename TMap::mapped_type insert_cached(TMap &map, size_t limit, typename TMap::key_type key, const typename TMap::mapped_type &value)
+{
+	if(limit > 0 && map.size() >= limit && map.find(key) == map.end())
+		map.clear();
+	return map.insert(std::make_pair(std::move(key), value)).first->second;
+}
+void resource::ResourceIntrospectionManifest::SetSchemaCacheLimit(size_t maxEntries)
+{
+	auto &cache = get_introspection_cache();
+	std::scoped_lock lock {cache.mutex};
+	cache.limit = maxEntries;
+}
+void resource::ResourceIntrospectionManifest::ClearSchemaCache()
+{
+	auto &cache = get_introspection_cache();
+	std::scoped_lock lock {cache.mutex};
+	cache.structs.clear();
+	cache.enums.clear();
+	cache.schemas.clear();
+}
+
 BlockType resource::ResourceIntrospectionManifest::GetType() const { return BlockType::NTRO; }
 
 void resource::ResourceIntrospectionManifest::Read(const Resource &resource, ufile::IFile &f)
@@ -636,17 +690,122 @@ void resource::ResourceIntrospectionManifest::Read(const Resource &resource, ufi
 
 	f.Seek(GetOffset() + sizeof(int32_t) * 3);
 	ReadEnums(f);
+
+	LoadSchema();
 }
 uint32_t resource::ResourceIntrospectionManifest::GetIntrospectionVersion() const { return m_introspectionVersion; }
-const std::vector<resource::ResourceIntrospectionManifest::ResourceDiskStruct> &resource::ResourceIntrospectionManifest::GetReferencedStructs() const { return m_referencedStructs; }
-const std::vector<resource::ResourceIntrospectionManifest::ResourceDiskEnum> &resource::ResourceIntrospectionManifest::GetReferencedEnums() const { return m_referencedEnums; }
+const std::vector<std::shared_ptr<const resource::ResourceIntrospectionManifest::ResourceDiskStruct>> &resource::ResourceIntrospectionManifest::GetReferencedStructs() const { return m_referencedStructs; }
+const std::vector<std::shared_ptr<const resource::ResourceIntrospectionManifest::ResourceDiskEnum>> &resource::ResourceIntrospectionManifest::GetReferencedEnums() const { return m_referencedEnums; }
+const resource::ResourceIntrospectionManifest::ResourceDiskStruct *resource::ResourceIntrospectionManifest::FindStruct(uint32_t id) const
+{
+	if(!m_schema)
+		return nullptr;
+	auto it = m_schema->structIndices.find(id);
+	return (it != m_schema->structIndices.end()) ? m_schema->structs[it->second].get() : nullptr;
+}
+const resource::ResourceIntrospectionManifest::DecodePlan &resource::ResourceIntrospectionManifest::GetDecodePlan(size_t structIdx) const { return m_schema->decodePlans.at(structIdx); }
+const resource::ResourceIntrospectionManifest::DecodePlan *resource::ResourceIntrospectionManifest::FindDecodePlan(uint32_t id) const
+{
+	if(!m_schema)
+		return nullptr;
+	auto it = m_schema->structIndices.find(id);
+	return (it != m_schema->structIndices.end()) ? &m_schema->decodePlans[it->second] : nullptr;
+}
+ResourceType resource::ResourceIntrospectionManifest::DetermineResourceTypeByStructName(std::string_view name)
+{
+	if(name == "VSoundEventScript_t")
+		return ResourceType::SoundEventScript;
+	if(name == "CWorldVisibility")
+		return ResourceType::WorldVisibility;
+	return ResourceType::Unknown;
+}
+void resource::ResourceIntrospectionManifest::LoadSchema()
+{
+	std::vector<uint64_t> key {};
+	key.reserve(m_referencedStructs.size());
+	for(auto &diskStruct : m_referencedStructs)
+		key.push_back(get_introspection_key(diskStruct->id, diskStruct->diskCrc));
+	auto &cache = get_introspection_cache();
+	{
+		std::scoped_lock lock {cache.mutex};
+		auto it = cache.schemas.find(key);
+		if(it != cache.schemas.end()) {
+			m_schema = it->second;
+			return;
+		}
+	}
+	auto schema = BuildSchema(m_referencedStructs);
+	std::scoped_lock lock {cache.mutex};
+	m_schema = insert_cached(cache.schemas, cache.limit, std::move(key), schema);
+}
+std::shared_ptr<const resource::ResourceIntrospectionManifest::Schema> resource::ResourceIntrospectionManifest::BuildSchema(const std::vector<std::shared_ptr<const ResourceDiskStruct>> &structs)
+{
+	auto schema = std::make_shared<Schema>();
+	schema->structs = structs;
+	auto &structIndices = schema->structIndices;
+	auto &decodePlans = schema->decodePlans;
+	structIndices.reserve(structs.size());
+	for(auto i = decltype(structs.size()) {0u}; i < structs.size(); ++i)
+		structIndices.insert(std::make_pair(structs[i]->id, i));
+
+	// The plans reference each other, so the vector must not be resized once they're compiled
+	decodePlans.resize(structs.size());
+	auto addFields = [&structIndices, &decodePlans](DecodePlan &plan, const ResourceDiskStruct &diskStruct) {
+		for(auto &field : diskStruct.fieldIntrospection) {
+			DecodePlan::Field planField {};
+			planField.field = &field;
+			planField.type = field.type;
+			planField.diskOffset = field.diskOffset;
+			planField.count = std::max<uint16_t>(field.count, static_cast<uint16_t>(1));
+			planField.isArray = field.count > 0 || field.indirections.empty() == false;
+			if(field.indirections.size() > 1) {
+				planField.indirection = DecodePlan::Indirection::Invalid;
+				planField.error = "More than one indirection, not yet handled.";
+			}
+			else if(field.indirections.size() == 1) {
+				auto indirection = field.indirections.front();
+				if(field.count > 0) {
+					planField.indirection = DecodePlan::Indirection::Invalid;
+					planField.error = "Indirection.Count > 0 && field.Count > 0";
+				}
+				else if(indirection == 0x03)
+					planField.indirection = DecodePlan::Indirection::Pointer;
+				else if(indirection == 0x04)
+					planField.indirection = DecodePlan::Indirection::Array;
+				else {
+					planField.indirection = DecodePlan::Indirection::Invalid;
+					planField.error = "Unknown indirection. (" + std::to_string(indirection) + ")";
+				}
+			}
+			if(field.type == DataType::Struct) {
+				auto it = structIndices.find(field.typeData);
+				if(it != structIndices.end())
+					planField.structPlan = &decodePlans[it->second];
+			}
+			plan.fields.push_back(std::move(planField));
+		}
+	};
+	for(auto i = decltype(structs.size()) {0u}; i < structs.size(); ++i) {
+		auto &diskStruct = *structs[i];
+		auto &plan = decodePlans[i];
+		plan.diskStruct = &diskStruct;
+		addFields(plan, diskStruct);
+		// Only the fields of the direct base struct are included, they're located at the same offsets as the struct's own fields
+		if(diskStruct.baseStructId != 0) {
+			auto it = structIndices.find(diskStruct.baseStructId);
+			if(it != structIndices.end())
+				addFields(plan, *structs[it->second]);
+		}
+	}
+	return schema;
+}
 void resource::ResourceIntrospectionManifest::DebugPrint(std::stringstream &ss, const std::string &t) const
 {
 	ss << t << "ResourceIntrospectionManifest = {\n";
 	ss << t << "\tIntrospection version: " << m_introspectionVersion << "\n";
 	ss << t << "\tStructs:\n";
 	for(auto i = decltype(m_referencedStructs.size()) {0u}; i < m_referencedStructs.size(); ++i) {
-		auto &strct = m_referencedStructs.at(i);
+		auto &strct = *m_referencedStructs.at(i);
 		ss << t << "\t[" << i << "] = {\n";
 		ss << t << "\t\tIntrospection version = " << strct.introspectionVersion << "\n";
 		ss << t << "\t\tId = " << strct.id << "\n";
@@ -673,7 +832,7 @@ void resource::ResourceIntrospectionManifest::DebugPrint(std::stringstream &ss,
 	}
 	ss << t << "\tEnums:\n";
 	for(auto i = decltype(m_referencedEnums.size()) {0u}; i < m_referencedEnums.size(); ++i) {
-		auto &en = m_referencedEnums.at(i);
+		auto &en = *m_referencedEnums.at(i);
 		ss << t << "\t[" << i << "] = {\n";
 		ss << t << "\t\tIntrospection version = " << en.introspectionVersion << "\n";
 		ss << t << "\t\tId = " << en.id << "\n";
@@ -694,16 +853,33 @@ void resource::ResourceIntrospectionManifest::DebugPrint(std::stringstream &ss,
 }
 void resource::ResourceIntrospectionManifest::ReadStructs(ufile::IFile &f)
 {
+	constexpr size_t ENTRY_SIZE = 40; // Fields and strings are stored outside of the entry
 	auto offset = f.Tell();
 	auto entriesOffset = f.Read<uint32_t>();
 	auto entriesCount = f.Read<uint32_t>();
 	if(entriesCount == 0)
 		return;
-	f.Seek(offset + entriesOffset);
+	auto &cache = get_introspection_cache();
 	m_referencedStructs.reserve(entriesCount);
 	for(auto i = decltype(entriesCount) {0u}; i < entriesCount; ++i) {
-		m_referencedStructs.push_back({});
-		auto &diskStruct = m_referencedStructs.back();
+		// Only the id and CRC are read if the struct is already known
+		auto entryOffset = offset + entriesOffset + i * ENTRY_SIZE;
+		f.Seek(entryOffset + sizeof(uint32_t));
+		auto id = f.Read<uint32_t>();
+		f.Seek(f.Tell() + sizeof(uint32_t)); // Name
+		auto key = get_introspection_key(id, f.Read<uint32_t>());
+		{
+			std::scoped_lock lock {cache.mutex};
+			auto it = cache.structs.find(key);
+			if(it != cache.structs.end()) {
+				m_referencedStructs.push_back(it->second);
+				continue;
+			}
+		}
+
+		f.Seek(entryOffset);
+		auto pDiskStruct = std::make_shared<ResourceDiskStruct>();
+		auto &diskStruct = *pDiskStruct;
 		diskStruct.introspectionVersion = f.Read<uint32_t>();
 		diskStruct.id = f.Read<uint32_t>();
 		diskStruct.name = read_offset_string(f);
@@ -743,20 +919,40 @@ void resource::ResourceIntrospectionManifest::ReadStructs(ufile::IFile &f)
 		}
 		diskStruct.structFlags = f.Read<uint8_t>();
 		f.Seek(f.Tell() + 3); // ??
+
+		std::scoped_lock lock {cache.mutex};
+		m_referencedStructs.push_back(insert_cached(cache.structs, cache.limit, key, pDiskStruct));
 	}
 }
 void resource::ResourceIntrospectionManifest::ReadEnums(ufile::IFile &f)
 {
+	constexpr size_t ENTRY_SIZE = 28; // Values and strings are stored outside of the entry
 	auto offset = f.Tell();
 	auto entriesOffset = f.Read<uint32_t>();
 	auto entriesCount = f.Read<uint32_t>();
 	if(entriesCount == 0)
 		return;
-	f.Seek(offset + entriesOffset);
+	auto &cache = get_introspection_cache();
 	m_referencedEnums.reserve(entriesCount);
 	for(auto i = decltype(entriesCount) {0u}; i < entriesCount; ++i) {
-		m_referencedEnums.push_back({});
-		auto &diskEnum = m_referencedEnums.back();
+		// Only the id and CRC are read if the enum is already known
+		auto entryOffset = offset + entriesOffset + i * ENTRY_SIZE;
+		f.Seek(entryOffset + sizeof(uint32_t));
+		auto id = f.Read<uint32_t>();
+		f.Seek(f.Tell() + sizeof(uint32_t)); // Name
+		auto key = get_introspection_key(id, f.Read<uint32_t>());
+		{
+			std::scoped_lock lock {cache.mutex};
+			auto it = cache.enums.find(key);
+			if(it != cache.enums.end()) {
+				m_referencedEnums.push_back(it->second);
+				continue;
+			}
+		}
+
+		f.Seek(entryOffset);
+		auto pDiskEnum = std::make_shared<ResourceDiskEnum>();
+		auto &diskEnum = *pDiskEnum;
 		diskEnum.introspectionVersion = f.Read<uint32_t>();
 		diskEnum.id = f.Read<uint32_t>();
 		diskEnum.name = read_offset_string(f);
@@ -777,5 +973,8 @@ void resource::ResourceIntrospectionManifest::ReadEnums(ufile::IFile &f)
 			}
 			f.Seek(prev);
 		}
+
+		std::scoped_lock lock {cache.mutex};
+		m_referencedEnums.push_back(insert_cached(cache.enums, cache.limit, key, pDiskEnum));
 	}
 }
@@ -0,0 +1,1422 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-FileCopyrightText: (c) 2015 Steam Database
+// SPDX-License-Identifier: MIT
+
+module;
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define US2_TEXTURE_DECODER_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+module source2;
+
+import :texture_decoder;
+import :thread_pool;
+
+using namespace source2;
+
+using byte = uint8_t;
+
+static std::array<std::array<uint8_t, 16>, 64> BC7PartitionTable3 {
+  //Partition table for 3-subset BPTC, with the 4×4 block of values for each partition number
+  std::array<uint8_t, 16> {0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2},
+  {0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1},
+  {0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+  {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2},
+  {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2},
+  {0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2},
+  {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2},
+  {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+  {0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2},
+  {0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2},
+  {0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2},
+  {0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2},
+  {0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0},
+  {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2},
+  {0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0},
+  {0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2},
+  {0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1},
+  {0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2},
+  {0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1},
+  {0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2},
+  {0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0},
+  {0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0},
+  {0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2},
+  {0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0},
+  {0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1},
+  {0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2},
+  {0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2},
+  {0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1},
+  {0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1},
+  {0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2},
+  {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2},
+  {0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0},
+  {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0},
+  {0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0},
+  {0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0},
+  {0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1},
+  {0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1},
+  {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+  {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1},
+  {0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2},
+  {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1},
+  {0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1},
+  {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1},
+  {0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1},
+  {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2},
+  {0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1},
+  {0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2},
+  {0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2},
+  {0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2},
+  {0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2},
+  {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2},
+  {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2},
+  {0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2},
+  {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2},
+  {0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2},
+  {0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1},
+  {0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2},
+  {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2},
+  {0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0},
+};
+
+static std::array<uint8_t, 64> BC7AnchorIndices32 {//BPTC anchor index values for the second subset of three-subset partitioning, by partition number
+  3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3, 3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15, 8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15, 3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3};
+static std::array<uint8_t, 64> BC7AnchorIndices33 {//BPTC anchor index values for the third subset of three-subset partitioning, by partition number
+  15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8, 15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8, 15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8, 15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8};
+static std::array<uint8_t, 8> BC7IndLength = {3, 3, 2, 2, 2, 2, 4, 2};
+
+static std::array<std::array<uint8_t, 16>, 64> BPTCPartitionTable2 {
+  //Partition table for 2-subset BPTC, with the 4×4 block of values for each partition number
+  std::array<uint8_t, 16> {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
+  {0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1},
+  {0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1},
+  {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1},
+  {0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+  {0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1},
+  {0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0},
+  {0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0},
+  {0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0},
+  {0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1},
+  {0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0},
+  {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0},
+  {0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0},
+  {0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0},
+  {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0},
+  {0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0},
+  {0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0},
+  {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1},
+  {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1},
+  {0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0},
+  {0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0},
+  {0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0},
+  {0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0},
+  {0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1},
+  {0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1},
+  {0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0},
+  {0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0},
+  {0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0},
+  {0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0},
+  {0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0},
+  {0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1},
+  {0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1},
+  {0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0},
+  {0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0},
+  {0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0},
+  {0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0},
+  {0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1},
+  {0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0},
+  {0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0},
+  {0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1},
+  {0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1},
+  {0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1},
+  {0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1},
+  {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0},
+  {0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0},
+  {0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1},
+};
+static std::array<uint8_t, 64> BPTCAnchorIndices2 {// BPTC anchor index values for the second subset of two-subset partitioning, by partition number
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2, 15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6, 6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15};
+static std::array<uint8_t, 4> BPTCWeights2 = {0, 21, 43, 64};
+static std::array<uint8_t, 8> BPTCWeights3 = {0, 9, 19, 27, 47, 46, 55, 64};
+static std::array<uint8_t, 16> BPTCWeights4 = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+[[maybe_unused]] static uint16_t BPTCInterpolateFactor(int weight, int e0, int e1) { return (uint16_t)((((64 - weight) * e0) + (weight * e1) + 32) >> 6); }
+
+namespace {
+	// Per-texel endpoints and weights of a decoded block, in output (BGRA) channel order
+	struct BlockTexels {
+		alignas(32) std::array<uint8_t, 64> e0;
+		alignas(32) std::array<uint8_t, 64> e1;
+		alignas(32) std::array<uint8_t, 64> weights;
+	};
+};
+
+// Computes ((64 - w) * e0 + w * e1 + 32) >> 6 for all 64 channels of a block
+static void bptc_interpolate(const BlockTexels &texels, uint8_t *outTexels)
+{
+#if defined(__AVX2__)
+	auto v64 = _mm256_set1_epi16(64);
+	auto v32 = _mm256_set1_epi16(32);
+	for(auto i = 0u; i < 64u; i += 16) {
+		auto e0 = _mm256_cvtepu8_epi16(_mm_load_si128(reinterpret_cast<const __m128i *>(texels.e0.data() + i)));
+		auto e1 = _mm256_cvtepu8_epi16(_mm_load_si128(reinterpret_cast<const __m128i *>(texels.e1.data() + i)));
+		auto w = _mm256_cvtepu8_epi16(_mm_load_si128(reinterpret_cast<const __m128i *>(texels.weights.data() + i)));
+		auto r = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(v64, w), e0), _mm256_mullo_epi16(w, e1)), v32);
+		r = _mm256_srli_epi16(r, 6);
+		auto packed = _mm_packus_epi16(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outTexels + i), packed);
+	}
+#elif defined(US2_TEXTURE_DECODER_SSE2)
+	auto zero = _mm_setzero_si128();
+	auto v64 = _mm_set1_epi16(64);
+	auto v32 = _mm_set1_epi16(32);
+	for(auto i = 0u; i < 64u; i += 16) {
+		auto e0 = _mm_load_si128(reinterpret_cast<const __m128i *>(texels.e0.data() + i));
+		auto e1 = _mm_load_si128(reinterpret_cast<const __m128i *>(texels.e1.data() + i));
+		auto w = _mm_load_si128(reinterpret_cast<const __m128i *>(texels.weights.data() + i));
+		auto interpolate = [&](__m128i e0, __m128i e1, __m128i w) {
+			auto r = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(v64, w), e0), _mm_mullo_epi16(w, e1)), v32);
+			return _mm_srli_epi16(r, 6);
+		};
+		auto lo = interpolate(_mm_unpacklo_epi8(e0, zero), _mm_unpacklo_epi8(e1, zero), _mm_unpacklo_epi8(w, zero));
+		auto hi = interpolate(_mm_unpackhi_epi8(e0, zero), _mm_unpackhi_epi8(e1, zero), _mm_unpackhi_epi8(w, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outTexels + i), _mm_packus_epi16(lo, hi));
+	}
+#elif defined(__ARM_NEON)
+	auto v64 = vdupq_n_u16(64);
+	for(auto i = 0u; i < 64u; i += 8) {
+		auto e0 = vmovl_u8(vld1_u8(texels.e0.data() + i));
+		auto e1 = vmovl_u8(vld1_u8(texels.e1.data() + i));
+		auto w = vmovl_u8(vld1_u8(texels.weights.data() + i));
+		auto r = vmlaq_u16(vmulq_u16(vsubq_u16(v64, w), e0), w, e1);
+		vst1_u8(outTexels + i, vmovn_u16(vrshrq_n_u16(r, 6)));
+	}
+#else
+	for(auto i = 0u; i < 64u; ++i)
+		outTexels[i] = static_cast<uint8_t>(BPTCInterpolateFactor(texels.weights[i], texels.e0[i], texels.e1[i]));
+#endif
+}
+
+// Reconstructs the normal of a single texel from its hemi-octahedral encoded red and green channels, blue is moved to alpha
+template<bool Rgba>
+static void hemi_oct_rb(uint8_t *texel)
+{
+	constexpr auto r = Rgba ? 0 : 2;
+	constexpr auto b = Rgba ? 2 : 0;
+	float nx = ((texel[r] + texel[1]) / 255.0f) - 1.003922f;
+	float ny = (texel[r] - texel[1]) / 255.0f;
+	float nz = 1 - fabsf(nx) - fabsf(ny);
+
+	float l = (float)sqrtf((nx * nx) + (ny * ny) + (nz * nz));
+	texel[3] = texel[b]; //b to alpha
+	texel[r] = (byte)(((nx / l * 0.5f) + 0.5f) * 255);
+	texel[1] = (byte)(((ny / l * 0.5f) + 0.5f) * 255);
+	texel[b] = (byte)(((nz / l * 0.5f) + 0.5f) * 255);
+}
+
+#if defined(__AVX2__)
+// Same as hemi_oct_rb for 8 texels, the operations are performed in the same order to produce identical results
+template<bool Rgba>
+static void hemi_oct_rb_x8(uint8_t *texels)
+{
+	constexpr auto rShift = Rgba ? 0 : 16;
+	constexpr auto bShift = Rgba ? 16 : 0;
+	auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(texels));
+	auto mask = _mm256_set1_epi32(0xFF);
+	auto r = _mm256_and_si256(_mm256_srli_epi32(v, rShift), mask);
+	auto g = _mm256_and_si256(_mm256_srli_epi32(v, 8), mask);
+	auto b = _mm256_and_si256(_mm256_srli_epi32(v, bShift), mask);
+	auto v255 = _mm256_set1_ps(255.0f);
+	auto vHalf = _mm256_set1_ps(0.5f);
+	auto absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	auto nx = _mm256_sub_ps(_mm256_div_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(r, g)), v255), _mm256_set1_ps(1.003922f));
+	auto ny = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(r, g)), v255);
+	auto nz = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_and_ps(nx, absMask)), _mm256_and_ps(ny, absMask));
+	auto l = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)));
+	auto toByte = [&](__m256 n) { return _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(n, l), vHalf), vHalf), v255)), mask); };
+	auto result = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(toByte(nx), rShift), _mm256_slli_epi32(toByte(ny), 8)), _mm256_or_si256(_mm256_slli_epi32(toByte(nz), bShift), _mm256_slli_epi32(b, 24)));
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(texels), result);
+}
+#elif defined(US2_TEXTURE_DECODER_SSE2)
+// Same as hemi_oct_rb for 4 texels, the operations are performed in the same order to produce identical results
+template<bool Rgba>
+static void hemi_oct_rb_x4(uint8_t *texels)
+{
+	constexpr auto rShift = Rgba ? 0 : 16;
+	constexpr auto bShift = Rgba ? 16 : 0;
+	auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(texels));
+	auto mask = _mm_set1_epi32(0xFF);
+	auto r = _mm_and_si128(_mm_srli_epi32(v, rShift), mask);
+	auto g = _mm_and_si128(_mm_srli_epi32(v, 8), mask);
+	auto b = _mm_and_si128(_mm_srli_epi32(v, bShift), mask);
+	auto v255 = _mm_set1_ps(255.0f);
+	auto vHalf = _mm_set1_ps(0.5f);
+	auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	auto nx = _mm_sub_ps(_mm_div_ps(_mm_cvtepi32_ps(_mm_add_epi32(r, g)), v255), _mm_set1_ps(1.003922f));
+	auto ny = _mm_div_ps(_mm_cvtepi32_ps(_mm_sub_epi32(r, g)), v255);
+	auto nz = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_and_ps(nx, absMask)), _mm_and_ps(ny, absMask));
+	auto l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+	auto toByte = [&](__m128 n) { return _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_div_ps(n, l), vHalf), vHalf), v255)), mask); };
+	auto result = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(toByte(nx), rShift), _mm_slli_epi32(toByte(ny), 8)), _mm_or_si128(_mm_slli_epi32(toByte(nz), bShift), _mm_slli_epi32(b, 24)));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(texels), result);
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+// Same as hemi_oct_rb for 4 texels, the operations are performed in the same order to produce identical results
+template<bool Rgba>
+static void hemi_oct_rb_x4(uint8_t *texels)
+{
+	constexpr auto rShift = Rgba ? 0 : 16;
+	constexpr auto bShift = Rgba ? 16 : 0;
+	auto v = vld1q_u32(reinterpret_cast<const uint32_t *>(texels));
+	auto mask = vdupq_n_u32(0xFF);
+	// Shifting by a negative amount shifts to the right, immediate shifts by zero are not allowed
+	auto r = vandq_u32(vshlq_u32(v, vdupq_n_s32(-rShift)), mask);
+	auto g = vandq_u32(vshrq_n_u32(v, 8), mask);
+	auto b = vandq_u32(vshlq_u32(v, vdupq_n_s32(-bShift)), mask);
+	auto v255 = vdupq_n_f32(255.0f);
+	auto vHalf = vdupq_n_f32(0.5f);
+	auto nx = vsubq_f32(vdivq_f32(vcvtq_f32_u32(vaddq_u32(r, g)), v255), vdupq_n_f32(1.003922f));
+	auto ny = vdivq_f32(vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(r), vreinterpretq_s32_u32(g))), v255);
+	auto nz = vsubq_f32(vsubq_f32(vdupq_n_f32(1.0f), vabsq_f32(nx)), vabsq_f32(ny));
+	auto l = vsqrtq_f32(vaddq_f32(vaddq_f32(vmulq_f32(nx, nx), vmulq_f32(ny, ny)), vmulq_f32(nz, nz)));
+	auto toByte = [&](float32x4_t n) { return vandq_u32(vreinterpretq_u32_s32(vcvtq_s32_f32(vmulq_f32(vaddq_f32(vmulq_f32(vdivq_f32(n, l), vHalf), vHalf), v255))), mask); };
+	auto result = vorrq_u32(vorrq_u32(vshlq_n_u32(toByte(nx), rShift), vshlq_n_u32(toByte(ny), 8)), vorrq_u32(vshlq_n_u32(toByte(nz), bShift), vshlq_n_u32(b, 24)));
+	vst1q_u32(reinterpret_cast<uint32_t *>(texels), result);
+}
+#endif
+
+template<bool Rgba>
+static void hemi_oct_rb(uint8_t *texels, size_t numTexels)
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	for(; i + 8 <= numTexels; i += 8)
+		hemi_oct_rb_x8<Rgba>(texels + i * 4);
+#elif defined(US2_TEXTURE_DECODER_SSE2) || (defined(__ARM_NEON) && defined(__aarch64__))
+	for(; i + 4 <= numTexels; i += 4)
+		hemi_oct_rb_x4<Rgba>(texels + i * 4);
+#endif
+	for(; i < numTexels; ++i)
+		hemi_oct_rb<Rgba>(texels + i * 4);
+}
+
+// Inverts the green channel of four-channel texels
+static void invert_green(uint8_t *texels, size_t numTexels)
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	auto mask = _mm256_set1_epi32(0xFF00);
+	for(; i + 8 <= numTexels; i += 8) {
+		auto *p = reinterpret_cast<__m256i *>(texels + i * 4);
+		_mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), mask));
+	}
+#elif defined(US2_TEXTURE_DECODER_SSE2)
+	auto mask = _mm_set1_epi32(0xFF00);
+	for(; i + 4 <= numTexels; i += 4) {
+		auto *p = reinterpret_cast<__m128i *>(texels + i * 4);
+		_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), mask));
+	}
+#elif defined(__ARM_NEON)
+	auto mask = vdupq_n_u32(0xFF00);
+	for(; i + 4 <= numTexels; i += 4) {
+		auto *p = reinterpret_cast<uint32_t *>(texels + i * 4);
+		vst1q_u32(p, veorq_u32(vld1q_u32(p), mask));
+	}
+#endif
+	for(; i < numTexels; ++i)
+		texels[i * 4 + 1] = (byte)(~texels[i * 4 + 1]); // LegacySource1InvertNormals
+}
+
+void impl::apply_decode_options(uint8_t *texels, size_t numTexels, const TextureDecodeOptions &options, bool rgba)
+{
+	if(options.hemiOctRB) {
+		if(rgba)
+			hemi_oct_rb<true>(texels, numTexels);
+		else
+			hemi_oct_rb<false>(texels, numTexels);
+	}
+	if(options.invert)
+		invert_green(texels, numTexels);
+}
+
+template<uint32_t Mode>
+static void decode_bc7_block(uint64_t block0, uint64_t block64, uint8_t *outTexels)
+{
+	constexpr auto m = Mode;
+	byte pb = 0;
+	byte rb = 0;
+	byte isb = 0;
+	std::array<std::array<uint8_t, 4>, 6> endpoints {};
+	byte epbits = 0;
+	byte spbits = 0;
+	uint64_t ib = 0;
+	uint64_t ib2 = 0;
+
+	if constexpr(m == 0)
+		pb = (byte)(block0 >> 1 & 0xF); //4bit
+	else if constexpr(m == 1 || m == 2 || m == 3 || m == 7)
+		pb = (byte)((block0 >> (m + 1)) & 0x3F); //6bit
+
+	auto readEndpoints = [&](int start, int ns2, int cb, int astart, int ab) {
+		auto getVal = [&](int p, byte vm) -> uint8_t {
+			byte res = 0;
+			if(p < 64) {
+				res = (byte)(block0 >> p & vm);
+				if(p + cb > 64)
+					res |= (byte)(block64 << (64 - p) & vm);
+			}
+			else
+				res = (byte)(block64 >> (p - 64) & vm);
+			return res;
+		};
+
+		auto mask = (byte)((0x1 << cb) - 1);
+		for(int c = 0; c < 3; c++) {
+			for(int s = 0; s < ns2; s++) {
+				int ofs = start + (cb * ((c * ns2) + s));
+				endpoints[s][c] = getVal(ofs, mask);
+				if constexpr(m == 1)
+					endpoints[s][c] = (byte)(endpoints[s][c] << 2 | ((spbits >> (s >> 1) & 1) << 1) | (endpoints[s][c] >> 5));
+				else if constexpr(m == 0 || m == 3 || m == 6 || m == 7)
+					endpoints[s][c] = (byte)(endpoints[s][c] << (8 - cb) | ((epbits >> s & 1) << (7 - cb)) | (endpoints[s][c] >> ((cb * 2) - 7)));
+				else
+					endpoints[s][c] = (byte)(endpoints[s][c] << (8 - cb) | (endpoints[s][c] >> ((cb * 2) - 8)));
+			}
+		}
+
+		if(ab != 0) {
+			mask = (byte)((0x1 << ab) - 1);
+			for(int s = 0; s < ns2; s++) {
+				int ofs = astart + (ab * s);
+				endpoints[s][3] = getVal(ofs, mask);
+				if constexpr(m == 6 || m == 7)
+					endpoints[s][3] = (byte)((endpoints[s][3] << (8 - ab)) | ((epbits >> s & 1) << (7 - ab)) | (endpoints[s][3] >> ((ab * 2) - 7)));
+				else
+					endpoints[s][3] = (byte)((endpoints[s][3] << (8 - ab)) | (endpoints[s][3] >> ((ab * 2) - 8)));
+			}
+		}
+	};
+
+	if constexpr(m == 0) {
+		epbits = (byte)(block64 >> 13 & 0x3F);
+		readEndpoints(5, 6, 4, 0, 0);
+		ib = block64 >> 19;
+	}
+	else if constexpr(m == 1) {
+		spbits = (byte)((block64 >> 16 & 1) | ((block64 >> 17 & 1) << 1));
+		readEndpoints(8, 4, 6, 0, 0);
+		ib = block64 >> 18;
+	}
+	else if constexpr(m == 2) {
+		readEndpoints(9, 6, 5, 0, 0);
+		ib = block64 >> 35;
+	}
+	else if constexpr(m == 3) {
+		epbits = (byte)(block64 >> 30 & 0xF);
+		readEndpoints(10, 4, 7, 0, 0);
+		ib = block64 >> 34;
+	}
+	else if constexpr(m == 4) {
+		rb = (byte)(block0 >> 5 & 0x3);
+		isb = (byte)(block0 >> 7 & 0x1);
+		readEndpoints(8, 2, 5, 38, 6);
+		ib = (block0 >> 50) | (block64 << 14);
+		ib2 = block64 >> 17;
+	}
+	else if constexpr(m == 5) {
+		rb = (byte)((block0 >> 6) & 0x3);
+		readEndpoints(8, 2, 7, 50, 8);
+		ib = block64 >> 2;
+		ib2 = block64 >> 33;
+	}
+	else if constexpr(m == 6) {
+		epbits = (byte)((block0 >> 63) | ((block64 & 1) << 1));
+		readEndpoints(7, 2, 7, 49, 7);
+		ib = block64 >> 1;
+	}
+	else if constexpr(m == 7) {
+		epbits = (byte)(block64 >> 30 & 0xF);
+		readEndpoints(14, 4, 5, 74, 5);
+		ib = block64 >> 34;
+	}
+
+	// Gather the endpoints and weights of every texel, the interpolation itself is done for the entire block at once
+	BlockTexels texels;
+	constexpr int ib2l = (m == 4) ? 3 : 2;
+	for(int io = 0; io < 16; io++) {
+		byte cweight = 0;
+		byte aweight = 0;
+		byte subset = 0;
+
+		int isAnchor = 0;
+		if constexpr(m == 0 || m == 2) { //3 subsets
+			isAnchor = (io == 0 || io == BC7AnchorIndices32[pb] || io == BC7AnchorIndices33[pb]) ? 1 : 0;
+			subset = (byte)(BC7PartitionTable3[pb][io] * 2);
+		}
+		else if constexpr(m == 1 || m == 3 || m == 7) { //2 subsets
+			subset = (byte)(BPTCPartitionTable2[pb][io] * 2);
+			isAnchor = (io == 0 || io == BPTCAnchorIndices2[pb]) ? 1 : 0;
+		}
+		else //1 subset
+			isAnchor = (io == 0) ? 1 : 0;
+
+		if constexpr(m == 0 || m == 1) //3 bit
+			cweight = BPTCWeights3[ib & (0x7u >> isAnchor)];
+		else if constexpr(m == 6) //4 bit
+			cweight = BPTCWeights4[ib & (0xFu >> isAnchor)];
+		else //2 bit
+			cweight = BPTCWeights2[ib & (0x3u >> isAnchor)];
+
+		ib >>= BC7IndLength[m] - isAnchor;
+
+		if constexpr(m == 4) {
+			aweight = BPTCWeights3[ib2 & (0x7u >> isAnchor)];
+			ib2 >>= ib2l - isAnchor;
+
+			if(isb == 1)
+				std::swap(cweight, aweight);
+		}
+		else if constexpr(m == 5) {
+			aweight = BPTCWeights2[ib2 & (0x3u >> isAnchor)];
+			ib2 >>= ib2l - isAnchor;
+		}
+		else if constexpr(m > 5)
+			aweight = cweight;
+
+		auto &e0 = endpoints[subset];
+		auto &e1 = endpoints[subset + 1];
+		auto offset = io * 4;
+		for(auto c = 0u; c < 3u; ++c) {
+			texels.e0[offset + c] = e0[2 - c];
+			texels.e1[offset + c] = e1[2 - c];
+			texels.weights[offset + c] = cweight;
+		}
+		if constexpr(m < 4) {
+			// Interpolating between two fully opaque endpoints always yields 255
+			texels.e0[offset + 3] = std::numeric_limits<uint8_t>::max();
+			texels.e1[offset + 3] = std::numeric_limits<uint8_t>::max();
+			texels.weights[offset + 3] = 0;
+		}
+		else {
+			texels.e0[offset + 3] = e0[3];
+			texels.e1[offset + 3] = e1[3];
+			texels.weights[offset + 3] = aweight;
+		}
+	}
+	bptc_interpolate(texels, outTexels);
+
+	if constexpr(m == 4 || m == 5) {
+		if(rb != 0) {
+			for(auto i = 0u; i < 16u; ++i)
+				std::swap(outTexels[i * 4 + 3], outTexels[i * 4 + 3 - rb]);
+		}
+	}
+}
+
+void impl::decode_bc7_block(const uint8_t *block, uint8_t *outTexels, const TextureDecodeOptions &options)
+{
+	uint64_t block0;
+	uint64_t block64;
+	memcpy(&block0, block, sizeof(block0));
+	memcpy(&block64, block + sizeof(block0), sizeof(block64));
+	// The mode is determined by the position of the lowest set bit
+	switch(std::countr_zero(static_cast<uint8_t>(block0))) {
+	case 0:
+		::decode_bc7_block<0>(block0, block64, outTexels);
+		break;
+	case 1:
+		::decode_bc7_block<1>(block0, block64, outTexels);
+		break;
+	case 2:
+		::decode_bc7_block<2>(block0, block64, outTexels);
+		break;
+	case 3:
+		::decode_bc7_block<3>(block0, block64, outTexels);
+		break;
+	case 4:
+		::decode_bc7_block<4>(block0, block64, outTexels);
+		break;
+	case 5:
+		::decode_bc7_block<5>(block0, block64, outTexels);
+		break;
+	case 6:
+		::decode_bc7_block<6>(block0, block64, outTexels);
+		break;
+	case 7:
+		::decode_bc7_block<7>(block0, block64, outTexels);
+		break;
+	default:
+		// Reserved mode, decodes to transparent black
+		memset(outTexels, 0, 16 * 4);
+		break;
+	}
+	if(options.hemiOctRB || options.invert)
+		apply_decode_options(outTexels, 16, options);
+}
+
+////////////////
+
+static uint32_t expand_bits(uint32_t value, uint32_t numBits) { return (value << (8 - numBits)) | (value >> (2 * numBits - 8)); }
+
+// Decodes the color part of a BC1-BC3 block. If 'allowAlpha' is false, the four color palette is always used (BC2/BC3).
+static void decode_bc1_colors(const uint8_t *block, uint8_t *outTexels, bool allowAlpha)
+{
+	uint16_t c0, c1;
+	uint32_t indices;
+	memcpy(&c0, block, sizeof(c0));
+	memcpy(&c1, block + 2, sizeof(c1));
+	memcpy(&indices, block + 4, sizeof(indices));
+
+	std::array<std::array<uint8_t, 4>, 4> palette;
+	auto toBgra = [](uint16_t c) -> std::array<uint8_t, 4> { return {static_cast<uint8_t>(expand_bits(c & 31, 5)), static_cast<uint8_t>(expand_bits((c >> 5) & 63, 6)), static_cast<uint8_t>(expand_bits(c >> 11, 5)), 255}; };
+	palette[0] = toBgra(c0);
+	palette[1] = toBgra(c1);
+	if(c0 > c1 || !allowAlpha) {
+		for(auto i = 0u; i < 3u; ++i) {
+			palette[2][i] = static_cast<uint8_t>((2 * palette[0][i] + palette[1][i]) / 3);
+			palette[3][i] = static_cast<uint8_t>((palette[0][i] + 2 * palette[1][i]) / 3);
+		}
+		palette[2][3] = palette[3][3] = 255;
+	}
+	else {
+		for(auto i = 0u; i < 3u; ++i)
+			palette[2][i] = static_cast<uint8_t>((palette[0][i] + palette[1][i]) / 2);
+		palette[2][3] = 255;
+		palette[3] = {0, 0, 0, 0};
+	}
+	for(auto i = 0u; i < 16u; ++i)
+		memcpy(outTexels + i * 4, palette[(indices >> (i * 2)) & 3].data(), 4);
+}
+
+// Decodes a BC4 block into every 'stride'-th byte of the output
+static void decode_bc4_channel(const uint8_t *block, uint8_t *out, uint32_t stride)
+{
+	uint32_t a0 = block[0];
+	uint32_t a1 = block[1];
+	std::array<uint8_t, 8> palette;
+	palette[0] = static_cast<uint8_t>(a0);
+	palette[1] = static_cast<uint8_t>(a1);
+	if(a0 > a1) {
+		for(auto i = 1u; i < 7u; ++i)
+			palette[i + 1] = static_cast<uint8_t>(((7 - i) * a0 + i * a1 + 3) / 7);
+	}
+	else {
+		for(auto i = 1u; i < 5u; ++i)
+			palette[i + 1] = static_cast<uint8_t>(((5 - i) * a0 + i * a1 + 2) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	uint64_t indices = 0;
+	memcpy(&indices, block + 2, 6);
+	for(auto i = 0u; i < 16u; ++i)
+		out[i * stride] = palette[(indices >> (i * 3)) & 7];
+}
+
+// Decodes a signed BC4 block into every 'stride'-th byte of the output, the values are remapped from [-1, 1] to [0, 255]
+static void decode_bc4_snorm_channel(const uint8_t *block, uint8_t *out, uint32_t stride)
+{
+	// -128 and -127 both represent -1
+	auto a0 = std::max<int32_t>(static_cast<int8_t>(block[0]), -127);
+	auto a1 = std::max<int32_t>(static_cast<int8_t>(block[1]), -127);
+	std::array<float, 8> values;
+	values[0] = static_cast<float>(a0);
+	values[1] = static_cast<float>(a1);
+	if(a0 > a1) {
+		for(auto i = 1; i < 7; ++i)
+			values[i + 1] = static_cast<float>((7 - i) * a0 + i * a1) / 7.f;
+	}
+	else {
+		for(auto i = 1; i < 5; ++i)
+			values[i + 1] = static_cast<float>((5 - i) * a0 + i * a1) / 5.f;
+		values[6] = -127.f;
+		values[7] = 127.f;
+	}
+	std::array<uint8_t, 8> palette;
+	for(auto i = 0u; i < palette.size(); ++i)
+		palette[i] = static_cast<uint8_t>(std::lround((values[i] + 127.f) * (255.f / 254.f)));
+	uint64_t indices = 0;
+	memcpy(&indices, block + 2, 6);
+	for(auto i = 0u; i < 16u; ++i)
+		out[i * stride] = palette[(indices >> (i * 3)) & 7];
+}
+
+static void decode_bc1_block(const uint8_t *block, uint8_t *outTexels) { decode_bc1_colors(block, outTexels, true); }
+static void decode_bc3_block(const uint8_t *block, uint8_t *outTexels)
+{
+	decode_bc1_colors(block + 8, outTexels, false);
+	decode_bc4_channel(block, outTexels + 3, 4);
+}
+static void decode_bc4_block(const uint8_t *block, uint8_t *outTexels)
+{
+	decode_bc4_channel(block, outTexels + 2, 4);
+	for(auto i = 0u; i < 16u; ++i) {
+		auto *texel = outTexels + i * 4;
+		texel[0] = texel[1] = texel[2];
+		texel[3] = 255;
+	}
+}
+static void decode_bc5_block(const uint8_t *block, uint8_t *outTexels)
+{
+	decode_bc4_channel(block, outTexels + 2, 4);
+	decode_bc4_channel(block + 8, outTexels + 1, 4);
+	for(auto i = 0u; i < 16u; ++i) {
+		outTexels[i * 4] = 0;
+		outTexels[i * 4 + 3] = 255;
+	}
+}
+static void decode_bc4_snorm_block(const uint8_t *block, uint8_t *outTexels)
+{
+	decode_bc4_snorm_channel(block, outTexels + 2, 4);
+	for(auto i = 0u; i < 16u; ++i) {
+		auto *texel = outTexels + i * 4;
+		texel[0] = texel[1] = texel[2];
+		texel[3] = 255;
+	}
+}
+static void decode_bc5_snorm_block(const uint8_t *block, uint8_t *outTexels)
+{
+	decode_bc4_snorm_channel(block, outTexels + 2, 4);
+	decode_bc4_snorm_channel(block + 8, outTexels + 1, 4);
+	for(auto i = 0u; i < 16u; ++i) {
+		outTexels[i * 4] = 0;
+		outTexels[i * 4 + 3] = 255;
+	}
+}
+
+////////////////
+
+namespace {
+	// Reads bits from a 128-bit block, starting at the least significant bit
+	class BlockBitReader {
+	  public:
+		BlockBitReader(const uint8_t *block)
+		{
+			memcpy(&m_lo, block, sizeof(m_lo));
+			memcpy(&m_hi, block + sizeof(m_lo), sizeof(m_hi));
+		}
+		uint32_t Read(uint32_t numBits)
+		{
+			uint64_t value;
+			if(m_pos >= 64)
+				value = m_hi >> (m_pos - 64);
+			else if(m_pos + numBits <= 64)
+				value = m_lo >> m_pos;
+			else
+				value = (m_lo >> m_pos) | (m_hi << (64 - m_pos));
+			m_pos += numBits;
+			return static_cast<uint32_t>(value & ((uint64_t {1} << numBits) - 1));
+		}
+		// Reads bits in reverse order, i.e. the first bit read becomes the most significant one
+		uint32_t ReadReversed(uint32_t numBits)
+		{
+			uint32_t value = 0;
+			for(auto i = 0u; i < numBits; ++i)
+				value |= Read(1) << (numBits - 1 - i);
+			return value;
+		}
+	  private:
+		uint64_t m_lo = 0;
+		uint64_t m_hi = 0;
+		uint32_t m_pos = 0;
+	};
+
+	struct BC6HModeInfo {
+		uint8_t endpointBits;
+		std::array<uint8_t, 3> deltaBits;
+		bool transformed;
+		uint8_t numRegions;
+	};
+};
+
+static std::array<uint8_t, 8> BC6HWeights3 = {0, 9, 18, 27, 37, 46, 55, 64};
+
+static int32_t sign_extend(int32_t value, uint32_t numBits)
+{
+	auto shift = 32 - numBits;
+	return static_cast<int32_t>(static_cast<uint32_t>(value) << shift) >> shift;
+}
+
+// Reads the endpoints of a BC6H block, returns false for reserved modes
+static bool read_bc6h_endpoints(BlockBitReader &reader, std::array<std::array<int32_t, 3>, 4> &endpoints, BC6HModeInfo &outInfo)
+{
+	auto &e = endpoints;
+	// Reads 'numBits' bits into channel 'c' of endpoint 'i', starting at bit 'shift'
+	auto bits = [&reader, &e](uint32_t i, uint32_t c, uint32_t shift, uint32_t numBits) { e[i][c] |= static_cast<int32_t>(reader.Read(numBits) << shift); };
+	auto bitsReversed = [&reader, &e](uint32_t i, uint32_t c, uint32_t shift, uint32_t numBits) { e[i][c] |= static_cast<int32_t>(reader.ReadReversed(numBits) << shift); };
+	constexpr uint32_t r = 0, g = 1, b = 2;
+	auto mode = reader.Read(2);
+	if(mode > 1)
+		mode |= reader.Read(3) << 2;
+	switch(mode) {
+	case 0x00:
+		outInfo = {10, {5, 5, 5}, true, 2};
+		bits(2, g, 4, 1);
+		bits(2, b, 4, 1);
+		bits(3, b, 4, 1);
+		bits(0, r, 0, 10);
+		bits(0, g, 0, 10);
+		bits(0, b, 0, 10);
+		bits(1, r, 0, 5);
+		bits(3, g, 4, 1);
+		bits(2, g, 0, 4);
+		bits(1, g, 0, 5);
+		bits(3, b, 0, 1);
+		bits(3, g, 0, 4);
+		bits(1, b, 0, 5);
+		bits(3, b, 1, 1);
+		bits(2, b, 0, 4);
+		bits(2, r, 0, 5);
+		bits(3, b, 2, 1);
+		bits(3, r, 0, 5);
+		bits(3, b, 3, 1);
+		break;
+	case 0x01:
+		outInfo = {7, {6, 6, 6}, true, 2};
+		bits(2, g, 5, 1);
+		bits(3, g, 4, 1);
+		bits(3, g, 5, 1);
+		bits(0, r, 0, 7);
+		bits(3, b, 0, 1);
+		bits(3, b, 1, 1);
+		bits(2, b, 4, 1);
+		bits(0, g, 0, 7);
+		bits(2, b, 5, 1);
+		bits(3, b, 2, 1);
+		bits(2, g, 4, 1);
+		bits(0, b, 0, 7);
+		bits(3, b, 3, 1);
+		bits(3, b, 5, 1);
+		bits(3, b, 4, 1);
+		bits(1, r, 0, 6);
+		bits(2, g, 0, 4);
+		bits(1, g, 0, 6);
+		bits(3, g, 0, 4);
+		bits(1, b, 0, 6);
+		bits(2, b, 0, 4);
+		bits(2, r, 0, 6);
+		bits(3, r, 0, 6);
+		break;
+	case 0x02:
+		outInfo = {11, {5, 4, 4}, true, 2};
+		bits(0, r, 0, 10);
+		bits(0, g, 0, 10);
+		bits(0, b, 0, 10);
+		bits(1, r, 0, 5);
+		bits(0, r, 10, 1);
+		bits(2, g, 0, 4);
+		bits(1, g, 0, 4);
+		bits(0, g, 10, 1);
+		bits(3, b, 0, 1);
+		bits(3, g, 0, 4);
+		bits(1, b, 0, 4);
+		bits(0, b, 10, 1);
+		bits(3, b, 1, 1);
+		bits(2, b, 0, 4);
+		bits(2, r, 0, 5);
+		bits(3, b, 2, 1);
+		bits(3, r, 0, 5);
+		bits(3, b, 3, 1);
+		break;
+	case 0x06:
+		outInfo = {11, {4, 5, 4}, true, 2};
+		bits(0, r, 0, 10);
+		bits(0, g, 0, 10);
+		bits(0, b, 0, 10);
+		bits(1, r, 0, 4);
+		bits(0, r, 10, 1);
+		bits(3, g, 4, 1);
+		bits(2, g, 0, 4);
+		bits(1, g, 0, 5);
+		bits(0, g, 10, 1);
+		bits(3, g, 0, 4);
+		bits(1, b, 0, 4);
+		bits(0, b, 10, 1);
+		bits(3, b, 1, 1);
+		bits(2, b, 0, 4);
+		bits(2, r, 0, 4);
+		bits(3, b, 0, 1);
+		bits(3, b, 2, 1);
+		bits(3, r, 0, 4);
+		bits(2, g, 4, 1);
+		bits(3, b, 3, 1);
+		break;
+	case 0x0a:
+		outInfo = {11, {4, 4, 5}, true, 2};
+		bits(0, r, 0, 10);
+		bits(0, g, 0, 10);
+		bits(0, b, 0, 10);
+		bits(1, r, 0, 4);
+		bits(0, r, 10, 1);
+		bits(2, b, 4, 1);
+		bits(2, g, 0, 4);
+		bits(1, g, 0, 4);
+		bits(0, g, 10, 1);
+		bits(3, b, 0, 1);
+		bits(3, g, 0, 4);
+		bits(1, b, 0, 5);
+		bits(0, b, 10, 1);
+		bits(2, b, 0, 4);
+		bits(2, r, 0, 4);
+		bits(3, b, 1, 1);
+		bits(3, b, 2, 1);
+		bits(3, r, 0, 4);
+		bits(3, b, 4, 1);
+		bits(3, b, 3, 1);
+		break;
+	case 0x0e:
+		outInfo = {9, {5, 5, 5}, true, 2};
+		bits(0, r, 0, 9);
+		bits(2, b, 4, 1);
+		bits(0, g, 0, 9);
+		bits(2, g, 4, 1);
+		bits(0, b, 0, 9);
+		bits(3, b, 4, 1);
+		bits(1, r, 0, 5);
+		bits(3, g, 4, 1);
+		bits(2, g, 0, 4);
+		bits(1, g, 0, 5);
+		bits(3, b, 0, 1);
+		bits(3, g, 0, 4);
+		bits(1, b, 0, 5);
+		bits(3, b, 1, 1);
+		bits(2, b, 0, 4);
+		bits(2, r, 0, 5);
+		bits(3, b, 2, 1);
+		bits(3, r, 0, 5);
+		bits(3, b, 3, 1);
+		break;
+	case 0x12:
+		outInfo = {8, {6, 5, 5}, true, 2};
+		bits(0, r, 0, 8);
+		bits(3, g, 4, 1);
+		bits(2, b, 4, 1);
+		bits(0, g, 0, 8);
+		bits(3, b, 2, 1);
+		bits(2, g, 4, 1);
+		bits(0, b, 0, 8);
+		bits(3, b, 3, 1);
+		bits(3, b, 4, 1);
+		bits(1, r, 0, 6);
+		bits(2, g, 0, 4);
+		bits(1, g, 0, 5);
+		bits(3, b, 0, 1);
+		bits(3, g, 0, 4);
+		bits(1, b, 0, 5);
+		bits(3, b, 1, 1);
+		bits(2, b, 0, 4);
+		bits(2, r, 0, 6);
+		bits(3, r, 0, 6);
+		break;
+	case 0x16:
+		outInfo = {8, {5, 6, 5}, true, 2};
+		bits(0, r, 0, 8);
+		bits(3, b, 0, 1);
+		bits(2, b, 4, 1);
+		bits(0, g, 0, 8);
+		bits(2, g, 5, 1);
+		bits(2, g, 4, 1);
+		bits(0, b, 0, 8);
+		bits(3, g, 5, 1);
+		bits(3, b, 4, 1);
+		bits(1, r, 0, 5);
+		bits(3, g, 4, 1);
+		bits(2, g, 0, 4);
+		bits(1, g, 0, 6);
+		bits(3, g, 0, 4);
+		bits(1, b, 0, 5);
+		bits(3, b, 1, 1);
+		bits(2, b, 0, 4);
+		bits(2, r, 0, 5);
+		bits(3, b, 2, 1);
+		bits(3, r, 0, 5);
+		bits(3, b, 3, 1);
+		break;
+	case 0x1a:
+		outInfo = {8, {5, 5, 6}, true, 2};
+		bits(0, r, 0, 8);
+		bits(3, b, 1, 1);
+		bits(2, b, 4, 1);
+		bits(0, g, 0, 8);
+		bits(2, b, 5, 1);
+		bits(2, g, 4, 1);
+		bits(0, b, 0, 8);
+		bits(3, b, 5, 1);
+		bits(3, b, 4, 1);
+		bits(1, r, 0, 5);
+		bits(3, g, 4, 1);
+		bits(2, g, 0, 4);
+		bits(1, g, 0, 5);
+		bits(3, b, 0, 1);
+		bits(3, g, 0, 4);
+		bits(1, b, 0, 6);
+		bits(2, b, 0, 4);
+		bits(2, r, 0, 5);
+		bits(3, b, 2, 1);
+		bits(3, r, 0, 5);
+		bits(3, b, 3, 1);
+		break;
+	case 0x1e:
+		outInfo = {6, {6, 6, 6}, false, 2};
+		bits(0, r, 0, 6);
+		bits(3, g, 4, 1);
+		bits(3, b, 0, 1);
+		bits(3, b, 1, 1);
+		bits(2, b, 4, 1);
+		bits(0, g, 0, 6);
+		bits(2, g, 5, 1);
+		bits(2, b, 5, 1);
+		bits(3, b, 2, 1);
+		bits(2, g, 4, 1);
+		bits(0, b, 0, 6);
+		bits(3, g, 5, 1);
+		bits(3, b, 3, 1);
+		bits(3, b, 5, 1);
+		bits(3, b, 4, 1);
+		bits(1, r, 0, 6);
+		bits(2, g, 0, 4);
+		bits(1, g, 0, 6);
+		bits(3, g, 0, 4);
+		bits(1, b, 0, 6);
+		bits(2, b, 0, 4);
+		bits(2, r, 0, 6);
+		bits(3, r, 0, 6);
+		break;
+	case 0x03:
+		outInfo = {10, {10, 10, 10}, false, 1};
+		for(auto i = 0u; i < 2u; ++i) {
+			bits(i, r, 0, 10);
+			bits(i, g, 0, 10);
+			bits(i, b, 0, 10);
+		}
+		break;
+	case 0x07:
+	case 0x0b:
+	case 0x0f:
+		{
+			// The endpoint bits exceeding 10 bits are stored after the delta of each channel
+			if(mode == 0x07)
+				outInfo = {11, {9, 9, 9}, true, 1};
+			else if(mode == 0x0b)
+				outInfo = {12, {8, 8, 8}, true, 1};
+			else
+				outInfo = {16, {4, 4, 4}, true, 1};
+			auto deltaBits = outInfo.deltaBits[0];
+			bits(0, r, 0, 10);
+			bits(0, g, 0, 10);
+			bits(0, b, 0, 10);
+			auto numExtraBits = outInfo.endpointBits - 10u;
+			for(auto c = 0u; c < 3u; ++c) {
+				bits(1, c, 0, deltaBits);
+				if(numExtraBits == 1)
+					bits(0, c, 10, 1);
+				else
+					bitsReversed(0, c, 10, numExtraBits);
+			}
+			break;
+		}
+	default:
+		return false;
+	}
+	return true;
+}
+
+static uint16_t unquantize_bc6h(int32_t value, uint32_t numBits)
+{
+	if(numBits >= 15 || value == 0)
+		return static_cast<uint16_t>(value);
+	if(value == (1 << numBits) - 1)
+		return 0xFFFF;
+	return static_cast<uint16_t>(((value << 16) + 0x8000) >> numBits);
+}
+
+static int32_t unquantize_bc6h_signed(int32_t value, uint32_t numBits)
+{
+	if(numBits >= 16)
+		return value;
+	auto negative = value < 0;
+	if(negative)
+		value = -value;
+	int32_t result;
+	if(value == 0)
+		result = 0;
+	else if(value >= (1 << (numBits - 1)) - 1)
+		result = 0x7FFF;
+	else
+		result = ((value << 15) + 0x4000) >> (numBits - 1);
+	return negative ? -result : result;
+}
+
+// Scales an interpolated signed value to the half-float range, the sign is stored separately
+static uint16_t finish_bc6h_signed(int32_t value)
+{
+	if(value < 0)
+		return static_cast<uint16_t>(0x8000 | (((-value) * 31) >> 5));
+	return static_cast<uint16_t>((value * 31) >> 5);
+}
+
+// Decodes an unsigned (BC6H_UF16) or signed (BC6H_SF16) block into 4x4 RGBA16F texels
+static void decode_bc6h_block(const uint8_t *block, uint8_t *outTexels, bool isSigned)
+{
+	BlockBitReader reader {block};
+	std::array<std::array<int32_t, 3>, 4> endpoints {};
+	BC6HModeInfo info;
+	auto *out = reinterpret_cast<uint16_t *>(outTexels);
+	if(!read_bc6h_endpoints(reader, endpoints, info)) {
+		// Reserved modes decode to black
+		for(auto i = 0u; i < 16u; ++i) {
+			out[i * 4] = out[i * 4 + 1] = out[i * 4 + 2] = 0;
+			out[i * 4 + 3] = 0x3C00;
+		}
+		return;
+	}
+	auto numEndpoints = info.numRegions * 2u;
+	auto partition = (info.numRegions == 2) ? reader.Read(5) : 0u;
+	auto mask = (1 << info.endpointBits) - 1;
+	for(auto c = 0u; c < 3u; ++c) {
+		if(isSigned)
+			endpoints[0][c] = sign_extend(endpoints[0][c], info.endpointBits);
+		for(auto i = 1u; i < numEndpoints; ++i) {
+			if(info.transformed)
+				endpoints[i][c] = (endpoints[0][c] + sign_extend(endpoints[i][c], info.deltaBits[c])) & mask;
+			if(isSigned)
+				endpoints[i][c] = sign_extend(endpoints[i][c], info.endpointBits);
+		}
+		for(auto i = 0u; i < numEndpoints; ++i)
+			endpoints[i][c] = isSigned ? unquantize_bc6h_signed(endpoints[i][c], info.endpointBits) : unquantize_bc6h(endpoints[i][c], info.endpointBits);
+	}
+
+	auto indexBits = (info.numRegions == 2) ? 3u : 4u;
+	auto anchor = (info.numRegions == 2) ? BPTCAnchorIndices2[partition] : 0u;
+	for(auto i = 0u; i < 16u; ++i) {
+		auto numBits = (i == 0 || i == anchor) ? (indexBits - 1) : indexBits;
+		auto index = reader.Read(numBits);
+		auto weight = (indexBits == 3) ? BC6HWeights3[index] : BPTCWeights4[index];
+		auto region = (info.numRegions == 2) ? BPTCPartitionTable2[partition][i] : 0u;
+		auto &e0 = endpoints[region * 2];
+		auto &e1 = endpoints[region * 2 + 1];
+		for(auto c = 0u; c < 3u; ++c) {
+			auto value = (e0[c] * (64 - weight) + e1[c] * weight + 32) >> 6;
+			// Scale to the half-float range
+			out[i * 4 + c] = isSigned ? finish_bc6h_signed(value) : static_cast<uint16_t>((value * 31) >> 6);
+		}
+		out[i * 4 + 3] = 0x3C00;
+	}
+}
+static void decode_bc6h_block(const uint8_t *block, uint8_t *outTexels) { decode_bc6h_block(block, outTexels, false); }
+static void decode_bc6h_sf16_block(const uint8_t *block, uint8_t *outTexels) { decode_bc6h_block(block, outTexels, true); }
+
+////////////////
+
+static std::array<std::array<int32_t, 4>, 8> ETC1Modifiers {
+  std::array<int32_t, 4> {2, 8, -2, -8},
+  {5, 17, -5, -17},
+  {9, 29, -9, -29},
+  {13, 42, -13, -42},
+  {18, 60, -18, -60},
+  {24, 80, -24, -80},
+  {33, 106, -33, -106},
+  {47, 183, -47, -183},
+};
+static std::array<int32_t, 8> ETC2Distances = {3, 6, 11, 16, 23, 32, 41, 64};
+static std::array<std::array<int32_t, 8>, 16> EACModifiers {
+  std::array<int32_t, 8> {-3, -6, -9, -15, 2, 5, 8, 14},
+  {-3, -7, -10, -13, 2, 6, 9, 12},
+  {-2, -5, -8, -13, 1, 4, 7, 12},
+  {-2, -4, -6, -13, 1, 3, 5, 12},
+  {-3, -6, -8, -12, 2, 5, 7, 11},
+  {-3, -7, -9, -11, 2, 6, 8, 10},
+  {-4, -7, -8, -11, 3, 6, 7, 10},
+  {-3, -5, -8, -11, 2, 4, 7, 10},
+  {-2, -6, -8, -10, 1, 5, 7, 9},
+  {-2, -5, -8, -10, 1, 4, 7, 9},
+  {-2, -4, -8, -10, 1, 3, 7, 9},
+  {-2, -5, -7, -10, 1, 4, 6, 9},
+  {-3, -4, -7, -10, 2, 3, 6, 9},
+  {-1, -2, -3, -10, 0, 1, 2, 9},
+  {-4, -6, -8, -9, 3, 5, 7, 8},
+  {-3, -5, -7, -9, 2, 4, 6, 8},
+};
+
+static uint64_t read_big_endian_u64(const uint8_t *data)
+{
+	uint64_t value = 0;
+	for(auto i = 0u; i < 8u; ++i)
+		value = (value << 8) | data[i];
+	return value;
+}
+static uint8_t clamp_u8(int32_t value) { return static_cast<uint8_t>(std::clamp(value, 0, 255)); }
+
+// Decodes an ETC1/ETC2 RGB block into 4x4 BGRA8 texels (alpha is not written)
+static void decode_etc2_colors(const uint8_t *block, uint8_t *outTexels)
+{
+	auto bits = read_big_endian_u64(block);
+	auto hi = static_cast<uint32_t>(bits >> 32);
+	auto lo = static_cast<uint32_t>(bits);
+	// ETC texels are stored column by column
+	auto getIndex = [lo](uint32_t x, uint32_t y) {
+		auto i = x * 4 + y;
+		return (((lo >> (i + 16)) & 1) << 1) | ((lo >> i) & 1);
+	};
+	auto setTexel = [outTexels](uint32_t x, uint32_t y, int32_t r, int32_t g, int32_t b) {
+		auto *texel = outTexels + (y * 4 + x) * 4;
+		texel[0] = clamp_u8(b);
+		texel[1] = clamp_u8(g);
+		texel[2] = clamp_u8(r);
+	};
+	auto field = [hi](uint32_t shift, uint32_t numBits) { return static_cast<int32_t>((hi >> shift) & ((1u << numBits) - 1)); };
+
+	auto diff = (hi & 2) != 0;
+	std::array<std::array<int32_t, 3>, 2> baseColors;
+	if(diff) {
+		std::array<int32_t, 3> base {field(27, 5), field(19, 5), field(11, 5)};
+		std::array<int32_t, 3> second {base[0] + sign_extend(field(24, 3), 3), base[1] + sign_extend(field(16, 3), 3), base[2] + sign_extend(field(8, 3), 3)};
+		if(second[0] < 0 || second[0] > 31) {
+			// T mode
+			std::array<std::array<int32_t, 3>, 2> colors {
+			  std::array<int32_t, 3> {(field(27, 2) << 2) | field(24, 2), field(20, 4), field(16, 4)},
+			  std::array<int32_t, 3> {field(12, 4), field(8, 4), field(4, 4)},
+			};
+			for(auto &color : colors) {
+				for(auto &c : color)
+					c = static_cast<int32_t>(expand_bits(c, 4));
+			}
+			auto d = ETC2Distances[(field(2, 2) << 1) | field(0, 1)];
+			std::array<std::array<int32_t, 3>, 4> paint {colors[0], colors[1], colors[1], colors[1]};
+			for(auto c = 0u; c < 3u; ++c) {
+				paint[1][c] += d;
+				paint[3][c] -= d;
+			}
+			for(auto y = 0u; y < 4u; ++y) {
+				for(auto x = 0u; x < 4u; ++x) {
+					auto &p = paint[getIndex(x, y)];
+					setTexel(x, y, p[0], p[1], p[2]);
+				}
+			}
+			return;
+		}
+		if(second[1] < 0 || second[1] > 31) {
+			// H mode
+			std::array<std::array<int32_t, 3>, 2> colors {
+			  std::array<int32_t, 3> {field(27, 4), (field(24, 3) << 1) | field(20, 1), (field(19, 1) << 3) | (field(16, 2) << 1) | field(15, 1)},
+			  std::array<int32_t, 3> {field(11, 4), (field(8, 3) << 1) | field(7, 1), field(3, 4)},
+			};
+			auto distanceIndex = (field(2, 1) << 2) | (field(0, 1) << 1);
+			if(((colors[0][0] << 8) | (colors[0][1] << 4) | colors[0][2]) >= ((colors[1][0] << 8) | (colors[1][1] << 4) | colors[1][2]))
+				distanceIndex |= 1;
+			for(auto &color : colors) {
+				for(auto &c : color)
+					c = static_cast<int32_t>(expand_bits(c, 4));
+			}
+			auto d = ETC2Distances[distanceIndex];
+			std::array<std::array<int32_t, 3>, 4> paint {colors[0], colors[0], colors[1], colors[1]};
+			for(auto c = 0u; c < 3u; ++c) {
+				paint[0][c] += d;
+				paint[1][c] -= d;
+				paint[2][c] += d;
+				paint[3][c] -= d;
+			}
+			for(auto y = 0u; y < 4u; ++y) {
+				for(auto x = 0u; x < 4u; ++x) {
+					auto &p = paint[getIndex(x, y)];
+					setTexel(x, y, p[0], p[1], p[2]);
+				}
+			}
+			return;
+		}
+		if(second[2] < 0 || second[2] > 31) {
+			// Planar mode
+			auto lowField = [lo](uint32_t shift, uint32_t numBits) { return static_cast<int32_t>((lo >> shift) & ((1u << numBits) - 1)); };
+			std::array<int32_t, 3> o {field(25, 6), (field(24, 1) << 6) | field(17, 6), (field(16, 1) << 5) | (field(11, 2) << 3) | field(7, 3)};
+			std::array<int32_t, 3> h {(field(2, 5) << 1) | field(0, 1), lowField(25, 7), lowField(19, 6)};
+			std::array<int32_t, 3> v {lowField(13, 6), lowField(6, 7), lowField(0, 6)};
+			for(auto *color : {&o, &h, &v}) {
+				(*color)[0] = static_cast<int32_t>(expand_bits((*color)[0], 6));
+				(*color)[1] = static_cast<int32_t>(expand_bits((*color)[1], 7));
+				(*color)[2] = static_cast<int32_t>(expand_bits((*color)[2], 6));
+			}
+			for(auto y = 0; y < 4; ++y) {
+				for(auto x = 0; x < 4; ++x) {
+					std::array<int32_t, 3> color;
+					for(auto c = 0u; c < 3u; ++c)
+						color[c] = (x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2;
+					setTexel(x, y, color[0], color[1], color[2]);
+				}
+			}
+			return;
+		}
+		for(auto c = 0u; c < 3u; ++c) {
+			baseColors[0][c] = static_cast<int32_t>(expand_bits(base[c], 5));
+			baseColors[1][c] = static_cast<int32_t>(expand_bits(second[c], 5));
+		}
+	}
+	else {
+		for(auto c = 0u; c < 3u; ++c) {
+			baseColors[0][c] = static_cast<int32_t>(expand_bits(field(28 - c * 8, 4), 4));
+			baseColors[1][c] = static_cast<int32_t>(expand_bits(field(24 - c * 8, 4), 4));
+		}
+	}
+	auto flip = (hi & 1) != 0;
+	std::array<uint32_t, 2> tables {static_cast<uint32_t>(field(5, 3)), static_cast<uint32_t>(field(2, 3))};
+	for(auto y = 0u; y < 4u; ++y) {
+		for(auto x = 0u; x < 4u; ++x) {
+			auto subBlock = flip ? (y >= 2 ? 1u : 0u) : (x >= 2 ? 1u : 0u);
+			auto &base = baseColors[subBlock];
+			auto modifier = ETC1Modifiers[tables[subBlock]][getIndex(x, y)];
+			setTexel(x, y, base[0] + modifier, base[1] + modifier, base[2] + modifier);
+		}
+	}
+}
+
+// Decodes an EAC block into every 'stride'-th byte of the output
+static void decode_eac_channel(const uint8_t *block, uint8_t *out, uint32_t stride)
+{
+	auto bits = read_big_endian_u64(block);
+	auto base = static_cast<int32_t>(bits >> 56);
+	auto multiplier = static_cast<int32_t>((bits >> 52) & 15);
+	auto &modifiers = EACModifiers[(bits >> 48) & 15];
+	for(auto x = 0u; x < 4u; ++x) {
+		for(auto y = 0u; y < 4u; ++y) {
+			auto index = (bits >> (45 - (x * 4 + y) * 3)) & 7;
+			out[(y * 4 + x) * stride] = clamp_u8(base + modifiers[index] * multiplier);
+		}
+	}
+}
+
+static void decode_etc2_block(const uint8_t *block, uint8_t *outTexels)
+{
+	decode_etc2_colors(block, outTexels);
+	for(auto i = 0u; i < 16u; ++i)
+		outTexels[i * 4 + 3] = 255;
+}
+static void decode_etc2_eac_block(const uint8_t *block, uint8_t *outTexels)
+{
+	decode_etc2_colors(block + 8, outTexels);
+	decode_eac_channel(block, outTexels + 3, 4);
+}
+
+////////////////
+
+uint32_t impl::get_block_size(BlockFormat format)
+{
+	switch(format) {
+	case BlockFormat::BC1:
+	case BlockFormat::BC4:
+	case BlockFormat::BC4_SNORM:
+	case BlockFormat::ETC2:
+		return 8;
+	default:
+		return 16;
+	}
+}
+uint32_t impl::get_decoded_texel_size(BlockFormat format) { return (format == BlockFormat::BC6H || format == BlockFormat::BC6H_SF16) ? 8 : 4; }
+
+using BlockDecoder = void (*)(const uint8_t *, uint8_t *);
+static BlockDecoder get_block_decoder(impl::BlockFormat format)
+{
+	switch(format) {
+	case impl::BlockFormat::BC1:
+		return decode_bc1_block;
+	case impl::BlockFormat::BC3:
+		return decode_bc3_block;
+	case impl::BlockFormat::BC4:
+		return decode_bc4_block;
+	case impl::BlockFormat::BC5:
+		return decode_bc5_block;
+	case impl::BlockFormat::BC6H:
+		return decode_bc6h_block;
+	case impl::BlockFormat::BC7:
+		// Decode options are applied by decode_block_rows
+		return [](const uint8_t *block, uint8_t *outTexels) { impl::decode_bc7_block(block, outTexels, {}); };
+	case impl::BlockFormat::ETC2:
+		return decode_etc2_block;
+	case impl::BlockFormat::ETC2_EAC:
+		return decode_etc2_eac_block;
+	case impl::BlockFormat::BC4_SNORM:
+		return decode_bc4_snorm_block;
+	case impl::BlockFormat::BC5_SNORM:
+		return decode_bc5_snorm_block;
+	case impl::BlockFormat::BC6H_SF16:
+		return decode_bc6h_sf16_block;
+	}
+	return nullptr;
+}
+
+void impl::decode_block_rows(BlockFormat format, std::span<const uint8_t> input, uint8_t *output, size_t rowPitch, uint32_t width, uint32_t height, uint32_t blockRowStart, uint32_t blockRowEnd, const TextureDecodeOptions &options)
+{
+	auto decodeBlock = get_block_decoder(format);
+	auto blockSize = get_block_size(format);
+	auto texelSize = get_decoded_texel_size(format);
+	auto blockCountX = (width + 3) / 4;
+	auto blockCountY = (height + 3) / 4;
+	if(input.size() < static_cast<size_t>(blockCountX) * blockCountY * blockSize)
+		throw std::runtime_error {"Insufficient block-compressed input data"};
+	blockRowEnd = std::min(blockRowEnd, blockCountY);
+	auto applyOptions = (options.hemiOctRB || options.invert) && texelSize == 4;
+	alignas(16) std::array<uint8_t, 16 * 8> texels;
+	for(auto j = blockRowStart; j < blockRowEnd; ++j) {
+		auto *blockRow = input.data() + static_cast<size_t>(j) * blockCountX * blockSize;
+		auto numRows = std::min(4u, height - j * 4);
+		for(auto i = decltype(blockCountX) {0u}; i < blockCountX; ++i) {
+			decodeBlock(blockRow + i * blockSize, texels.data());
+			if(applyOptions)
+				apply_decode_options(texels.data(), 16, options);
+			auto numCols = std::min(4u, width - i * 4);
+			for(auto by = 0u; by < numRows; ++by)
+				memcpy(output + (static_cast<size_t>(j) * 4 + by) * rowPitch + static_cast<size_t>(i) * 4 * texelSize, texels.data() + by * 4 * texelSize, numCols * texelSize);
+		}
+	}
+}
+
+void impl::decode_blocks(BlockFormat format, std::span<const uint8_t> input, uint8_t *output, size_t rowPitch, uint32_t width, uint32_t height, const TextureDecodeOptions &options, uint32_t numThreads)
+{
+	numThreads = std::max(numThreads, 1u);
+	auto blockCountY = (height + 3) / 4;
+	if(numThreads == 1 || blockCountY <= 1) {
+		decode_block_rows(format, input, output, rowPitch, width, height, 0, blockCountY, options);
+		return;
+	}
+	ThreadPool threadPool {numThreads - 1};
+	decode_blocks(format, input, output, rowPitch, width, height, options, threadPool);
+}
+void impl::decode_blocks(BlockFormat format, std::span<const uint8_t> input, uint8_t *output, size_t rowPitch, uint32_t width, uint32_t height, const TextureDecodeOptions &options, ThreadPool &threadPool)
+{
+	auto blockCountY = (height + 3) / 4;
+	// Split into a few more chunks than threads to balance out uneven workloads
+	auto numChunks = std::max(std::min(blockCountY, (threadPool.GetWorkerCount() + 1) * 4), 1u);
+	auto rowsPerChunk = (blockCountY + numChunks - 1) / numChunks;
+	TaskGroup taskGroup {threadPool};
+	for(auto start = 0u; start < blockCountY; start += rowsPerChunk) {
+		auto end = std::min(start + rowsPerChunk, blockCountY);
+		taskGroup.Run([=, &input, &options]() { decode_block_rows(format, input, output, rowPitch, width, height, start, end, options); });
+	}
+	taskGroup.Wait();
+}
@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+export module source2:texture_decoder;
+
+export import std.compat;
+import :thread_pool;
+
+export namespace source2::impl {
+	struct TextureDecodeOptions {
+		bool hemiOctRB = false;
+		bool invert = false;
+	};
+
+	enum class BlockFormat : uint8_t {
+		BC1,
+		BC3,
+		BC4,
+		BC5,
+		BC6H,
+		BC7,
+		ETC2,
+		ETC2_EAC,
+		// Signed variants, which aren't used by texture resources. Signed BC4 and BC5 channels are remapped from [-1, 1] to [0, 255].
+		BC4_SNORM,
+		BC5_SNORM,
+		BC6H_SF16,
+	};
+
+	// Size of a single 4x4 block in bytes
+	uint32_t get_block_size(BlockFormat format);
+	// Size of a decoded texel in bytes, BC6H is decoded to RGBA16F (both variants), all other formats to BGRA8
+	uint32_t get_decoded_texel_size(BlockFormat format);
+
+	// Post-processes decoded texels with four 8-bit channels in place, 'rgba' selects RGBA instead of BGRA channel order
+	void apply_decode_options(uint8_t *texels, size_t numTexels, const TextureDecodeOptions &options, bool rgba = false);
+
+	// Decodes a single BC7 block into 4x4 BGRA8 texels (16 * 4 bytes, tightly packed)
+	void decode_bc7_block(const uint8_t *block, uint8_t *outTexels, const TextureDecodeOptions &options);
+	// Decodes block-compressed data, 'rowPitch' is the number of bytes between two output rows.
+	// Texels outside of width x height are not written. Block rows are split across 'numThreads' threads (including the calling thread).
+	// The decode options only apply to formats which are decoded to BGRA8.
+	void decode_blocks(BlockFormat format, std::span<const uint8_t> input, uint8_t *output, size_t rowPitch, uint32_t width, uint32_t height, const TextureDecodeOptions &options = {}, uint32_t numThreads = 1);
+	// Same as above, but the block rows are split across the workers of the pool and the calling thread
+	void decode_blocks(BlockFormat format, std::span<const uint8_t> input, uint8_t *output, size_t rowPitch, uint32_t width, uint32_t height, const TextureDecodeOptions &options, ThreadPool &threadPool);
+	// Decodes the block rows [blockRowStart, blockRowEnd) on the calling thread, 'input' and 'output' refer to the entire image
+	void decode_block_rows(BlockFormat format, std::span<const uint8_t> input, uint8_t *output, size_t rowPitch, uint32_t width, uint32_t height, uint32_t blockRowStart, uint32_t blockRowEnd, const TextureDecodeOptions &options = {});
+};
@@ -0,0 +1,431 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+module source2;
+
+using namespace source2;
+
+namespace {
+	// Storage layout of a texture format, uncompressed formats are treated as 1x1 blocks
+	struct FormatLayout {
+		uint32_t blockDim = 1;
+		uint32_t blockSize = 0;
+	};
+
+	// A single sample of a KTX2 data format descriptor
+	struct DfdSample {
+		uint16_t bitOffset;
+		uint8_t bitLength;
+		uint8_t channelType;
+		uint32_t lower;
+		uint32_t upper;
+	};
+
+	struct Ktx2FormatInfo {
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint8_t colorModel;
+		std::vector<DfdSample> samples;
+		uint8_t transferFunction = 1; // Linear
+	};
+};
+
+static std::optional<uint32_t> get_dxgi_format(VTexFormat format)
+{
+	switch(format) {
+	case DXT1:
+		return 71; // DXGI_FORMAT_BC1_UNORM
+	case DXT5:
+		return 77; // DXGI_FORMAT_BC3_UNORM
+	case ATI1N:
+		return 80; // DXGI_FORMAT_BC4_UNORM
+	case ATI2N:
+		return 83; // DXGI_FORMAT_BC5_UNORM
+	case BC6H:
+		return 95; // DXGI_FORMAT_BC6H_UF16
+	case BC7:
+		return 98; // DXGI_FORMAT_BC7_UNORM
+	case RGBA8888:
+		return 28; // DXGI_FORMAT_R8G8B8A8_UNORM
+	case BGRA8888:
+		return 87; // DXGI_FORMAT_B8G8R8A8_UNORM
+	case R16:
+		return 56; // DXGI_FORMAT_R16_UNORM
+	case RG1616:
+		return 35; // DXGI_FORMAT_R16G16_UNORM
+	case RGBA16161616:
+		return 11; // DXGI_FORMAT_R16G16B16A16_UNORM
+	case R16F:
+		return 54; // DXGI_FORMAT_R16_FLOAT
+	case RG1616F:
+		return 34; // DXGI_FORMAT_R16G16_FLOAT
+	case RGBA16161616F:
+		return 10; // DXGI_FORMAT_R16G16B16A16_FLOAT
+	case R32F:
+		return 41; // DXGI_FORMAT_R32_FLOAT
+	case RG3232F:
+		return 16; // DXGI_FORMAT_R32G32_FLOAT
+	case RGB323232F:
+		return 6; // DXGI_FORMAT_R32G32B32_FLOAT
+	case RGBA32323232F:
+		return 2; // DXGI_FORMAT_R32G32B32A32_FLOAT
+	default:
+		return {};
+	}
+}
+
+// Only color formats have an sRGB variant
+static std::optional<uint32_t> get_dxgi_srgb_format(VTexFormat format)
+{
+	switch(format) {
+	case DXT1:
+		return 72; // DXGI_FORMAT_BC1_UNORM_SRGB
+	case DXT5:
+		return 78; // DXGI_FORMAT_BC3_UNORM_SRGB
+	case BC7:
+		return 99; // DXGI_FORMAT_BC7_UNORM_SRGB
+	case RGBA8888:
+		return 29; // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+	case BGRA8888:
+		return 91; // DXGI_FORMAT_B8G8R8A8_UNORM_SRGB
+	default:
+		return {};
+	}
+}
+
+static std::optional<Ktx2FormatInfo> get_ktx2_format(VTexFormat format)
+{
+	// Data format descriptor constants, see the Khronos Data Format Specification
+	constexpr uint8_t modelRgbsda = 1;
+	constexpr uint8_t modelBc1a = 128;
+	constexpr uint8_t modelBc3 = 130;
+	constexpr uint8_t modelBc4 = 131;
+	constexpr uint8_t modelBc5 = 132;
+	constexpr uint8_t modelBc6h = 133;
+	constexpr uint8_t modelBc7 = 134;
+	constexpr uint8_t modelEtc2 = 161;
+	constexpr uint8_t channelRed = 0;
+	constexpr uint8_t channelGreen = 1;
+	constexpr uint8_t channelBlue = 2;
+	constexpr uint8_t channelAlpha = 15;
+	constexpr uint8_t channelEtc2Color = 2;
+	constexpr uint8_t qualifierFloatSigned = 0x80 | 0x40;
+	constexpr uint32_t floatMinusOne = 0xBF800000;
+	constexpr uint32_t floatOne = 0x3F800000;
+	auto unorm = [](uint16_t bitOffset, uint8_t numBits, uint8_t channel) { return DfdSample {bitOffset, static_cast<uint8_t>(numBits - 1), channel, 0, static_cast<uint32_t>((uint64_t {1} << numBits) - 1)}; };
+	auto sfloat = [&](uint16_t bitOffset, uint8_t numBits, uint8_t channel) { return DfdSample {bitOffset, static_cast<uint8_t>(numBits - 1), static_cast<uint8_t>(channel | qualifierFloatSigned), floatMinusOne, floatOne}; };
+	auto block = [](uint16_t bitOffset, uint8_t numBits, uint8_t channel) { return DfdSample {bitOffset, static_cast<uint8_t>(numBits - 1), channel, 0, std::numeric_limits<uint32_t>::max()}; };
+	switch(format) {
+	case DXT1:
+		// VK_FORMAT_BC1_RGBA_UNORM_BLOCK, the alpha-present channel
+		return Ktx2FormatInfo {133, 1, modelBc1a, {block(0, 64, 1)}};
+	case DXT5:
+		return Ktx2FormatInfo {137, 1, modelBc3, {block(0, 64, channelAlpha), block(64, 64, channelRed)}};
+	case ATI1N:
+		return Ktx2FormatInfo {139, 1, modelBc4, {block(0, 64, channelRed)}};
+	case ATI2N:
+		return Ktx2FormatInfo {141, 1, modelBc5, {block(0, 64, channelRed), block(64, 64, channelGreen)}};
+	case BC6H:
+		return Ktx2FormatInfo {143, 1, modelBc6h, {DfdSample {0, 127, static_cast<uint8_t>(channelRed | 0x80), 0, floatOne}}};
+	case BC7:
+		return Ktx2FormatInfo {145, 1, modelBc7, {block(0, 128, channelRed)}};
+	case ETC2:
+		return Ktx2FormatInfo {147, 1, modelEtc2, {block(0, 64, channelEtc2Color)}};
+	case ETC2_EAC:
+		return Ktx2FormatInfo {151, 1, modelEtc2, {block(0, 64, channelAlpha), block(64, 64, channelEtc2Color)}};
+	case RGBA8888:
+		return Ktx2FormatInfo {37, 1, modelRgbsda, {unorm(0, 8, channelRed), unorm(8, 8, channelGreen), unorm(16, 8, channelBlue), unorm(24, 8, channelAlpha)}};
+	case BGRA8888:
+		return Ktx2FormatInfo {44, 1, modelRgbsda, {unorm(0, 8, channelBlue), unorm(8, 8, channelGreen), unorm(16, 8, channelRed), unorm(24, 8, channelAlpha)}};
+	case R16:
+		return Ktx2FormatInfo {70, 2, modelRgbsda, {unorm(0, 16, channelRed)}};
+	case RG1616:
+		return Ktx2FormatInfo {77, 2, modelRgbsda, {unorm(0, 16, channelRed), unorm(16, 16, channelGreen)}};
+	case RGBA16161616:
+		return Ktx2FormatInfo {91, 2, modelRgbsda, {unorm(0, 16, channelRed), unorm(16, 16, channelGreen), unorm(32, 16, channelBlue), unorm(48, 16, channelAlpha)}};
+	case R16F:
+		return Ktx2FormatInfo {76, 2, modelRgbsda, {sfloat(0, 16, channelRed)}};
+	case RG1616F:
+		return Ktx2FormatInfo {83, 2, modelRgbsda, {sfloat(0, 16, channelRed), sfloat(16, 16, channelGreen)}};
+	case RGBA16161616F:
+		return Ktx2FormatInfo {97, 2, modelRgbsda, {sfloat(0, 16, channelRed), sfloat(16, 16, channelGreen), sfloat(32, 16, channelBlue), sfloat(48, 16, channelAlpha)}};
+	case R32F:
+		return Ktx2FormatInfo {100, 4, modelRgbsda, {sfloat(0, 32, channelRed)}};
+	case RG3232F:
+		return Ktx2FormatInfo {103, 4, modelRgbsda, {sfloat(0, 32, channelRed), sfloat(32, 32, channelGreen)}};
+	case RGB323232F:
+		return Ktx2FormatInfo {106, 4, modelRgbsda, {sfloat(0, 32, channelRed), sfloat(32, 32, channelGreen), sfloat(64, 32, channelBlue)}};
+	case RGBA32323232F:
+		return Ktx2FormatInfo {109, 4, modelRgbsda, {sfloat(0, 32, channelRed), sfloat(32, 32, channelGreen), sfloat(64, 32, channelBlue), sfloat(96, 32, channelAlpha)}};
+	default:
+		return {};
+	}
+}
+
+// Switches the format to its sRGB variant, formats without one are left unchanged
+static void apply_ktx2_srgb(VTexFormat format, Ktx2FormatInfo &info)
+{
+	std::optional<uint32_t> vkFormat {};
+	switch(format) {
+	case DXT1:
+		vkFormat = 134; // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+		break;
+	case DXT5:
+		vkFormat = 138; // VK_FORMAT_BC3_SRGB_BLOCK
+		break;
+	case BC7:
+		vkFormat = 146; // VK_FORMAT_BC7_SRGB_BLOCK
+		break;
+	case ETC2:
+		vkFormat = 148; // VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK
+		break;
+	case ETC2_EAC:
+		vkFormat = 152; // VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK
+		break;
+	case RGBA8888:
+		vkFormat = 43; // VK_FORMAT_R8G8B8A8_SRGB
+		break;
+	case BGRA8888:
+		vkFormat = 50; // VK_FORMAT_B8G8R8A8_SRGB
+		break;
+	default:
+		return;
+	}
+	constexpr uint8_t modelRgbsda = 1;
+	constexpr uint8_t channelAlpha = 15;
+	constexpr uint8_t qualifierLinear = 0x10;
+	info.vkFormat = *vkFormat;
+	info.transferFunction = 2; // sRGB
+	// The alpha channel of uncompressed sRGB formats is stored linearly
+	if(info.colorModel == modelRgbsda) {
+		for(auto &sample : info.samples) {
+			if(sample.channelType == channelAlpha)
+				sample.channelType |= qualifierLinear;
+		}
+	}
+}
+
+static bool is_block_compressed(VTexFormat format)
+{
+	switch(format) {
+	case DXT1:
+	case DXT5:
+	case ATI1N:
+	case ATI2N:
+	case BC6H:
+	case BC7:
+	case ETC2:
+	case ETC2_EAC:
+		return true;
+	default:
+		return false;
+	}
+}
+
+template<typename T>
+static void write(std::vector<uint8_t> &data, const T &value)
+{
+	auto offset = data.size();
+	data.resize(offset + sizeof(T));
+	memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+namespace {
+	// Provides the stored data of each mipmap, cropped to the non-power-of-two size of the texture
+	class MipSource {
+	  public:
+		MipSource(const resource::Texture &texture, FormatLayout layout, uint32_t numMips, uint32_t storedWidth, uint32_t storedHeight) : m_texture {texture}, m_layout {layout}, m_mips(numMips), m_storedWidth {storedWidth}, m_storedHeight {storedHeight} {}
+		uint32_t GetWidth(uint8_t mipLevel) const { return std::max(m_texture.GetWidth() >> mipLevel, 1); }
+		uint32_t GetHeight(uint8_t mipLevel) const { return std::max(m_texture.GetHeight() >> mipLevel, 1); }
+		uint32_t GetRowSize(uint8_t mipLevel) const { return (GetWidth(mipLevel) + m_layout.blockDim - 1) / m_layout.blockDim * m_layout.blockSize; }
+		uint32_t GetNumRows(uint8_t mipLevel) const { return (GetHeight(mipLevel) + m_layout.blockDim - 1) / m_layout.blockDim; }
+		size_t GetSliceSize(uint8_t mipLevel) const { return static_cast<size_t>(GetRowSize(mipLevel)) * GetNumRows(mipLevel); }
+		// Appends slices [firstSlice, firstSlice + numSlices) of the specified mipmap
+		void WriteSlices(std::vector<uint8_t> &outData, uint8_t mipLevel, uint32_t firstSlice, uint32_t numSlices)
+		{
+			auto &mip = m_mips[mipLevel];
+			if(!mip) {
+				mip = m_texture.GetMappedTextureData(mipLevel);
+				if(!mip) {
+					m_texture.ReadTextureData(mipLevel, m_buffers[mipLevel]);
+					mip = m_buffers[mipLevel];
+				}
+			}
+			// Dimensions of the mipmap as it is stored
+			auto *mipInfo = m_texture.GetMipInfo(mipLevel);
+			auto storedWidth = std::max(m_storedWidth >> mipLevel, 1u);
+			auto storedHeight = std::max(m_storedHeight >> mipLevel, 1u);
+			auto storedRowSize = static_cast<size_t>((storedWidth + m_layout.blockDim - 1) / m_layout.blockDim) * m_layout.blockSize;
+			auto storedSliceSize = storedRowSize * ((storedHeight + m_layout.blockDim - 1) / m_layout.blockDim);
+			auto rowSize = GetRowSize(mipLevel);
+			auto numRows = GetNumRows(mipLevel);
+			if(storedSliceSize * (firstSlice + numSlices) > std::min<size_t>(mip->size(), mipInfo->size))
+				throw std::runtime_error {"Insufficient texture data for mipmap " + std::to_string(mipLevel)};
+			auto offset = outData.size();
+			outData.resize(offset + static_cast<size_t>(rowSize) * numRows * numSlices);
+			auto *out = outData.data() + offset;
+			for(auto slice = firstSlice; slice < firstSlice + numSlices; ++slice) {
+				auto *sliceData = mip->data() + storedSliceSize * slice;
+				for(auto row = decltype(numRows) {0u}; row < numRows; ++row) {
+					memcpy(out, sliceData + row * storedRowSize, rowSize);
+					out += rowSize;
+				}
+			}
+		}
+	  private:
+		const resource::Texture &m_texture;
+		FormatLayout m_layout;
+		std::vector<std::optional<std::span<const uint8_t>>> m_mips;
+		std::unordered_map<uint8_t, std::vector<uint8_t>> m_buffers;
+		uint32_t m_storedWidth;
+		uint32_t m_storedHeight;
+	};
+};
+
+static FormatLayout get_format_layout(const resource::Texture &texture)
+{
+	FormatLayout layout {};
+	layout.blockSize = texture.GetBlockSize();
+	if(is_block_compressed(texture.GetFormat()))
+		layout.blockDim = 4;
+	return layout;
+}
+
+bool resource::Texture::ExportDDS(std::vector<uint8_t> &outData, bool srgb) const
+{
+	auto dxgiFormat = get_dxgi_format(m_format);
+	if(!dxgiFormat || m_mipInfos.empty())
+		return false;
+	if(auto srgbFormat = srgb ? get_dxgi_srgb_format(m_format) : std::nullopt)
+		dxgiFormat = srgbFormat;
+	auto layout = get_format_layout(*this);
+	auto numMips = static_cast<uint8_t>(m_mipInfos.size());
+	MipSource source {*this, layout, numMips, m_width, m_height};
+	auto isVolume = pragma::math::to_integral(m_flags) & pragma::math::to_integral(VTexFlags::VOLUME_TEXTURE);
+	auto isCube = GetFaceCount() == 6;
+
+	constexpr uint32_t ddsdCaps = 0x1, ddsdHeight = 0x2, ddsdWidth = 0x4, ddsdPitch = 0x8, ddsdPixelFormat = 0x1000, ddsdMipMapCount = 0x20000, ddsdLinearSize = 0x80000, ddsdDepth = 0x800000;
+	constexpr uint32_t ddsCapsComplex = 0x8, ddsCapsTexture = 0x1000, ddsCapsMipMap = 0x400000;
+	constexpr uint32_t ddsCaps2Cubemap = 0x200 | 0xFC00, ddsCaps2Volume = 0x200000;
+	outData.clear();
+	write(outData, std::array<char, 4> {'D', 'D', 'S', ' '});
+	write<uint32_t>(outData, 124);
+	auto flags = ddsdCaps | ddsdHeight | ddsdWidth | ddsdPixelFormat | ddsdMipMapCount | (isVolume ? ddsdDepth : 0);
+	flags |= (layout.blockDim > 1) ? ddsdLinearSize : ddsdPitch;
+	write<uint32_t>(outData, flags);
+	write<uint32_t>(outData, source.GetHeight(0));
+	write<uint32_t>(outData, source.GetWidth(0));
+	write<uint32_t>(outData, (layout.blockDim > 1) ? static_cast<uint32_t>(source.GetSliceSize(0)) : source.GetRowSize(0));
+	write<uint32_t>(outData, isVolume ? GetMipDepth(0) : 0);
+	write<uint32_t>(outData, numMips);
+	write(outData, std::array<uint32_t, 11> {});
+	// Pixel format, the actual format is specified by the DX10 header
+	write<uint32_t>(outData, 32);
+	write<uint32_t>(outData, 0x4); // DDPF_FOURCC
+	write(outData, std::array<char, 4> {'D', 'X', '1', '0'});
+	write(outData, std::array<uint32_t, 5> {});
+	auto caps = ddsCapsTexture | ((numMips > 1) ? (ddsCapsMipMap | ddsCapsComplex) : 0) | ((isCube || isVolume) ? ddsCapsComplex : 0);
+	write<uint32_t>(outData, caps);
+	write<uint32_t>(outData, isCube ? ddsCaps2Cubemap : (isVolume ? ddsCaps2Volume : 0));
+	write(outData, std::array<uint32_t, 3> {});
+
+	// DX10 header
+	write<uint32_t>(outData, *dxgiFormat);
+	write<uint32_t>(outData, isVolume ? 4 : 3); // D3D10_RESOURCE_DIMENSION_TEXTURE3D / TEXTURE2D
+	write<uint32_t>(outData, isCube ? 0x4 : 0);  // D3D11_RESOURCE_MISC_TEXTURECUBE
+	write<uint32_t>(outData, isVolume ? 1 : GetMipDepth(0));
+	write<uint32_t>(outData, 0);
+
+	if(isVolume) {
+		// Volume textures store all slices of a mipmap, followed by the next mipmap
+		for(auto mip = decltype(numMips) {0u}; mip < numMips; ++mip)
+			source.WriteSlices(outData, mip, 0, GetMipDepth(mip));
+		return true;
+	}
+	// Every array layer and cube face stores its entire mip chain
+	auto numSlices = GetMipDepth(0) * GetFaceCount();
+	for(auto slice = decltype(numSlices) {0u}; slice < numSlices; ++slice) {
+		for(auto mip = decltype(numMips) {0u}; mip < numMips; ++mip)
+			source.WriteSlices(outData, mip, slice, 1);
+	}
+	return true;
+}
+
+bool resource::Texture::ExportKTX2(std::vector<uint8_t> &outData, bool srgb) const
+{
+	auto format = get_ktx2_format(m_format);
+	if(!format || m_mipInfos.empty())
+		return false;
+	if(srgb)
+		apply_ktx2_srgb(m_format, *format);
+	auto layout = get_format_layout(*this);
+	auto numMips = static_cast<uint8_t>(m_mipInfos.size());
+	MipSource source {*this, layout, numMips, m_width, m_height};
+	auto isVolume = pragma::math::to_integral(m_flags) & pragma::math::to_integral(VTexFlags::VOLUME_TEXTURE);
+	auto isArray = !isVolume && GetMipDepth(0) > 1;
+
+	outData.clear();
+	write(outData, std::array<uint8_t, 12> {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'});
+	write<uint32_t>(outData, format->vkFormat);
+	write<uint32_t>(outData, format->typeSize);
+	write<uint32_t>(outData, source.GetWidth(0));
+	write<uint32_t>(outData, source.GetHeight(0));
+	write<uint32_t>(outData, isVolume ? GetMipDepth(0) : 0);
+	write<uint32_t>(outData, isArray ? GetMipDepth(0) : 0);
+	write<uint32_t>(outData, GetFaceCount());
+	write<uint32_t>(outData, numMips);
+	write<uint32_t>(outData, 0); // No supercompression
+
+	// Index, the data format descriptor directly follows the level index
+	auto dfdBlockSize = static_cast<uint32_t>(24 + format->samples.size() * 16);
+	auto dfdSize = 4 + dfdBlockSize;
+	auto levelIndexOffset = outData.size() + sizeof(uint32_t) * 4 + sizeof(uint64_t) * 2;
+	auto dfdOffset = levelIndexOffset + numMips * sizeof(uint64_t) * 3;
+	write<uint32_t>(outData, static_cast<uint32_t>(dfdOffset));
+	write<uint32_t>(outData, dfdSize);
+	write<uint32_t>(outData, 0); // No key/value data
+	write<uint32_t>(outData, 0);
+	write<uint64_t>(outData, 0); // No supercompression global data
+	write<uint64_t>(outData, 0);
+	outData.resize(dfdOffset);
+
+	// Basic data format descriptor
+	write<uint32_t>(outData, dfdSize);
+	write<uint32_t>(outData, 0); // Khronos vendor, basic descriptor type
+	write<uint32_t>(outData, 2 | (dfdBlockSize << 16));
+	write<uint8_t>(outData, format->colorModel);
+	write<uint8_t>(outData, 1); // BT.709 primaries
+	write<uint8_t>(outData, format->transferFunction);
+	write<uint8_t>(outData, 0);
+	auto blockDim = static_cast<uint8_t>(layout.blockDim - 1);
+	write(outData, std::array<uint8_t, 4> {blockDim, blockDim, 0, 0});
+	write(outData, std::array<uint8_t, 8> {static_cast<uint8_t>(layout.blockSize), 0, 0, 0, 0, 0, 0, 0});
+	for(auto &sample : format->samples) {
+		write<uint16_t>(outData, sample.bitOffset);
+		write<uint8_t>(outData, sample.bitLength);
+		write<uint8_t>(outData, sample.channelType);
+		write<uint32_t>(outData, 0); // Sample position
+		write<uint32_t>(outData, sample.lower);
+		write<uint32_t>(outData, sample.upper);
+	}
+
+	// Mipmaps are stored from the smallest to the largest one, each one aligned to the block size
+	auto alignment = std::lcm<size_t>(layout.blockSize, 4);
+	auto numSlices = GetFaceCount();
+	std::vector<std::array<uint64_t, 2>> levels(numMips);
+	for(auto mip = static_cast<int32_t>(numMips) - 1; mip >= 0; --mip) {
+		outData.resize((outData.size() + alignment - 1) / alignment * alignment);
+		auto offset = outData.size();
+		source.WriteSlices(outData, mip, 0, GetMipDepth(mip) * numSlices);
+		levels[mip] = {offset, outData.size() - offset};
+	}
+	for(auto mip = decltype(numMips) {0u}; mip < numMips; ++mip) {
+		auto *levelIndex = outData.data() + levelIndexOffset + mip * sizeof(uint64_t) * 3;
+		auto &level = levels[mip];
+		std::array<uint64_t, 3> entry {level[0], level[1], level[1]};
+		memcpy(levelIndex, entry.data(), sizeof(entry));
+	}
+	return true;
+}
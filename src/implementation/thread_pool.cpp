@@ -0,0 +1,181 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+module source2;
+
+import :thread_pool;
+
+using namespace source2;
+
+static thread_local impl::ThreadPool *g_currentPool = nullptr;
+static thread_local uint32_t g_currentWorkerIdx = 0;
+static thread_local impl::ThreadPool *g_waitingPool = nullptr;
+
+namespace {
+	// Marks the calling thread as waiting on a pool, the previous pool is restored even if a task throws
+	class WaitingPoolScope {
+	  public:
+		WaitingPoolScope(impl::ThreadPool &pool) : m_prevPool {std::exchange(g_waitingPool, &pool)} {}
+		WaitingPoolScope(const WaitingPoolScope &) = delete;
+		WaitingPoolScope &operator=(const WaitingPoolScope &) = delete;
+		~WaitingPoolScope() { g_waitingPool = m_prevPool; }
+	  private:
+		impl::ThreadPool *m_prevPool;
+	};
+};
+
+impl::ThreadPool::ThreadPool(uint32_t numWorkers)
+{
+	// Tasks submitted from outside of the pool are distributed across the worker queues,
+	// without workers a single queue is used which is drained by waiting threads
+	auto numQueues = std::max(numWorkers, 1u);
+	m_queues.reserve(numQueues);
+	for(auto i = decltype(numQueues) {0u}; i < numQueues; ++i)
+		m_queues.push_back(std::make_unique<Queue>());
+	m_workers.reserve(numWorkers);
+	for(auto i = decltype(numWorkers) {0u}; i < numWorkers; ++i)
+		m_workers.push_back(std::thread {[this, i]() { RunWorker(i); }});
+}
+impl::ThreadPool::~ThreadPool()
+{
+	{
+		std::scoped_lock lock {m_wakeMutex};
+		m_stop = true;
+	}
+	m_wakeCondition.notify_all();
+	for(auto &worker : m_workers)
+		worker.join();
+}
+uint32_t impl::ThreadPool::GetWorkerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+impl::ThreadPool *impl::ThreadPool::GetCurrent() { return g_currentPool ? g_currentPool : g_waitingPool; }
+void impl::ThreadPool::Submit(Task task)
+{
+	auto queueIdx = (g_currentPool == this) ? g_currentWorkerIdx : (m_nextQueue++ % static_cast<uint32_t>(m_queues.size()));
+	++m_pendingTaskCount;
+	{
+		auto &queue = *m_queues[queueIdx];
+		std::scoped_lock lock {queue.mutex};
+		queue.tasks.push_back(std::move(task));
+	}
+	auto hasWaiters = false;
+	{
+		std::scoped_lock lock {m_wakeMutex};
+		hasWaiters = (m_waiterCount > 0);
+	}
+	m_wakeCondition.notify_one();
+	// Threads waiting on a group may be the only ones that can execute the task (e.g. if all workers are waiting as well)
+	if(hasWaiters)
+		m_waiterCondition.notify_all();
+}
+void impl::ThreadPool::WaitForTask(const std::function<bool()> &isDone)
+{
+	std::unique_lock lock {m_wakeMutex};
+	++m_waiterCount;
+	m_waiterCondition.wait(lock, [this, &isDone]() { return m_pendingTaskCount > 0 || isDone(); });
+	--m_waiterCount;
+}
+void impl::ThreadPool::NotifyWaiters()
+{
+	{
+		std::scoped_lock lock {m_wakeMutex};
+	}
+	m_waiterCondition.notify_all();
+}
+std::optional<impl::ThreadPool::Task> impl::ThreadPool::PopTask()
+{
+	auto numQueues = static_cast<uint32_t>(m_queues.size());
+	auto isWorker = (g_currentPool == this);
+	auto firstQueue = isWorker ? g_currentWorkerIdx : 0u;
+	for(auto i = decltype(numQueues) {0u}; i < numQueues; ++i) {
+		auto &queue = *m_queues[(firstQueue + i) % numQueues];
+		std::scoped_lock lock {queue.mutex};
+		if(queue.tasks.empty())
+			continue;
+		Task task;
+		if(isWorker && i == 0) {
+			// Workers process their own queue in LIFO order, which keeps nested tasks close to their parent
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		}
+		else {
+			// Steal the oldest task
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+		--m_pendingTaskCount;
+		return task;
+	}
+	return {};
+}
+bool impl::ThreadPool::RunPendingTask()
+{
+	auto task = PopTask();
+	if(!task)
+		return false;
+	(*task)();
+	return true;
+}
+void impl::ThreadPool::RunWorker(uint32_t workerIdx)
+{
+	g_currentPool = this;
+	g_currentWorkerIdx = workerIdx;
+	for(;;) {
+		if(RunPendingTask())
+			continue;
+		std::unique_lock lock {m_wakeMutex};
+		m_wakeCondition.wait(lock, [this]() { return m_stop || m_pendingTaskCount > 0; });
+		if(m_stop)
+			break;
+	}
+	g_currentPool = nullptr;
+}
+
+////////////////
+
+impl::TaskGroup::TaskGroup(ThreadPool &pool) : m_pool {pool} {}
+impl::TaskGroup::~TaskGroup()
+{
+	// Tasks reference the group, so it must not be destroyed before they have completed
+	try {
+		Wait();
+	}
+	catch(...) {
+	}
+}
+void impl::TaskGroup::Run(ThreadPool::Task task)
+{
+	++m_pendingTaskCount;
+	m_pool.Submit([this, task = std::move(task)]() {
+		try {
+			task();
+		}
+		catch(...) {
+			std::scoped_lock lock {m_exceptionMutex};
+			if(!m_exception)
+				m_exception = std::current_exception();
+		}
+		// The group may be destroyed as soon as the last task has completed
+		auto &pool = m_pool;
+		if(--m_pendingTaskCount == 0)
+			pool.NotifyWaiters();
+	});
+}
+void impl::TaskGroup::Wait()
+{
+	{
+		WaitingPoolScope waitingPoolScope {m_pool};
+		while(m_pendingTaskCount > 0) {
+			if(!m_pool.RunPendingTask())
+				m_pool.WaitForTask([this]() { return m_pendingTaskCount == 0; });
+		}
+	}
+	std::exception_ptr exception = nullptr;
+	{
+		std::scoped_lock lock {m_exceptionMutex};
+		exception = std::exchange(m_exception, nullptr);
+	}
+	if(exception)
+		std::rethrow_exception(exception);
+}
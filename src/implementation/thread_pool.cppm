@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+export module source2:thread_pool;
+
+export import std.compat;
+
+export namespace source2::impl {
+	// Work-stealing thread pool. Every worker owns a task queue, tasks submitted from a worker are pushed to its own queue
+	// and idle workers steal from the other queues.
+	class ThreadPool {
+	  public:
+		using Task = std::function<void()>;
+		// With zero worker threads, tasks are only executed by threads waiting on a TaskGroup
+		ThreadPool(uint32_t numWorkers);
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+		~ThreadPool();
+		uint32_t GetWorkerCount() const;
+		void Submit(Task task);
+		// Executes a single pending task on the calling thread, returns false if there was none
+		bool RunPendingTask();
+		// Blocks the calling thread until a task is pending or isDone returns true. isDone is called with an internal lock held,
+		// threads which change its result must call NotifyWaiters afterwards.
+		void WaitForTask(const std::function<bool()> &isDone);
+		void NotifyWaiters();
+		// Pool the calling thread is executing tasks for, either as a worker or while waiting on a TaskGroup.
+		// nullptr if the thread isn't part of any pool.
+		static ThreadPool *GetCurrent();
+	  private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+		std::optional<Task> PopTask();
+		void RunWorker(uint32_t workerIdx);
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::thread> m_workers;
+		std::atomic<uint32_t> m_nextQueue = 0;
+		std::atomic<uint32_t> m_pendingTaskCount = 0;
+		std::mutex m_wakeMutex;
+		std::condition_variable m_wakeCondition;
+		std::condition_variable m_waiterCondition;
+		uint32_t m_waiterCount = 0;
+		bool m_stop = false;
+	};
+
+	// Set of tasks which can be waited on. Tasks may add further tasks to the group they are part of.
+	class TaskGroup {
+	  public:
+		TaskGroup(ThreadPool &pool);
+		TaskGroup(const TaskGroup &) = delete;
+		TaskGroup &operator=(const TaskGroup &) = delete;
+		~TaskGroup();
+		void Run(ThreadPool::Task task);
+		// Helps executing pending tasks until all tasks of this group have completed, blocks while there are none.
+		// If any of the tasks threw an exception, the first one is rethrown.
+		void Wait();
+	  private:
+		ThreadPool &m_pool;
+		std::atomic<uint32_t> m_pendingTaskCount = 0;
+		std::mutex m_exceptionMutex;
+		std::exception_ptr m_exception = nullptr;
+	};
+};
+
+export namespace source2 {
+	// Can be passed to World::Load, Texture::DecodeAllMips and Texture::UncompressBC7 to reuse worker threads across calls
+	using ThreadPool = impl::ThreadPool;
+};
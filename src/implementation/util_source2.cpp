@@ -257,14 +257,121 @@ std::string source2::to_string(BlockType blockType)
 	return "Invalid";
 }
 
-std::shared_ptr<source2::resource::Resource> source2::load_resource(ufile::IFile &file, const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &fAssetLoader)
+std::shared_ptr<source2::resource::Resource> source2::load_resource(ufile::IFile &file, const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &fAssetLoader) { return load_resource(file, resource::ResourceLoadOptions {}, fAssetLoader); }
+
+std::shared_ptr<source2::resource::Resource> source2::load_resource(ufile::IFile &file, const resource::ResourceLoadOptions &loadOptions, const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &fAssetLoader)
 {
-	auto resource = std::make_shared<resource::Resource>(fAssetLoader);
+	if(loadOptions.memoryMap || loadOptions.lazyBlocks)
+		return load_resource(resource::MappedFile::Create(file), loadOptions, fAssetLoader);
+	auto resource = std::make_shared<resource::Resource>(fAssetLoader, loadOptions);
 	if(resource->Read(file) == false)
 		resource = nullptr;
 	return resource;
 }
 
+std::shared_ptr<source2::resource::Resource> source2::load_resource(const std::shared_ptr<const resource::MappedFile> &mappedFile, const resource::ResourceLoadOptions &loadOptions, const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &fAssetLoader)
+{
+	auto resource = std::make_shared<resource::Resource>(fAssetLoader, loadOptions);
+	if(resource->Read(mappedFile) == false)
+		resource = nullptr;
+	return resource;
+}
+
+// Reads a string referenced by an offset at the current position into a fixed buffer, longer strings are truncated
+static std::string_view read_offset_string_view(ufile::IFile &f, std::span<char> buffer)
+{
+	auto currentOffset = f.Tell();
+	auto offset = f.Read<uint32_t>();
+	if(offset == 0)
+		return {};
+	f.Seek(currentOffset + offset);
+	size_t length = 0;
+	auto fileSize = f.GetSize();
+	while(length < buffer.size() && f.Tell() < fileSize) {
+		auto c = f.Read<char>();
+		if(c == '\0')
+			break;
+		buffer[length++] = c;
+	}
+	f.Seek(currentOffset + sizeof(uint32_t));
+	return {buffer.data(), length};
+}
+std::optional<source2::resource::ResourceProbe> source2::probe_resource(ufile::IFile &f)
+{
+	auto fileSize = f.GetSize();
+	constexpr size_t headerSize = sizeof(uint32_t) * 2 + sizeof(uint16_t) * 2;
+	if(fileSize < headerSize)
+		return {};
+	resource::ResourceProbe probe {};
+	probe.fileSize = f.Read<uint32_t>();
+	constexpr uint32_t knownHeaderVersion = 12u;
+	if(f.Read<uint16_t>() != knownHeaderVersion)
+		return {}; // VPK, compiled shader or unknown file
+	probe.version = f.Read<uint16_t>();
+	auto blockTableOffset = f.Tell() + f.Read<uint32_t>();
+	probe.blockCount = f.Read<uint32_t>();
+
+	// Each entry of the block table consists of the type, the offset relative to the offset field, and the size
+	constexpr size_t blockEntrySize = sizeof(uint32_t) * 3;
+	if(blockTableOffset + static_cast<uint64_t>(probe.blockCount) * blockEntrySize > fileSize)
+		return {};
+	std::optional<uint32_t> rediOffset {};
+	std::optional<uint32_t> ntroOffset {};
+	auto rediFirst = false;
+	for(auto i = decltype(probe.blockCount) {0u}; i < probe.blockCount; ++i) {
+		f.Seek(blockTableOffset + i * blockEntrySize);
+		resource::ResourceProbe::BlockInfo info {};
+		info.type = f.Read<std::array<char, 4>>();
+		auto position = f.Tell();
+		info.offset = position + f.Read<uint32_t>();
+		info.size = f.Read<uint32_t>();
+		if(i < probe.blocks.size())
+			probe.blocks[i] = info;
+		std::string_view type {info.type.data(), info.type.size()};
+		if(type == "REDI" && !rediOffset) {
+			rediOffset = info.offset;
+			rediFirst = !ntroOffset;
+		}
+		else if(type == "NTRO" && !ntroOffset)
+			ntroOffset = info.offset;
+	}
+
+	std::array<char, 64> buffer {};
+	std::array<char, 64> buffer2 {};
+	auto probeREDI = [&f, fileSize, &rediOffset, &buffer, &buffer2]() -> ResourceType {
+		if(!rediOffset || *rediOffset + (pragma::math::to_integral(REDIStruct::SpecialDependencies) + 1) * sizeof(uint32_t) * 2 > fileSize)
+			return ResourceType::Unknown;
+		f.Seek(*rediOffset + pragma::math::to_integral(REDIStruct::SpecialDependencies) * sizeof(uint32_t) * 2);
+		auto position = f.Tell();
+		auto offset = position + f.Read<uint32_t>();
+		auto count = f.Read<uint32_t>();
+		if(count == 0 || offset + sizeof(uint32_t) * 2 > fileSize)
+			return ResourceType::Unknown;
+		f.Seek(offset);
+		auto string = read_offset_string_view(f, buffer);
+		auto compilerIdentifier = read_offset_string_view(f, buffer2);
+		return resource::SpecialDependencies::DetermineResourceTypeByCompilerIdentifier(compilerIdentifier, string);
+	};
+	auto probeNTRO = [&f, fileSize, &ntroOffset, &buffer]() -> ResourceType {
+		if(!ntroOffset || *ntroOffset + sizeof(uint32_t) * 3 > fileSize)
+			return ResourceType::Unknown;
+		f.Seek(*ntroOffset + sizeof(uint32_t)); // Introspection version
+		auto position = f.Tell();
+		auto structsOffset = position + f.Read<uint32_t>();
+		auto structCount = f.Read<uint32_t>();
+		if(structCount == 0 || structsOffset + sizeof(uint32_t) * 3 > fileSize)
+			return ResourceType::Unknown;
+		// The name of the first struct follows its introspection version and id
+		f.Seek(structsOffset + sizeof(uint32_t) * 2);
+		return resource::ResourceIntrospectionManifest::DetermineResourceTypeByStructName(read_offset_string_view(f, buffer));
+	};
+	// Same order as Resource::Read, the second block is only checked if the first one doesn't determine the type
+	probe.type = rediFirst ? probeREDI() : probeNTRO();
+	if(probe.type == ResourceType::Unknown)
+		probe.type = rediFirst ? probeNTRO() : probeREDI();
+	return probe;
+}
+
 void source2::debug_print(resource::Resource &resource, std::stringstream &ss)
 {
 	for(auto &block : resource.GetBlocks()) {
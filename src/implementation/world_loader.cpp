@@ -5,81 +5,187 @@ module;
 
 module source2;
 
+import :thread_pool;
+
 using namespace source2;
 
-std::shared_ptr<resource::Scene> resource::World::Load()
+namespace {
+	// Scene nodes created for a single scene object, they're added to the scene in a deterministic order once loading has completed
+	struct SceneObjectNodes {
+		std::shared_ptr<resource::SceneNode> modelNode = nullptr;
+		std::shared_ptr<resource::SceneNode> meshNode = nullptr;
+	};
+
+	struct WorldNodeData {
+		std::vector<std::string> layerNames;
+		std::vector<int32_t> sceneObjectLayerIndices;
+		std::vector<resource::IKeyValueCollection *> sceneObjects;
+	};
+
+	struct EntityLumpEntities {
+		std::vector<EntityLumpEntities> children;
+		std::vector<std::shared_ptr<resource::Entity>> entities;
+	};
+};
+
+static std::shared_ptr<WorldNodeData> get_world_node_data(resource::WorldNode &worldNode)
+{
+	auto data = worldNode.GetData();
+	if(data == nullptr)
+		return nullptr;
+	auto worldNodeData = std::make_shared<WorldNodeData>();
+	worldNodeData->layerNames = data->FindArrayValues<std::string>("m_layerNames");
+	worldNodeData->sceneObjectLayerIndices = data->FindArrayValues<int32_t>("m_sceneObjectLayerIndices");
+	worldNodeData->sceneObjects = data->FindArrayValues<resource::IKeyValueCollection *>("m_sceneObjects");
+	return worldNodeData;
+}
+
+static void load_scene_object(const resource::Resource &resource, resource::Scene &scene, const WorldNodeData &worldNodeData, uint32_t sceneObjectIdx, SceneObjectNodes &outNodes)
+{
+	auto &worldLayers = worldNodeData.layerNames;
+	auto &sceneObjectLayerIndices = worldNodeData.sceneObjectLayerIndices;
+	auto *sceneObject = worldNodeData.sceneObjects.at(sceneObjectIdx);
+	int32_t layerIndex = (sceneObjectIdx < sceneObjectLayerIndices.size()) ? sceneObjectLayerIndices.at(sceneObjectIdx) : -1;
+
+	// sceneObject is SceneObject_t
+	auto renderableModel = sceneObject->FindValue<std::string>("m_renderableModel");
+	auto matrix = sceneObject->FindValue<Mat4>("m_vTransform", Mat4 {1.f}); // TODO
+
+	auto tintColor = sceneObject->FindValue<Vector4>("m_vTintColor", Vector4 {1.f, 1.f, 1.f, 1.f});
+	if(tintColor.w == 0) {
+		// Ignoring tintColor, it will fuck things up.
+		tintColor = {1.f, 1.f, 1.f, 1.f};
+	}
+
+	if(renderableModel.has_value()) {
+		auto newResource = resource.LoadResource(*renderableModel + "_c");
+		auto *model = newResource ? dynamic_cast<resource::Model *>(newResource->FindBlock(BlockType::DATA)) : nullptr;
+		if(model == nullptr)
+			return;
+
+		// TODO
+		auto modelNode = std::make_shared<resource::ModelSceneNode>(scene, newResource, *model);
+		modelNode->SetTransform(matrix);
+		modelNode->SetLayerName(worldLayers.at(layerIndex));
+		modelNode->SetTint(tintColor);
+
+		outNodes.modelNode = modelNode;
+	}
+
+	auto renderable = sceneObject->FindValue<std::string>("m_renderable");
+	if(renderable.has_value()) {
+		auto newResource = resource.LoadResource(*renderable);
+
+		if(newResource == nullptr)
+			return;
+
+		auto mesh = resource::Mesh::Create(*newResource);
+		auto meshSceneNode = std::make_shared<resource::MeshSceneNode>(scene, newResource, *mesh);
+		meshSceneNode->SetTransform(matrix);
+		meshSceneNode->SetTint(tintColor);
+		meshSceneNode->SetLayerName(worldLayers.at(layerIndex));
+
+		outNodes.meshNode = meshSceneNode;
+	}
+}
+
+static void add_scene_object_nodes(resource::Scene &scene, const std::vector<SceneObjectNodes> &nodes)
+{
+	for(auto &sceneObjectNodes : nodes) {
+		if(sceneObjectNodes.modelNode)
+			scene.Add(*sceneObjectNodes.modelNode);
+		if(sceneObjectNodes.meshNode)
+			scene.Add(*sceneObjectNodes.meshNode);
+	}
+}
+
+static void load_entity_lump(const resource::Resource &resource, const resource::EntityLump &entityLump, impl::TaskGroup &taskGroup, EntityLumpEntities &outEntities)
+{
+	auto childEntities = entityLump.GetChildEntityNames();
+	// Must not be resized after this point, child tasks write into the elements
+	outEntities.children.resize(childEntities.size());
+	for(auto i = decltype(childEntities.size()) {0u}; i < childEntities.size(); ++i) {
+		taskGroup.Run([&resource, &taskGroup, &outChild = outEntities.children[i], childEntityName = std::move(childEntities[i])]() {
+			auto lumpEntRes = resource.LoadResource(childEntityName + "_c");
+			auto *childLump = lumpEntRes ? dynamic_cast<resource::EntityLump *>(lumpEntRes->FindBlock(BlockType::DATA)) : nullptr;
+			if(childLump == nullptr)
+				return;
+			load_entity_lump(resource, *childLump, taskGroup, outChild);
+		});
+	}
+	outEntities.entities = entityLump.GetEntities();
+}
+
+static void add_entities(resource::Scene &scene, const EntityLumpEntities &entities)
+{
+	// Entities of child lumps are added before the entities of their parent
+	for(auto &child : entities.children)
+		add_entities(scene, child);
+	for(auto &ent : entities.entities)
+		scene.Add(*ent);
+}
+
+std::shared_ptr<resource::Scene> resource::World::Load(uint32_t numThreads)
+{
+	// The calling thread executes tasks as well while it's waiting
+	impl::ThreadPool threadPool {(numThreads > 0) ? (numThreads - 1) : 0u};
+	return Load(threadPool);
+}
+std::shared_ptr<resource::Scene> resource::World::Load(ThreadPool &threadPool)
 {
 	auto scene = std::make_shared<Scene>();
-	for(auto &worldNodeName : GetWorldNodeNames()) {
-		auto worldNodeRes = m_resource.LoadResource(worldNodeName + ".vwnod_c");
-		auto *worldNode = worldNodeRes ? dynamic_cast<WorldNode *>(worldNodeRes->FindBlock(BlockType::DATA)) : nullptr;
-		if(worldNode == nullptr)
-			continue;
-		worldNode->Load(*worldNodeRes, *scene);
+	impl::TaskGroup taskGroup {threadPool};
+
+	// Results are stored per world node / entity lump and merged into the scene in their original order
+	auto worldNodeNames = GetWorldNodeNames();
+	std::vector<std::vector<SceneObjectNodes>> worldNodeSceneObjects {};
+	worldNodeSceneObjects.resize(worldNodeNames.size());
+	for(auto i = decltype(worldNodeNames.size()) {0u}; i < worldNodeNames.size(); ++i) {
+		taskGroup.Run([this, &scene, &taskGroup, &outNodes = worldNodeSceneObjects[i], &worldNodeName = worldNodeNames[i]]() {
+			auto worldNodeRes = m_resource.LoadResource(worldNodeName + ".vwnod_c");
+			auto *worldNode = worldNodeRes ? dynamic_cast<WorldNode *>(worldNodeRes->FindBlock(BlockType::DATA)) : nullptr;
+			if(worldNode == nullptr)
+				return;
+			auto worldNodeData = get_world_node_data(*worldNode);
+			if(worldNodeData == nullptr)
+				return;
+			outNodes.resize(worldNodeData->sceneObjects.size());
+			for(auto j = decltype(outNodes.size()) {0u}; j < outNodes.size(); ++j) {
+				// The world node resource owns the scene object data, so it has to be kept alive until all tasks are complete
+				taskGroup.Run([&scene, &outSceneObjectNodes = outNodes[j], worldNodeRes, worldNodeData, j]() { load_scene_object(*worldNodeRes, *scene, *worldNodeData, static_cast<uint32_t>(j), outSceneObjectNodes); });
+			}
+		});
 	}
 
-	for(auto &lumpName : GetEntityLumpNames()) {
-		auto lumpNodeRes = m_resource.LoadResource(lumpName + "_c");
-		auto *entityLump = lumpNodeRes ? dynamic_cast<EntityLump *>(lumpNodeRes->FindBlock(BlockType::DATA)) : nullptr;
-		if(entityLump == nullptr)
-			continue;
-		LoadEntitiesFromLump(*entityLump, "world_layer_base", *scene);
+	auto lumpNames = GetEntityLumpNames();
+	std::vector<EntityLumpEntities> lumpEntities {};
+	lumpEntities.resize(lumpNames.size());
+	for(auto i = decltype(lumpNames.size()) {0u}; i < lumpNames.size(); ++i) {
+		taskGroup.Run([this, &taskGroup, &outEntities = lumpEntities[i], &lumpName = lumpNames[i]]() {
+			auto lumpNodeRes = m_resource.LoadResource(lumpName + "_c");
+			auto *entityLump = lumpNodeRes ? dynamic_cast<EntityLump *>(lumpNodeRes->FindBlock(BlockType::DATA)) : nullptr;
+			if(entityLump == nullptr)
+				return;
+			load_entity_lump(m_resource, *entityLump, taskGroup, outEntities);
+		});
 	}
+	taskGroup.Wait();
+
+	for(auto &sceneObjectNodes : worldNodeSceneObjects)
+		add_scene_object_nodes(*scene, sceneObjectNodes);
+	for(auto &entities : lumpEntities)
+		add_entities(*scene, entities);
 	return scene;
 }
 
 void resource::WorldNode::WorldNode::Load(Resource &resource, Scene &scene)
 {
-	auto data = GetData();
-	if(data == nullptr)
+	auto worldNodeData = get_world_node_data(*this);
+	if(worldNodeData == nullptr)
 		return;
-	auto worldLayers = data->FindArrayValues<std::string>("m_layerNames");
-	auto sceneObjectLayerIndices = data->FindArrayValues<int32_t>("m_sceneObjectLayerIndices");
-	auto sceneObjects = data->FindArrayValues<IKeyValueCollection *>("m_sceneObjects");
-	uint32_t i = 0;
-	for(auto *sceneObject : sceneObjects) {
-		int32_t layerIndex = (i < sceneObjectLayerIndices.size()) ? sceneObjectLayerIndices.at(i) : -1;
-		++i;
-
-		// sceneObject is SceneObject_t
-		auto renderableModel = sceneObject->FindValue<std::string>("m_renderableModel");
-		auto matrix = sceneObject->FindValue<Mat4>("m_vTransform", Mat4 {1.f}); // TODO
-
-		auto tintColor = sceneObject->FindValue<Vector4>("m_vTintColor", Vector4 {1.f, 1.f, 1.f, 1.f});
-		if(tintColor.w == 0) {
-			// Ignoring tintColor, it will fuck things up.
-			tintColor = {1.f, 1.f, 1.f, 1.f};
-		}
-
-		if(renderableModel.has_value()) {
-			auto newResource = resource.LoadResource(*renderableModel + "_c");
-			auto *model = newResource ? dynamic_cast<Model *>(newResource->FindBlock(BlockType::DATA)) : nullptr;
-			if(model == nullptr)
-				continue;
-
-			// TODO
-			auto modelNode = std::make_shared<ModelSceneNode>(scene, newResource, *model);
-			modelNode->SetTransform(matrix);
-			modelNode->SetLayerName(worldLayers.at(layerIndex));
-			modelNode->SetTint(tintColor);
-
-			scene.Add(*modelNode);
-		}
-
-		auto renderable = sceneObject->FindValue<std::string>("m_renderable");
-		if(renderable.has_value()) {
-			auto newResource = resource.LoadResource(*renderable);
-
-			if(newResource == nullptr)
-				continue;
-
-			auto mesh = Mesh::Create(*newResource);
-			auto meshSceneNode = std::make_shared<MeshSceneNode>(scene, newResource, *mesh);
-			meshSceneNode->SetTransform(matrix);
-			meshSceneNode->SetTint(tintColor);
-			meshSceneNode->SetLayerName(worldLayers.at(layerIndex));
-
-			scene.Add(*meshSceneNode);
-		}
-	}
+	std::vector<SceneObjectNodes> nodes {};
+	nodes.resize(worldNodeData->sceneObjects.size());
+	for(auto i = decltype(nodes.size()) {0u}; i < nodes.size(); ++i)
+		load_scene_object(resource, scene, *worldNodeData, static_cast<uint32_t>(i), nodes[i]);
+	add_scene_object_nodes(scene, nodes);
 }
@@ -20,8 +20,18 @@ export namespace source2::resource {
 		uint32_t GetSize() const;
 		void SetOffset(uint32_t offset);
 		void SetSize(uint32_t size);
+	  protected:
+		// Reads 'size' bytes starting at the current file position. If the resource was loaded from memory,
+		// the returned span references the file data directly and 'buffer' is left untouched.
+		std::span<const uint8_t> ReadData(const Resource &resource, ufile::IFile &f, size_t size, std::vector<uint8_t> &buffer) const;
+		// Reads output.size() bytes starting at the current file position directly into 'output'
+		void ReadData(const Resource &resource, ufile::IFile &f, std::span<uint8_t> output) const;
 	  private:
+		friend class Resource;
 		uint32_t m_offset = 0u;
 		uint32_t m_size = 0u;
+		std::once_flag m_readOnce {};
+		// Set if reading the block failed, the error is rethrown on every access
+		std::exception_ptr m_readException = nullptr;
 	};
 };
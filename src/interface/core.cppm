@@ -107,7 +107,30 @@ export namespace source2 {
 
 	namespace resource {
 		class Resource;
+		class MappedFile;
+		struct ResourceLoadOptions;
+
+		// Header information of a resource file, see probe_resource
+		struct DLLUS2 ResourceProbe {
+			static constexpr size_t MAX_BLOCKS = 16;
+			struct BlockInfo {
+				std::array<char, 4> type {};
+				uint32_t offset = 0; // Absolute offset in the file
+				uint32_t size = 0;
+			};
+			uint32_t fileSize = 0;
+			uint16_t version = 0;
+			ResourceType type = ResourceType::Unknown;
+			uint32_t blockCount = 0; // Only the first MAX_BLOCKS blocks are stored in 'blocks'
+			std::array<BlockInfo, MAX_BLOCKS> blocks {};
+		};
 	};
 	DLLUS2 std::shared_ptr<resource::Resource> load_resource(ufile::IFile &file, const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &fAssetLoader = nullptr);
+	DLLUS2 std::shared_ptr<resource::Resource> load_resource(ufile::IFile &file, const resource::ResourceLoadOptions &loadOptions, const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &fAssetLoader = nullptr);
+	DLLUS2 std::shared_ptr<resource::Resource> load_resource(const std::shared_ptr<const resource::MappedFile> &mappedFile, const resource::ResourceLoadOptions &loadOptions, const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &fAssetLoader = nullptr);
 	DLLUS2 void debug_print(resource::Resource &resource, std::stringstream &ss);
+	// Reads the header and block table of a resource without parsing any blocks. The resource type is determined from the REDI and NTRO
+	// blocks the same way load_resource does, but only the required strings are read. Doesn't allocate any memory.
+	// Returns an empty optional if the file is not a resource file.
+	DLLUS2 std::optional<resource::ResourceProbe> probe_resource(ufile::IFile &file);
 };
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+module;
+
+#include "definitions.hpp"
+
+export module source2:mapped_file;
+
+import :core;
+
+export namespace source2::resource {
+	// Read-only contents of an entire resource file, either memory-mapped or read into memory in one go
+	class DLLUS2 MappedFile {
+	  public:
+		// Maps the file at the specified system path into memory, returns nullptr on failure
+		static std::shared_ptr<MappedFile> Open(const std::string &systemPath);
+		// Reads the entire file into memory, for files which cannot be mapped (e.g. files inside of archives)
+		static std::shared_ptr<MappedFile> Create(ufile::IFile &f);
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+		~MappedFile();
+		std::span<const uint8_t> GetData() const;
+		bool IsMemoryMapped() const;
+	  private:
+		MappedFile() = default;
+		const uint8_t *m_data = nullptr;
+		size_t m_size = 0;
+		bool m_isMemoryMapped = false;
+		std::vector<uint8_t> m_buffer {};
+#ifdef _WIN32
+		void *m_fileHandle = nullptr;
+		void *m_mappingHandle = nullptr;
+#endif
+	};
+};
@@ -62,6 +62,7 @@ export namespace source2::resource {
 			void DebugPrint(std::stringstream &ss, const std::string &t = "") const;
 		};
 		static ResourceType DetermineResourceTypeByCompilerIdentifier(const SpecialDependency &input);
+		static ResourceType DetermineResourceTypeByCompilerIdentifier(std::string_view compilerIdentifier, std::string_view string);
 		virtual void Read(const Resource &resource, ufile::IFile &f) override;
 		virtual void DebugPrint(std::stringstream &ss, const std::string &t = "") const override;
 		const std::vector<SpecialDependency> &GetSpecialDependencies() const;
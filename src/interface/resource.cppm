@@ -9,14 +9,50 @@ module;
 export module source2:resource;
 
 import :block;
+import :thread_pool;
 
 export namespace source2::resource {
 	class ResourceData;
 	class ResourceIntrospectionManifest;
 	class ResourceExtRefList;
+	class ResourceCache;
+
+	enum class KV3Representation : uint8_t {
+		Tree = 0, // Reference-counted KVObject/KVValue tree
+		Document, // Flat KV3Document, values are stored inline in a single node array
+		Raw,      // Only the decompressed data is kept, values are accessed through BinaryKV3::Visit
+	};
+
+	struct DLLUS2 ResourceLoadOptions {
+		KV3Representation kv3Representation = KV3Representation::Tree;
+		// If enabled, KV3 binary blobs are exposed as views into the decompressed block data instead of being copied.
+		// They can only be accessed through FindBinaryBlobView in that case.
+		bool aliasBinaryBlobs = false;
+		// If enabled, the file is read into memory with a single read and all blocks are parsed from there.
+		// Uncompressed vertex, index and texture data is referenced instead of copied, which keeps the file data alive
+		// for as long as those blocks exist. Files loaded through a MappedFile are always parsed this way.
+		bool memoryMap = false;
+		// If enabled, only the REDI and NTRO blocks are parsed when the resource is read. All other blocks are parsed
+		// the first time they are accessed through FindBlock, GetBlock or GetBlocks, which is thread-safe.
+		// Parsing errors of these blocks are thrown from the accessor instead of the load call, later accesses rethrow the same error.
+		// Implies memoryMap, lazy parsing is disabled if the resource is read from a plain IFile.
+		bool lazyBlocks = false;
+		// Must only be set if the asset file loader can be called from multiple threads at once (e.g. by World::Load or
+		// concurrent LoadResource calls). Otherwise calls to the loader are serialized, which is shared with all child resources.
+		bool threadSafeAssetLoader = false;
+		// If set, resources loaded through Resource::LoadResource are shared through this cache. The cache is inherited by all
+		// child resources, cached resources must be treated as immutable.
+		std::shared_ptr<ResourceCache> cache = nullptr;
+		// Identifies the asset file loader in the keys of the cache, resources are only shared between loaders with the same key.
+		// If empty, all resources using the default file system loader share one key and every other loader gets a unique one
+		// (inherited by its child resources). Loaders which resolve paths the same way can set the same key to share resources
+		// across separately loaded resources. Keys starting with '#' are reserved.
+		std::string assetLoaderKey;
+	};
+
 	class DLLUS2 Resource {
 	  public:
-		Resource(const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &assetFileLoader);
+		Resource(const std::function<std::unique_ptr<ufile::IFile>(const std::string &)> &assetFileLoader, const ResourceLoadOptions &loadOptions = {});
 		std::unique_ptr<ufile::IFile> OpenAssetFile(const std::string &path) const;
 		std::shared_ptr<Resource> LoadResource(const std::string &path) const;
 
@@ -25,6 +61,7 @@ export namespace source2::resource {
 		const std::vector<std::shared_ptr<Block>> &GetBlocks() const;
 		std::shared_ptr<Block> GetBlock(uint32_t idx) const;
 		bool Read(ufile::IFile &f);
+		bool Read(const std::shared_ptr<const MappedFile> &mappedFile);
 		std::shared_ptr<Block> ConstructFromType(std::string input);
 		std::shared_ptr<ResourceData> ConstructResourceType();
 
@@ -35,11 +72,73 @@ export namespace source2::resource {
 		const ResourceExtRefList *GetExternalReferences() const;
 
 		uint32_t GetVersion() const;
+		uint32_t GetFileSize() const;
+		const ResourceLoadOptions &GetLoadOptions() const;
+		// Only set if the resource was loaded from memory
+		const std::shared_ptr<const MappedFile> &GetMappedFile() const;
 	  private:
 		static bool IsHandledResourceType(ResourceType type);
+		void ReadBlock(Block &block, ufile::IFile &f) const;
+		void LoadBlock(Block &block) const;
 		ResourceType m_resourceType = ResourceType::Unknown;
 		std::vector<std::shared_ptr<Block>> m_blocks = {};
 		std::function<std::unique_ptr<ufile::IFile>(const std::string &)> m_assetFileLoader = nullptr;
+		ResourceLoadOptions m_loadOptions {};
+		std::shared_ptr<const MappedFile> m_mappedFile = nullptr;
+		bool m_lazyBlocks = false;
 		uint16_t m_version = 0u;
+		uint32_t m_fileSize = 0u;
+	};
+
+	// Thread-safe cache of loaded resources, keyed by their asset path, the load options which affect how they're parsed and the
+	// asset loader key. Concurrent requests for the same key are only loaded once.
+	class DLLUS2 ResourceCache {
+	  public:
+		struct Statistics {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t evictions = 0;
+			size_t fileSize = 0; // Sum of the file sizes of all cached resources
+			size_t entryCount = 0;
+		};
+		// Once the sum of the file sizes of all cached resources exceeds the budget, the least recently used resources are evicted.
+		// This is an approximation of the memory footprint, which also includes decoded data. 0 means unlimited.
+		ResourceCache(size_t fileSizeBudget = 0);
+		ResourceCache(const ResourceCache &) = delete;
+		ResourceCache &operator=(const ResourceCache &) = delete;
+		// If the resource is still being loaded by another thread, the calling thread helps executing pending tasks of its
+		// thread pool (if it is part of one) until the resource is available, and blocks while there are none.
+		// Returns nullptr if the resource is requested again while it's being loaded on the same thread (cyclic dependency).
+		std::shared_ptr<Resource> Load(const std::string &path, const ResourceLoadOptions &loadOptions, const std::function<std::shared_ptr<Resource>()> &loader);
+		void SetFileSizeBudget(size_t fileSizeBudget);
+		size_t GetFileSizeBudget() const;
+		Statistics GetStatistics() const;
+		void ResetStatistics();
+		void Clear();
+	  private:
+		struct Entry {
+			std::shared_future<std::shared_ptr<Resource>> resource;
+			std::list<std::string>::iterator lruIt;
+			uint64_t id = 0;
+			size_t size = 0;
+			bool loaded = false;
+		};
+		static std::string NormalizePath(const std::string &path);
+		static std::string GetKey(const std::string &path, const ResourceLoadOptions &loadOptions);
+		void Remove(const std::string &key, uint64_t id);
+		void EvictEntries();
+		std::shared_ptr<Resource> WaitForResource(const std::shared_future<std::shared_ptr<Resource>> &resource);
+		void NotifyWaitingPools();
+		mutable std::mutex m_mutex;
+		// Pools of the threads which are waiting for a resource, they are woken up whenever a load has completed
+		std::vector<impl::ThreadPool *> m_waitingPools;
+		std::unordered_map<std::string, Entry> m_entries;
+		std::list<std::string> m_lru; // Most recently used first
+		size_t m_fileSizeBudget = 0;
+		size_t m_fileSize = 0;
+		uint64_t m_nextId = 0;
+		uint64_t m_hits = 0;
+		uint64_t m_misses = 0;
+		uint64_t m_evictions = 0;
 	};
 };
@@ -12,15 +12,19 @@ export module source2:resource_data;
 
 import :block;
 import :resource_edit_info;
+import :thread_pool;
 import pragma.string;
 
 export namespace source2::resource {
 	class IKeyValueCollection;
 	class NTROStruct;
 	class KVObject;
+	class KV3Collection;
 	class ResourceData;
 	template<typename T0, typename T1>
 	std::optional<T1> cast_to_type(const T0 &v);
+	template<typename T, typename TComponents>
+	std::optional<T> cast_components_to_type(const TComponents &v);
 
 	class DLLUS2 ResourceData : public Block {
 	  public:
@@ -38,6 +42,12 @@ export namespace source2::resource {
 	};
 
 	using BinaryBlob = std::vector<uint8_t>;
+	// Binary blob that aliases a buffer it does not own, e.g. the decompressed data of a KV3 block.
+	// The owning stream is kept alive for as long as the view exists.
+	struct DLLUS2 BinaryBlobView {
+		pragma::util::DataStream owner;
+		std::span<const uint8_t> data;
+	};
 	struct DLLUS2 NTROArray : public NTROValue {
 	  public:
 		NTROArray(DataType type, uint32_t count, bool pointer = false, bool isIndirection = false);
@@ -60,29 +70,92 @@ export namespace source2::resource {
 		T value;
 	};
 
+	// Matrix2x4, Matrix3x4 and CTransform values are stored with their components in the order they appear on disk
+	template<size_t N>
+	using NTROFloats = std::array<float, N>;
+	// Types of NTRO values that consist of floats only
+	template<typename T>
+	constexpr bool is_packed_ntro_type_v = std::is_same_v<T, Vector3> || std::is_same_v<T, Vector4> || std::is_same_v<T, Quat> || std::is_same_v<T, NTROFloats<8>> || std::is_same_v<T, NTROFloats<12>>;
+
+	// Key with a precomputed FNV-1a hash, string literals are hashed at compile time.
+	// Strings, string views and non-constant char buffers are hashed at runtime.
+	// The key only references the string, it must outlive the lookup.
+	struct DLLUS2 KVKey {
+		static constexpr uint64_t Hash(std::string_view str)
+		{
+			uint64_t hash = 14'695'981'039'346'656'037ull;
+			for(auto c : str) {
+				hash ^= static_cast<uint8_t>(c);
+				hash *= 1'099'511'628'211ull;
+			}
+			return hash;
+		}
+		template<size_t N>
+		consteval KVKey(const char (&str)[N]) : name {str, N - 1}, hash {Hash(name)}
+		{
+		}
+		// Writable buffers may be terminated before their end
+		template<size_t N>
+		KVKey(char (&str)[N]) : KVKey {std::string_view {str}}
+		{
+		}
+		template<typename T>
+		    requires(std::is_same_v<T, const char *> || std::is_same_v<T, char *>)
+		KVKey(T str) : KVKey {std::string_view {str}}
+		{
+		}
+		KVKey(const std::string &str) : name {str}, hash {Hash(name)} {}
+		KVKey(std::string_view str) : name {str}, hash {Hash(name)} {}
+		std::string_view name;
+		uint64_t hash;
+	};
+	// Transparent hash and equality for maps with string keys, which allows looking them up by KVKey without allocating or rehashing
+	struct DLLUS2 KVKeyHash {
+		using is_transparent = void;
+		size_t operator()(const KVKey &key) const { return static_cast<size_t>(key.hash); }
+		size_t operator()(const std::string &str) const { return static_cast<size_t>(KVKey::Hash(str)); }
+	};
+	struct DLLUS2 KVKeyEqual {
+		using is_transparent = void;
+		bool operator()(const KVKey &a, const KVKey &b) const { return a.name == b.name; }
+		// Stored keys are compared by name, without hashing them again
+		bool operator()(const KVKey &a, const std::string &b) const { return a.name == b; }
+		bool operator()(const std::string &a, const KVKey &b) const { return a == b.name; }
+		bool operator()(const std::string &a, const std::string &b) const { return a == b; }
+	};
+	template<typename T>
+	using KVKeyMap = std::unordered_map<std::string, T, KVKeyHash, KVKeyEqual>;
+
 	class DLLUS2 IKeyValueCollection : public std::enable_shared_from_this<IKeyValueCollection> {
 	  public:
 		IKeyValueCollection() = default;
 		virtual ~IKeyValueCollection() = default;
 
-		IKeyValueCollection *FindSubCollection(const std::string &key);
-		BinaryBlob *FindBinaryBlob(const std::string &key);
+		IKeyValueCollection *FindSubCollection(KVKey key);
+		// Returns nullptr if the blob only exists as a view, use FindBinaryBlobView to handle both cases
+		BinaryBlob *FindBinaryBlob(KVKey key);
+		std::optional<std::span<const uint8_t>> FindBinaryBlobView(KVKey key);
 
 		template<typename T>
-		T FindValue(const std::string &key, const T &def);
+		T FindValue(KVKey key, const T &def);
 		template<typename T>
-		std::optional<T> FindValue(const std::string &key);
+		std::optional<T> FindValue(KVKey key);
 		template<typename T>
-		std::optional<T> FindValue(const std::string &key) const;
+		std::optional<T> FindValue(KVKey key) const;
 		template<typename T>
-		std::vector<T> FindArrayValues(const std::string &key);
+		std::vector<T> FindArrayValues(KVKey key);
+		// Returns a view of the array elements if they are stored contiguously as T, use FindArrayValues to handle both cases
+		template<typename T>
+		std::optional<std::span<const T>> FindArrayView(KVKey key);
 
 		template<typename T>
-		static std::optional<T> FindValue(IKeyValueCollection &collection, const std::string &key);
+		static std::optional<T> FindValue(IKeyValueCollection &collection, KVKey key);
+		template<typename T>
+		static std::optional<T> FindValue(const IKeyValueCollection &collection, KVKey key);
 		template<typename T>
-		static std::optional<T> FindValue(const IKeyValueCollection &collection, const std::string &key);
+		static std::vector<T> FindArrayValues(IKeyValueCollection &collection, KVKey key);
 		template<typename T>
-		static std::vector<T> FindArrayValues(IKeyValueCollection &collection, const std::string &key);
+		static std::optional<std::span<const T>> FindArrayView(IKeyValueCollection &collection, KVKey key);
 	};
 
 	template<typename T>
@@ -92,23 +165,24 @@ export namespace source2::resource {
 	  public:
 		NTROStruct(const std::string &name);
 		NTROStruct(const std::vector<std::shared_ptr<NTROValue>> &values);
-		const std::unordered_map<std::string, std::shared_ptr<NTROValue>> &GetContents() const;
-		BinaryBlob *FindBinaryBlob(const std::string &key);
-		NTROValue *FindValue(const std::string &key);
-		const NTROValue *FindValue(const std::string &key) const;
-		NTROArray *FindArray(const std::string &key);
-		const NTROArray *FindArray(const std::string &key) const;
+		const KVKeyMap<std::shared_ptr<NTROValue>> &GetContents() const;
+		BinaryBlob *FindBinaryBlob(KVKey key);
+		std::optional<std::span<const uint8_t>> FindBinaryBlobView(KVKey key);
+		NTROValue *FindValue(KVKey key);
+		const NTROValue *FindValue(KVKey key) const;
+		NTROArray *FindArray(KVKey key);
+		const NTROArray *FindArray(KVKey key) const;
 		void Add(const std::string &id, NTROValue &val);
 		void DebugPrint(std::stringstream &ss, const std::string &t = "") const;
 
 		template<typename T>
-		std::vector<T> FindArrayValues(const std::string &key);
+		std::vector<T> FindArrayValues(KVKey key);
 
 		template<typename T>
-		std::optional<T> FindValue(const std::string &key);
+		std::optional<T> FindValue(KVKey key);
 	  private:
 		std::string m_name;
-		std::unordered_map<std::string, std::shared_ptr<NTROValue>> m_contents;
+		KVKeyMap<std::shared_ptr<NTROValue>> m_contents;
 	};
 
 	class DLLUS2 NTRO : public ResourceData {
@@ -120,9 +194,12 @@ export namespace source2::resource {
 	  private:
 		std::shared_ptr<NTROStruct> m_output = nullptr;
 		std::string m_structName;
-		std::shared_ptr<NTROStruct> ReadStructure(const Resource &resource, const ResourceIntrospectionManifest::ResourceDiskStruct &refStruct, int64_t startingOffset, ufile::IFile &f);
-		void ReadFieldIntrospection(const Resource &resource, const ResourceIntrospectionManifest::ResourceDiskStruct::Field &field, NTROStruct &structEntry, ufile::IFile &f);
-		std::shared_ptr<NTROValue> ReadField(const Resource &resource, const ResourceIntrospectionManifest::ResourceDiskStruct::Field &field, bool pointer, ufile::IFile &f);
+		// The block data is decoded from memory, offsets are file offsets
+		struct DataSource;
+		std::shared_ptr<NTROStruct> ReadStructure(const DataSource &source, const ResourceIntrospectionManifest::DecodePlan &plan, size_t startingOffset);
+		void ReadFieldIntrospection(const DataSource &source, const ResourceIntrospectionManifest::DecodePlan::Field &field, size_t offset, NTROStruct &structEntry);
+		// Reads a single value at 'offset' and advances it past the value
+		std::shared_ptr<NTROValue> ReadField(const DataSource &source, const ResourceIntrospectionManifest::DecodePlan::Field &field, bool pointer, size_t &offset);
 	};
 
 	class DLLUS2 Panorama : public ResourceData {
@@ -181,6 +258,9 @@ export namespace source2::resource {
 		virtual BlockType GetType() const override;
 
 		const std::shared_ptr<IKeyValueCollection> &GetData() const;
+		// Returns the data if it has been loaded. Otherwise, if the KV3 data was loaded with KV3Representation::Raw,
+		// only the specified key paths are decoded (see BinaryKV3::Project).
+		std::shared_ptr<IKeyValueCollection> GetData(std::span<const std::string_view> paths) const;
 		const std::shared_ptr<ResourceData> &GetBakingData() const;
 	  protected:
 		std::shared_ptr<IKeyValueCollection> m_data = nullptr;
@@ -196,10 +276,14 @@ export namespace source2::resource {
 		World(Resource &resource);
 		std::vector<std::string> GetEntityLumpNames() const;
 		std::vector<std::string> GetWorldNodeNames() const;
-		std::shared_ptr<Scene> Load();
+		// World nodes, entity lumps and the resources they reference are loaded in parallel with the specified number of threads (including the calling thread).
+		// Calls to the asset file loader are serialized unless ResourceLoadOptions::threadSafeAssetLoader is set.
+		// The resulting scene does not depend on the number of threads.
+		std::shared_ptr<Scene> Load(uint32_t numThreads = 1);
+		// Same as above, but the work is executed by the workers of the specified pool and the calling thread
+		std::shared_ptr<Scene> Load(ThreadPool &threadPool);
 	  private:
 		Resource &m_resource;
-		void LoadEntitiesFromLump(EntityLump &entityLump, const std::string &lumpName, Scene &scene);
 	};
 
 	class Scene;
@@ -356,7 +440,7 @@ export namespace source2::resource {
 		std::vector<std::string> GetChildEntityNames() const;
 		std::vector<std::shared_ptr<Entity>> GetEntities() const;
 	  private:
-		std::shared_ptr<Entity> ParseEntityProperties(const std::vector<uint8_t> &bytes) const;
+		std::shared_ptr<Entity> ParseEntityProperties(std::span<const uint8_t> bytes) const;
 		void ReadTypedValue(pragma::util::DataStream &ds, uint32_t keyHash, const std::optional<std::string> &keyName, std::unordered_map<uint32_t, EntityProperty> &properties) const;
 	};
 
@@ -584,6 +668,10 @@ export namespace source2::resource {
 	class DLLUS2 Texture : public ResourceData {
 	  public:
 		static void UncompressBC7(uint32_t RowBytes, pragma::util::DataStream &ds, std::vector<uint8_t> &data, int w, int h, bool hemiOctRB, bool invert);
+		// Decodes a BC7 image into BGRA8 texels, only texels within width x height are written.
+		// Block rows are decoded on up to 'numThreads' threads.
+		static void UncompressBC7(std::span<const uint8_t> input, std::span<uint8_t> output, uint32_t rowPitch, uint32_t width, uint32_t height, bool hemiOctRB, bool invert, uint32_t numThreads = 1);
+		static void UncompressBC7(std::span<const uint8_t> input, std::span<uint8_t> output, uint32_t rowPitch, uint32_t width, uint32_t height, bool hemiOctRB, bool invert, ThreadPool &threadPool);
 		uint16_t GetVersion() const;
 		uint16_t GetWidth() const;
 		uint16_t GetHeight() const;
@@ -597,14 +685,101 @@ export namespace source2::resource {
 		virtual void Read(const Resource &resource, ufile::IFile &f) override;
 		virtual void DebugPrint(std::stringstream &ss, const std::string &t = "") const override;
 
-		uint32_t GetBlockSize();
-		uint64_t GetMipmapDataOffset(uint8_t mipmap);
+		// Location of a single mipmap within the resource file
+		struct MipInfo {
+			uint64_t offset = 0;
+			// Number of bytes stored in the file, smaller than 'size' if the mipmap is LZ4-compressed
+			uint32_t storedSize = 0;
+			uint32_t size = 0;
+			bool IsCompressed() const { return storedSize < size; }
+		};
+
+		uint32_t GetBlockSize() const;
+		uint64_t GetMipmapDataOffset(uint8_t mipmap) const;
+		// Returns nullptr if the mip level does not exist
+		const MipInfo *GetMipInfo(uint8_t mipLevel) const;
+
+		struct DecodedMipChain {
+			// All decoded mipmaps with tightly packed rows, in order of their mip level
+			std::vector<uint8_t> data;
+			// Offset of each mip level within 'data'
+			std::vector<size_t> mipOffsets;
+		};
+
+		// Post-processing of decoded texels, only applies to formats which are decoded to 8-bit RGBA or BGRA
+		struct DecodeOptions {
+			// Reconstructs the normal from a hemi-octahedron encoded red/green pair
+			bool hemiOctRB = false;
+			// Inverts the green channel
+			bool invert = false;
+		};
 
-		void ReadTextureData(uint8_t mipLevel, std::vector<uint8_t> &outData);
-		std::vector<uint8_t> GetDecompressedTextureAtMipLevel(int mipLevel);
+		// Texel layout of the data returned by GetDecompressedTextureAtMipLevel, DecodeTextureData and DecodeAllMips
+		enum class DecodedFormat : uint8_t {
+			BGRA8 = 0, // All block-compressed formats except BC6H, and BGRA8888
+			RGBA8,     // RGBA8888
+			RGBA16F,   // BC6H and RGBA16161616F
+			RGBA32F,   // RGBA32323232F
+			Stored,    // Any other uncompressed format is returned as stored, see GetFormat
+		};
 
-		uint32_t CalculateBufferSizeForMipLevel(uint8_t mipLevel);
+		// Buffer sizes required for DecodeTextureData
+		struct DecodeBufferSizes {
+			size_t outputSize = 0;
+			// Zero if no scratch memory is required
+			size_t scratchSize = 0;
+			uint32_t rowPitch = 0;
+		};
+
+		// Reading texture data is thread-safe, different mipmaps of the same texture can be read concurrently
+		void ReadTextureData(uint8_t mipLevel, std::vector<uint8_t> &outData) const;
+		// Writes the (LZ4-decompressed) mipmap data into the specified buffer, which must be at least GetMipInfo(mipLevel)->size bytes large
+		void ReadTextureData(uint8_t mipLevel, std::span<uint8_t> outData) const;
+		// Reads the mipmaps [firstMipLevel, lastMipLevel], the result is indexed by mipLevel - firstMipLevel
+		std::vector<std::vector<uint8_t>> ReadTextureDataRange(uint8_t firstMipLevel, uint8_t lastMipLevel) const;
+		// Returns the mipmap data without copying it, only available if the mipmap is stored uncompressed
+		std::optional<std::span<const uint8_t>> GetMappedTextureData(uint8_t mipLevel) const;
+		// Decodes block-compressed formats to BGRA8 (RGBA16F for BC6H), uncompressed formats are returned as stored.
+		// The resulting layout is reported by GetDecodedFormat.
+		std::vector<uint8_t> GetDecompressedTextureAtMipLevel(int mipLevel, const DecodeOptions &options = {}) const;
+		DecodedFormat GetDecodedFormat() const;
+		// Size of a texel decoded by DecodeTextureData in bytes
+		uint32_t GetDecodedTexelSize() const;
+		// Applies the decode options to texels with four 8-bit channels in place, using the same kernels as the decoders.
+		// 'rgba' selects RGBA instead of BGRA channel order.
+		static void ApplyDecodeOptions(std::span<uint8_t> texels, const DecodeOptions &options, bool rgba = false);
+
+		// Block-compressed formats which can be decoded without a texture resource. The signed variants don't occur in texture resources.
+		enum class BlockFormat : uint8_t { BC1 = 0, BC3, BC4, BC5, BC6H, BC7, ETC2, ETC2_EAC, BC4_SNORM, BC5_SNORM, BC6H_SF16 };
+		// Decodes a block-compressed image into BGRA8 texels (RGBA16F for both BC6H variants), only texels within width x height are written.
+		// Signed BC4 and BC5 channels are remapped from [-1, 1] to [0, 255].
+		static void DecodeBlocks(BlockFormat format, std::span<const uint8_t> input, std::span<uint8_t> output, uint32_t rowPitch, uint32_t width, uint32_t height, const DecodeOptions &options = {}, uint32_t numThreads = 1);
+		// A row pitch of 0 corresponds to tightly packed rows
+		DecodeBufferSizes GetDecodeBufferSizes(uint8_t mipLevel, uint32_t rowPitch = 0) const;
+		// Decodes the mipmap into the output buffer, slices of volume textures are stored one after another.
+		// No memory is allocated if the scratch buffer is at least as large as reported by GetDecodeBufferSizes.
+		void DecodeTextureData(uint8_t mipLevel, std::span<uint8_t> output, uint32_t rowPitch = 0, std::span<uint8_t> scratch = {}, const DecodeOptions &options = {}) const;
+		// Decompresses and decodes all mipmaps, the work is split across 'numThreads' threads (including the calling thread)
+		DecodedMipChain DecodeAllMips(uint32_t numThreads = 1, const DecodeOptions &options = {}) const;
+		// Same as above, but the work is executed by the workers of the pool and the calling thread. Sharing a pool
+		// avoids starting new threads for every texture when decoding many textures.
+		DecodedMipChain DecodeAllMips(ThreadPool &threadPool, const DecodeOptions &options = {}) const;
+		// 6 for cube maps, 1 otherwise
+		uint32_t GetFaceCount() const;
+
+		// Writes the stored texture data into a DDS (with DX10 header) or KTX2 container without decoding it. Textures with a
+		// non-power-of-two size are cropped. Returns false if the container does not support the texture format.
+		// Texture resources don't store whether their colors are sRGB-encoded, that depends on how a material uses them.
+		// If 'srgb' is set, formats with an sRGB variant (BC1, BC3, BC7, ETC2 and 8-bit RGBA/BGRA) are exported as such.
+		bool ExportDDS(std::vector<uint8_t> &outData, bool srgb = false) const;
+		bool ExportKTX2(std::vector<uint8_t> &outData, bool srgb = false) const;
+
+		uint32_t CalculateBufferSizeForMipLevel(uint8_t mipLevel) const;
 	  private:
+		// 'outNumSlices' includes the faces of cube maps
+		void GetMipDimensions(uint8_t mipLevel, uint32_t &outWidth, uint32_t &outHeight, uint32_t &outNumSlices) const;
+		// Depth of a volume texture or number of array layers
+		uint32_t GetMipDepth(uint8_t mipLevel) const;
 		VTexFlags m_flags = VTexFlags::None;
 		Vector4 m_reflectivity = {};
 		uint16_t m_width = 0u;
@@ -617,7 +792,10 @@ export namespace source2::resource {
 		std::unordered_map<VTexExtraData, std::vector<uint8_t>> m_extraData {};
 		uint32_t m_nonPow2Width = 0u;
 		uint32_t m_nonPow2Height = 0u;
-		ufile::IFile *m_file = nullptr;
+		// Shared with the resource if it was loaded from memory, otherwise the file contents are read into memory when the texture is read.
+		// Mipmaps are read by offset, without any shared cursor.
+		std::shared_ptr<const MappedFile> m_mappedFile = nullptr;
+		std::vector<MipInfo> m_mipInfos {};
 
 		bool m_isCompressed = false;
 		std::vector<int32_t> m_compressedMips = {};
@@ -644,31 +822,46 @@ export namespace source2::resource {
 		INT64_ONE = 16,
 		DOUBLE_ZERO = 17,
 		DOUBLE_ONE = 18,
+		// Only occur in the binary data of KV3\x04 and newer, the values are reported as DOUBLE, INT32 and UINT32
+		FLOAT = 19,
+		INT16 = 20,
+		UINT16 = 21,
 	};
 	DLLUS2 std::string to_string(KVType type);
 
 	enum class KVFlag : uint8_t { None, Resource, DeferredResource };
 
-	class DLLUS2 KVValue : public std::enable_shared_from_this<KVValue> {
+	// Array elements are stored by value in their KVObject, object members are owned by a shared_ptr.
+	// Copies share the stored object.
+	class DLLUS2 KVValue {
 	  public:
 		KVValue(KVType type, std::shared_ptr<void> value, KVFlag flags = KVFlag::None);
+		KVValue(const BinaryBlobView &blobView, KVFlag flags = KVFlag::None);
 		void *GetObject();
 		const void *GetObject() const;
 		KVFlag GetFlags() const;
 		KVType GetType() const;
+		bool IsBinaryBlobView() const;
 		void DebugPrint(std::stringstream &ss, const std::string &t = "") const;
 		template<typename T>
 		std::optional<T> GetObjectValue()
 		{
 			if constexpr(std::is_same_v<T, std::nullptr_t>)
 				return {};
+			else if constexpr(std::is_same_v<T, std::span<const uint8_t>>) {
+				if(GetType() != KVType::BINARY_BLOB)
+					return {};
+				if(m_isBlobView)
+					return static_cast<BinaryBlobView *>(GetObject())->data;
+				return std::span<const uint8_t> {*static_cast<BinaryBlob *>(GetObject())};
+			}
 			else if constexpr(std::is_same_v<T, const std::string *> || std::is_same_v<T, std::string *>) {
 				if(GetType() != KVType::STRING)
 					return {};
 				return static_cast<std::string *>(GetObject());
 			}
 			else if constexpr(std::is_same_v<T, const BinaryBlob *> || std::is_same_v<T, BinaryBlob *>) {
-				if(GetType() != KVType::BINARY_BLOB)
+				if(GetType() != KVType::BINARY_BLOB || m_isBlobView)
 					return {};
 				return static_cast<BinaryBlob *>(GetObject());
 			}
@@ -687,6 +880,7 @@ export namespace source2::resource {
 		std::shared_ptr<void> m_object = nullptr;
 		KVFlag m_flags = KVFlag::None;
 		KVType m_type = KVType::Invalid;
+		bool m_isBlobView = false;
 	};
 
 	template<typename T>
@@ -722,35 +916,63 @@ export namespace source2::resource {
 	class DLLUS2 KVObject : public std::enable_shared_from_this<KVObject>, public IKeyValueCollection {
 	  public:
 		KVObject(const std::string &name, bool isArray = false);
-		void AddProperty(const std::string &name, KVValue &value);
-		const std::unordered_map<std::string, std::shared_ptr<KVValue>> &GetValues() const;
-		KVValue *FindValue(const std::string &key);
-		const KVValue *FindValue(const std::string &key) const;
-		KVObject *FindArray(const std::string &key);
-		const KVObject *FindArray(const std::string &key) const;
-		BinaryBlob *FindBinaryBlob(const std::string &key);
+		// The value is copied into the array storage or into a new object member, the copy shares the stored object
+		void AddProperty(const std::string &name, const KVValue &value);
+		// Object members keep the value itself, array elements are copied
+		void AddProperty(const std::string &name, const std::shared_ptr<KVValue> &value);
+		// Constructs the value in place, without a separate allocation for array elements
+		template<typename... TArgs>
+		void EmplaceProperty(const std::string &name, TArgs &&...args)
+		{
+			if(m_isArray) {
+				m_arrayValues.emplace_back(std::forward<TArgs>(args)...);
+				return;
+			}
+			m_values.insert(std::make_pair(name, std::make_shared<KVValue>(std::forward<TArgs>(args)...)));
+		}
+		const KVKeyMap<std::shared_ptr<KVValue>> &GetValues() const;
+		KVValue *FindValue(KVKey key);
+		const KVValue *FindValue(KVKey key) const;
+		KVObject *FindArray(KVKey key);
+		const KVObject *FindArray(KVKey key) const;
+		BinaryBlob *FindBinaryBlob(KVKey key);
+		std::optional<std::span<const uint8_t>> FindBinaryBlobView(KVKey key);
 		template<typename T>
-		std::vector<T> FindArrayValues(const std::string &key)
+		std::vector<T> FindArrayValues(KVKey key)
 		{
 			auto *array = FindArray(key);
 			if(array == nullptr)
 				return {};
-			auto n = array->GetArrayCount();
+			if(array->HasTypedArray())
+				return array->CopyTypedArray<T>();
+			auto values = array->GetArrayValues();
 
 			std::vector<T> arrayElements {};
-			arrayElements.reserve(n);
-			for(auto i = decltype(n) {0u}; i < n; ++i) {
-				auto v = array->GetArrayValue<T>(i);
+			arrayElements.reserve(values.size());
+			for(auto &val : values) {
+				auto v = val.GetObjectValue<T>();
 				if(v.has_value() == false)
 					continue;
 				arrayElements.push_back(*v);
 			}
 			return arrayElements;
 		}
+		template<typename T>
+		std::optional<std::span<const T>> FindArrayView(KVKey key)
+		{
+			auto *array = FindArray(key);
+			if(array == nullptr)
+				return {};
+			return array->GetTypedArray<T>();
+		}
 
 		template<typename T>
-		std::optional<T> FindValue(const std::string &key, std::optional<KVType> optTypeFilter = {})
+		std::optional<T> FindValue(KVKey key, std::optional<KVType> optTypeFilter = {})
 		{
+			if(HasTypedArray()) {
+				auto idx = ParseArrayIndex(key);
+				return idx.has_value() ? GetArrayValue<T>(*idx, optTypeFilter) : std::optional<T> {};
+			}
 			auto *val = FindValue(key);
 			if(val == nullptr || (optTypeFilter.has_value() && val->GetType() != *optTypeFilter))
 				return {};
@@ -759,21 +981,250 @@ export namespace source2::resource {
 
 		bool IsArray() const;
 		uint32_t GetArrayCount() const;
+		void ReserveArray(uint32_t count);
+
+		// Typed arrays of numbers, booleans and strings are stored in a single buffer, which is read by FindArrayValues, FindArrayView,
+		// FindValue<T> and GetArrayValue<T> without creating any KVValues. The KVValues of the elements are only created the
+		// first time they're accessed through GetArrayValues, GetArrayValue or FindValue, which is thread-safe.
+		using TypedArray = std::variant<std::monostate, std::vector<int32_t>, std::vector<uint32_t>, std::vector<int64_t>, std::vector<uint64_t>, std::vector<double>, std::vector<bool>, std::vector<std::string>>;
+		// Must be called before the array elements are accessed
+		void SetTypedArray(TypedArray &&values);
+		bool HasTypedArray() const;
+		// Returns an empty optional if the elements are not stored as T. Booleans are bit-packed and can't be viewed.
+		template<typename T>
+		std::optional<std::span<const T>> GetTypedArray() const
+		{
+			if constexpr(std::is_same_v<T, bool>)
+				return {};
+			else {
+				auto *values = std::get_if<std::vector<T>>(&m_typedArray);
+				if(values == nullptr)
+					return {};
+				return std::span<const T> {*values};
+			}
+		}
+		// Creates a KVValue for every element of the typed array, the typed buffer is kept.
+		// Called implicitly by the accessors below, does nothing if the values already exist.
+		void MaterializeTypedArray();
 
+		// Array elements are stored contiguously in insertion order
+		std::span<KVValue> GetArrayValues();
+		std::span<const KVValue> GetArrayValues() const;
 		KVValue *GetArrayValue(uint32_t idx, std::optional<KVType> confirmType = {});
 		const KVValue *GetArrayValue(uint32_t idx, std::optional<KVType> confirmType = {}) const;
 		template<typename T>
 		std::optional<T> GetArrayValue(uint32_t idx, std::optional<KVType> confirmType = {})
 		{
+			if(HasTypedArray()) {
+				return std::visit(
+				  [idx, &confirmType](const auto &values) -> std::optional<T> {
+					  using TValues = std::remove_cvref_t<decltype(values)>;
+					  if constexpr(std::is_same_v<TValues, std::monostate>)
+						  return {};
+					  else {
+						  using TElement = typename TValues::value_type;
+						  if(idx >= values.size() || (confirmType.has_value() && *confirmType != GetTypedArrayElementType<TElement>()))
+							  return {};
+						  return cast_to_type<TElement, T>(values[idx]);
+					  }
+				  },
+				  m_typedArray);
+			}
 			auto *val = GetArrayValue(idx, confirmType);
 			return val ? val->GetObjectValue<T>() : std::optional<T> {};
 		}
 		void DebugPrint(std::stringstream &ss, const std::string &t = "") const;
 	  private:
+		template<typename T>
+		std::vector<T> CopyTypedArray() const
+		{
+			return std::visit(
+			  [](const auto &values) -> std::vector<T> {
+				  using TValues = std::remove_cvref_t<decltype(values)>;
+				  if constexpr(std::is_same_v<TValues, std::monostate>)
+					  return {};
+				  else if constexpr(std::is_same_v<typename TValues::value_type, T>)
+					  return values;
+				  else {
+					  std::vector<T> arrayElements {};
+					  arrayElements.reserve(values.size());
+					  for(auto &&v : values) {
+						  auto o = cast_to_type<typename TValues::value_type, T>(v);
+						  if(o.has_value())
+							  arrayElements.push_back(*o);
+					  }
+					  return arrayElements;
+				  }
+			  },
+			  m_typedArray);
+		}
+		template<typename TElement>
+		static constexpr KVType GetTypedArrayElementType()
+		{
+			if constexpr(std::is_same_v<TElement, int32_t>)
+				return KVType::INT32;
+			else if constexpr(std::is_same_v<TElement, uint32_t>)
+				return KVType::UINT32;
+			else if constexpr(std::is_same_v<TElement, int64_t>)
+				return KVType::INT64;
+			else if constexpr(std::is_same_v<TElement, uint64_t>)
+				return KVType::UINT64;
+			else if constexpr(std::is_same_v<TElement, bool>)
+				return KVType::BOOLEAN;
+			else if constexpr(std::is_same_v<TElement, std::string>)
+				return KVType::STRING;
+			else
+				return KVType::DOUBLE;
+		}
+		static std::optional<uint32_t> ParseArrayIndex(KVKey key);
+		// Copies of a KVObject start with an unset flag, MaterializeTypedArray skips arrays whose values already exist
+		struct MaterializeOnce {
+			MaterializeOnce() = default;
+			MaterializeOnce(const MaterializeOnce &) {}
+			MaterializeOnce &operator=(const MaterializeOnce &) { return *this; }
+			std::once_flag flag {};
+		};
 		std::string m_key;
-		std::unordered_map<std::string, std::shared_ptr<KVValue>> m_values;
+		KVKeyMap<std::shared_ptr<KVValue>> m_values;
+		std::vector<KVValue> m_arrayValues;
+		TypedArray m_typedArray;
+		MaterializeOnce m_materializeOnce {};
 		bool m_isArray = false;
-		uint32_t m_count = 0u;
+	};
+
+	struct DLLUS2 KV3Node {
+		KVType type = KVType::Null;
+		KVFlag flags = KVFlag::None;
+		uint32_t count = 0u; // Number of members for objects and arrays, size in bytes for binary blobs
+		struct Container {
+			uint32_t firstMember;
+			uint32_t collection;
+		};
+		union {
+			int64_t int64 = 0;
+			uint64_t uint64;
+			int32_t int32;
+			uint32_t uint32;
+			double float64;
+			bool boolean;
+			int32_t stringId;
+			uint32_t blobIndex;
+			Container container;
+		};
+	};
+
+	struct DLLUS2 KV3Member {
+		int32_t keyId = -1; // Index into the string table, -1 for array elements
+		uint32_t node = 0u;
+	};
+
+	class KV3Document;
+	class DLLUS2 KV3Collection : public IKeyValueCollection {
+	  public:
+		KV3Collection(const KV3Document &document, uint32_t node);
+		const KV3Document &GetDocument() const;
+		const KV3Node &GetNode() const;
+		bool IsArray() const;
+		uint32_t GetCount() const;
+		const KV3Node *FindNode(KVKey key) const;
+		const KV3Node *GetArrayNode(uint32_t idx) const;
+		BinaryBlob *FindBinaryBlob(KVKey key) const;
+		std::optional<std::span<const uint8_t>> FindBinaryBlobView(KVKey key) const;
+		void DebugPrint(std::stringstream &ss, const std::string &t = "") const;
+
+		template<typename T>
+		std::optional<T> FindValue(KVKey key) const;
+		template<typename T>
+		std::vector<T> FindArrayValues(KVKey key) const;
+	  private:
+		const KV3Document *m_document = nullptr;
+		uint32_t m_node = 0u;
+	};
+
+	// Alternative to the KVObject tree: All values of a KV3 block are stored inline in a single node array,
+	// strings are referenced by their index in the string table and the entire document is released at once.
+	class DLLUS2 KV3Document {
+	  public:
+		KV3Document(std::vector<std::string> &&strings);
+		KV3Document(const KV3Document &) = delete;
+		KV3Document &operator=(const KV3Document &) = delete;
+
+		const std::vector<std::string> &GetStrings() const;
+		const std::string &GetString(int32_t id) const;
+		const std::vector<KV3Node> &GetNodes() const;
+		const KV3Node &GetNode(uint32_t idx) const;
+		std::span<const KV3Member> GetMembers(const KV3Node &node) const;
+		const KV3Node *FindMember(const KV3Node &node, KVKey key) const;
+		const KV3Node *GetArrayElement(const KV3Node &node, uint32_t idx) const;
+		KV3Collection *GetCollection(const KV3Node &node) const;
+		// Returns nullptr if the document aliases the decompressed block data, use GetBinaryBlobView in that case
+		BinaryBlob *GetBinaryBlob(const KV3Node &node) const;
+		std::span<const uint8_t> GetBinaryBlobView(const KV3Node &node) const;
+		KV3Collection &GetRoot();
+		const KV3Collection &GetRoot() const;
+		void DebugPrint(std::stringstream &ss, const std::string &t = "") const;
+
+		template<typename T>
+		std::optional<T> GetValue(const KV3Node &node) const;
+	  private:
+		friend class BinaryKV3;
+		void DebugPrint(std::stringstream &ss, const KV3Node &node, const std::string &t) const;
+		std::vector<std::string> m_strings;
+		std::vector<uint64_t> m_stringHashes;
+		std::vector<KV3Node> m_nodes;
+		std::vector<KV3Member> m_members;
+		std::vector<BinaryBlob> m_blobs;
+		std::vector<std::span<const uint8_t>> m_blobViews;
+		pragma::util::DataStream m_buffer {};
+		std::vector<KV3Collection> m_collections;
+	};
+
+	// Receives the values of a KV3 block in document order. Members of an object are preceded by a Key event,
+	// array elements are not. Keys, strings and blobs are views into the KV3 data and are only valid during the call.
+	class DLLUS2 KV3Visitor {
+	  public:
+		virtual ~KV3Visitor() = default;
+		// Returning false skips the contents of the container, the matching End event is not reported in that case
+		virtual bool BeginObject(uint32_t memberCount, KVFlag flags) { return true; }
+		virtual void EndObject() {}
+		virtual bool BeginArray(uint32_t elementCount, KVFlag flags) { return true; }
+		virtual void EndArray() {}
+		// 'stringId' is the index into the string table, -1 for empty keys
+		virtual void Key(std::string_view key, int32_t stringId) {}
+		// Null, boolean, integer, floating point and string values, binary-only types are converted to their generic type.
+		// 'str' is only set for strings.
+		virtual void Scalar(const KV3Node &value, std::string_view str) {}
+		virtual void Blob(std::span<const uint8_t> data, KVFlag flags) {}
+		// Typed arrays of 32-bit or 64-bit integers and doubles are offered as a single block of 'count' tightly packed
+		// little-endian values, which may not be aligned. Booleans are offered as one byte per element and strings as
+		// 32-bit indices into the string table (-1 for empty strings).
+		// Returning false reports the array as BeginArray, Scalar and EndArray events instead.
+		virtual bool TypedArray(KVType elementType, std::span<const uint8_t> data, uint32_t count, KVFlag flags) { return false; }
+	};
+
+	// Reads binary KV3 data without building a tree. Nested containers are tracked on an explicit stack, so the
+	// nesting depth is not limited by the call stack and no memory is allocated per value.
+	class DLLUS2 KV3Reader {
+	  public:
+		// 'offset' is the start of the KV data within 'data'. The types array and the binary and eight-byte offsets
+		// are only used by KV3 version 2, which stores these values in separate sections.
+		// If 'blobSizes' is not empty, binary blobs are stored one after another from 'blobsOffset' on instead of in the binary section.
+		// 'twoBytesOffset' is the start of the two-byte value section of KV3\x04.
+		KV3Reader(std::span<const uint8_t> data, size_t offset, std::span<const std::string> strings, std::span<const uint8_t> types = {}, int64_t binaryBytesOffset = -1, int64_t eightBytesOffset = -1, std::span<const uint32_t> blobSizes = {},
+		  size_t blobsOffset = 0, int64_t twoBytesOffset = -1);
+		// Reports the root value and all of its descendants to the visitor, can be called multiple times
+		void Read(KV3Visitor &visitor) const;
+	  private:
+		struct Cursor;
+		std::span<const uint8_t> m_data;
+		size_t m_offset = 0;
+		std::span<const std::string> m_strings;
+		std::span<const uint8_t> m_types;
+		int64_t m_binaryBytesOffset = -1;
+		int64_t m_eightBytesOffset = -1;
+		std::span<const uint32_t> m_blobSizes;
+		size_t m_blobsOffset = 0;
+		int64_t m_twoBytesOffset = -1;
 	};
 
 	class DLLUS2 BinaryKV3 : public ResourceData {
@@ -783,14 +1234,30 @@ export namespace source2::resource {
 		static const pragma::util::GUID KV3_ENCODING_BINARY_BLOCK_LZ4;
 		static const pragma::util::GUID KV3_FORMAT_GENERIC;
 		static constexpr int32_t MAGIC = 0x03564B56;  // VKV3 (3 isn't ascii, its 0x03)
-		static constexpr int32_t MAGIC2 = 0x4B563301; // KV3\x01
+		static constexpr int32_t MAGIC2 = 0x4B563301; // KV3\x01, the lowest byte is the version
 		static const std::array<uint8_t, 16> ENCODING;
 		static const std::array<uint8_t, 16> FORMAT;
 		static const std::array<uint8_t, 4> SIG; // VKV3 (3 isn't ascii, its 0x03)
+		// True for MAGIC and KV3\x01 to KV3\xFF. Only KV3\x01 to KV3\x04 can be read, newer versions are rejected when the block is read.
+		static bool IsMagic(uint32_t magic);
+		// Decodes KV3_ENCODING_BINARY_BLOCK_COMPRESSED data, including the leading flags. Truncated input yields the bytes
+		// decoded so far, invalid back-references throw.
+		static void BlockDecompress(std::span<const uint8_t> input, pragma::util::DataStream &outData);
 
 		const std::vector<std::string> &GetStringArray() const;
 		const std::shared_ptr<KVObject> &GetData() const;
 		std::shared_ptr<KVObject> &GetData();
+		// Only set if the resource was loaded with KV3Representation::Document
+		const std::shared_ptr<KV3Document> &GetDocument() const;
+		// Root collection of whichever representation was loaded, nullptr for KV3Representation::Raw
+		std::shared_ptr<IKeyValueCollection> GetCollection() const;
+		// Streams the values to the visitor, only available if the decompressed data was retained, i.e. if the resource
+		// was loaded with KV3Representation::Raw or with aliasBinaryBlobs enabled
+		void Visit(KV3Visitor &visitor) const;
+		// Builds a tree which only contains the values at the specified key paths and the containers leading to them,
+		// all other subtrees are skipped without being decoded. Keys are separated by '.', array elements are selected
+		// with [*] or [index], e.g. "m_materialGroups[*].m_materials". Has the same requirements as Visit.
+		std::shared_ptr<KVObject> Project(std::span<const std::string_view> paths) const;
 
 		virtual void Read(const Resource &resource, ufile::IFile &f) override;
 		void DebugPrint(std::stringstream &ss, const std::string &t = "") const;
@@ -798,81 +1265,185 @@ export namespace source2::resource {
 		BinaryKV3() = default;
 		BinaryKV3(BlockType type);
 	  private:
-		//template<class TKVValue,typename T>
-		//	static std::shared_ptr<KVValue> MakeValue(KVType type, T data, KVFlag flag);
-		//template<class TKVValue,typename TPtr=void>
-		//	static std::shared_ptr<KVValue> MakeValueFromPtr(KVType type, TPtr &data, KVFlag flag);
-		//template<class TKVValue>
-		//	static std::shared_ptr<KVValue> MakeValueFromPtr(KVType type, nullptr_t nptr, KVFlag flag);
-		static KVType ConvertBinaryOnlyKVType(KVType type);
-		static std::shared_ptr<KVValue> MakeValue(KVType type, std::shared_ptr<void> data, KVFlag flag);
-		void ReadVersion2(ufile::IFile &f, pragma::util::DataStream &outData);
-		void BlockDecompress(ufile::IFile &f, pragma::util::DataStream &outData);
-		void DecompressLZ4(ufile::IFile &f, pragma::util::DataStream &outData);
-		std::pair<KVType, KVFlag> ReadType(pragma::util::DataStream &ds);
-		std::shared_ptr<KVObject> ReadBinaryValue(const std::string &name, KVType datatype, KVFlag flagInfo, pragma::util::DataStream ds, std::shared_ptr<KVObject> optParent);
-		std::shared_ptr<KVObject> ParseBinaryKV3(pragma::util::DataStream &ds, std::shared_ptr<KVObject> optParent, bool inArray = false);
-		int64_t m_currentBinaryBytesOffset = -1;
-		int64_t m_currentEightBytesOffset = -1;
-		int64_t m_currentTypeIndex = 0;
+		class TreeBuilder;
+		class DocumentBuilder;
+		class ProjectionFilter;
+		KV3Reader CreateReader(const pragma::util::DataStream &ds) const;
+		void ReadVersion2(const Resource &resource, ufile::IFile &f, pragma::util::DataStream &outData, uint8_t version);
+		void DecompressLZ4(std::span<const uint8_t> input, pragma::util::DataStream &outData);
+		void Parse(const Resource &resource, pragma::util::DataStream &ds);
+		// Start of the binary and eight-byte value sections of KV3 version 2, -1 for version 1
+		int64_t m_binaryBytesOffset = -1;
+		int64_t m_eightBytesOffset = -1;
+		// Start of the two-byte value section of KV3\x04, -1 if there are no two-byte values
+		int64_t m_twoBytesOffset = -1;
+		// Sizes of the binary blobs of KV3\x02 and newer, which are decompressed to the end of the buffer starting at m_blobsOffset
+		std::vector<uint32_t> m_blobSizes = {};
+		size_t m_blobsOffset = 0;
 		std::vector<std::string> m_stringArray = {};
 		std::vector<uint8_t> m_typesArray = {};
-		bool m_hasTypesArray = false;
 		std::shared_ptr<KVObject> m_data = nullptr;
+		std::shared_ptr<KV3Document> m_document = nullptr;
+		// Decompressed block data, only kept if binary blobs alias it or for KV3Representation::Raw
+		pragma::util::DataStream m_buffer {};
+		bool m_bufferRetained = false;
+		size_t m_kvDataOffset = 0;
+		bool m_aliasBinaryBlobs = false;
 		BlockType m_blockType = BlockType::DATA;
 	};
 };
 
 template<typename T>
-T source2::resource::IKeyValueCollection::FindValue(const std::string &key, const T &def)
+T source2::resource::IKeyValueCollection::FindValue(KVKey key, const T &def)
 {
 	auto optVal = FindValue<T>(key);
 	return optVal.has_value() ? *optVal : def;
 }
 template<typename T>
-std::optional<T> source2::resource::IKeyValueCollection::FindValue(const std::string &key)
+std::optional<T> source2::resource::IKeyValueCollection::FindValue(KVKey key)
 {
 	return FindValue<T>(*this, key);
 }
 template<typename T>
-std::optional<T> source2::resource::IKeyValueCollection::FindValue(const std::string &key) const
+std::optional<T> source2::resource::IKeyValueCollection::FindValue(KVKey key) const
 {
 	return FindValue<T>(*this, key);
 }
 template<typename T>
-std::vector<T> source2::resource::IKeyValueCollection::FindArrayValues(const std::string &key)
+std::vector<T> source2::resource::IKeyValueCollection::FindArrayValues(KVKey key)
 {
 	return FindArrayValues<T>(*this, key);
 }
 
 template<typename T>
-std::optional<T> source2::resource::IKeyValueCollection::FindValue(IKeyValueCollection &collection, const std::string &key)
+std::optional<std::span<const T>> source2::resource::IKeyValueCollection::FindArrayView(KVKey key)
+{
+	return FindArrayView<T>(*this, key);
+}
+
+template<typename T>
+std::optional<T> source2::resource::IKeyValueCollection::FindValue(IKeyValueCollection &collection, KVKey key)
 {
 	if(typeid(collection) == typeid(NTROStruct))
 		return static_cast<NTROStruct &>(collection).FindValue<T>(key);
 	else if(typeid(collection) == typeid(KVObject))
 		return static_cast<KVObject &>(collection).FindValue<T>(key);
+	else if(typeid(collection) == typeid(KV3Collection))
+		return static_cast<KV3Collection &>(collection).FindValue<T>(key);
 	return {};
 }
 template<typename T>
-std::optional<T> source2::resource::IKeyValueCollection::FindValue(const IKeyValueCollection &collection, const std::string &key)
+std::optional<T> source2::resource::IKeyValueCollection::FindValue(const IKeyValueCollection &collection, KVKey key)
 {
 	return FindValue<T>(const_cast<IKeyValueCollection &>(collection), key);
 }
 template<typename T>
-std::vector<T> source2::resource::IKeyValueCollection::FindArrayValues(IKeyValueCollection &collection, const std::string &key)
+std::vector<T> source2::resource::IKeyValueCollection::FindArrayValues(IKeyValueCollection &collection, KVKey key)
 {
 	if(typeid(collection) == typeid(NTROStruct))
 		return static_cast<NTROStruct &>(collection).FindArrayValues<T>(key);
 	else if(typeid(collection) == typeid(KVObject))
 		return static_cast<KVObject &>(collection).FindArrayValues<T>(key);
+	else if(typeid(collection) == typeid(KV3Collection))
+		return static_cast<KV3Collection &>(collection).FindArrayValues<T>(key);
+	return {};
+}
+template<typename T>
+std::optional<std::span<const T>> source2::resource::IKeyValueCollection::FindArrayView(IKeyValueCollection &collection, KVKey key)
+{
+	// Only the KVObject tree stores array elements contiguously
+	if(typeid(collection) == typeid(KVObject))
+		return static_cast<KVObject &>(collection).FindArrayView<T>(key);
+	return {};
+}
+
+//////////////
+
+template<typename T>
+std::optional<T> source2::resource::KV3Collection::FindValue(KVKey key) const
+{
+	auto *node = FindNode(key);
+	if(node == nullptr)
+		return {};
+	return m_document->GetValue<T>(*node);
+}
+
+template<typename T>
+std::vector<T> source2::resource::KV3Collection::FindArrayValues(KVKey key) const
+{
+	auto *node = FindNode(key);
+	if(node == nullptr || node->type != KVType::ARRAY)
+		return {};
+	auto members = m_document->GetMembers(*node);
+	std::vector<T> arrayElements {};
+	arrayElements.reserve(members.size());
+	for(auto &member : members) {
+		auto v = m_document->GetValue<T>(m_document->GetNode(member.node));
+		if(v.has_value() == false)
+			continue;
+		arrayElements.push_back(*v);
+	}
+	return arrayElements;
+}
+
+template<typename T>
+std::optional<T> source2::resource::KV3Document::GetValue(const KV3Node &node) const
+{
+	if constexpr(std::is_same_v<T, std::nullptr_t>)
+		return {};
+	else if constexpr(std::is_same_v<T, const std::string *>) {
+		if(node.type != KVType::STRING)
+			return {};
+		return &GetString(node.stringId);
+	}
+	else if constexpr(std::is_same_v<T, const BinaryBlob *> || std::is_same_v<T, BinaryBlob *>) {
+		auto *blob = GetBinaryBlob(node);
+		if(blob == nullptr)
+			return {};
+		return blob;
+	}
+	else if constexpr(std::is_same_v<T, std::span<const uint8_t>>) {
+		if(node.type != KVType::BINARY_BLOB)
+			return {};
+		return GetBinaryBlobView(node);
+	}
+	else if constexpr(std::is_same_v<T, const KV3Collection *> || std::is_same_v<T, KV3Collection *> || std::is_same_v<T, const IKeyValueCollection *> || std::is_same_v<T, IKeyValueCollection *>) {
+		if(node.type != KVType::ARRAY && node.type != KVType::OBJECT)
+			return {};
+		return GetCollection(node);
+	}
+	else if constexpr(std::is_pointer_v<T>)
+		return {};
+	else {
+		switch(node.type) {
+		case KVType::BOOLEAN:
+			return cast_to_type<bool, T>(node.boolean);
+		case KVType::INT64:
+			return cast_to_type<int64_t, T>(node.int64);
+		case KVType::UINT64:
+			return cast_to_type<uint64_t, T>(node.uint64);
+		case KVType::DOUBLE:
+			return cast_to_type<double, T>(node.float64);
+		case KVType::STRING:
+			return cast_to_type<std::string, T>(GetString(node.stringId));
+		case KVType::INT32:
+			return cast_to_type<int32_t, T>(node.int32);
+		case KVType::UINT32:
+			return cast_to_type<uint32_t, T>(node.uint32);
+		case KVType::OBJECT:
+		case KVType::ARRAY:
+			return cast_to_type<IKeyValueCollection, T>(*GetCollection(node));
+		default:
+			break;
+		}
+	}
 	return {};
 }
 
 //////////////
 
 template<typename T>
-std::vector<T> source2::resource::NTROStruct::FindArrayValues(const std::string &key)
+std::vector<T> source2::resource::NTROStruct::FindArrayValues(KVKey key)
 {
 	auto *array = FindArray(key);
 	if(array == nullptr)
@@ -891,7 +1462,7 @@ std::vector<T> source2::resource::NTROStruct::FindArrayValues(const std::string
 }
 
 template<typename T>
-std::optional<T> source2::resource::NTROStruct::FindValue(const std::string &key)
+std::optional<T> source2::resource::NTROStruct::FindValue(KVKey key)
 {
 	auto *val = FindValue(key);
 	if(val == nullptr)
@@ -902,10 +1473,10 @@ std::optional<T> source2::resource::NTROStruct::FindValue(const std::string &key
 		return std::static_pointer_cast<NTROArray>(static_cast<NTROArray *>(val)->shared_from_this());
 	}
 	else if constexpr(std::is_same_v<T, NTROStruct *>) {
-		if(val->type != DataType::Vector && val->type != DataType::Quaternion && val->type != DataType::Color && val->type != DataType::Fltx4 && val->type != DataType::Vector4D && val->type != DataType::Vector4D_44 && val->type != DataType::String4 && val->type != DataType::String
-		  && val->type != DataType::Matrix2x4 && val->type != DataType::Matrix3x4 && val->type != DataType::Matrix3x4a && val->type != DataType::CTransform)
+		auto *vStrct = dynamic_cast<TNTROValue<NTROStruct> *>(val);
+		if(vStrct == nullptr)
 			return {};
-		return std::optional<NTROStruct *> {&dynamic_cast<TNTROValue<NTROStruct> *>(val)->value};
+		return std::optional<NTROStruct *> {&vStrct->value};
 	}
 	else {
 		// Only arithmetic types and string remaining
@@ -937,6 +1508,14 @@ void source2::resource::TNTROValue<T>::DebugPrint(std::stringstream &ss, const s
 		ss << t << "\tValue:\n";
 		value.DebugPrint(ss, t + "\t\t");
 	}
+	else if constexpr(std::is_same_v<T, std::shared_ptr<const std::string>>)
+		ss << t << "\tValue = " << (value ? *value : "NULL") << "\n";
+	else if constexpr(is_packed_ntro_type_v<T>) {
+		ss << t << "\tValue =";
+		for(size_t i = 0; i < sizeof(T) / sizeof(float); ++i)
+			ss << " " << value[i];
+		ss << "\n";
+	}
 	else
 		ss << t << "\tValue = " << value << "\n";
 	ss << t << "}\n";
@@ -978,10 +1557,36 @@ std::optional<T> source2::resource::cast_to_type(NTROValue &v0)
 		case DataType::UInt64:
 			return cast_to_type<uint64_t, T>(static_cast<TNTROValue<uint64_t> &>(v0).value);
 		case DataType::String:
-		case DataType::ExternalReference:
 			return cast_to_type<std::string, T>(static_cast<TNTROValue<std::string> &>(v0).value);
+		case DataType::ExternalReference:
+			{
+				auto &name = static_cast<TNTROValue<std::shared_ptr<const std::string>> &>(v0).value;
+				if constexpr(std::is_same_v<T, std::shared_ptr<const std::string>>)
+					return name;
+				else {
+					// Unresolved references are treated as empty names
+					if(!name)
+						return cast_to_type<std::string, T>(std::string {});
+					return cast_to_type<std::string, T>(*name);
+				}
+			}
 		case DataType::Struct:
 			return cast_to_type<IKeyValueCollection *, T>(static_cast<TNTROValue<std::shared_ptr<NTROStruct>> &>(v0).value.get());
+		case DataType::Vector:
+			return cast_components_to_type<T>(static_cast<TNTROValue<Vector3> &>(v0).value);
+		case DataType::Quaternion:
+			return cast_components_to_type<T>(static_cast<TNTROValue<Quat> &>(v0).value);
+		case DataType::Color:
+		case DataType::Fltx4:
+		case DataType::Vector4D:
+		case DataType::Vector4D_44:
+			return cast_components_to_type<T>(static_cast<TNTROValue<Vector4> &>(v0).value);
+		case DataType::Matrix2x4:
+		case DataType::CTransform:
+			return cast_components_to_type<T>(static_cast<TNTROValue<NTROFloats<8>> &>(v0).value);
+		case DataType::Matrix3x4:
+		case DataType::Matrix3x4a:
+			return cast_components_to_type<T>(static_cast<TNTROValue<NTROFloats<12>> &>(v0).value);
 		default:
 			{
 				auto *vStrct = dynamic_cast<TNTROValue<NTROStruct> *>(&v0);
@@ -994,6 +1599,30 @@ std::optional<T> source2::resource::cast_to_type(NTROValue &v0)
 	return {};
 }
 
+template<typename T, typename TComponents>
+std::optional<T> source2::resource::cast_components_to_type(const TComponents &v)
+{
+	constexpr auto numComponents = sizeof(TComponents) / sizeof(float);
+	if constexpr(std::is_same_v<T, TComponents>)
+		return v;
+	else if constexpr(is_packed_ntro_type_v<T>) {
+		T result {};
+		for(size_t i = 0; i < std::min(numComponents, sizeof(T) / sizeof(float)); ++i)
+			result[i] = v[i];
+		return result;
+	}
+	else if constexpr(std::is_same_v<T, Mat4> && numComponents == 12) {
+		// Rows of a 3x4 matrix, the last row is implicit
+		auto result = umat::identity();
+		for(uint8_t i = 0; i < 3; ++i) {
+			for(uint8_t j = 0; j < 4; ++j)
+				result[i][j] = v[i * 4 + j];
+		}
+		return result;
+	}
+	return {};
+}
+
 template<typename T0, typename T1>
 std::optional<T1> source2::resource::cast_to_type(const T0 &v)
 {
@@ -29,14 +29,17 @@ export namespace source2::resource {
 	  public:
 		struct ResourceReferenceInfo {
 			uint64_t id = 0;
-			std::string name;
+			// Shared with all values that reference the resource
+			std::shared_ptr<const std::string> name;
 		};
 		virtual BlockType GetType() const override;
 		virtual void Read(const Resource &resource, ufile::IFile &f) override;
 		virtual void DebugPrint(std::stringstream &ss, const std::string &t = "") const override;
 		const std::vector<ResourceReferenceInfo> &GetResourceReferenceInfos() const;
+		const ResourceReferenceInfo *FindResourceReferenceInfo(uint64_t id) const;
 	  private:
 		std::vector<ResourceReferenceInfo> m_resourceReferenceInfos = {};
+		std::unordered_map<uint64_t, size_t> m_referenceIndices {};
 	};
 
 	enum class DXGI_FORMAT : uint32_t {
@@ -204,7 +207,10 @@ export namespace source2::resource {
 			uint32_t size = 0;
 			std::vector<VertexAttribute> attributes;
 			std::vector<uint8_t> buffer;
+			// Only set if the data is referenced from a resource loaded into memory, 'buffer' is empty in that case
+			std::span<const uint8_t> mappedBuffer;
 
+			std::span<const uint8_t> GetBuffer() const;
 			void ReadVertexAttribute(uint32_t offset, const VertexAttribute &attribute, std::vector<float> &outData) const;
 		};
 
@@ -212,6 +218,10 @@ export namespace source2::resource {
 			uint32_t count = 0;
 			uint32_t size = 0;
 			std::vector<uint8_t> buffer;
+			// Only set if the data is referenced from a resource loaded into memory, 'buffer' is empty in that case
+			std::span<const uint8_t> mappedBuffer;
+
+			std::span<const uint8_t> GetBuffer() const;
 		};
 
 		virtual BlockType GetType() const override;
@@ -223,6 +233,7 @@ export namespace source2::resource {
 		void ReadVertexAttribute(uint32_t offset, const VertexBuffer &vertexBuffer, const VertexAttribute &attribute, std::vector<float> &outData);
 		std::vector<VertexBuffer> m_vertexBuffers;
 		std::vector<IndexBuffer> m_indexBuffers;
+		std::shared_ptr<const MappedFile> m_mappedFile = nullptr; // Keeps referenced buffer data alive
 	};
 
 	class DLLUS2 MBUF : public VBIB {
@@ -281,19 +292,59 @@ export namespace source2::resource {
 			std::vector<Value> enumValueIntrospection;
 		};
 
+		// Flat list of the fields of a struct (including the fields of its base struct) with all struct references resolved.
+		// The plans are compiled once when the manifest is read.
+		struct DecodePlan {
+			enum class Indirection : uint8_t { None = 0, Pointer, Array, Invalid };
+			struct Field {
+				const ResourceDiskStruct::Field *field = nullptr;
+				DataType type = DataType::Unknown;
+				uint16_t diskOffset = 0;
+				uint16_t count = 1; // Number of inline values, the value count of Array indirections is stored in the data
+				bool isArray = false;
+				Indirection indirection = Indirection::None;
+				const DecodePlan *structPlan = nullptr; // Only set for DataType::Struct
+				std::string error {};                   // Reason why the field can't be decoded if the indirection is Invalid
+			};
+			const ResourceDiskStruct *diskStruct = nullptr;
+			std::vector<Field> fields;
+		};
+
+		// Struct lookup and decode plans for a set of structs. Schemas are shared by all manifests with the same structs.
+		struct Schema {
+			std::vector<std::shared_ptr<const ResourceDiskStruct>> structs {}; // Structs referenced by the plans
+			std::unordered_map<uint32_t, size_t> structIndices {};
+			std::vector<DecodePlan> decodePlans {};
+		};
+
 		virtual BlockType GetType() const override;
 		virtual void Read(const Resource &resource, ufile::IFile &f) override;
 		virtual void DebugPrint(std::stringstream &ss, const std::string &t = "") const override;
 
 		uint32_t GetIntrospectionVersion() const;
-		const std::vector<ResourceDiskStruct> &GetReferencedStructs() const;
-		const std::vector<ResourceDiskEnum> &GetReferencedEnums() const;
+		// Struct and enum definitions are immutable and shared between all resources that contain the same definition
+		const std::vector<std::shared_ptr<const ResourceDiskStruct>> &GetReferencedStructs() const;
+		const std::vector<std::shared_ptr<const ResourceDiskEnum>> &GetReferencedEnums() const;
+		const ResourceDiskStruct *FindStruct(uint32_t id) const;
+		// 'structIdx' is the index into GetReferencedStructs
+		const DecodePlan &GetDecodePlan(size_t structIdx) const;
+		const DecodePlan *FindDecodePlan(uint32_t id) const;
+		// Some resource types can only be identified by the name of their first struct
+		static ResourceType DetermineResourceTypeByStructName(std::string_view name);
+
+		// Struct definitions, enum definitions and schemas are cached process-wide. Each of them is flushed once it holds
+		// 'maxEntries' entries (0 means unlimited), manifests keep the entries they use alive.
+		static void SetSchemaCacheLimit(size_t maxEntries);
+		static void ClearSchemaCache();
 	  private:
 		void ReadStructs(ufile::IFile &f);
 		void ReadEnums(ufile::IFile &f);
+		void LoadSchema();
+		static std::shared_ptr<const Schema> BuildSchema(const std::vector<std::shared_ptr<const ResourceDiskStruct>> &structs);
 		uint32_t m_introspectionVersion = 0;
-		std::vector<ResourceDiskStruct> m_referencedStructs {};
-		std::vector<ResourceDiskEnum> m_referencedEnums {};
+		std::vector<std::shared_ptr<const ResourceDiskStruct>> m_referencedStructs {};
+		std::vector<std::shared_ptr<const ResourceDiskEnum>> m_referencedEnums {};
+		std::shared_ptr<const Schema> m_schema = nullptr;
 	};
 	DLLUS2 std::string to_string(DataType type);
 };
@@ -6,8 +6,10 @@ export module source2;
 
 export import :block;
 export import :core;
+export import :mapped_file;
 export import :mesh_optimizer;
 export import :redi;
 export import :resource;
 export import :resource_data;
 export import :resource_edit_info;
+export import :thread_pool;
@@ -0,0 +1,163 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Measures KV3 parse time, heap allocations and array element access of the KVObject tree and the flat KV3Document.
+// Usage: bench_kv3 [resource file, e.g. a .vwnod_c] [array key, e.g. m_sceneObjects] [iterations]
+// Without a file only the synthetic array benchmark is run.
+
+import source2;
+
+// Allocation counters, every allocation is prefixed with its size so the live heap size can be tracked
+static std::atomic<uint64_t> g_allocationCount = 0;
+static std::atomic<int64_t> g_liveBytes = 0;
+static constexpr size_t ALLOCATION_HEADER_SIZE = alignof(std::max_align_t);
+
+void *operator new(size_t size)
+{
+	auto *p = static_cast<uint8_t *>(std::malloc(size + ALLOCATION_HEADER_SIZE));
+	if(!p)
+		throw std::bad_alloc {};
+	*reinterpret_cast<size_t *>(p) = size;
+	++g_allocationCount;
+	g_liveBytes += size;
+	return p + ALLOCATION_HEADER_SIZE;
+}
+void operator delete(void *ptr) noexcept
+{
+	if(!ptr)
+		return;
+	auto *p = static_cast<uint8_t *>(ptr) - ALLOCATION_HEADER_SIZE;
+	g_liveBytes -= *reinterpret_cast<size_t *>(p);
+	std::free(p);
+}
+void operator delete(void *ptr, size_t) noexcept { operator delete(ptr); }
+
+template<typename TFunc>
+static double measure_ms(TFunc &&func)
+{
+	auto t0 = std::chrono::steady_clock::now();
+	func();
+	auto t1 = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+struct ParseResult {
+	double bestMs = std::numeric_limits<double>::max();
+	uint64_t allocations = 0;
+	int64_t retainedBytes = 0;
+};
+static ParseResult parse(const std::shared_ptr<const source2::resource::MappedFile> &mappedFile, source2::resource::KV3Representation representation, uint32_t iterations)
+{
+	source2::resource::ResourceLoadOptions loadOptions {};
+	loadOptions.kv3Representation = representation;
+	ParseResult result {};
+	for(auto i = decltype(iterations) {0u}; i < iterations; ++i) {
+		std::shared_ptr<source2::resource::Resource> resource;
+		auto allocations = g_allocationCount.load();
+		auto liveBytes = g_liveBytes.load();
+		result.bestMs = std::min(result.bestMs, measure_ms([&]() { resource = source2::load_resource(mappedFile, loadOptions); }));
+		if(!resource)
+			throw std::runtime_error {"Failed to load resource"};
+		result.allocations = g_allocationCount - allocations;
+		result.retainedBytes = g_liveBytes - liveBytes;
+	}
+	return result;
+}
+
+static source2::resource::IKeyValueCollection *get_data(source2::resource::Resource &resource)
+{
+	auto *data = dynamic_cast<source2::resource::ResourceData *>(resource.FindBlock(source2::BlockType::DATA));
+	return data ? data->GetData() : nullptr;
+}
+
+// Compares lookups by stringified index (the only way to address array elements before they were stored contiguously)
+// with indexed access and FindArrayValues
+static void bench_array_access(source2::resource::KVObject &parent, const std::string &key, uint32_t iterations)
+{
+	auto *array = parent.FindArray(key);
+	if(!array || array->GetArrayCount() == 0) {
+		std::cerr << "'" << key << "' is not a non-empty array" << std::endl;
+		return;
+	}
+	auto count = array->GetArrayCount();
+	auto perElementNs = [count](double ms) { return ms * 1'000'000.0 / count; };
+	double best[3] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+	size_t found = 0;
+	for(auto i = decltype(iterations) {0u}; i < iterations; ++i) {
+		best[0] = std::min(best[0], measure_ms([&]() {
+			for(auto j = decltype(count) {0u}; j < count; ++j)
+				found += (array->FindValue(std::to_string(j)) != nullptr);
+		}));
+		best[1] = std::min(best[1], measure_ms([&]() {
+			for(auto j = decltype(count) {0u}; j < count; ++j)
+				found += (array->GetArrayValue(j) != nullptr);
+		}));
+		best[2] = std::min(best[2], measure_ms([&]() { found += parent.FindArrayValues<source2::resource::IKeyValueCollection *>(key).size(); }));
+	}
+	std::cout << "'" << key << "' (" << count << " elements, " << found << " found)" << std::endl;
+	std::cout << "\tFindValue(std::to_string(i)): " << perElementNs(best[0]) << " ns/element" << std::endl;
+	std::cout << "\tGetArrayValue(i):             " << perElementNs(best[1]) << " ns/element" << std::endl;
+	std::cout << "\tFindArrayValues:              " << perElementNs(best[2]) << " ns/element" << std::endl;
+}
+
+static std::shared_ptr<source2::resource::KVObject> create_synthetic_array(uint32_t count)
+{
+	auto root = std::make_shared<source2::resource::KVObject>("root");
+	auto array = std::make_shared<source2::resource::KVObject>("m_sceneObjects", true);
+	array->ReserveArray(count);
+	for(auto i = decltype(count) {0u}; i < count; ++i) {
+		auto element = std::make_shared<source2::resource::KVObject>("");
+		element->EmplaceProperty("m_nObjectTypeFlags", source2::resource::KVType::INT32, std::make_shared<int32_t>(i));
+		array->EmplaceProperty("", source2::resource::KVType::OBJECT, element);
+	}
+	root->EmplaceProperty("m_sceneObjects", source2::resource::KVType::ARRAY, array);
+	return root;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t iterations = (argc > 3) ? std::stoul(argv[3]) : 10u;
+	try {
+		std::cout << "Synthetic array:" << std::endl;
+		auto synthetic = create_synthetic_array(100'000);
+		bench_array_access(*synthetic, "m_sceneObjects", iterations);
+
+		if(argc > 1) {
+			auto mappedFile = source2::resource::MappedFile::Open(argv[1]);
+			if(!mappedFile)
+				throw std::runtime_error {std::string {"Failed to open '"} + argv[1] + "'"};
+			std::cout << std::endl << argv[1] << " (" << mappedFile->GetData().size() << " bytes):" << std::endl;
+			std::pair<source2::resource::KV3Representation, const char *> representations[] = {{source2::resource::KV3Representation::Tree, "tree"}, {source2::resource::KV3Representation::Document, "document"}};
+			for(auto &[representation, name] : representations) {
+				auto result = parse(mappedFile, representation, iterations);
+				std::cout << "\t" << name << " parse: " << result.bestMs << " ms, " << result.allocations << " allocations, " << result.retainedBytes << " bytes retained" << std::endl;
+			}
+
+			if(argc > 2) {
+				auto resource = source2::load_resource(mappedFile, {});
+				auto *data = resource ? dynamic_cast<source2::resource::KVObject *>(get_data(*resource)) : nullptr;
+				if(!data)
+					throw std::runtime_error {"Resource has no KV3 data"};
+				bench_array_access(*data, argv[2], iterations);
+
+				source2::resource::ResourceLoadOptions loadOptions {};
+				loadOptions.kv3Representation = source2::resource::KV3Representation::Document;
+				auto docResource = source2::load_resource(mappedFile, loadOptions);
+				auto *docData = docResource ? get_data(*docResource) : nullptr;
+				if(!docData)
+					throw std::runtime_error {"Resource has no KV3 data"};
+				auto best = std::numeric_limits<double>::max();
+				size_t count = 0;
+				for(auto i = decltype(iterations) {0u}; i < iterations; ++i)
+					best = std::min(best, measure_ms([&]() { count = docData->FindArrayValues<source2::resource::IKeyValueCollection *>(argv[2]).size(); }));
+				if(count > 0)
+					std::cout << "\tKV3Document FindArrayValues: " << (best * 1'000'000.0 / count) << " ns/element" << std::endl;
+			}
+		}
+	}
+	catch(const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Classifies all compiled resources (*_c) in a directory tree with probe_resource on a growing number of threads and
+// reports the throughput, optionally compared to a full load_resource of every file.
+// Usage: bench_probe_resource <directory> [max threads] [--full]
+
+import source2;
+
+struct ScanResult {
+	double seconds = 0.0;
+	size_t numResources = 0;
+	std::map<source2::ResourceType, size_t> typeCounts;
+};
+
+template<typename TFunc>
+static ScanResult scan(const std::vector<std::string> &files, uint32_t numThreads, TFunc &&classify)
+{
+	ScanResult result {};
+	std::atomic<size_t> nextFile = 0;
+	std::mutex resultMutex;
+	auto worker = [&]() {
+		std::map<source2::ResourceType, size_t> typeCounts;
+		size_t numResources = 0;
+		for(auto i = nextFile++; i < files.size(); i = nextFile++) {
+			auto fp = pragma::fs::open_system_file(files[i], pragma::fs::FileMode::Read | pragma::fs::FileMode::Binary);
+			if(!fp)
+				continue;
+			pragma::fs::File f {fp};
+			auto type = classify(f);
+			if(!type)
+				continue;
+			++numResources;
+			++typeCounts[*type];
+		}
+		std::scoped_lock lock {resultMutex};
+		result.numResources += numResources;
+		for(auto &[type, count] : typeCounts)
+			result.typeCounts[type] += count;
+	};
+	auto t0 = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for(auto i = 1u; i < numThreads; ++i)
+		threads.emplace_back(worker);
+	worker();
+	for(auto &t : threads)
+		t.join();
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	return result;
+}
+
+static std::optional<source2::ResourceType> probe(ufile::IFile &f)
+{
+	auto info = source2::probe_resource(f);
+	return info ? info->type : std::optional<source2::ResourceType> {};
+}
+// Only used for the throughput comparison, Resource doesn't expose its type
+static std::optional<source2::ResourceType> load(ufile::IFile &f)
+{
+	try {
+		if(!source2::load_resource(f))
+			return {};
+		return source2::ResourceType::Unknown;
+	}
+	catch(const std::exception &) {
+		return {};
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " <directory> [max threads] [--full]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	auto full = false;
+	for(auto i = 2; i < argc; ++i) {
+		if(std::string_view {argv[i]} == "--full")
+			full = true;
+		else
+			maxThreads = std::stoul(argv[i]);
+	}
+
+	std::vector<std::string> files;
+	for(auto &entry : std::filesystem::recursive_directory_iterator {argv[1], std::filesystem::directory_options::skip_permission_denied}) {
+		if(entry.is_regular_file() && entry.path().filename().string().ends_with("_c"))
+			files.push_back(entry.path().string());
+	}
+	std::cout << files.size() << " files" << std::endl;
+	if(files.empty())
+		return EXIT_SUCCESS;
+
+	std::cout << "threads\tprobe files/s" << (full ? "\tload_resource files/s" : "") << std::endl;
+	ScanResult last {};
+	for(auto numThreads = 1u; numThreads <= maxThreads; numThreads *= 2) {
+		last = scan(files, numThreads, probe);
+		std::cout << numThreads << '\t' << (files.size() / last.seconds);
+		if(full)
+			std::cout << '\t' << (files.size() / scan(files, numThreads, load).seconds);
+		std::cout << std::endl;
+	}
+
+	std::cout << std::endl << last.numResources << " resources:" << std::endl;
+	for(auto &[type, count] : last.typeCounts)
+		std::cout << '\t' << source2::to_string(type) << ": " << count << std::endl;
+	return EXIT_SUCCESS;
+}
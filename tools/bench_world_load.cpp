@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Measures how World::Load scales with the number of threads.
+// Usage: bench_world_load <game directory> <world path relative to game directory, e.g. maps/x/world.vwrld_c> [max threads] [iterations]
+
+import source2;
+
+// Referenced assets are resolved relative to the game directory, the loader is stateless and therefore thread-safe
+static std::shared_ptr<source2::resource::Resource> load_resource(const std::string &gameDir, const std::string &path)
+{
+	auto assetLoader = [gameDir](const std::string &path) -> std::unique_ptr<ufile::IFile> {
+		auto fp = pragma::fs::open_system_file(gameDir + path, pragma::fs::FileMode::Read | pragma::fs::FileMode::Binary);
+		if(!fp)
+			return nullptr;
+		return std::make_unique<pragma::fs::File>(fp);
+	};
+	source2::resource::ResourceLoadOptions loadOptions {};
+	loadOptions.memoryMap = true;
+	loadOptions.threadSafeAssetLoader = true;
+	auto mappedFile = source2::resource::MappedFile::Open(gameDir + path);
+	if(!mappedFile)
+		throw std::runtime_error {"Failed to open '" + gameDir + path + "'"};
+	auto resource = source2::load_resource(mappedFile, loadOptions, assetLoader);
+	if(!resource)
+		throw std::runtime_error {"Failed to load '" + path + "'"};
+	return resource;
+}
+
+static double load_world(const std::string &gameDir, const std::string &path, uint32_t numThreads, bool reusePool, size_t &outNumNodes)
+{
+	auto resource = load_resource(gameDir, path);
+	auto *world = dynamic_cast<source2::resource::World *>(resource->FindBlock(source2::BlockType::DATA));
+	if(!world)
+		throw std::runtime_error {"'" + path + "' is not a world resource"};
+
+	std::unique_ptr<source2::ThreadPool> pool;
+	if(reusePool)
+		pool = std::make_unique<source2::ThreadPool>(numThreads - 1);
+	auto t0 = std::chrono::steady_clock::now();
+	auto scene = reusePool ? world->Load(*pool) : world->Load(numThreads);
+	auto t1 = std::chrono::steady_clock::now();
+	outNumNodes = scene ? scene->GetSceneNodes().size() : 0;
+	return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc < 3) {
+		std::cerr << "Usage: " << argv[0] << " <game directory> <world path> [max threads] [iterations]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::string gameDir = argv[1];
+	if(!gameDir.empty() && gameDir.back() != '/' && gameDir.back() != '\\')
+		gameDir += '/';
+	std::string path = argv[2];
+	uint32_t maxThreads = (argc > 3) ? std::stoul(argv[3]) : std::max(std::thread::hardware_concurrency(), 1u);
+	uint32_t iterations = (argc > 4) ? std::stoul(argv[4]) : 5u;
+	try {
+		std::optional<size_t> refNumNodes {};
+		std::optional<double> refTime {};
+		std::cout << "threads\tpool\tbest ms\tspeedup\tnodes" << std::endl;
+		for(auto numThreads = 1u; numThreads <= maxThreads; numThreads *= 2) {
+			for(auto reusePool : {false, true}) {
+				auto best = std::numeric_limits<double>::max();
+				size_t numNodes = 0;
+				for(auto i = decltype(iterations) {0u}; i < iterations; ++i)
+					best = std::min(best, load_world(gameDir, path, numThreads, reusePool, numNodes));
+				if(!refNumNodes) {
+					refNumNodes = numNodes;
+					refTime = best;
+				}
+				else if(*refNumNodes != numNodes) {
+					std::cerr << "Scene with " << numThreads << " threads has " << numNodes << " nodes, expected " << *refNumNodes << std::endl;
+					return EXIT_FAILURE;
+				}
+				std::cout << numThreads << '\t' << (reusePool ? "shared" : "new") << '\t' << best << '\t' << (*refTime / best) << '\t' << numNodes << std::endl;
+			}
+		}
+	}
+	catch(const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,604 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-FileCopyrightText: (c) 2015 Steam Database
+// SPDX-License-Identifier: MIT
+
+// Checks Texture::UncompressBC7 for bit-exactness against the previous BC7 decoder, which is kept below as the reference.
+// - Checked-in reference images (data/bc7_blocks.bin, data/bc7_reference.bin) contain blocks of every mode and the output
+//   of the previous decoder for all combinations of the hemi-octahedral and invert options.
+// - Randomly generated images of arbitrary sizes are compared with the reference decoder directly, single and multithreaded.
+// Usage: test_bc7_decoder [--data <dir>] [--seed <n>] [--bench] [--generate]
+// --bench measures the decode rate in Mtexels/s per BC7 mode, --generate rewrites the reference images.
+
+import source2;
+
+using byte = uint8_t;
+
+//////////////// Previous decoder
+
+static std::array<std::array<uint8_t, 16>, 64> BC7PartitionTable3 {
+  //Partition table for 3-subset BPTC, with the 4×4 block of values for each partition number
+  std::array<uint8_t, 16> {0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2},
+  {0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1},
+  {0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+  {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2},
+  {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2},
+  {0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2},
+  {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2},
+  {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+  {0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2},
+  {0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2},
+  {0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2},
+  {0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2},
+  {0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0},
+  {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2},
+  {0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0},
+  {0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2},
+  {0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1},
+  {0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2},
+  {0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1},
+  {0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2},
+  {0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0},
+  {0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0},
+  {0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2},
+  {0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0},
+  {0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1},
+  {0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2},
+  {0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2},
+  {0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1},
+  {0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1},
+  {0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2},
+  {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2},
+  {0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0},
+  {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0},
+  {0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0},
+  {0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0},
+  {0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1},
+  {0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1},
+  {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+  {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1},
+  {0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2},
+  {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1},
+  {0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1},
+  {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1},
+  {0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1},
+  {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2},
+  {0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1},
+  {0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2},
+  {0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2},
+  {0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2},
+  {0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2},
+  {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2},
+  {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2},
+  {0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2},
+  {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2},
+  {0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2},
+  {0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1},
+  {0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2},
+  {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2},
+  {0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0},
+};
+
+static std::array<uint8_t, 64> BC7AnchorIndices32 {//BPTC anchor index values for the second subset of three-subset partitioning, by partition number
+  3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3, 3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15, 8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15, 3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3};
+static std::array<uint8_t, 64> BC7AnchorIndices33 {//BPTC anchor index values for the third subset of three-subset partitioning, by partition number
+  15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8, 15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8, 15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8, 15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8};
+static std::array<uint8_t, 8> BC7IndLength = {3, 3, 2, 2, 2, 2, 4, 2};
+
+static std::array<std::array<uint8_t, 16>, 64> BPTCPartitionTable2 {
+  //Partition table for 2-subset BPTC, with the 4×4 block of values for each partition number
+  std::array<uint8_t, 16> {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
+  {0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1},
+  {0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1},
+  {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1},
+  {0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1},
+  {0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1},
+  {0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0},
+  {0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0},
+  {0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0},
+  {0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1},
+  {0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0},
+  {0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0},
+  {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0},
+  {0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0},
+  {0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0},
+  {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0},
+  {0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0},
+  {0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0},
+  {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1},
+  {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1},
+  {0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0},
+  {0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0},
+  {0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0},
+  {0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0},
+  {0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1},
+  {0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1},
+  {0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0},
+  {0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0},
+  {0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0},
+  {0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0},
+  {0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0},
+  {0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1},
+  {0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1},
+  {0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0},
+  {0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0},
+  {0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0},
+  {0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0},
+  {0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0},
+  {0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1},
+  {0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0},
+  {0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0},
+  {0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1},
+  {0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1},
+  {0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1},
+  {0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1},
+  {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0},
+  {0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0},
+  {0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1},
+};
+static std::array<uint8_t, 64> BPTCAnchorIndices2 {// BPTC anchor index values for the second subset of two-subset partitioning, by partition number
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2, 15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6, 6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15};
+static std::array<uint8_t, 4> BPTCWeights2 = {0, 21, 43, 64};
+static std::array<uint8_t, 8> BPTCWeights3 = {0, 9, 19, 27, 47, 46, 55, 64};
+static std::array<uint8_t, 16> BPTCWeights4 = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+static uint16_t BPTCInterpolateFactor(int weight, int e0, int e1) { return (uint16_t)((((64 - weight) * e0) + (weight * e1) + 32) >> 6); }
+
+static void reference_uncompress_bc7(uint32_t RowBytes, const uint8_t *input, std::vector<uint8_t> &data, int w, int h, bool hemiOctRB, bool invert)
+{
+	auto read64 = [&input]() {
+		uint64_t v;
+		memcpy(&v, input, sizeof(v));
+		input += sizeof(v);
+		return v;
+	};
+	auto blockCountX = (w + 3) / 4;
+	auto blockCountY = (h + 3) / 4;
+
+	for(auto j = decltype(blockCountY) {0u}; j < blockCountY; ++j) {
+		for(auto i = decltype(blockCountX) {0u}; i < blockCountX; ++i) {
+			auto block0 = read64();
+			auto block64 = read64();
+			int m = 0;
+			for(; m < 8; m++) {
+				if((block0 >> m & 1) == 1) {
+					break;
+				}
+			}
+
+			byte pb = 0;
+			byte rb = 0;
+			byte isb = 0;
+			std::array<std::array<uint8_t, 4>, 6> endpoints {};
+			byte epbits = 0;
+			byte spbits = 0;
+			uint64_t ib = 0;
+			uint64_t ib2 = 0;
+
+			if(m == 0) {
+				pb = (byte)(block0 >> 1 & 0xF); //4bit
+			}
+			else if(m == 1 || m == 2 || m == 3 || m == 7) {
+				pb = (byte)((block0 >> (m + 1)) & 0x3F); //6bit
+			}
+
+			auto ReadEndpoints = [&](int start, int ns2, int cb, int astart, int ab) {
+				auto GetVal = [&](int p, byte vm) -> uint8_t {
+					byte res = 0;
+					if(p < 64) {
+						res = (byte)(block0 >> p & vm);
+						if(p + cb > 64) {
+							res |= (byte)(block64 << (64 - p) & vm);
+						}
+					}
+					else {
+						res = (byte)(block64 >> (p - 64) & vm);
+					}
+
+					return res;
+				};
+
+				auto mask = (byte)((0x1 << cb) - 1);
+				for(int c = 0; c < 3; c++) {
+					for(int s = 0; s < ns2; s++) {
+						int ofs = start + (cb * ((c * ns2) + s));
+						endpoints[s][c] = GetVal(ofs, mask);
+						if(m == 1) {
+							endpoints[s][c] = (byte)(endpoints[s][c] << 2 | ((spbits >> (s >> 1) & 1) << 1) | (endpoints[s][c] >> 5));
+						}
+						else if(m == 0 || m == 3 || m == 6 || m == 7) {
+							endpoints[s][c] = (byte)(endpoints[s][c] << (8 - cb) | ((epbits >> s & 1) << (7 - cb)) | (endpoints[s][c] >> ((cb * 2) - 7)));
+						}
+						else {
+							endpoints[s][c] = (byte)(endpoints[s][c] << (8 - cb) | (endpoints[s][c] >> ((cb * 2) - 8)));
+						}
+					}
+				}
+
+				if(ab != 0) {
+					mask = (byte)((0x1 << ab) - 1);
+					for(int s = 0; s < ns2; s++) {
+						int ofs = astart + (ab * s);
+						endpoints[s][3] = GetVal(ofs, mask);
+						if(m == 6 || m == 7) {
+							endpoints[s][3] = (byte)((endpoints[s][3] << (8 - ab)) | ((epbits >> s & 1) << (7 - ab)) | (endpoints[s][3] >> ((ab * 2) - 7)));
+						}
+						else {
+							endpoints[s][3] = (byte)((endpoints[s][3] << (8 - ab)) | (endpoints[s][3] >> ((ab * 2) - 8)));
+						}
+					}
+				}
+			};
+
+			if(m == 0) {
+				epbits = (byte)(block64 >> 13 & 0x3F);
+				ReadEndpoints(5, 6, 4, 0, 0);
+				ib = block64 >> 19;
+			}
+			else if(m == 1) {
+				spbits = (byte)((block64 >> 16 & 1) | ((block64 >> 17 & 1) << 1));
+				ReadEndpoints(8, 4, 6, 0, 0);
+				ib = block64 >> 18;
+			}
+			else if(m == 2) {
+				ReadEndpoints(9, 6, 5, 0, 0);
+				ib = block64 >> 35;
+			}
+			else if(m == 3) {
+				epbits = (byte)(block64 >> 30 & 0xF);
+				ReadEndpoints(10, 4, 7, 0, 0);
+				ib = block64 >> 34;
+			}
+			else if(m == 4) {
+				rb = (byte)(block0 >> 5 & 0x3);
+				isb = (byte)(block0 >> 7 & 0x1);
+				ReadEndpoints(8, 2, 5, 38, 6);
+				ib = (block0 >> 50) | (block64 << 14);
+				ib2 = block64 >> 17;
+			}
+			else if(m == 5) {
+				rb = (byte)((block0 >> 6) & 0x3);
+				ReadEndpoints(8, 2, 7, 50, 8);
+				ib = block64 >> 2;
+				ib2 = block64 >> 33;
+			}
+			else if(m == 6) {
+				epbits = (byte)((block0 >> 63) | ((block64 & 1) << 1));
+				ReadEndpoints(7, 2, 7, 49, 7);
+				ib = block64 >> 1;
+			}
+			else if(m == 7) {
+				epbits = (byte)(block64 >> 30 & 0xF);
+				ReadEndpoints(14, 4, 5, 74, 5);
+				ib = block64 >> 34;
+			}
+
+			int ib2l = (m == 4) ? 3 : 2;
+			for(int by = 0; by < 4; by++) {
+				for(int bx = 0; bx < 4; bx++) {
+					int io = (by * 4) + bx;
+					auto pixelIndex = (((j * 4) + by) * RowBytes) + (((i * 4) + bx) * 4);
+
+					byte cweight = 0;
+					byte aweight = 0;
+					byte subset = 0;
+
+					int isAnchor = 0;
+					if(m == 0 || m == 2) { //3 subsets
+						isAnchor = (io == 0 || io == BC7AnchorIndices32[pb] || io == BC7AnchorIndices33[pb]) ? 1 : 0;
+						subset = (byte)(BC7PartitionTable3[pb][io] * 2);
+					}
+					else if(m == 1 || m == 3 || m == 7) { //2 subsets
+						subset = (byte)(BPTCPartitionTable2[pb][io] * 2);
+						isAnchor = (io == 0 || io == BPTCAnchorIndices2[pb]) ? 1 : 0;
+					}
+					else if(m == 4 || m == 5 || m == 6) { //1 subset
+						isAnchor = (io == 0) ? 1 : 0;
+					}
+
+					if(m == 0 || m == 1) { //3 bit
+						cweight = BPTCWeights3[ib & (0x7u >> isAnchor)];
+					}
+					else if(m == 6) { //4 bit
+						cweight = BPTCWeights4[ib & (0xFu >> isAnchor)];
+					}
+					else { //2 bit
+						cweight = BPTCWeights2[ib & (0x3u >> isAnchor)];
+					}
+
+					ib >>= BC7IndLength[m] - isAnchor;
+
+					if(m == 4) {
+						aweight = BPTCWeights3[ib2 & (0x7u >> isAnchor)];
+						ib2 >>= ib2l - isAnchor;
+
+						if(isb == 1) {
+							byte t = cweight;
+							cweight = aweight;
+							aweight = t;
+						}
+					}
+					else if(m == 5) {
+						aweight = BPTCWeights2[ib2 & (0x3u >> isAnchor)];
+						ib2 >>= ib2l - isAnchor;
+					}
+					else if(m > 5) {
+						aweight = cweight;
+					}
+
+					data[pixelIndex] = (byte)BPTCInterpolateFactor(cweight, endpoints[subset][2], endpoints[subset + 1][2]);
+					data[pixelIndex + 1] = (byte)BPTCInterpolateFactor(cweight, endpoints[subset][1], endpoints[subset + 1][1]);
+					data[pixelIndex + 2] = (byte)BPTCInterpolateFactor(cweight, endpoints[subset][0], endpoints[subset + 1][0]);
+
+					if(m < 4) {
+						data[pixelIndex + 3] = std::numeric_limits<uint8_t>::max();
+					}
+					else {
+						data[pixelIndex + 3] = (byte)BPTCInterpolateFactor(aweight, endpoints[subset][3], endpoints[subset + 1][3]);
+
+						if((m == 4 || m == 5) && rb != 0) {
+							byte t = data[pixelIndex + 3];
+							data[pixelIndex + 3] = data[pixelIndex + 3 - rb];
+							data[pixelIndex + 3 - rb] = t;
+						}
+					}
+
+					if(hemiOctRB) {
+						float nx = ((data[pixelIndex + 2] + data[pixelIndex + 1]) / 255.0f) - 1.003922f;
+						float ny = (data[pixelIndex + 2] - data[pixelIndex + 1]) / 255.0f;
+						float nz = 1 - fabsf(nx) - fabsf(ny);
+
+						float l = (float)sqrtf((nx * nx) + (ny * ny) + (nz * nz));
+						data[pixelIndex + 3] = data[pixelIndex + 0]; //b to alpha
+						data[pixelIndex + 2] = (byte)(((nx / l * 0.5f) + 0.5f) * 255);
+						data[pixelIndex + 1] = (byte)(((ny / l * 0.5f) + 0.5f) * 255);
+						data[pixelIndex + 0] = (byte)(((nz / l * 0.5f) + 0.5f) * 255);
+					}
+
+					if(invert) {
+						data[pixelIndex + 1] = (byte)(~data[pixelIndex + 1]); // LegacySource1InvertNormals
+					}
+				}
+			}
+		}
+	}
+}
+
+//////////////// Test
+
+static constexpr uint32_t NUM_MODES = 8;
+static constexpr uint32_t BLOCKS_PER_MODE = 64;
+// The reference image is 32x16 blocks, each pair of block rows contains the blocks of one mode
+static constexpr uint32_t REFERENCE_WIDTH = 128;
+static constexpr uint32_t REFERENCE_HEIGHT = 64;
+static constexpr uint32_t REFERENCE_GENERATOR_SEED = 1234;
+
+// Random blocks, forced to the specified mode. Mode 8 (no mode bit set) is reserved and not generated.
+static std::vector<uint8_t> generate_blocks(std::mt19937_64 &rng, size_t numBlocks, std::optional<uint32_t> mode = {})
+{
+	std::vector<uint8_t> blocks(numBlocks * 16);
+	for(size_t i = 0; i < blocks.size(); i += sizeof(uint64_t)) {
+		auto v = rng();
+		memcpy(blocks.data() + i, &v, sizeof(v));
+	}
+	for(size_t i = 0; i < numBlocks; ++i) {
+		auto m = mode.has_value() ? *mode : static_cast<uint32_t>(rng() % NUM_MODES);
+		auto &b = blocks[i * 16];
+		b = static_cast<uint8_t>((b & ~((2u << m) - 1)) | (1u << m));
+	}
+	return blocks;
+}
+
+static std::vector<uint8_t> reference_decode(std::span<const uint8_t> blocks, uint32_t width, uint32_t height, bool hemiOctRB, bool invert)
+{
+	// The previous decoder always writes complete blocks
+	auto blockCountX = (width + 3) / 4;
+	auto blockCountY = (height + 3) / 4;
+	std::vector<uint8_t> data(static_cast<size_t>(blockCountX) * 16 * blockCountY * 4);
+	reference_uncompress_bc7(blockCountX * 16, blocks.data(), data, width, height, hemiOctRB, invert);
+	return data;
+}
+
+static std::vector<uint8_t> decode(std::span<const uint8_t> blocks, uint32_t width, uint32_t height, uint32_t rowPitch, bool hemiOctRB, bool invert, uint32_t numThreads)
+{
+	std::vector<uint8_t> data(static_cast<size_t>(rowPitch) * height, 0xCD);
+	source2::resource::Texture::UncompressBC7(blocks, data, rowPitch, width, height, hemiOctRB, invert, numThreads);
+	return data;
+}
+
+static uint32_t g_failures = 0;
+static void check(bool condition, const std::string &msg)
+{
+	if(condition)
+		return;
+	std::cerr << "FAILED: " << msg << std::endl;
+	++g_failures;
+}
+
+// Compares the texels within width x height, the reference has a row pitch of whole blocks
+static bool compare(const std::vector<uint8_t> &data, uint32_t rowPitch, const std::vector<uint8_t> &reference, uint32_t refRowPitch, uint32_t width, uint32_t height)
+{
+	for(auto y = 0u; y < height; ++y) {
+		if(memcmp(data.data() + static_cast<size_t>(y) * rowPitch, reference.data() + static_cast<size_t>(y) * refRowPitch, width * 4) != 0)
+			return false;
+	}
+	return true;
+}
+
+static std::vector<uint8_t> read_file(const std::string &path)
+{
+	std::ifstream f {path, std::ios::binary};
+	if(!f)
+		throw std::runtime_error {"Failed to open '" + path + "'"};
+	return {std::istreambuf_iterator<char> {f}, std::istreambuf_iterator<char> {}};
+}
+static void write_file(const std::string &path, const std::vector<uint8_t> &data)
+{
+	std::ofstream f {path, std::ios::binary};
+	if(!f)
+		throw std::runtime_error {"Failed to write '" + path + "'"};
+	f.write(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+static void generate_reference_images(const std::string &dataDir)
+{
+	std::mt19937_64 rng {REFERENCE_GENERATOR_SEED};
+	std::vector<uint8_t> blocks;
+	for(auto m = 0u; m < NUM_MODES; ++m) {
+		auto modeBlocks = generate_blocks(rng, BLOCKS_PER_MODE, m);
+		blocks.insert(blocks.end(), modeBlocks.begin(), modeBlocks.end());
+	}
+	std::vector<uint8_t> reference;
+	for(auto opt = 0u; opt < 4; ++opt) {
+		auto data = reference_decode(blocks, REFERENCE_WIDTH, REFERENCE_HEIGHT, (opt & 1) != 0, (opt & 2) != 0);
+		reference.insert(reference.end(), data.begin(), data.end());
+	}
+	write_file(dataDir + "/bc7_blocks.bin", blocks);
+	write_file(dataDir + "/bc7_reference.bin", reference);
+	std::cout << "Reference images written to '" << dataDir << "'" << std::endl;
+}
+
+static void check_reference_images(const std::string &dataDir)
+{
+	auto blocks = read_file(dataDir + "/bc7_blocks.bin");
+	auto reference = read_file(dataDir + "/bc7_reference.bin");
+	constexpr size_t imageSize = REFERENCE_WIDTH * REFERENCE_HEIGHT * 4;
+	if(blocks.size() != NUM_MODES * BLOCKS_PER_MODE * 16 || reference.size() != imageSize * 4)
+		throw std::runtime_error {"Unexpected size of the reference images"};
+	for(auto opt = 0u; opt < 4; ++opt) {
+		std::vector<uint8_t> expected {reference.begin() + opt * imageSize, reference.begin() + (opt + 1) * imageSize};
+		for(auto numThreads : {1u, 4u}) {
+			auto data = decode(blocks, REFERENCE_WIDTH, REFERENCE_HEIGHT, REFERENCE_WIDTH * 4, (opt & 1) != 0, (opt & 2) != 0, numThreads);
+			if(data == expected)
+				continue;
+			// Report the first mismatching block to narrow down the mode
+			for(size_t i = 0; i < data.size(); ++i) {
+				if(data[i] == expected[i])
+					continue;
+				auto blockIdx = ((i / (REFERENCE_WIDTH * 4)) / 4) * (REFERENCE_WIDTH / 4) + (i % (REFERENCE_WIDTH * 4)) / 16;
+				check(false, "reference image " + std::to_string(opt) + " (" + std::to_string(numThreads) + " threads) differs in block " + std::to_string(blockIdx) + " (mode " + std::to_string(blockIdx / BLOCKS_PER_MODE) + ")");
+				break;
+			}
+		}
+	}
+}
+
+static void check_random_images(uint64_t seed)
+{
+	std::mt19937_64 rng {seed};
+	for(auto i = 0u; i < 200; ++i) {
+		auto width = static_cast<uint32_t>(1 + rng() % 70);
+		auto height = static_cast<uint32_t>(1 + rng() % 70);
+		auto blocks = generate_blocks(rng, static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4));
+		auto refRowPitch = ((width + 3) / 4) * 16;
+		for(auto opt = 0u; opt < 4; ++opt) {
+			auto hemiOctRB = (opt & 1) != 0;
+			auto invert = (opt & 2) != 0;
+			auto reference = reference_decode(blocks, width, height, hemiOctRB, invert);
+			// Tightly packed and with padding between rows, which must not be written
+			for(auto rowPitch : {width * 4, width * 4 + 12}) {
+				for(auto numThreads : {1u, 3u}) {
+					auto data = decode(blocks, width, height, rowPitch, hemiOctRB, invert, numThreads);
+					auto name = "random image " + std::to_string(i) + " (" + std::to_string(width) + "x" + std::to_string(height) + ", options " + std::to_string(opt) + ", row pitch " + std::to_string(rowPitch) + ", " + std::to_string(numThreads) + " threads)";
+					check(compare(data, rowPitch, reference, refRowPitch, width, height), name + " does not match");
+					auto paddingIntact = true;
+					for(auto y = 0u; y < height; ++y) {
+						for(auto x = width * 4; x < rowPitch; ++x)
+							paddingIntact = paddingIntact && data[static_cast<size_t>(y) * rowPitch + x] == 0xCD;
+					}
+					check(paddingIntact, name + " wrote past the image width");
+				}
+			}
+		}
+	}
+}
+
+static void run_bench(uint64_t seed)
+{
+	constexpr uint32_t size = 2048;
+	std::mt19937_64 rng {seed};
+	auto numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<uint8_t> output(size * size * 4);
+	auto measure = [&](auto &&func) {
+		auto best = std::numeric_limits<double>::max();
+		for(auto i = 0u; i < 3; ++i) {
+			auto t0 = std::chrono::steady_clock::now();
+			func();
+			auto t1 = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+		}
+		return (static_cast<double>(size) * size / 1'000'000.0) / best;
+	};
+	std::cout << "mode\tprevious\t1 thread\t" << numThreads << " threads\t(Mtexels/s, " << size << "x" << size << ")" << std::endl;
+	for(auto m = 0u; m <= NUM_MODES; ++m) {
+		// The last row mixes all modes
+		auto blocks = (m < NUM_MODES) ? generate_blocks(rng, (size / 4) * (size / 4), m) : generate_blocks(rng, (size / 4) * (size / 4));
+		auto previous = measure([&]() { reference_uncompress_bc7(size * 4, blocks.data(), output, size, size, false, false); });
+		auto single = measure([&]() { source2::resource::Texture::UncompressBC7(blocks, output, size * 4, size, size, false, false, 1); });
+		auto multi = measure([&]() { source2::resource::Texture::UncompressBC7(blocks, output, size * 4, size, size, false, false, numThreads); });
+		std::cout << ((m < NUM_MODES) ? std::to_string(m) : std::string {"mixed"}) << '\t' << previous << '\t' << single << '\t' << multi << std::endl;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef US2_TOOLS_DATA_DIR
+	std::string dataDir = US2_TOOLS_DATA_DIR;
+#else
+	std::string dataDir = "data";
+#endif
+	uint64_t seed = 1;
+	auto bench = false;
+	auto generate = false;
+	for(auto i = 1; i < argc; ++i) {
+		std::string_view arg {argv[i]};
+		if(arg == "--bench")
+			bench = true;
+		else if(arg == "--generate")
+			generate = true;
+		else if(arg == "--data" && i + 1 < argc)
+			dataDir = argv[++i];
+		else if(arg == "--seed" && i + 1 < argc)
+			seed = std::stoull(argv[++i]);
+	}
+	try {
+		if(generate) {
+			generate_reference_images(dataDir);
+			return EXIT_SUCCESS;
+		}
+		check_reference_images(dataDir);
+		check_random_images(seed);
+		if(bench)
+			run_bench(seed);
+	}
+	catch(const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	if(g_failures > 0) {
+		std::cerr << g_failures << " check(s) failed (seed " << seed << ")" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed (seed " << seed << ")" << std::endl;
+	return EXIT_SUCCESS;
+}
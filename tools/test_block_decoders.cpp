@@ -0,0 +1,222 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Known-answer tests for the BC1, BC3, BC4, BC5, BC6H, ETC2 and ETC2+EAC block decoders, including the signed BC4, BC5 and BC6H
+// variants and the T, H and planar modes of ETC2.
+// - The expected texels were computed with reference decoders written from the D3D11 and Khronos format specifications.
+// - Every block is decoded on its own and as part of an image with partial edge blocks, row padding and multiple threads.
+// Usage: test_block_decoders
+
+import source2;
+
+using BlockFormat = source2::resource::Texture::BlockFormat;
+
+namespace {
+	// Expected texels are BGRA8 in memory order, written as 0xAARRGGBB
+	struct BlockCase {
+		const char *name;
+		BlockFormat format;
+		std::vector<uint8_t> block;
+		std::array<uint32_t, 16> texels;
+	};
+	// Expected texels are the RGB channels of RGBA16F, the alpha channel is always 1.0
+	struct HalfBlockCase {
+		const char *name;
+		BlockFormat format;
+		std::vector<uint8_t> block;
+		std::array<uint16_t, 48> texels;
+	};
+};
+
+static const std::vector<BlockCase> g_blockCases = {
+	{"BC1 four colors", BlockFormat::BC1, {0x00, 0xF8, 0x1F, 0x00, 0xE4, 0xE4, 0xE4, 0xE4},
+	  {0xFFFF0000, 0xFF0000FF, 0xFFAA0055, 0xFF5500AA, 0xFFFF0000, 0xFF0000FF, 0xFFAA0055, 0xFF5500AA, 0xFFFF0000, 0xFF0000FF, 0xFFAA0055, 0xFF5500AA, 0xFFFF0000, 0xFF0000FF, 0xFFAA0055, 0xFF5500AA}},
+	{"BC1 three colors and transparent", BlockFormat::BC1, {0x1F, 0x00, 0xE0, 0x07, 0x1B, 0x1B, 0x1B, 0x1B},
+	  {0x00000000, 0xFF007F7F, 0xFF00FF00, 0xFF0000FF, 0x00000000, 0xFF007F7F, 0xFF00FF00, 0xFF0000FF, 0x00000000, 0xFF007F7F, 0xFF00FF00, 0xFF0000FF, 0x00000000, 0xFF007F7F, 0xFF00FF00, 0xFF0000FF}},
+	{"BC1 random", BlockFormat::BC1, {0x5C, 0x8A, 0x24, 0x31, 0xA7, 0xD2, 0x63, 0x9C},
+	  {0xFF4F3063, 0xFF312421, 0xFF6D3CA5, 0xFF6D3CA5, 0xFF6D3CA5, 0xFF8C49E7, 0xFF312421, 0xFF4F3063, 0xFF4F3063, 0xFF8C49E7, 0xFF6D3CA5, 0xFF312421, 0xFF8C49E7, 0xFF4F3063, 0xFF312421, 0xFF6D3CA5}},
+	{"BC3 eight alpha values", BlockFormat::BC3, {0xC8, 0x28, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA, 0x1F, 0x00, 0xE0, 0x07, 0xE4, 0xE4, 0xE4, 0xE4},
+	  {0xC80000FF, 0x2800FF00, 0xB10055AA, 0x9A00AA55, 0x830000FF, 0x6D00FF00, 0x560055AA, 0x3F00AA55, 0xC80000FF, 0x2800FF00, 0xB10055AA, 0x9A00AA55, 0x830000FF, 0x6D00FF00, 0x560055AA, 0x3F00AA55}},
+	{"BC3 six alpha values", BlockFormat::BC3, {0x1E, 0xDC, 0x63, 0x7D, 0x44, 0x63, 0x7D, 0x44, 0xFF, 0xFF, 0x00, 0x00, 0x4E, 0x4E, 0x4E, 0x4E},
+	  {0x6AAAAAAA, 0x90555555, 0xB6FFFFFF, 0x00000000, 0xFFAAAAAA, 0x1E555555, 0xDCFFFFFF, 0x44000000, 0x6AAAAAAA, 0x90555555, 0xB6FFFFFF, 0x00000000, 0xFFAAAAAA, 0x1E555555, 0xDCFFFFFF, 0x44000000}},
+	{"BC4 eight values", BlockFormat::BC4, {0xF0, 0x10, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA},
+	  {0xFFF0F0F0, 0xFF101010, 0xFFD0D0D0, 0xFFB0B0B0, 0xFF909090, 0xFF707070, 0xFF505050, 0xFF303030, 0xFFF0F0F0, 0xFF101010, 0xFFD0D0D0, 0xFFB0B0B0, 0xFF909090, 0xFF707070, 0xFF505050, 0xFF303030}},
+	{"BC4 six values", BlockFormat::BC4, {0x10, 0xF0, 0xF5, 0x11, 0x8D, 0xF5, 0x11, 0x8D},
+	  {0xFFC3C3C3, 0xFF000000, 0xFFFFFFFF, 0xFF101010, 0xFFF0F0F0, 0xFF3D3D3D, 0xFF6A6A6A, 0xFF969696, 0xFFC3C3C3, 0xFF000000, 0xFFFFFFFF, 0xFF101010, 0xFFF0F0F0, 0xFF3D3D3D, 0xFF6A6A6A, 0xFF969696}},
+	{"BC5", BlockFormat::BC5, {0xFA, 0x05, 0xD1, 0x58, 0x1F, 0xD1, 0x58, 0x1F, 0x05, 0xFA, 0x3E, 0xA2, 0xB1, 0x3E, 0xA2, 0xB1},
+	  {0xFF050000, 0xFFD7FF00, 0xFFB40500, 0xFF91FA00, 0xFF6E3600, 0xFF4B6700, 0xFF289800, 0xFFFAC900, 0xFF050000, 0xFFD7FF00, 0xFFB40500, 0xFF91FA00, 0xFF6E3600, 0xFF4B6700, 0xFF289800, 0xFFFAC900}},
+	{"BC4 signed six values", BlockFormat::BC4_SNORM, {0x80, 0x64, 0x1A, 0xEB, 0x23, 0x1A, 0xEB, 0x23},
+	  {0xFF2E2E2E, 0xFF5B5B5B, 0xFF898989, 0xFFB6B6B6, 0xFF000000, 0xFFFFFFFF, 0xFF000000, 0xFFE4E4E4, 0xFF2E2E2E, 0xFF5B5B5B, 0xFF898989, 0xFFB6B6B6, 0xFF000000, 0xFFFFFFFF, 0xFF000000, 0xFFE4E4E4}},
+	{"BC4 signed eight values", BlockFormat::BC4_SNORM, {0x5A, 0xA0, 0x47, 0x34, 0xD6, 0x47, 0x34, 0xD6},
+	  {0xFF3A3A3A, 0xFFDADADA, 0xFF1F1F1F, 0xFFBFBFBF, 0xFFA5A5A5, 0xFF8A8A8A, 0xFF6F6F6F, 0xFF545454, 0xFF3A3A3A, 0xFFDADADA, 0xFF1F1F1F, 0xFFBFBFBF, 0xFFA5A5A5, 0xFF8A8A8A, 0xFF6F6F6F, 0xFF545454}},
+	{"BC5 signed", BlockFormat::BC5_SNORM, {0x7F, 0x81, 0xAC, 0x8F, 0x68, 0xAC, 0x8F, 0x68, 0xCE, 0x3C, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA},
+	  {0xFF924D00, 0xFF6DBC00, 0xFF496300, 0xFF247900, 0xFFFF9000, 0xFF00A600, 0xFFDB0000, 0xFFB6FF00, 0xFF924D00, 0xFF6DBC00, 0xFF496300, 0xFF247900, 0xFFFF9000, 0xFF00A600, 0xFFDB0000, 0xFFB6FF00}},
+	{"ETC2 individual mode", BlockFormat::ETC2, {0x36, 0x34, 0x57, 0x99, 0x8F, 0xF2, 0x2B, 0x92},
+	  {0xFF454567, 0xFF000019, 0xFF000019, 0xFF454567, 0xFF000019, 0xFF212143, 0xFF000019, 0xFF6F6F91, 0xFF876598, 0xFF452356, 0xFF452356, 0xFF876598, 0xFF876598, 0xFF00000D, 0xFF00000D, 0xFF452356}},
+	{"ETC2 differential mode", BlockFormat::ETC2, {0xED, 0x67, 0x46, 0x5E, 0x4A, 0xD2, 0xA4, 0xD8},
+	  {0xFFF86C4B, 0xFFD24625, 0xFFFF8960, 0xFFFF8960, 0xFFE65A39, 0xFFF86C4B, 0xFFA72B02, 0xFFFFFFE8, 0xFFF86C4B, 0xFFD24625, 0xFFFFFFE8, 0xFFA72B02, 0xFFFF805F, 0xFFD24625, 0xFFA72B02, 0xFFFFFFE8}},
+	{"ETC2 T mode", BlockFormat::ETC2, {0x0D, 0xA5, 0x73, 0x3E, 0xC9, 0x77, 0x32, 0xE2},
+	  {0xFF773333, 0xFF773333, 0xFF773333, 0xFFA05C5C, 0xFF4E0A0A, 0xFF4E0A0A, 0xFFA05C5C, 0xFFA05C5C, 0xFF773333, 0xFF4E0A0A, 0xFF55AA55, 0xFF773333, 0xFF55AA55, 0xFFA05C5C, 0xFF773333, 0xFF773333}},
+	{"ETC2 H mode", BlockFormat::ETC2, {0x92, 0x06, 0xFB, 0x5F, 0x78, 0x53, 0x9D, 0x71},
+	  {0xFFD63D92, 0xFFD63D92, 0xFF001B2C, 0xFFD63D92, 0xFFFF8FE4, 0xFF001B2C, 0xFF4B6D7E, 0xFFFF8FE4, 0xFF4B6D7E, 0xFFD63D92, 0xFF001B2C, 0xFFFF8FE4, 0xFF4B6D7E, 0xFF4B6D7E, 0xFFD63D92, 0xFF001B2C}},
+	{"ETC2 planar mode", BlockFormat::ETC2, {0xE4, 0x7D, 0x1C, 0x63, 0x6F, 0x46, 0x69, 0x8A},
+	  {0xFFCB7CE3, 0xFFCA79D3, 0xFFC975C3, 0xFFC872B2, 0xFFCC70B4, 0xFFCB6DA4, 0xFFCA6994, 0xFFC96684, 0xFFCD6486, 0xFFCC6175, 0xFFCB5D65, 0xFFCA5A55, 0xFFCE5857, 0xFFCD5547, 0xFFCC5136, 0xFFCB4E26}},
+	{"ETC2 with EAC alpha", BlockFormat::ETC2_EAC, {0x75, 0x86, 0xBC, 0x2E, 0x93, 0x64, 0xB6, 0x77, 0x9F, 0x06, 0x32, 0x8D, 0x9B, 0xEC, 0xCC, 0x31},
+	  {0xA5D53C6F, 0xC5D53C6F, 0x1D870021, 0x1D870021, 0xC5AB1245, 0x355D0000, 0x3D870021, 0x3DAB1245, 0x55F25915, 0x35F25915, 0x3DFF904C, 0xADFF904C, 0x35F25915, 0x1DF25915, 0x1DD53C00, 0xC5D53C00}},
+	{"ETC2 with EAC alpha, multiplier 0", BlockFormat::ETC2_EAC, {0xF9, 0x04, 0x8E, 0x42, 0xD3, 0xEE, 0xAC, 0x6D, 0x92, 0x06, 0xFB, 0x5F, 0x78, 0x53, 0x9D, 0x71},
+	  {0xF9D63D92, 0xF9D63D92, 0xF9001B2C, 0xF9D63D92, 0xF9FF8FE4, 0xF9001B2C, 0xF94B6D7E, 0xF9FF8FE4, 0xF94B6D7E, 0xF9D63D92, 0xF9001B2C, 0xF9FF8FE4, 0xF94B6D7E, 0xF94B6D7E, 0xF9D63D92, 0xF9001B2C}},
+};
+
+static const std::vector<HalfBlockCase> g_halfBlockCases = {
+	{"BC6H one region, 10-bit endpoints", BlockFormat::BC6H, {0xE3, 0x07, 0x20, 0xA0, 0xA4, 0x81, 0xFE, 0x59, 0x94, 0xE0, 0xE2, 0x59, 0xAB, 0xE4, 0xF4, 0xE8},
+	  {0x0780, 0x17F4, 0x40B7, 0x06E6, 0x4BF8, 0x2A0D, 0x07B0, 0x07CF, 0x47BF, 0x0670, 0x736E, 0x18DC, 0x0780, 0x17F4, 0x40B7, 0x0670, 0x736E, 0x18DC, 0x06E6, 0x4BF8, 0x2A0D, 0x0740, 0x2D7A, 0x3756, 0x06B6, 0x5C1D, 0x2305, 0x06CB, 0x54F0, 0x2625, 0x0755, 0x264D, 0x3A76, 0x0670, 0x736E, 0x18DC, 0x0755, 0x264D, 0x3A76, 0x065B, 0x7A9B, 0x15BC, 0x06FB, 0x44CB, 0x2D2D, 0x0670, 0x736E, 0x18DC}},
+	{"BC6H one region, 16-bit endpoint and 4-bit deltas", BlockFormat::BC6H, {0x0F, 0x26, 0xFB, 0x43, 0x91, 0x9B, 0xA6, 0x96, 0x5B, 0xEE, 0xE0, 0xCD, 0xD6, 0x4F, 0x4F, 0x77},
+	  {0x72E3, 0x62CB, 0x251D, 0x72E3, 0x62CB, 0x251D, 0x72E4, 0x62CD, 0x251C, 0x72E4, 0x62CD, 0x251C, 0x72E3, 0x62CB, 0x251D, 0x72E4, 0x62CD, 0x251C, 0x72E4, 0x62CC, 0x251C, 0x72E4, 0x62CC, 0x251D, 0x72E3, 0x62CC, 0x251D, 0x72E4, 0x62CC, 0x251C, 0x72E4, 0x62CD, 0x251C, 0x72E3, 0x62CB, 0x251D, 0x72E4, 0x62CD, 0x251C, 0x72E3, 0x62CB, 0x251D, 0x72E3, 0x62CC, 0x251D, 0x72E3, 0x62CC, 0x251D}},
+	{"BC6H two regions", BlockFormat::BC6H, {0xC4, 0x0D, 0x98, 0xED, 0xFD, 0x6B, 0xE1, 0x09, 0xA4, 0x14, 0xA3, 0xB6, 0xA2, 0xBF, 0x2A, 0xF5},
+	  {0x0D61, 0x62DF, 0x5BD9, 0x0D58, 0x633F, 0x5B68, 0x0C13, 0x61A9, 0x5BFC, 0x0CDC, 0x61E6, 0x5C42, 0x0D54, 0x636F, 0x5B2F, 0x0D4B, 0x63D4, 0x5AB7, 0x0D61, 0x62DF, 0x5BD9, 0x0DAF, 0x6226, 0x5C8B, 0x0D42, 0x6434, 0x5A46, 0x0D42, 0x6434, 0x5A46, 0x0D58, 0x633F, 0x5B68, 0x0DAF, 0x6226, 0x5C8B, 0x0D58, 0x633F, 0x5B68, 0x0D58, 0x633F, 0x5B68, 0x0D4B, 0x63D4, 0x5AB7, 0x0D42, 0x6434, 0x5A46}},
+	{"BC6H reserved mode", BlockFormat::BC6H, {0x33, 0x01, 0x92, 0x9E, 0x42, 0xA6, 0x4C, 0x3A, 0xE2, 0xFF, 0x0B, 0x09, 0xF3, 0x18, 0x20, 0x11},
+	  {0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000}},
+	{"BC6H signed one region, 10-bit endpoints", BlockFormat::BC6H_SF16, {0x03, 0x46, 0x3C, 0x25, 0x9B, 0x8F, 0xE2, 0x3F, 0x0B, 0xA5, 0xEE, 0xAC, 0xED, 0x68, 0xA4, 0x14},
+	  {0xA3E3, 0xD2A9, 0x22DC, 0xF07F, 0xDF0F, 0x617B, 0xA3E3, 0xD2A9, 0x22DC, 0x2C5D, 0xC5AC, 0x9EBE, 0x6A61, 0xBBA3, 0xD16F, 0x6A61, 0xBBA3, 0xD16F, 0x498C, 0xC0F3, 0xB699, 0x2C5D, 0xC5AC, 0x9EBE, 0x5824, 0xBE97, 0xC286, 0x6A61, 0xBBA3, 0xD16F, 0x0B88, 0xCAFC, 0x83E7, 0x91A6, 0xCFB5, 0x13F3, 0xB27B, 0xD505, 0x2EC9, 0x2C5D, 0xC5AC, 0x9EBE, 0xB27B, 0xD505, 0x2EC9, 0xE1E7, 0xDCB2, 0x558D}},
+	{"BC6H signed one region, 16-bit endpoint and 4-bit deltas", BlockFormat::BC6H_SF16, {0x2F, 0xA5, 0x06, 0x22, 0x6E, 0xC5, 0x40, 0xBE, 0x6C, 0xD4, 0xC3, 0xAF, 0xD7, 0xF4, 0x6A, 0x0C},
+	  {0x4E9E, 0x03EE, 0x9449, 0x4E9E, 0x03EE, 0x9449, 0x4E9E, 0x03EE, 0x9448, 0x4E9C, 0x03F1, 0x944A, 0x4E9E, 0x03ED, 0x9448, 0x4E9D, 0x03F1, 0x944A, 0x4E9C, 0x03F2, 0x944B, 0x4E9D, 0x03F0, 0x944A, 0x4E9E, 0x03EF, 0x9449, 0x4E9C, 0x03F1, 0x944A, 0x4E9E, 0x03EE, 0x9448, 0x4E9C, 0x03F2, 0x944B, 0x4E9D, 0x03F0, 0x944A, 0x4E9E, 0x03EE, 0x9449, 0x4E9D, 0x03F1, 0x944A, 0x4E9F, 0x03EC, 0x9447}},
+	{"BC6H signed two regions", BlockFormat::BC6H_SF16, {0x9C, 0x89, 0xF7, 0x11, 0x1E, 0xAD, 0xF6, 0xC0, 0x38, 0x28, 0x50, 0x2E, 0x73, 0xE1, 0x38, 0x61},
+	  {0x1287, 0x843D, 0xBC2F, 0x130C, 0x8627, 0xBC02, 0x12F2, 0x85C7, 0xBC0B, 0x1055, 0x85D7, 0xBF1D, 0x12A1, 0x849C, 0xBC26, 0x12D5, 0x855C, 0xBC14, 0x1326, 0x8687, 0xBBF9, 0x0F78, 0x8544, 0xBF79, 0x1287, 0x843D, 0xBC2F, 0x1326, 0x8687, 0xBBF9, 0x12A1, 0x849C, 0xBC26, 0x0F0F, 0x84FE, 0xBFA5, 0x12A1, 0x849C, 0xBC26, 0x12A1, 0x849C, 0xBC26, 0x12F2, 0x85C7, 0xBC0B, 0x1126, 0x8663, 0xBEC6}},
+};
+
+static uint32_t g_failures = 0;
+static void check(bool condition, const std::string &msg)
+{
+	if(condition)
+		return;
+	std::cerr << "FAILED: " << msg << std::endl;
+	++g_failures;
+}
+
+static uint32_t get_texel_size(BlockFormat format) { return (format == BlockFormat::BC6H || format == BlockFormat::BC6H_SF16) ? 8 : 4; }
+static uint32_t get_block_size(BlockFormat format) { return (format == BlockFormat::BC1 || format == BlockFormat::BC4 || format == BlockFormat::BC4_SNORM || format == BlockFormat::ETC2) ? 8 : 16; }
+
+// Expected bytes of texel 'i' of a block
+static std::array<uint8_t, 8> get_expected_texel(const BlockCase &c, uint32_t i)
+{
+	std::array<uint8_t, 8> texel {};
+	memcpy(texel.data(), &c.texels[i], 4);
+	return texel;
+}
+static std::array<uint8_t, 8> get_expected_texel(const HalfBlockCase &c, uint32_t i)
+{
+	std::array<uint16_t, 4> channels {c.texels[i * 3], c.texels[i * 3 + 1], c.texels[i * 3 + 2], 0x3C00};
+	std::array<uint8_t, 8> texel {};
+	memcpy(texel.data(), channels.data(), sizeof(channels));
+	return texel;
+}
+
+template<typename TCase>
+static void check_single_blocks(const std::vector<TCase> &cases)
+{
+	for(auto &c : cases) {
+		auto texelSize = get_texel_size(c.format);
+		check(c.block.size() == get_block_size(c.format), std::string {c.name} + ": invalid block size");
+		std::vector<uint8_t> output(16 * texelSize, 0xCD);
+		source2::resource::Texture::DecodeBlocks(c.format, c.block, output, 4 * texelSize, 4, 4);
+		for(auto i = 0u; i < 16u; ++i) {
+			auto expected = get_expected_texel(c, i);
+			check(memcmp(output.data() + i * texelSize, expected.data(), texelSize) == 0, std::string {c.name} + ": texel " + std::to_string(i) + " does not match");
+		}
+	}
+}
+
+// Decodes all blocks of a format as a single image with partial blocks at the right and bottom edges
+template<typename TCase>
+static void check_images(const std::vector<TCase> &cases, BlockFormat format, const std::string &formatName)
+{
+	std::vector<const TCase *> formatCases;
+	for(auto &c : cases) {
+		if(c.format == format)
+			formatCases.push_back(&c);
+	}
+	auto texelSize = get_texel_size(format);
+	auto blockCountX = static_cast<uint32_t>(formatCases.size());
+	constexpr uint32_t blockCountY = 5;
+	std::vector<uint8_t> blocks;
+	for(auto y = 0u; y < blockCountY; ++y) {
+		// Every block row is shifted by one block
+		for(auto x = 0u; x < blockCountX; ++x) {
+			auto &block = formatCases[(x + y) % blockCountX]->block;
+			blocks.insert(blocks.end(), block.begin(), block.end());
+		}
+	}
+	auto width = blockCountX * 4 - 1;
+	auto height = blockCountY * 4 - 2;
+	for(auto rowPitch : {width * texelSize, width * texelSize + 12}) {
+		for(auto numThreads : {1u, 3u}) {
+			std::vector<uint8_t> output(static_cast<size_t>(rowPitch) * height, 0xCD);
+			source2::resource::Texture::DecodeBlocks(format, blocks, output, rowPitch, width, height, {}, numThreads);
+			auto matches = true;
+			auto paddingIntact = true;
+			for(auto y = 0u; y < height; ++y) {
+				auto *row = output.data() + static_cast<size_t>(y) * rowPitch;
+				for(auto x = 0u; x < width; ++x) {
+					auto expected = get_expected_texel(*formatCases[(x / 4 + y / 4) % blockCountX], (y % 4) * 4 + x % 4);
+					matches = matches && memcmp(row + x * texelSize, expected.data(), texelSize) == 0;
+				}
+				for(auto x = width * texelSize; x < rowPitch; ++x)
+					paddingIntact = paddingIntact && row[x] == 0xCD;
+			}
+			auto name = formatName + " image (" + std::to_string(width) + "x" + std::to_string(height) + ", row pitch " + std::to_string(rowPitch) + ", " + std::to_string(numThreads) + " threads)";
+			check(matches, name + " does not match");
+			check(paddingIntact, name + " wrote past the image width");
+		}
+	}
+}
+
+// The decode options are applied to the decoded BGRA8 texels with the same kernels as ApplyDecodeOptions
+static void check_decode_options()
+{
+	for(auto &c : g_blockCases) {
+		for(auto opt = 1u; opt < 4; ++opt) {
+			source2::resource::Texture::DecodeOptions options {};
+			options.hemiOctRB = (opt & 1) != 0;
+			options.invert = (opt & 2) != 0;
+			std::vector<uint8_t> expected(64);
+			memcpy(expected.data(), c.texels.data(), expected.size());
+			source2::resource::Texture::ApplyDecodeOptions(expected, options);
+			std::vector<uint8_t> output(64);
+			source2::resource::Texture::DecodeBlocks(c.format, c.block, output, 16, 4, 4, options);
+			check(output == expected, std::string {c.name} + ": decode options " + std::to_string(opt) + " do not match");
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try {
+		check_single_blocks(g_blockCases);
+		check_single_blocks(g_halfBlockCases);
+		constexpr std::array<std::pair<BlockFormat, const char *>, 8> formats {{
+		  {BlockFormat::BC1, "BC1"},
+		  {BlockFormat::BC3, "BC3"},
+		  {BlockFormat::BC4, "BC4"},
+		  {BlockFormat::BC4_SNORM, "BC4 signed"},
+		  {BlockFormat::BC5, "BC5"},
+		  {BlockFormat::BC5_SNORM, "BC5 signed"},
+		  {BlockFormat::ETC2, "ETC2"},
+		  {BlockFormat::ETC2_EAC, "ETC2 EAC"},
+		}};
+		for(auto &[format, name] : formats)
+			check_images(g_blockCases, format, name);
+		check_images(g_halfBlockCases, BlockFormat::BC6H, "BC6H");
+		check_images(g_halfBlockCases, BlockFormat::BC6H_SF16, "BC6H signed");
+		check_decode_options();
+	}
+	catch(const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	if(g_failures > 0) {
+		std::cerr << g_failures << " check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,127 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Checks the vectorized normal-map kernels behind Texture::DecodeOptions against the previous per-texel scalar code
+// for every red/green combination, in BGRA and RGBA order and for run lengths that exercise the scalar tail.
+// Usage: test_decode_kernels [--bench]
+// --bench measures each kernel in Mtexels/s against the scalar code.
+
+import source2;
+
+// Previous per-texel code of the BC7 decoder, generalized to both channel orders
+static void reference_apply(uint8_t *texel, bool hemiOctRB, bool invert, bool rgba)
+{
+	auto r = rgba ? 0 : 2;
+	auto b = rgba ? 2 : 0;
+	if(hemiOctRB) {
+		float nx = ((texel[r] + texel[1]) / 255.0f) - 1.003922f;
+		float ny = (texel[r] - texel[1]) / 255.0f;
+		float nz = 1 - fabsf(nx) - fabsf(ny);
+
+		float l = (float)sqrtf((nx * nx) + (ny * ny) + (nz * nz));
+		texel[3] = texel[b]; //b to alpha
+		texel[r] = (uint8_t)(((nx / l * 0.5f) + 0.5f) * 255);
+		texel[1] = (uint8_t)(((ny / l * 0.5f) + 0.5f) * 255);
+		texel[b] = (uint8_t)(((nz / l * 0.5f) + 0.5f) * 255);
+	}
+	if(invert)
+		texel[1] = (uint8_t)(~texel[1]); // LegacySource1InvertNormals
+}
+static void reference_apply(std::span<uint8_t> texels, bool hemiOctRB, bool invert, bool rgba)
+{
+	for(size_t i = 0; i < texels.size(); i += 4)
+		reference_apply(texels.data() + i, hemiOctRB, invert, rgba);
+}
+
+static uint32_t g_failures = 0;
+static void check(bool condition, const std::string &msg)
+{
+	if(condition)
+		return;
+	std::cerr << "FAILED: " << msg << std::endl;
+	++g_failures;
+}
+
+static std::string describe(bool hemiOctRB, bool invert, bool rgba) { return std::string {"hemiOctRB="} + (hemiOctRB ? "1" : "0") + " invert=" + (invert ? "1" : "0") + (rgba ? " RGBA" : " BGRA"); }
+
+static void check_kernels()
+{
+	// Every red/green combination, with varying blue and alpha
+	std::vector<uint8_t> all(256 * 256 * 4);
+	for(auto i = 0u; i < 256 * 256; ++i) {
+		all[i * 4 + 0] = static_cast<uint8_t>(i * 7);
+		all[i * 4 + 1] = static_cast<uint8_t>(i & 0xFF);
+		all[i * 4 + 2] = static_cast<uint8_t>(i >> 8);
+		all[i * 4 + 3] = static_cast<uint8_t>(i * 13);
+	}
+	std::mt19937 rng {1};
+	for(auto opt = 1u; opt < 4; ++opt) {
+		auto hemiOctRB = (opt & 1) != 0;
+		auto invert = (opt & 2) != 0;
+		for(auto rgba : {false, true}) {
+			source2::resource::Texture::DecodeOptions options {};
+			options.hemiOctRB = hemiOctRB;
+			options.invert = invert;
+			auto expected = all;
+			reference_apply(expected, hemiOctRB, invert, rgba);
+			auto data = all;
+			source2::resource::Texture::ApplyDecodeOptions(data, options, rgba);
+			check(data == expected, "all red/green combinations differ (" + describe(hemiOctRB, invert, rgba) + ")");
+
+			// Runs which don't fill whole vectors, at arbitrary offsets
+			for(auto numTexels = 1u; numTexels <= 37; ++numTexels) {
+				auto offset = std::uniform_int_distribution<size_t> {0, 256 * 256 - numTexels}(rng) * 4;
+				std::vector<uint8_t> run {all.begin() + offset, all.begin() + offset + numTexels * 4};
+				auto expectedRun = run;
+				reference_apply(expectedRun, hemiOctRB, invert, rgba);
+				source2::resource::Texture::ApplyDecodeOptions(run, options, rgba);
+				check(run == expectedRun, std::to_string(numTexels) + " texels differ (" + describe(hemiOctRB, invert, rgba) + ")");
+			}
+		}
+	}
+}
+
+static void run_bench()
+{
+	constexpr size_t numTexels = 4096 * 1024;
+	std::vector<uint8_t> texels(numTexels * 4);
+	std::mt19937 rng {2};
+	for(auto &v : texels)
+		v = static_cast<uint8_t>(rng());
+	auto measure = [&](auto &&func) {
+		auto best = std::numeric_limits<double>::max();
+		for(auto i = 0u; i < 5; ++i) {
+			auto t0 = std::chrono::steady_clock::now();
+			func();
+			auto t1 = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+		}
+		return (numTexels / 1'000'000.0) / best;
+	};
+	std::cout << "kernel\t\t\tscalar\tvectorized\t(Mtexels/s)" << std::endl;
+	for(auto opt = 1u; opt < 4; ++opt) {
+		auto hemiOctRB = (opt & 1) != 0;
+		auto invert = (opt & 2) != 0;
+		source2::resource::Texture::DecodeOptions options {};
+		options.hemiOctRB = hemiOctRB;
+		options.invert = invert;
+		// The kernels are applied to the same buffer repeatedly, the values don't matter for the timing
+		auto scalar = measure([&]() { reference_apply(texels, hemiOctRB, invert, false); });
+		auto vectorized = measure([&]() { source2::resource::Texture::ApplyDecodeOptions(texels, options); });
+		std::cout << describe(hemiOctRB, invert, false) << '\t' << scalar << '\t' << vectorized << std::endl;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	auto bench = (argc > 1 && std::string_view {argv[1]} == "--bench");
+	check_kernels();
+	if(bench)
+		run_bench();
+	if(g_failures > 0) {
+		std::cerr << g_failures << " check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,244 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Regression test of BinaryKV3::BlockDecompress against the previous decoder, with randomly generated streams,
+// long overlapping back-reference chains, truncated and invalid input.
+// Usage: test_kv3_block_decompress [seed] [--bench]
+// With --bench, the throughput of both decoders is measured on a 16 MiB stream.
+
+import source2;
+
+// Previous decoder, kept as the reference. Reads from a span instead of an IFile and stops at the end of the input.
+static std::vector<uint8_t> reference_decompress(std::span<const uint8_t> input)
+{
+	size_t inPos = 0;
+	auto read16 = [&](uint16_t &v) {
+		if(inPos + sizeof(v) > input.size())
+			return false;
+		memcpy(&v, input.data() + inPos, sizeof(v));
+		inPos += sizeof(v);
+		return true;
+	};
+	std::array<uint8_t, 4> flags;
+	memcpy(flags.data(), input.data(), flags.size());
+	inPos += flags.size();
+	if((flags[3] & 0x80) > 0)
+		return {input.begin() + inPos, input.end()};
+	size_t outSize = (flags[2] << 16) + (flags[1] << 8) + flags[0];
+
+	std::vector<uint8_t> vOutData {};
+	uint64_t dataReadOffset = 0ull;
+	uint64_t dataWriteOffset = 0ull;
+	auto fRead = [&vOutData, &dataReadOffset](void *outData, uint64_t size) {
+		memcpy(outData, vOutData.data() + dataReadOffset, size);
+		dataReadOffset += size;
+	};
+	auto fWrite = [&vOutData, &dataWriteOffset, &dataReadOffset](const void *inData, uint64_t size) {
+		if(dataWriteOffset + size >= vOutData.size())
+			vOutData.resize(dataWriteOffset + size);
+		memcpy(vOutData.data() + dataWriteOffset, inData, size);
+		dataWriteOffset += size;
+		dataReadOffset += size;
+	};
+	auto running = true;
+	while(inPos < input.size() && running) {
+		uint16_t blockMask;
+		if(!read16(blockMask))
+			break;
+		for(auto i = decltype(blockMask) {0u}; i < (sizeof(blockMask) * 8); ++i) {
+			if((blockMask & (1 << i)) > 0) {
+				uint16_t offsetSize;
+				if(!read16(offsetSize)) {
+					running = false;
+					break;
+				}
+				int32_t offset = ((offsetSize & 0xFFF0) >> 4) + 1;
+				int32_t size = (offsetSize & 0x000F) + 3;
+				auto lookupSize = (offset < size) ? offset : size;
+				auto p = dataReadOffset;
+				dataReadOffset = p - offset;
+				std::vector<uint8_t> data {};
+				data.resize(lookupSize);
+				fRead(data.data(), data.size());
+				dataWriteOffset = p;
+				dataReadOffset = p;
+				while(size > 0) {
+					fWrite(data.data(), (lookupSize < size) ? lookupSize : size);
+					size -= lookupSize;
+				}
+			}
+			else {
+				if(inPos >= input.size()) {
+					running = false;
+					break;
+				}
+				auto data = input[inPos++];
+				fWrite(&data, sizeof(data));
+			}
+			if(vOutData.size() == outSize) {
+				running = false;
+				break;
+			}
+		}
+	}
+	return vOutData;
+}
+
+// Generates a valid compressed stream and its decoded contents
+struct Stream {
+	std::vector<uint8_t> compressed;
+	std::vector<uint8_t> decoded;
+};
+static Stream generate_stream(std::mt19937 &rng, size_t outSize, uint32_t backRefPercentage, uint32_t maxOffset)
+{
+	Stream stream {};
+	auto &out = stream.decoded;
+	auto &in = stream.compressed;
+	out.reserve(outSize);
+	in = {static_cast<uint8_t>(outSize & 0xFF), static_cast<uint8_t>((outSize >> 8) & 0xFF), static_cast<uint8_t>((outSize >> 16) & 0xFF), 0};
+	auto write16 = [&in](size_t pos, uint16_t v) { memcpy(in.data() + pos, &v, sizeof(v)); };
+	while(out.size() < outSize) {
+		auto maskPos = in.size();
+		in.resize(in.size() + sizeof(uint16_t));
+		uint16_t blockMask = 0;
+		for(auto i = 0u; i < 16 && out.size() < outSize; ++i) {
+			auto size = std::uniform_int_distribution<size_t> {3, 18}(rng);
+			if(!out.empty() && out.size() + size <= outSize && std::uniform_int_distribution<uint32_t> {0, 99}(rng) < backRefPercentage) {
+				auto offset = std::uniform_int_distribution<size_t> {1, std::min<size_t>({out.size(), maxOffset, 4'096})}(rng);
+				blockMask |= (1 << i);
+				auto pos = in.size();
+				in.resize(in.size() + sizeof(uint16_t));
+				write16(pos, static_cast<uint16_t>(((offset - 1) << 4) | (size - 3)));
+				for(auto j = 0u; j < size; ++j)
+					out.push_back(out[out.size() - offset]);
+				continue;
+			}
+			auto literal = static_cast<uint8_t>(rng());
+			in.push_back(literal);
+			out.push_back(literal);
+		}
+		write16(maskPos, blockMask);
+	}
+	return stream;
+}
+
+static std::vector<uint8_t> decompress(std::span<const uint8_t> input)
+{
+	pragma::util::DataStream ds {};
+	source2::resource::BinaryKV3::BlockDecompress(input, ds);
+	auto *data = static_cast<const uint8_t *>(ds->GetData());
+	return {data, data + ds->GetInternalSize()};
+}
+
+static uint32_t g_failures = 0;
+static void check(bool condition, const std::string &msg)
+{
+	if(condition)
+		return;
+	std::cerr << "FAILED: " << msg << std::endl;
+	++g_failures;
+}
+
+static void run_bench(std::mt19937 &rng)
+{
+	constexpr size_t outSize = 0xFFFFFF;
+	auto stream = generate_stream(rng, outSize, 60, 4'096);
+	auto measure = [&](auto &&func) {
+		auto best = std::numeric_limits<double>::max();
+		for(auto i = 0u; i < 5; ++i) {
+			auto t0 = std::chrono::steady_clock::now();
+			func();
+			auto t1 = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+		}
+		return (outSize / (1024.0 * 1024.0)) / best;
+	};
+	std::cout << "BlockDecompress: " << measure([&]() { decompress(stream.compressed); }) << " MiB/s (decoded)" << std::endl;
+	std::cout << "Previous decoder: " << measure([&]() { reference_decompress(stream.compressed); }) << " MiB/s (decoded)" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t seed = 1;
+	auto bench = false;
+	for(auto i = 1; i < argc; ++i) {
+		if(std::string_view {argv[i]} == "--bench")
+			bench = true;
+		else
+			seed = std::stoul(argv[i]);
+	}
+	std::mt19937 rng {seed};
+
+	// Random streams with varying back-reference densities and distances
+	for(auto i = 0u; i < 500; ++i) {
+		auto outSize = std::uniform_int_distribution<size_t> {1, 64 * 1024}(rng);
+		auto backRefPercentage = std::uniform_int_distribution<uint32_t> {0, 100}(rng);
+		auto maxOffset = (i % 2 == 0) ? 4'096u : 8u;
+		auto stream = generate_stream(rng, outSize, backRefPercentage, maxOffset);
+		auto decoded = decompress(stream.compressed);
+		check(decoded == stream.decoded, "random stream " + std::to_string(i) + " does not match the generated data");
+		check(decoded == reference_decompress(stream.compressed), "random stream " + std::to_string(i) + " does not match the previous decoder");
+
+		// Truncated input must not throw and yields a prefix of the decoded data
+		auto cut = std::uniform_int_distribution<size_t> {4, stream.compressed.size()}(rng);
+		try {
+			auto partial = decompress(std::span<const uint8_t> {stream.compressed}.first(cut));
+			check(partial.size() <= stream.decoded.size() && std::equal(partial.begin(), partial.end(), stream.decoded.begin()), "truncated stream " + std::to_string(i) + " is not a prefix");
+		}
+		catch(const std::exception &e) {
+			check(false, "truncated stream " + std::to_string(i) + " threw: " + e.what());
+		}
+	}
+
+	// Long chains of overlapping back-references, each one repeats bytes written by the previous one
+	for(auto offset : {1u, 2u, 3u, 17u}) {
+		auto stream = generate_stream(rng, 1024 * 1024, 100, offset);
+		check(decompress(stream.compressed) == stream.decoded, "overlapping chain with offset " + std::to_string(offset) + " does not match");
+		check(reference_decompress(stream.compressed) == stream.decoded, "previous decoder does not match overlapping chain with offset " + std::to_string(offset));
+	}
+
+	// Largest size that can be declared in the flags
+	{
+		auto stream = generate_stream(rng, 0xFFFFFF, 50, 4'096);
+		check(decompress(stream.compressed) == stream.decoded, "stream with maximum size does not match");
+	}
+
+	// Uncompressed block
+	{
+		std::vector<uint8_t> input {0, 0, 0, 0x80, 1, 2, 3, 4, 5};
+		check(decompress(input) == std::vector<uint8_t> {1, 2, 3, 4, 5}, "uncompressed block does not match");
+	}
+
+	// Back-references before the start of the output and past the declared size must be rejected
+	for(auto &input : std::vector<std::vector<uint8_t>> {{16, 0, 0, 0, 0x01, 0x00, 0x00, 0x00}, {4, 0, 0, 0, 0x02, 0x00, 'a', 0x0F, 0x00}}) {
+		auto threw = false;
+		try {
+			decompress(input);
+		}
+		catch(const std::exception &) {
+			threw = true;
+		}
+		check(threw, "invalid back-reference was accepted");
+	}
+
+	// Input that ends before the flags
+	{
+		auto threw = false;
+		try {
+			decompress(std::vector<uint8_t> {1, 0});
+		}
+		catch(const std::exception &) {
+			threw = true;
+		}
+		check(threw, "input without flags was accepted");
+	}
+
+	if(bench)
+		run_bench(rng);
+	if(g_failures > 0) {
+		std::cerr << g_failures << " check(s) failed (seed " << seed << ")" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed (seed " << seed << ")" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,394 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Reads uncompressed KV3\x02 to KV3\x04 DATA blocks, including the 16-bit and float values of KV3\x04 and typed
+// boolean and string arrays, with every KV3 representation, and checks that KV3\x05 is rejected and that parsing errors
+// of lazy blocks are rethrown on every access.
+// The blocks are assembled by KV3Writer below, section by section in the order the values are read.
+// Usage: test_kv3_versions
+
+import source2;
+
+using source2::resource::KVType;
+
+class KV3Writer {
+  public:
+	void BeginObject(uint32_t memberCount)
+	{
+		Type(KVType::OBJECT);
+		Put(m_bytes4, static_cast<int32_t>(memberCount));
+	}
+	void Key(const std::string &key) { Put(m_bytes4, String(key)); }
+	void Int16(int16_t value)
+	{
+		Type(KVType::INT16);
+		Put(m_bytes2, value);
+	}
+	void UInt16(uint16_t value)
+	{
+		Type(KVType::UINT16);
+		Put(m_bytes2, value);
+	}
+	void Float(float value)
+	{
+		Type(KVType::FLOAT);
+		Put(m_bytes4, value);
+	}
+	void Int32(int32_t value)
+	{
+		Type(KVType::INT32);
+		Put(m_bytes4, value);
+	}
+	void Double(double value)
+	{
+		Type(KVType::DOUBLE);
+		Put(m_bytes8, value);
+	}
+	void Boolean(bool value)
+	{
+		Type(KVType::BOOLEAN);
+		Put(m_bytes1, static_cast<uint8_t>(value));
+	}
+	void String(const std::string &key, const std::string &value)
+	{
+		Key(key);
+		Type(KVType::STRING);
+		Put(m_bytes4, String(value));
+	}
+	void TypedInt16Array(std::span<const int16_t> values)
+	{
+		Type(KVType::ARRAY_TYPED);
+		Put(m_bytes4, static_cast<int32_t>(values.size()));
+		Type(KVType::INT16);
+		for(auto v : values)
+			Put(m_bytes2, v);
+	}
+	void TypedFloatArray(std::span<const float> values)
+	{
+		Type(KVType::ARRAY_TYPED);
+		Put(m_bytes4, static_cast<int32_t>(values.size()));
+		Type(KVType::FLOAT);
+		for(auto v : values)
+			Put(m_bytes4, v);
+	}
+	void TypedBoolArray(std::span<const bool> values)
+	{
+		Type(KVType::ARRAY_TYPED);
+		Put(m_bytes4, static_cast<int32_t>(values.size()));
+		Type(KVType::BOOLEAN);
+		for(auto v : values)
+			Put(m_bytes1, static_cast<uint8_t>(v));
+	}
+	// Empty strings are stored as -1
+	void TypedStringArray(std::span<const std::string> values)
+	{
+		Type(KVType::ARRAY_TYPED);
+		Put(m_bytes4, static_cast<int32_t>(values.size()));
+		Type(KVType::STRING);
+		for(auto &v : values)
+			Put(m_bytes4, v.empty() ? -1 : String(v));
+	}
+
+	// Uncompressed DATA block of the specified container version
+	std::vector<uint8_t> Build(uint8_t version) const
+	{
+		std::vector<uint8_t> data;
+		data.insert(data.end(), m_bytes1.begin(), m_bytes1.end());
+		if(version >= 4 && !m_bytes2.empty()) {
+			Align(data, 2);
+			data.insert(data.end(), m_bytes2.begin(), m_bytes2.end());
+		}
+		Align(data, 4);
+		Put(data, static_cast<int32_t>(m_strings.size()));
+		data.insert(data.end(), m_bytes4.begin(), m_bytes4.end());
+		Align(data, 8);
+		data.insert(data.end(), m_bytes8.begin(), m_bytes8.end());
+		auto stringsOffset = data.size();
+		for(auto &str : m_strings)
+			data.insert(data.end(), str.c_str(), str.c_str() + str.size() + 1);
+		data.insert(data.end(), m_types.begin(), m_types.end());
+		auto stringAndTypesBufferSize = static_cast<uint32_t>(data.size() - stringsOffset);
+		Put(data, uint32_t {0xFFEEDD00});
+
+		std::vector<uint8_t> block;
+		Put(block, static_cast<uint32_t>(source2::resource::BinaryKV3::MAGIC2 & ~0xFFu) | version);
+		block.resize(block.size() + 16); // Format
+		Put(block, int32_t {0});         // Compression method
+		Put(block, uint16_t {0});        // Compression dictionary
+		Put(block, uint16_t {0});        // Compression frame size
+		Put(block, static_cast<int32_t>(m_bytes1.size()));
+		Put(block, static_cast<int32_t>(1 + m_bytes4.size() / 4));
+		Put(block, static_cast<int32_t>(m_bytes8.size() / 8));
+		Put(block, stringAndTypesBufferSize);
+		Put(block, uint16_t {0}); // Object count
+		Put(block, uint16_t {0}); // Array count
+		Put(block, static_cast<uint32_t>(data.size()));
+		Put(block, static_cast<uint32_t>(data.size()));
+		Put(block, uint32_t {0}); // Blob count
+		Put(block, uint32_t {0}); // Total blob size
+		if(version >= 4) {
+			Put(block, static_cast<uint32_t>(m_bytes2.size() / 2));
+			Put(block, uint32_t {0});
+		}
+		block.insert(block.end(), data.begin(), data.end());
+		return block;
+	}
+
+	template<typename T>
+	static void Put(std::vector<uint8_t> &out, T value)
+	{
+		auto offset = out.size();
+		out.resize(offset + sizeof(T));
+		memcpy(out.data() + offset, &value, sizeof(T));
+	}
+  private:
+	static void Align(std::vector<uint8_t> &data, size_t alignment) { data.resize((data.size() + alignment - 1) / alignment * alignment); }
+	void Type(KVType type) { m_types.push_back(static_cast<uint8_t>(type)); }
+	int32_t String(const std::string &str)
+	{
+		auto it = std::find(m_strings.begin(), m_strings.end(), str);
+		if(it != m_strings.end())
+			return static_cast<int32_t>(it - m_strings.begin());
+		m_strings.push_back(str);
+		return static_cast<int32_t>(m_strings.size() - 1);
+	}
+	std::vector<uint8_t> m_bytes1;
+	std::vector<uint8_t> m_bytes2;
+	std::vector<uint8_t> m_bytes4;
+	std::vector<uint8_t> m_bytes8;
+	std::vector<uint8_t> m_types;
+	std::vector<std::string> m_strings;
+};
+
+// Resource file with a single DATA block. The resource type is unknown, so the block is detected by its KV3 magic.
+static std::vector<uint8_t> build_resource(const std::vector<uint8_t> &block)
+{
+	constexpr uint32_t headerSize = 28;
+	std::vector<uint8_t> file;
+	KV3Writer::Put(file, static_cast<uint32_t>(headerSize + block.size()));
+	KV3Writer::Put(file, uint16_t {12}); // Header version
+	KV3Writer::Put(file, uint16_t {0});  // Resource version
+	KV3Writer::Put(file, uint32_t {8});  // Block offset
+	KV3Writer::Put(file, uint32_t {1});  // Block count
+	file.insert(file.end(), {'D', 'A', 'T', 'A'});
+	KV3Writer::Put(file, uint32_t {headerSize - 20}); // Relative to the offset field
+	KV3Writer::Put(file, static_cast<uint32_t>(block.size()));
+	file.insert(file.end(), block.begin(), block.end());
+	return file;
+}
+
+static std::shared_ptr<source2::resource::Resource> load(std::vector<uint8_t> &file, source2::resource::KV3Representation representation)
+{
+	source2::resource::ResourceLoadOptions options {};
+	options.kv3Representation = representation;
+	ufile::MemoryFile f {file.data(), file.size()};
+	return source2::load_resource(f, options);
+}
+
+static uint32_t g_failures = 0;
+static void check(bool condition, const std::string &msg)
+{
+	if(condition)
+		return;
+	std::cerr << "FAILED: " << msg << std::endl;
+	++g_failures;
+}
+
+static std::string describe(uint8_t version, source2::resource::KV3Representation representation)
+{
+	return "KV3\\x0" + std::to_string(version) + (representation == source2::resource::KV3Representation::Document ? " (Document)" : (representation == source2::resource::KV3Representation::Raw ? " (Raw)" : " (Tree)"));
+}
+
+// Values which every version can store
+constexpr uint32_t COMMON_MEMBER_COUNT = 6;
+static const std::array<bool, 3> g_bools = {true, false, true};
+static const std::array<std::string, 3> g_names = {"first", "", "kv3"};
+static void write_common(KV3Writer &writer)
+{
+	writer.Key("m_int");
+	writer.Int32(-7);
+	writer.Key("m_double");
+	writer.Double(2.25);
+	writer.Key("m_bool");
+	writer.Boolean(true);
+	writer.String("m_name", "kv3");
+	writer.Key("m_bools");
+	writer.TypedBoolArray(g_bools);
+	writer.Key("m_names");
+	writer.TypedStringArray(g_names);
+}
+static void check_common(source2::resource::IKeyValueCollection &root, const std::string &desc)
+{
+	check(root.FindValue<int32_t>("m_int") == -7, desc + ": m_int");
+	check(root.FindValue<double>("m_double") == 2.25, desc + ": m_double");
+	check(root.FindValue<bool>("m_bool") == true, desc + ": m_bool");
+	check(root.FindValue<std::string>("m_name") == "kv3", desc + ": m_name");
+
+	// Keys that aren't string literals are hashed at runtime
+	auto intKey = std::string {"m_"} + "int";
+	char keyBuffer[32] {};
+	std::copy(intKey.begin(), intKey.end(), keyBuffer);
+	check(root.FindValue<int32_t>(keyBuffer) == -7, desc + ": m_int by char buffer");
+	auto key = std::string {"m_double"};
+	check(root.FindValue<double>(std::string_view {key}) == 2.25, desc + ": m_double by string view");
+
+	auto bools = root.FindArrayValues<bool>("m_bools");
+	check(std::equal(bools.begin(), bools.end(), g_bools.begin(), g_bools.end()), desc + ": m_bools");
+	auto names = root.FindArrayValues<std::string>("m_names");
+	check(std::equal(names.begin(), names.end(), g_names.begin(), g_names.end()), desc + ": m_names");
+
+	// Typed arrays of the tree are stored in a single buffer, the KVValues of the elements are created on first access
+	auto *object = dynamic_cast<source2::resource::KVObject *>(&root);
+	if(!object)
+		return;
+	auto *boolArray = object->FindArray("m_bools");
+	check(boolArray && boolArray->HasTypedArray(), desc + ": m_bools is not stored as a typed array");
+	check(boolArray && boolArray->GetArrayValues().size() == g_bools.size(), desc + ": m_bools values are not created on access");
+	auto *nameArray = object->FindArray("m_names");
+	check(nameArray && nameArray->HasTypedArray(), desc + ": m_names is not stored as a typed array");
+	auto *name = nameArray ? nameArray->FindValue("2") : nullptr;
+	check(name && name->GetObjectValue<std::string>() == "kv3", desc + ": m_names[2] is not created on access");
+
+	// Array elements aren't owned by a shared_ptr, adding one to an object copies it
+	if(name) {
+		source2::resource::KVObject copy {"copy"};
+		copy.AddProperty("m_name", *name);
+		check(copy.FindValue<std::string>("m_name") == "kv3", desc + ": array element could not be added to an object");
+	}
+}
+
+// Counts the scalars of the raw representation, which are reported with their widened types
+class ScalarCounter : public source2::resource::KV3Visitor {
+  public:
+	virtual void Scalar(const source2::resource::KV3Node &value, std::string_view str) override { ++counts[value.type]; }
+	std::map<KVType, uint32_t> counts;
+};
+
+static void check_versions()
+{
+	constexpr std::array<source2::resource::KV3Representation, 3> representations = {source2::resource::KV3Representation::Tree, source2::resource::KV3Representation::Document, source2::resource::KV3Representation::Raw};
+	for(uint8_t version = 2; version <= 3; ++version) {
+		KV3Writer writer {};
+		writer.BeginObject(COMMON_MEMBER_COUNT);
+		write_common(writer);
+		auto file = build_resource(writer.Build(version));
+		for(auto representation : representations) {
+			auto desc = describe(version, representation);
+			try {
+				auto resource = load(file, representation);
+				auto *kv3 = resource ? dynamic_cast<source2::resource::BinaryKV3 *>(resource->GetBlock(0).get()) : nullptr;
+				check(kv3 != nullptr, desc + ": DATA block is not a BinaryKV3");
+				if(kv3 && representation != source2::resource::KV3Representation::Raw)
+					check_common(*kv3->GetCollection(), desc);
+			}
+			catch(const std::exception &e) {
+				check(false, desc + ": " + e.what());
+			}
+		}
+	}
+
+	KV3Writer writer {};
+	writer.BeginObject(COMMON_MEMBER_COUNT + 6);
+	write_common(writer);
+	writer.Key("m_int16");
+	writer.Int16(-1234);
+	writer.Key("m_uint16");
+	writer.UInt16(54321);
+	writer.Key("m_float");
+	writer.Float(1.5f);
+	std::array<int16_t, 5> int16s = {1, -2, 3, std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max()};
+	writer.Key("m_int16s");
+	writer.TypedInt16Array(int16s);
+	std::array<float, 3> floats = {0.5f, -4.0f, 1e10f};
+	writer.Key("m_floats");
+	writer.TypedFloatArray(floats);
+	writer.Key("m_after");
+	writer.Int32(99); // Reads from the four-byte section after the typed float array
+	auto file = build_resource(writer.Build(4));
+	for(auto representation : representations) {
+		auto desc = describe(4, representation);
+		try {
+			auto resource = load(file, representation);
+			auto *kv3 = resource ? dynamic_cast<source2::resource::BinaryKV3 *>(resource->GetBlock(0).get()) : nullptr;
+			check(kv3 != nullptr, desc + ": DATA block is not a BinaryKV3");
+			if(!kv3)
+				continue;
+			if(representation == source2::resource::KV3Representation::Raw) {
+				ScalarCounter counter {};
+				kv3->Visit(counter);
+				check(counter.counts[KVType::INT32] == 1 + 1 + 1 + int16s.size(), desc + ": INT16 values are not reported as INT32");
+				check(counter.counts[KVType::UINT32] == 1, desc + ": UINT16 values are not reported as UINT32");
+				check(counter.counts[KVType::DOUBLE] == 1 + 1 + floats.size(), desc + ": FLOAT values are not reported as DOUBLE");
+				continue;
+			}
+			auto &root = *kv3->GetCollection();
+			check_common(root, desc);
+			check(root.FindValue<int32_t>("m_int16") == -1234, desc + ": m_int16");
+			check(root.FindValue<uint32_t>("m_uint16") == 54321, desc + ": m_uint16");
+			check(root.FindValue<float>("m_float") == 1.5f, desc + ": m_float");
+			auto int16Values = root.FindArrayValues<int32_t>("m_int16s");
+			check(std::equal(int16Values.begin(), int16Values.end(), int16s.begin(), int16s.end()), desc + ": m_int16s");
+			auto floatValues = root.FindArrayValues<float>("m_floats");
+			check(std::equal(floatValues.begin(), floatValues.end(), floats.begin(), floats.end()), desc + ": m_floats");
+			check(root.FindValue<int32_t>("m_after") == 99, desc + ": m_after");
+		}
+		catch(const std::exception &e) {
+			check(false, desc + ": " + e.what());
+		}
+	}
+
+	// A 16-bit value without a two-byte section (i.e. before KV3\x04) is invalid
+	auto invalid = build_resource(writer.Build(3));
+	auto threw = false;
+	try {
+		load(invalid, source2::resource::KV3Representation::Tree);
+	}
+	catch(const std::exception &) {
+		threw = true;
+	}
+	check(threw, "KV3\\x03 with 16-bit values was accepted");
+
+	// Lazy blocks are only parsed once, the parsing error is rethrown on every access
+	source2::resource::ResourceLoadOptions lazyOptions {};
+	lazyOptions.lazyBlocks = true;
+	ufile::MemoryFile lazyFile {invalid.data(), invalid.size()};
+	auto lazyResource = source2::load_resource(lazyFile, lazyOptions);
+	check(lazyResource != nullptr, "KV3\\x03 with 16-bit values could not be loaded with lazy blocks");
+	if(lazyResource) {
+		std::array<std::string, 2> errors;
+		for(auto &err : errors) {
+			try {
+				lazyResource->FindBlock(source2::BlockType::DATA);
+			}
+			catch(const std::exception &e) {
+				err = e.what();
+			}
+		}
+		check(!errors[0].empty() && errors[1] == errors[0], "Lazy block error was not rethrown: '" + errors[0] + "', '" + errors[1] + "'");
+	}
+
+	// KV3\x05 has a different buffer layout, which is not supported
+	std::vector<uint8_t> v5Block;
+	KV3Writer::Put(v5Block, static_cast<uint32_t>(source2::resource::BinaryKV3::MAGIC2 & ~0xFFu) | 5u);
+	v5Block.resize(256);
+	auto v5 = build_resource(v5Block);
+	std::string error;
+	try {
+		load(v5, source2::resource::KV3Representation::Tree);
+	}
+	catch(const std::exception &e) {
+		error = e.what();
+	}
+	check(error == "Unsupported KV3 version 5", "KV3\\x05 was not rejected: '" + error + "'");
+}
+
+int main(int argc, char *argv[])
+{
+	check_versions();
+	if(g_failures > 0) {
+		std::cerr << g_failures << " check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}
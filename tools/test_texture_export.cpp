@@ -0,0 +1,297 @@
+// SPDX-FileCopyrightText: (c) 2024 Silverlan <opensource@pragma-engine.com>
+// SPDX-License-Identifier: MIT
+
+// Exports synthetic texture resources as DDS and KTX2 and parses the containers back.
+// - Checks the DDS and DX10 headers, the KTX2 header, level index and data format descriptor, including the sRGB variants.
+// - Every byte of the stored mipmaps is unique enough to detect wrong face, slice or mip ordering and a wrong non-power-of-two crop.
+// Usage: test_texture_export
+
+import source2;
+
+namespace {
+	struct TextureDesc {
+		const char *name;
+		source2::VTexFormat format;
+		source2::VTexFlags flags;
+		uint16_t width;
+		uint16_t height;
+		uint16_t depth;
+		uint8_t mipCount;
+		// Size stored as FILL_TO_POWER_OF_TWO extra data, 0 if the texture doesn't have any
+		uint16_t nonPow2Width = 0;
+		uint16_t nonPow2Height = 0;
+	};
+
+	struct FormatLayout {
+		uint32_t blockDim;
+		uint32_t blockSize;
+		uint32_t dxgiFormat;
+		uint32_t dxgiSrgbFormat; // Same as dxgiFormat if there is no sRGB variant
+		uint32_t vkFormat;
+		uint32_t vkSrgbFormat;
+	};
+};
+
+static const std::vector<TextureDesc> g_textures = {
+  {"BC1 2D", source2::DXT1, source2::VTexFlags::None, 16, 16, 1, 5},
+  {"BC7 non-power-of-two", source2::BC7, source2::VTexFlags::None, 16, 16, 1, 3, 10, 6},
+  {"BC3 cube", source2::DXT5, source2::VTexFlags::CUBE_TEXTURE, 8, 8, 1, 2},
+  {"BC1 array", source2::DXT1, source2::VTexFlags::TEXTURE_ARRAY, 8, 8, 4, 2},
+  {"BC4 2D", source2::ATI1N, source2::VTexFlags::None, 8, 4, 1, 2},
+  {"RGBA8888 volume", source2::RGBA8888, source2::VTexFlags::VOLUME_TEXTURE, 4, 4, 4, 3},
+  {"RGBA8888 non-power-of-two cube", source2::RGBA8888, source2::VTexFlags::CUBE_TEXTURE, 8, 8, 1, 2, 5, 3},
+};
+
+static uint32_t g_failures = 0;
+static void check(bool condition, const std::string &msg)
+{
+	if(condition)
+		return;
+	std::cerr << "FAILED: " << msg << std::endl;
+	++g_failures;
+}
+
+static FormatLayout get_format_layout(source2::VTexFormat format)
+{
+	switch(format) {
+	case source2::DXT1:
+		return {4, 8, 71, 72, 133, 134};
+	case source2::DXT5:
+		return {4, 16, 77, 78, 137, 138};
+	case source2::BC7:
+		return {4, 16, 98, 99, 145, 146};
+	case source2::ATI1N:
+		return {4, 8, 80, 80, 139, 139};
+	case source2::RGBA8888:
+		return {1, 4, 28, 29, 37, 43};
+	default:
+		throw std::runtime_error {"Unsupported test format"};
+	}
+}
+
+static bool has_flag(const TextureDesc &desc, source2::VTexFlags flag) { return (static_cast<uint16_t>(desc.flags) & static_cast<uint16_t>(flag)) != 0; }
+static uint32_t get_face_count(const TextureDesc &desc) { return has_flag(desc, source2::VTexFlags::CUBE_TEXTURE) ? 6 : 1; }
+static uint32_t get_mip_depth(const TextureDesc &desc, uint8_t mip) { return std::max<uint32_t>(has_flag(desc, source2::VTexFlags::VOLUME_TEXTURE) ? (desc.depth >> mip) : desc.depth, 1); }
+static uint32_t get_mip_extent(uint32_t size, uint8_t mip) { return std::max(size >> mip, 1u); }
+static uint32_t get_visible_width(const TextureDesc &desc) { return (desc.nonPow2Width > 0) ? desc.nonPow2Width : desc.width; }
+static uint32_t get_visible_height(const TextureDesc &desc) { return (desc.nonPow2Height > 0) ? desc.nonPow2Height : desc.height; }
+
+// Size of a single face or slice of a mipmap with the specified dimensions
+static uint32_t get_row_size(const FormatLayout &layout, uint32_t width) { return (width + layout.blockDim - 1) / layout.blockDim * layout.blockSize; }
+static uint32_t get_row_count(const FormatLayout &layout, uint32_t height) { return (height + layout.blockDim - 1) / layout.blockDim; }
+
+static uint8_t get_stored_byte(uint8_t mip, size_t offset) { return static_cast<uint8_t>((static_cast<uint32_t>(offset) * 2654435761u + mip * 40503u) >> 24); }
+
+template<typename T>
+static void put(std::vector<uint8_t> &data, const T &value)
+{
+	auto offset = data.size();
+	data.resize(offset + sizeof(T));
+	memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+template<typename T>
+static T get(const std::vector<uint8_t> &data, size_t offset)
+{
+	T value {};
+	if(offset + sizeof(T) <= data.size())
+		memcpy(&value, data.data() + offset, sizeof(T));
+	return value;
+}
+
+// Assembles the texture block followed by the mipmaps, smallest one first
+static std::vector<uint8_t> build_texture(const TextureDesc &desc, uint32_t &outBlockSize)
+{
+	auto layout = get_format_layout(desc.format);
+	std::vector<uint8_t> data;
+	put<uint16_t>(data, 1);
+	put(data, desc.flags);
+	put(data, std::array<float, 4> {});
+	put(data, desc.width);
+	put(data, desc.height);
+	put(data, desc.depth);
+	put(data, desc.format);
+	put(data, desc.mipCount);
+	put<uint32_t>(data, 0);
+	auto hasExtraData = desc.nonPow2Width > 0;
+	// Offsets are relative to the offset field
+	put<uint32_t>(data, hasExtraData ? 8 : 0);
+	put<uint32_t>(data, hasExtraData ? 1 : 0);
+	if(hasExtraData) {
+		put(data, source2::VTexExtraData::FILL_TO_POWER_OF_TWO);
+		put<uint32_t>(data, 8);
+		put<uint32_t>(data, 6);
+		put<uint16_t>(data, 0);
+		put(data, desc.nonPow2Width);
+		put(data, desc.nonPow2Height);
+	}
+	outBlockSize = static_cast<uint32_t>(data.size());
+
+	for(auto mip = static_cast<int32_t>(desc.mipCount) - 1; mip >= 0; --mip) {
+		auto sliceSize = static_cast<size_t>(get_row_size(layout, get_mip_extent(desc.width, mip))) * get_row_count(layout, get_mip_extent(desc.height, mip));
+		auto mipSize = sliceSize * get_mip_depth(desc, mip) * get_face_count(desc);
+		for(auto i = decltype(mipSize) {0u}; i < mipSize; ++i)
+			data.push_back(get_stored_byte(mip, i));
+	}
+	return data;
+}
+
+static std::shared_ptr<source2::resource::Texture> load_texture(const TextureDesc &desc)
+{
+	uint32_t blockSize;
+	auto data = build_texture(desc, blockSize);
+	ufile::MemoryFile f {data.data(), data.size()};
+	source2::resource::Resource resource {nullptr};
+	auto texture = std::make_shared<source2::resource::Texture>();
+	texture->SetOffset(0);
+	texture->SetSize(blockSize);
+	texture->Read(resource, f);
+	return texture;
+}
+
+// Expected contents of a single face or slice of a mipmap, cropped to the non-power-of-two size
+static std::vector<uint8_t> get_expected_slice(const TextureDesc &desc, uint8_t mip, uint32_t slice)
+{
+	auto layout = get_format_layout(desc.format);
+	auto storedRowSize = get_row_size(layout, get_mip_extent(desc.width, mip));
+	auto storedSliceSize = static_cast<size_t>(storedRowSize) * get_row_count(layout, get_mip_extent(desc.height, mip));
+	auto rowSize = get_row_size(layout, get_mip_extent(get_visible_width(desc), mip));
+	auto numRows = get_row_count(layout, get_mip_extent(get_visible_height(desc), mip));
+	std::vector<uint8_t> data;
+	for(auto row = decltype(numRows) {0u}; row < numRows; ++row) {
+		for(auto i = decltype(rowSize) {0u}; i < rowSize; ++i)
+			data.push_back(get_stored_byte(mip, storedSliceSize * slice + static_cast<size_t>(row) * storedRowSize + i));
+	}
+	return data;
+}
+
+static void append(std::vector<uint8_t> &data, const std::vector<uint8_t> &other) { data.insert(data.end(), other.begin(), other.end()); }
+
+static void check_dds(const TextureDesc &desc, const source2::resource::Texture &texture, bool srgb)
+{
+	auto name = std::string {desc.name} + (srgb ? " (sRGB)" : "") + " DDS";
+	auto layout = get_format_layout(desc.format);
+	auto isCube = has_flag(desc, source2::VTexFlags::CUBE_TEXTURE);
+	auto isVolume = has_flag(desc, source2::VTexFlags::VOLUME_TEXTURE);
+	std::vector<uint8_t> dds;
+	check(texture.ExportDDS(dds, srgb), name + ": export failed");
+	constexpr size_t headerSize = 4 + 124 + 20;
+	if(dds.size() < headerSize) {
+		check(false, name + ": file is too small");
+		return;
+	}
+	check(memcmp(dds.data(), "DDS ", 4) == 0, name + ": invalid magic");
+	check(get<uint32_t>(dds, 4) == 124, name + ": invalid header size");
+	check(get<uint32_t>(dds, 12) == get_visible_height(desc), name + ": invalid height");
+	check(get<uint32_t>(dds, 16) == get_visible_width(desc), name + ": invalid width");
+	auto pitch = (layout.blockDim > 1) ? get_row_size(layout, get_visible_width(desc)) * get_row_count(layout, get_visible_height(desc)) : get_row_size(layout, get_visible_width(desc));
+	check(get<uint32_t>(dds, 20) == pitch, name + ": invalid pitch or linear size");
+	check(get<uint32_t>(dds, 24) == (isVolume ? desc.depth : 0u), name + ": invalid depth");
+	check(get<uint32_t>(dds, 28) == desc.mipCount, name + ": invalid mipmap count");
+	check(get<uint32_t>(dds, 80) == 0x4 && memcmp(dds.data() + 84, "DX10", 4) == 0, name + ": missing DX10 pixel format");
+	check(get<uint32_t>(dds, 112) == (isCube ? 0xFE00u : (isVolume ? 0x200000u : 0u)), name + ": invalid caps2");
+
+	check(get<uint32_t>(dds, 128) == (srgb ? layout.dxgiSrgbFormat : layout.dxgiFormat), name + ": invalid DXGI format");
+	check(get<uint32_t>(dds, 132) == (isVolume ? 4u : 3u), name + ": invalid resource dimension");
+	check(get<uint32_t>(dds, 136) == (isCube ? 0x4u : 0u), name + ": invalid misc flags");
+	check(get<uint32_t>(dds, 140) == (isVolume ? 1u : desc.depth), name + ": invalid array size");
+
+	// Volume textures store all slices of a mipmap together, otherwise every face and layer stores its mip chain
+	std::vector<uint8_t> expected;
+	if(isVolume) {
+		for(auto mip = decltype(desc.mipCount) {0u}; mip < desc.mipCount; ++mip) {
+			for(auto slice = 0u; slice < get_mip_depth(desc, mip); ++slice)
+				append(expected, get_expected_slice(desc, mip, slice));
+		}
+	}
+	else {
+		for(auto slice = 0u; slice < desc.depth * get_face_count(desc); ++slice) {
+			for(auto mip = decltype(desc.mipCount) {0u}; mip < desc.mipCount; ++mip)
+				append(expected, get_expected_slice(desc, mip, slice));
+		}
+	}
+	check(dds.size() == headerSize + expected.size() && memcmp(dds.data() + headerSize, expected.data(), expected.size()) == 0, name + ": texture data does not match");
+}
+
+static void check_ktx2(const TextureDesc &desc, const source2::resource::Texture &texture, bool srgb)
+{
+	auto name = std::string {desc.name} + (srgb ? " (sRGB)" : "") + " KTX2";
+	auto layout = get_format_layout(desc.format);
+	auto isVolume = has_flag(desc, source2::VTexFlags::VOLUME_TEXTURE);
+	std::vector<uint8_t> ktx;
+	check(texture.ExportKTX2(ktx, srgb), name + ": export failed");
+	constexpr size_t levelIndexOffset = 80;
+	if(ktx.size() < levelIndexOffset + desc.mipCount * sizeof(uint64_t) * 3) {
+		check(false, name + ": file is too small");
+		return;
+	}
+	check(ktx[0] == 0xAB && memcmp(ktx.data() + 1, "KTX 20", 6) == 0, name + ": invalid identifier");
+	auto vkFormat = srgb ? layout.vkSrgbFormat : layout.vkFormat;
+	check(get<uint32_t>(ktx, 12) == vkFormat, name + ": invalid VkFormat");
+	check(get<uint32_t>(ktx, 16) == 1, name + ": invalid type size");
+	check(get<uint32_t>(ktx, 20) == get_visible_width(desc), name + ": invalid width");
+	check(get<uint32_t>(ktx, 24) == get_visible_height(desc), name + ": invalid height");
+	check(get<uint32_t>(ktx, 28) == (isVolume ? desc.depth : 0u), name + ": invalid depth");
+	check(get<uint32_t>(ktx, 32) == ((!isVolume && desc.depth > 1) ? desc.depth : 0u), name + ": invalid layer count");
+	check(get<uint32_t>(ktx, 36) == get_face_count(desc), name + ": invalid face count");
+	check(get<uint32_t>(ktx, 40) == desc.mipCount, name + ": invalid level count");
+
+	// Data format descriptor
+	auto dfdOffset = get<uint32_t>(ktx, 48);
+	auto dfdSize = get<uint32_t>(ktx, 52);
+	check(dfdOffset == levelIndexOffset + desc.mipCount * sizeof(uint64_t) * 3, name + ": data format descriptor does not follow the level index");
+	check(dfdOffset + dfdSize <= ktx.size() && get<uint32_t>(ktx, dfdOffset) == dfdSize, name + ": invalid data format descriptor size");
+	auto isSrgb = (vkFormat != layout.vkFormat);
+	check(ktx[dfdOffset + 14] == (isSrgb ? 2 : 1), name + ": invalid transfer function");
+	check(ktx[dfdOffset + 16] == layout.blockDim - 1 && ktx[dfdOffset + 17] == layout.blockDim - 1, name + ": invalid texel block dimensions");
+	check(ktx[dfdOffset + 20] == layout.blockSize, name + ": invalid bytes per plane");
+	auto numSamples = (dfdSize - 28) / 16;
+	for(auto i = 0u; i < numSamples; ++i) {
+		auto channelType = ktx[dfdOffset + 28 + i * 16 + 3];
+		// The alpha channel of uncompressed sRGB formats is linear
+		if((channelType & 0xF) == 15 && layout.blockDim == 1)
+			check(channelType == (isSrgb ? 0x1F : 0xF), name + ": invalid alpha sample qualifiers");
+	}
+
+	// Level index, the mipmaps are stored from the smallest to the largest one
+	auto alignment = std::lcm(layout.blockSize, 4u);
+	auto prevOffset = static_cast<uint64_t>(ktx.size());
+	for(auto mip = decltype(desc.mipCount) {0u}; mip < desc.mipCount; ++mip) {
+		auto entry = levelIndexOffset + mip * sizeof(uint64_t) * 3;
+		auto offset = get<uint64_t>(ktx, entry);
+		auto size = get<uint64_t>(ktx, entry + sizeof(uint64_t));
+		auto mipName = name + " mipmap " + std::to_string(mip);
+		check(get<uint64_t>(ktx, entry + sizeof(uint64_t) * 2) == size, mipName + ": uncompressed size does not match");
+		check(offset % alignment == 0, mipName + ": level is not aligned");
+		check(offset + size <= prevOffset, mipName + ": level is not stored before the previous one");
+		prevOffset = offset;
+		std::vector<uint8_t> expected;
+		for(auto slice = 0u; slice < get_mip_depth(desc, mip) * get_face_count(desc); ++slice)
+			append(expected, get_expected_slice(desc, mip, slice));
+		check(size == expected.size() && offset + size <= ktx.size() && memcmp(ktx.data() + offset, expected.data(), expected.size()) == 0, mipName + ": texture data does not match");
+	}
+	check(prevOffset >= dfdOffset + dfdSize, name + ": levels overlap the data format descriptor");
+}
+
+int main(int argc, char *argv[])
+{
+	try {
+		for(auto &desc : g_textures) {
+			auto texture = load_texture(desc);
+			for(auto srgb : {false, true}) {
+				check_dds(desc, *texture, srgb);
+				check_ktx2(desc, *texture, srgb);
+			}
+		}
+	}
+	catch(const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	if(g_failures > 0) {
+		std::cerr << g_failures << " check(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed" << std::endl;
+	return EXIT_SUCCESS;
+}